@@ -0,0 +1,39 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdint.h>
+
+/*
+ * 学号 B+ 树索引（磁盘文件，4KB 页）
+ *
+ * 键为 (学号, 记录号)，允许多条记录学号相同（如还没设置学号的学生都是 0）；
+ * 叶子页按键有序并串成链表，查找一个学号是 O(log n) 次页读取。
+ * 删除只从叶子页移除键，不合并页；重建时整棵树重新紧凑排列。
+ */
+
+typedef struct
+{
+    int fd;
+    uint32_t root;      // 根页号
+    uint32_t pages;     // 文件中的页数（含第 0 页的文件头）
+    uint32_t height;    // 1 表示根就是叶子
+} BPTree;
+
+// 打开已有的索引，records 为数据文件当前的记录数
+// 返回值: 索引完整且与数据文件一致返回 SUCCESS；否则返回 FAILURE，需要调用 bptree_build 重建
+int bptree_open(BPTree *tree, const char *path, uint32_t records);
+
+// 按数据文件中的全部学号重建索引，ids[i] 为第 i 条记录的学号（自底向上批量构建）
+int bptree_build(BPTree *tree, const char *path, const long long *ids, uint32_t records);
+
+int bptree_insert(BPTree *tree, long long id, uint32_t slot);
+int bptree_remove(BPTree *tree, long long id, uint32_t slot);
+
+// 按记录号从小到大对学号为 id 的每条记录调用 fn，fn 返回非 0 时停止
+// 返回值: fn 的返回值（遍历完返回 0）；读索引失败返回 -1
+int bptree_find(BPTree *tree, long long id, int (*fn)(uint32_t slot, void *ctx), void *ctx);
+
+// 落盘并标记为一致（records 为数据文件的记录数），然后关闭
+void bptree_close(BPTree *tree, uint32_t records);
+
+#endif // BPTREE_H
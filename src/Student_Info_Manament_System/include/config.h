@@ -13,6 +13,17 @@
 
 /* 文件路径 */
 #define DATA_FILE "data/students.dat"   // 数据文件路径
+#define INDEX_USER_FILE "data/students.hidx"  // 用户名哈希索引
+#define INDEX_ID_FILE "data/students.bidx"    // 学号 B+ 树索引
+#define WAL_FILE "data/students.wal"          // 数据文件的预写日志
+
+/* 存储引擎 */
+#define STORAGE_SYNC_DEFAULT SYNC_EACH  // 日志落盘策略，见 storage.h
+#define SYNC_INTERVAL_SEC 1             // SYNC_INTERVAL 策略的落盘间隔
+#define WAL_CHECKPOINT_SIZE (4 << 20)   // 日志超过这么大时做检查点
+#define COMPACT_INTERVAL_SEC 10         // 后台检查是否需要整理的间隔
+#define COMPACT_MIN_FREE 64             // 空闲槽至少这么多、且占 1/4 以上时才整理
+#define COMPACT_BATCH 256               // 整理时每次持锁搬动的记录数
 
 /* 管理员配置 */
 #define ADMIN_USERNAME "admin"       // 默认管理员用户名
@@ -0,0 +1,54 @@
+#ifndef DATA_FILE_H
+#define DATA_FILE_H
+
+#include "record_format.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 学生数据文件（内存映射）
+ *
+ * 文件格式见 record_format.h：文件头 + 字段表 + 小端紧密排列的定长记录。
+ * 打开时校验文件头和字段表，并把整个文件只读映射进内存，records 就是记录数组的只读视图：
+ * 读第 i 条记录只是指针运算加逐字段解码，遍历全部记录不需要任何系统调用。
+ * 写入仍用 pwrite，共享映射立即可见；记录数超过映射容量时按两倍重新映射。
+ *
+ * 文件头里的记录数只在 data_file_sync 时更新（数据先落盘，再写文件头），
+ * 所以它永远不会超过文件中已落盘的记录；之后追加的记录由预写日志负责恢复。
+ * 旧格式或旧结构版本的数据文件在打开时用 migrate_file 流式升级。
+ */
+
+typedef struct
+{
+    int fd;
+    uint32_t count;                 // 槽数（含墓碑）
+    uint32_t capacity;              // 当前映射能容纳的槽数
+    const unsigned char *records;   // 只读视图，第 i 条记录从 records + i * STUDENT_RECORD_SIZE 开始
+    uint32_t header_size;           // 文件头（含字段表）大小
+    void *map;
+    size_t map_len;
+    uint32_t header_count;          // 文件头中的记录数
+} DataFile;
+
+// 打开（不存在时创建）数据文件，校验文件头并映射
+// 返回值: 成功返回 SUCCESS；文件头不对或映射失败返回 FAILURE
+int data_file_open(DataFile *df, const char *path);
+
+// 从映射中解码第 slot 条记录
+int data_file_read(const DataFile *df, uint32_t slot, studentInfo *record);
+
+// 写第 slot 条记录；slot 等于 count 时追加，映射不够大时重新映射（之前取得的 records 指针失效）
+int data_file_write(DataFile *df, uint32_t slot, const studentInfo *record);
+
+// 预留 count 个槽：映射和磁盘空间都准备好，之后写这些槽不会因为重新映射或磁盘满而失败
+int data_file_reserve(DataFile *df, uint32_t count);
+
+// 把记录数截断为 count，文件在下次 data_file_sync 时才真正变短
+void data_file_truncate(DataFile *df, uint32_t count);
+
+// 记录落盘，然后更新文件头中的记录数并截掉多余的部分
+int data_file_sync(DataFile *df);
+
+void data_file_close(DataFile *df);
+
+#endif // DATA_FILE_H
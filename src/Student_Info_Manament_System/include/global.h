@@ -6,7 +6,8 @@
 // 用户角色枚举
 typedef enum {
     ROLE_STUDENT = 0,  // 学生角色
-    ROLE_ADMIN = 1     // 管理员角色
+    ROLE_ADMIN = 1,    // 管理员角色
+    ROLE_DELETED = 2   // 已删除的记录槽（墓碑），等待新记录复用
 } UserRole;
 
 typedef struct
@@ -0,0 +1,42 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stdint.h>
+
+/*
+ * 用户名哈希索引（磁盘文件，线性探测开放寻址）
+ *
+ * 文件 = 64 字节头 + capacity 个槽，每个槽为 用户名(16) + 记录号(4)；
+ * 查找按哈希值定位到槽，一般一两次 pread 就能命中，与学生人数无关。
+ * 装载率超过 3/4 时容量翻倍并重新散列。
+ */
+
+#define HASH_USER_LEN 16
+
+typedef struct
+{
+    int fd;
+    uint32_t capacity;  // 槽数，2 的幂
+    uint32_t count;     // 已用的槽数
+} HashIndex;
+
+// 打开已有的索引，records 为数据文件当前的记录数
+// 返回值: 索引完整且与数据文件一致返回 SUCCESS；否则返回 FAILURE，需要调用 hash_index_build 重建
+int hash_index_open(HashIndex *idx, const char *path, uint32_t records);
+
+// 按数据文件中的全部用户名重建索引，users[i] 为第 i 条记录的用户名；用户名重复时保留第一条
+int hash_index_build(HashIndex *idx, const char *path, const char (*users)[HASH_USER_LEN], uint32_t records);
+
+// 查找用户名对应的记录号
+int hash_index_find(HashIndex *idx, const char *user, uint32_t *slot);
+
+// 插入或更新用户名对应的记录号
+int hash_index_insert(HashIndex *idx, const char *user, uint32_t slot);
+
+// 删除用户名
+int hash_index_remove(HashIndex *idx, const char *user);
+
+// 落盘并标记为一致（records 为数据文件的记录数），然后关闭
+void hash_index_close(HashIndex *idx, uint32_t records);
+
+#endif // HASH_INDEX_H
@@ -0,0 +1,56 @@
+#ifndef MIGRATE_H
+#define MIGRATE_H
+
+#include "record_format.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * 数据文件流式迁移
+ *
+ * 把任意已知格式的数据文件转换为当前格式（见 record_format.h）：
+ * 源文件按块切分，多个线程各自领取一块，pread → 按字段名转换 → pwrite 到目标文件的固定位置，
+ * 块之间互不依赖，不需要按顺序写。内存占用只有 线程数 × 块大小，与文件大小无关。
+ *
+ * 能识别的源文件：
+ *   - 格式 2（自描述，任意结构版本）：按文件里的字段表转换
+ *   - 格式 1（64 字节文件头 + 本机 studentInfo）
+ *   - 没有文件头的旧文件，按下面三种 x86-64 上的结构体布局读取
+ */
+
+typedef enum
+{
+    LEGACY_AUTO = 0,    // 按文件大小推断，有多种可能或抽查不合理时失败
+    LEGACY_V1,          // v1.0：int 学号，没有 role，64 字节
+    LEGACY_V2,          // v2.0：int 学号，有 role，68 字节
+    LEGACY_V3           // long long 学号，有 role，72 字节
+} LegacyLayout;
+
+typedef struct
+{
+    int threads;                // 转换线程数，0 表示 CPU 核数
+    uint32_t chunk_records;     // 每块记录数，0 表示默认值
+    LegacyLayout legacy;        // 源文件没有文件头时的布局
+} MigrateOptions;
+
+// 识别出的源文件
+typedef struct
+{
+    uint32_t format_version;    // 0 表示没有文件头
+    uint32_t data_offset;       // 第一条记录的偏移
+    uint32_t count;
+    Schema schema;
+} MigrateSource;
+
+// 识别 fd 指向的数据文件（size 为文件大小）
+// 返回值: 能识别且记录完整返回 SUCCESS
+int migrate_probe(int fd, off_t size, LegacyLayout legacy, MigrateSource *src);
+
+// 源文件是否已经是当前格式和结构版本
+int migrate_is_current(const MigrateSource *src);
+
+// 把 src_path 转换为当前格式写到 dst_path（覆盖），完成后 fdatasync
+// 返回值: 成功返回 SUCCESS，*source 为识别出的源文件（可以为 NULL）
+int migrate_file(const char *src_path, const char *dst_path, const MigrateOptions *opts, MigrateSource *source);
+
+#endif // MIGRATE_H
@@ -0,0 +1,97 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+#include "global.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 学生数据文件格式（自描述）
+ *
+ * 文件 = 64 字节文件头 + 字段表 + 定长记录数组，所有整数都按小端序逐字节编码，
+ * 记录内的字段紧密排列、没有填充，与编译器和结构体对齐无关。
+ *
+ * 文件头: 魔数 "SDAT" | 格式版本 | 文件头大小（含字段表）| 记录大小 | 记录数 | 结构版本 | 字段数
+ * 字段表: 每个字段 32 字节 = 名称(16) | 类型(1) | 保留(1) | 大小(2) | 在记录中的偏移(4) | 保留(8)
+ *
+ * 读取方只认自己编译时的结构版本；其他版本的文件用 migrate_file 按字段名逐个转换。
+ */
+
+#define DATA_MAGIC "SDAT"
+#define FORMAT_VERSION 2            // 1 为 data_file 最早的文件头 + 本机 studentInfo 结构体
+#define STUDENT_SCHEMA_VERSION 1    // 当前记录结构的版本，字段增删时加一
+#define FILE_HEADER_SIZE 64
+#define FIELD_DESC_SIZE 32
+#define FIELD_NAME_LEN 16
+#define MAX_FIELDS 16
+
+typedef enum
+{
+    FIELD_INT = 1,      // 有符号整数，小端序，size 为 1/2/4/8
+    FIELD_CHARS = 2     // 定长字节串（字符串以 '\0' 补齐）
+} FieldType;
+
+typedef struct
+{
+    char name[FIELD_NAME_LEN];
+    uint8_t type;
+    uint16_t size;
+    uint32_t offset;
+} FieldDesc;
+
+typedef struct
+{
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t field_count;
+    FieldDesc fields[MAX_FIELDS];
+} Schema;
+
+// 解码后的文件头
+typedef struct
+{
+    uint32_t format_version;
+    uint32_t header_size;       // 记录从这里开始
+    uint32_t count;
+    Schema schema;
+} FileHeader;
+
+// 当前结构版本的记录布局
+extern const Schema student_schema;
+
+#define STUDENT_RECORD_SIZE 68     // 与 record_format.c 中的字段布局一致，由静态断言检查
+
+// 当前结构版本的文件头大小（含字段表）
+uint32_t file_header_size(const Schema *schema);
+
+// 把文件头编码到 buf（大小至少为 file_header_size）
+void file_header_encode(unsigned char *buf, const FileHeader *hdr);
+
+// 从 buf 解码文件头，len 为 buf 中可用的字节数
+// 返回值: 魔数、格式版本、字段表都合法时返回 SUCCESS
+int file_header_decode(const unsigned char *buf, size_t len, FileHeader *hdr);
+
+// 两个结构是否完全相同
+int schema_equal(const Schema *a, const Schema *b);
+
+// 按当前结构编码 / 解码一条记录
+void record_encode(unsigned char *out, const studentInfo *record);
+void record_decode(const unsigned char *in, studentInfo *record);
+
+// 两个结构之间按字段名的对应关系
+typedef struct
+{
+    const Schema *from;
+    const Schema *to;
+    int source[MAX_FIELDS];     // to 的第 i 个字段对应 from 的第几个字段，-1 表示没有
+} Conversion;
+
+void conversion_init(Conversion *conv, const Schema *from, const Schema *to);
+
+// 把一条 from 结构的记录转换为 to 结构：同名字段按类型和大小转换，缺少的字段为 0
+void record_convert(const Conversion *conv, const unsigned char *in, unsigned char *out);
+
+// 读出记录中的一个整数字段（按字段大小符号扩展）
+int64_t field_get_int(const FieldDesc *field, const unsigned char *record);
+
+#endif // RECORD_FORMAT_H
@@ -0,0 +1,74 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "global.h"
+#include <limits.h>
+#include <stdint.h>
+
+/*
+ * 学生数据存储引擎
+ *
+ * 数据文件 DATA_FILE 是文件头 + studentInfo 记录数组（见 data_file.h），第 i 条记录称为记录号 i；
+ * 数据文件整个映射进内存，读记录和遍历全部记录都不需要系统调用。
+ * 另外维护两个磁盘索引：用户名 -> 记录号的哈希索引，(学号, 记录号) 的 B+ 树。
+ * 登录和按用户名查找是 O(1)，按学号查找是 O(log n)，不再逐条扫描数据文件。
+ * 索引缺失、与数据文件记录数不一致或上次没有正常关闭时，打开时自动重建。
+ *
+ * 每条记录占一个固定的槽：更新直接 pwrite 到它的槽；删除写入墓碑，
+ * 空出的槽记在 B+ 树的 FREE_SLOT_ID 键下，插入时优先复用。
+ * 后台线程定期把文件末尾的记录搬进空闲槽并截断文件（整理）。
+ *
+ * 每次修改先写预写日志 WAL_FILE（见 wal.h），日志提交之后才写数据文件，数据文件只在检查点时落盘；
+ * 启动时把日志重放到数据文件。同时到达的修改排队成一批，共用一次日志提交和 fdatasync（组提交）。
+ * 日志写失败后引擎转为只读：这一批和之后的修改都返回 FAILURE 且不会写进数据文件，查询不受影响，重启后恢复。
+ * 所有接口都是线程安全的。
+ */
+
+// 墓碑记录的学号，空闲槽在 B+ 树中以 (FREE_SLOT_ID, 记录号) 登记
+#define FREE_SLOT_ID LLONG_MIN
+
+// 日志的落盘策略
+typedef enum
+{
+    SYNC_NONE = 0,      // 只写入日志文件，不主动落盘；进程崩溃不丢修改，断电可能丢
+    SYNC_EACH,          // 修改返回前日志已 fdatasync
+    SYNC_INTERVAL       // 后台线程每 SYNC_INTERVAL_SEC 秒 fdatasync 一次日志
+} SyncPolicy;
+
+// 打开数据文件和索引，程序启动时调用一次
+int storage_open(void);
+
+// 落盘索引并关闭，程序退出前调用
+void storage_close(void);
+
+// 按用户名查找（任意角色）
+int storage_find_by_username(const char *username, studentInfo *result);
+
+// 按学号查找第一个学生角色的记录
+int storage_find_by_id(long long id, studentInfo *result);
+
+// 追加一条记录，用户名已存在时失败
+int storage_insert(const studentInfo *record);
+
+// 按用户名更新整条记录
+int storage_update(const studentInfo *record);
+
+// 按用户名删除记录
+int storage_delete(const char *username);
+
+// 按记录号顺序对每条有效记录调用 fn，fn 返回非 0 时停止
+void storage_scan(int (*fn)(const studentInfo *record, void *ctx), void *ctx);
+
+// 当前的有效记录数（不含墓碑）
+uint32_t storage_count(void);
+
+// 设置落盘策略，默认为 STORAGE_SYNC_DEFAULT
+void storage_set_sync_policy(SyncPolicy policy);
+
+// 立即整理：把末尾的记录全部搬进空闲槽并截断文件
+void storage_compact(void);
+
+// 统计：写入的日志条数和日志 fdatasync 次数
+void storage_wal_stats(uint64_t *records, uint64_t *syncs);
+
+#endif // STORAGE_H
@@ -0,0 +1,67 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include "data_file.h"
+#include "global.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * 数据文件的预写日志（WAL）
+ *
+ * 文件 = 64 字节头 + 定长日志记录，只追加。每条日志是一次物理修改：
+ * 把一条记录写到某个槽，或把数据文件截断到某个记录数；重放多少次结果都一样。
+ * 每条日志带连续的序号（LSN）和 CRC32，重放遇到序号不连续或校验失败即停止（写了一半的尾部）。
+ *
+ * 组提交：wal_append 只把日志放进内存缓冲区；wal_commit 时第一个等待者成为 leader，
+ * 把缓冲区里所有线程的日志一次 write + fdatasync，其余线程等它完成。
+ * 检查点：数据文件 fdatasync 后把日志截断为空。
+ */
+
+#define WAL_OP_WRITE 1      // 把 record 写到第 slot 个槽
+#define WAL_OP_TRUNCATE 2   // 把数据文件截断为 slot 条记录
+
+typedef struct
+{
+    int fd;
+    uint64_t next_lsn;      // 下一条日志的序号
+    uint64_t written_lsn;   // 已写入日志文件的最大序号
+    uint64_t synced_lsn;    // 已 fdatasync 的最大序号
+    char *buf;              // 等待写入的日志
+    size_t len;
+    size_t cap;
+    char *flush_buf;        // leader 正在写入的日志，与 buf 交替使用
+    size_t flush_cap;
+    int flushing;           // 有 leader 正在写入
+    int failed;             // 写日志失败后不再接受提交
+    off_t size;             // 日志文件大小
+    uint64_t records;       // 统计：写入的日志条数
+    uint64_t syncs;         // 统计：fdatasync 次数
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Wal;
+
+// 打开日志并把其中的修改重放到数据文件，然后做一次检查点
+// 返回值: 成功返回 SUCCESS，*replayed 为重放的日志条数；日志文件头损坏时返回 FAILURE
+int wal_open(Wal *wal, const char *path, DataFile *data, uint32_t *replayed);
+
+// 追加一条日志到内存缓冲区，返回它的序号
+uint64_t wal_append(Wal *wal, uint32_t op, uint32_t slot, const studentInfo *record);
+
+// 等待序号不超过 lsn 的日志写入日志文件；sync 非 0 时还要等它们 fdatasync
+int wal_commit(Wal *wal, uint64_t lsn, int sync);
+
+// 检查点：日志全部落盘，数据文件落盘，然后把日志截断为空
+int wal_checkpoint(Wal *wal, DataFile *data);
+
+// 日志是否已经写失败（之后的提交都会失败）
+int wal_failed(Wal *wal);
+
+// 日志文件当前大小（含还在缓冲区里的日志）
+off_t wal_size(Wal *wal);
+
+// 关闭日志（不做检查点）
+void wal_close(Wal *wal);
+
+#endif // WAL_H
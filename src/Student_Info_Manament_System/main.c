@@ -6,11 +6,20 @@
 #include "register.h"
 #include "ui_display.h"
 #include "config.h"
+#include "storage.h"
 
 int main(void)
 {
+    // 打开数据文件和索引（索引缺失或不一致时会自动重建）
+    if (storage_open() == FAILURE)
+    {
+        printf("无法打开数据文件 %s\n", DATA_FILE);
+        return 1;
+    }
+    
     // UI_Display已经包含了循环逻辑
     UI_Display();
+    storage_close();
     
     printf("\n感谢使用学生信息管理系统！再见！\n");
     return 0;
@@ -1,125 +1,146 @@
+/*
+ * 数据文件迁移工具：把任意已知格式的 students.dat 升级为当前格式（见 record_format.h）
+ *
+ * 按块流式转换，多个线程并行，内存占用只有 线程数 × 块大小，可以处理几 GB 的文件。
+ * 用法: ./migrate_data [-f v1|v2|v3] [-j 线程数] [-c 每块记录数] 源文件 [目标文件]
+ *   -f  源文件没有文件头时的结构体布局，默认按文件大小推断（有歧义时必须指定）
+ *   不给目标文件时原地升级：先写到 源文件.tmp，原文件改名为 源文件.bak，再替换
+ */
+#include "config.h"
+#include "migrate.h"
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-#define MAX_NAME_LEN 10
-
-// v1.0 旧数据结构（没有 role 字段）
-typedef struct {
-    int id;
-    char name[MAX_NAME_LEN];
-    char sex;
-    int age;
-} studentBase_v1;
-
-typedef struct {
-    char user[16];
-    char password[16];
-    // 注意：v1.0 没有 role 字段
-} studentAccout_v1;
-
-typedef struct {
-    int Chinese;
-    int Maths;
-    int English;
-} StudentScore_v1;
-
-typedef struct {
-    studentBase_v1 stubase_;
-    StudentScore_v1 studscore_;
-    studentAccout_v1 stuaccout_;
-} studentInfo_v1;
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
 
-// v2.0 新数据结构（有 role 字段）
-typedef enum {
-    ROLE_STUDENT = 0,
-    ROLE_ADMIN = 1
-} UserRole;
+static void usage(const char *prog)
+{
+    printf("用法: %s [-f v1|v2|v3] [-j 线程数] [-c 每块记录数] 源文件 [目标文件]\n", prog);
+}
 
-typedef struct {
-    int id;
-    char name[MAX_NAME_LEN];
-    char sex;
-    int age;
-} studentBase_v2;
+static int parse_legacy(const char *arg, LegacyLayout *legacy)
+{
+    static const char *names[] = {"v1", "v2", "v3"};
+    for (int i = 0; i < 3; i++)
+    {
+        if (strcmp(arg, names[i]) == 0)
+        {
+            *legacy = (LegacyLayout)(LEGACY_V1 + i);
+            return SUCCESS;
+        }
+    }
+    return FAILURE;
+}
 
-typedef struct {
-    char user[16];
-    char password[16];
-    UserRole role;  // 新增字段
-} studentAccout_v2;
+static void describe(const MigrateSource *src)
+{
+    if (src->format_version == 0)
+    {
+        printf("源文件: 没有文件头，%u 字节/条，%u 条记录\n", src->schema.record_size, src->count);
+    }
+    else
+    {
+        printf("源文件: 格式 %u，结构版本 %u，%u 字节/条，%u 条记录\n", src->format_version, src->schema.version,
+               src->schema.record_size, src->count);
+    }
+}
 
-typedef struct {
-    int Chinese;
-    int Maths;
-    int English;
-} StudentScore_v2;
+int main(int argc, char *argv[])
+{
+    MigrateOptions opts = {0, 0, LEGACY_AUTO};
+    MigrateSource src;
+    struct stat st;
+    char temp[512], backup[512];
+    int opt;
 
-typedef struct {
-    studentBase_v2 stubase_;
-    StudentScore_v2 studscore_;
-    studentAccout_v2 stuaccout_;
-} studentInfo_v2;
+    while ((opt = getopt(argc, argv, "f:j:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (parse_legacy(optarg, &opts.legacy) == FAILURE)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'j':
+            opts.threads = atoi(optarg);
+            break;
+        case 'c':
+            opts.chunk_records = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || argc - optind > 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *source = argv[optind];
+    const char *target = optind + 1 < argc ? argv[optind + 1] : NULL;
 
-int main(void)
-{
-    printf("学生信息管理系统 - 数据迁移工具 v1.0 -> v2.0\n");
-    printf("========================================\n\n");
-    
-    // 打开旧数据文件
-    FILE *old_fp = fopen("data/students.dat.v1", "r");
-    if (old_fp == NULL) {
-        printf("错误：无法打开旧数据文件 data/students.dat.v1\n");
-        printf("请先将旧的 students.dat 重命名为 students.dat.v1\n");
+    // 先识别源文件，已经是当前格式就什么都不做
+    int fd = open(source, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        printf("%s无法打开 %s%s\n", COLOR_RED, source, COLOR_RESET);
         return 1;
     }
-    
-    // 创建新数据文件
-    FILE *new_fp = fopen("data/students.dat", "w");
-    if (new_fp == NULL) {
-        printf("错误：无法创建新数据文件 data/students.dat\n");
-        fclose(old_fp);
+    int ok = migrate_probe(fd, st.st_size, opts.legacy, &src);
+    close(fd);
+    if (ok == FAILURE)
+    {
+        printf("%s%s 不是能识别的数据文件（可以用 -f 指定没有文件头时的布局）%s\n", COLOR_RED, source, COLOR_RESET);
         return 1;
     }
-    
-    studentInfo_v1 old_student;
-    studentInfo_v2 new_student;
-    int count = 0;
-    
-    // 读取旧数据并转换
-    while (fread(&old_student, sizeof(studentInfo_v1), 1, old_fp) == 1) {
-        // 复制基本信息
-        new_student.stubase_.id = old_student.stubase_.id;
-        strncpy(new_student.stubase_.name, old_student.stubase_.name, MAX_NAME_LEN);
-        new_student.stubase_.sex = old_student.stubase_.sex;
-        new_student.stubase_.age = old_student.stubase_.age;
-        
-        // 复制成绩信息
-        new_student.studscore_.Chinese = old_student.studscore_.Chinese;
-        new_student.studscore_.Maths = old_student.studscore_.Maths;
-        new_student.studscore_.English = old_student.studscore_.English;
-        
-        // 复制账号信息
-        strncpy(new_student.stuaccout_.user, old_student.stuaccout_.user, 16);
-        strncpy(new_student.stuaccout_.password, old_student.stuaccout_.password, 16);
-        
-        // 设置角色为学生（默认）
-        new_student.stuaccout_.role = ROLE_STUDENT;
-        
-        // 写入新文件
-        fwrite(&new_student, sizeof(studentInfo_v2), 1, new_fp);
-        
-        printf("已迁移用户：%s\n", new_student.stuaccout_.user);
-        count++;
+    describe(&src);
+    if (migrate_is_current(&src))
+    {
+        printf("%s已经是当前格式 %d（结构版本 %d），不需要迁移%s\n", COLOR_GREEN, FORMAT_VERSION, STUDENT_SCHEMA_VERSION,
+               COLOR_RESET);
+        return 0;
     }
-    
-    fclose(old_fp);
-    fclose(new_fp);
-    
-    printf("\n========================================\n");
-    printf("迁移完成！共迁移 %d 个用户账号。\n", count);
-    printf("旧数据文件：data/students.dat.v1（已保留）\n");
-    printf("新数据文件：data/students.dat\n");
-    printf("========================================\n");
-    
+
+    if (target == NULL)
+    {
+        snprintf(temp, sizeof(temp), "%s.tmp", source);
+    }
+    double start = now_sec();
+    if (migrate_file(source, target != NULL ? target : temp, &opts, &src) == FAILURE)
+    {
+        printf("%s迁移失败，%s 没有改动%s\n", COLOR_RED, source, COLOR_RESET);
+        return 1;
+    }
+    double elapsed = now_sec() - start;
+
+    if (target == NULL)
+    {
+        snprintf(backup, sizeof(backup), "%s.bak", source);
+        if (rename(source, backup) == -1 || rename(temp, source) == -1)
+        {
+            printf("%s替换 %s 失败，转换结果在 %s%s\n", COLOR_RED, source, temp, COLOR_RESET);
+            return 1;
+        }
+        printf("原文件已保留为 %s\n", backup);
+        target = source;
+    }
+
+    double mb = (double)st.st_size / (1024.0 * 1024.0);
+    printf("%s迁移完成: %u 条记录，%.1f MB，用时 %.2f 秒（%.1f MB/s），写入 %s%s\n", COLOR_GREEN, src.count, mb, elapsed,
+           elapsed > 0 ? mb / elapsed : 0.0, target, COLOR_RESET);
     return 0;
 }
@@ -1,5 +1,6 @@
 #include "admin.h"
 #include "config.h"
+#include "storage.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -78,49 +79,22 @@ void admin_menu(studentInfo *admin)
     }
 }
 
-// 根据用户名查找学生
+// 根据用户名查找学生（哈希索引）
 int find_student_by_username(const char *username, studentInfo *result)
 {
-    FILE *fp = fopen(DATA_FILE, "r");
-    if (fp == NULL)
-        return FAILURE;
-    
     studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (strcmp(temp.stuaccout_.user, username) == 0 && 
-            temp.stuaccout_.role == ROLE_STUDENT)
-        {
-            memcpy(result, &temp, sizeof(studentInfo));
-            fclose(fp);
-            return SUCCESS;
-        }
-    }
-    
-    fclose(fp);
-    return FAILURE;
+
+    if (storage_find_by_username(username, &temp) == FAILURE || temp.stuaccout_.role != ROLE_STUDENT)
+        return FAILURE;
+
+    memcpy(result, &temp, sizeof(studentInfo));
+    return SUCCESS;
 }
 
-// 根据学号查找学生
+// 根据学号查找学生（B+ 树索引）
 int find_student_by_id(long long id, studentInfo *result)
 {
-    FILE *fp = fopen(DATA_FILE, "r");
-    if (fp == NULL)
-        return FAILURE;
-    
-    studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (temp.stubase_.id == id && temp.stuaccout_.role == ROLE_STUDENT)
-        {
-            memcpy(result, &temp, sizeof(studentInfo));
-            fclose(fp);
-            return SUCCESS;
-        }
-    }
-    
-    fclose(fp);
-    return FAILURE;
+    return storage_find_by_id(id, result);
 }
 
 // 添加学生成绩
@@ -170,36 +144,12 @@ void add_student_score(void)
     clear_input_buffer();
     
     // 更新文件
-    FILE *fp = fopen(DATA_FILE, "r");
-    FILE *temp_fp = fopen("data/temp.dat", "w");
-    
-    if (fp == NULL || temp_fp == NULL)
+    if (storage_update(&student) == FAILURE)
     {
         printf("%s文件操作失败！%s\n", COLOR_RED, COLOR_RESET);
-        if (fp) fclose(fp);
-        if (temp_fp) fclose(temp_fp);
         return;
     }
     
-    studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (temp.stubase_.id == id && temp.stuaccout_.role == ROLE_STUDENT)
-        {
-            fwrite(&student, sizeof(studentInfo), 1, temp_fp);
-        }
-        else
-        {
-            fwrite(&temp, sizeof(studentInfo), 1, temp_fp);
-        }
-    }
-    
-    fclose(fp);
-    fclose(temp_fp);
-    
-    remove(DATA_FILE);
-    rename("data/temp.dat", DATA_FILE);
-    
     printf("%s\n成绩添加成功！%s\n", COLOR_GREEN, COLOR_RESET);
 }
 
@@ -288,37 +238,32 @@ void modify_student_score(void)
     }
     
     // 更新文件
-    FILE *fp = fopen(DATA_FILE, "r");
-    FILE *temp_fp = fopen("data/temp.dat", "w");
-    
-    if (fp == NULL || temp_fp == NULL)
+    if (storage_update(&student) == FAILURE)
     {
         printf("%s文件操作失败！%s\n", COLOR_RED, COLOR_RESET);
-        if (fp) fclose(fp);
-        if (temp_fp) fclose(temp_fp);
         return;
     }
     
-    studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
+    printf("%s\n成绩修改成功！%s\n", COLOR_GREEN, COLOR_RESET);
+}
+
+// 打印一名学生，供 view_all_students 遍历时调用
+static int print_student_row(const studentInfo *temp, void *ctx)
+{
+    int *count = ctx;
+
+    if (temp->stuaccout_.role == ROLE_STUDENT)
     {
-        if (temp.stubase_.id == id && temp.stuaccout_.role == ROLE_STUDENT)
-        {
-            fwrite(&student, sizeof(studentInfo), 1, temp_fp);
-        }
-        else
-        {
-            fwrite(&temp, sizeof(studentInfo), 1, temp_fp);
-        }
+        printf("%-12lld %-12s %-10s %-6d %-6d %-6d\n",
+               temp->stubase_.id,
+               temp->stuaccout_.user,
+               temp->stubase_.name[0] ? temp->stubase_.name : "(未设置)",
+               temp->studscore_.Chinese,
+               temp->studscore_.Maths,
+               temp->studscore_.English);
+        (*count)++;
     }
-    
-    fclose(fp);
-    fclose(temp_fp);
-    
-    remove(DATA_FILE);
-    rename("data/temp.dat", DATA_FILE);
-    
-    printf("%s\n成绩修改成功！%s\n", COLOR_GREEN, COLOR_RESET);
+    return 0;
 }
 
 // 查看所有学生信息
@@ -329,8 +274,7 @@ void view_all_students(void)
     printf("%s         所有学生信息列表         %s\n", COLOR_MAGENTA, COLOR_RESET);
     print_line(COLOR_MAGENTA);
     
-    FILE *fp = fopen(DATA_FILE, "r");
-    if (fp == NULL)
+    if (storage_count() == 0)
     {
         printf("%s暂无学生数据。%s\n", COLOR_YELLOW, COLOR_RESET);
         return;
@@ -340,25 +284,8 @@ void view_all_students(void)
            "学号", "用户名", "姓名", "语文", "数学", "英语");
     print_line(COLOR_CYAN);
     
-    studentInfo temp;
     int count = 0;
-    
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (temp.stuaccout_.role == ROLE_STUDENT)
-        {
-            printf("%-12lld %-12s %-10s %-6d %-6d %-6d\n",
-                   temp.stubase_.id,
-                   temp.stuaccout_.user,
-                   temp.stubase_.name[0] ? temp.stubase_.name : "(未设置)",
-                   temp.studscore_.Chinese,
-                   temp.studscore_.Maths,
-                   temp.studscore_.English);
-            count++;
-        }
-    }
-    
-    fclose(fp);
+    storage_scan(print_student_row, &count);
     
     if (count == 0)
     {
@@ -408,32 +335,12 @@ void delete_student_info(void)
     }
     
     // 更新文件
-    FILE *fp = fopen(DATA_FILE, "r");
-    FILE *temp_fp = fopen("data/temp.dat", "w");
-    
-    if (fp == NULL || temp_fp == NULL)
+    if (storage_delete(username) == FAILURE)
     {
         printf("%s文件操作失败！%s\n", COLOR_RED, COLOR_RESET);
-        if (fp) fclose(fp);
-        if (temp_fp) fclose(temp_fp);
         return;
     }
     
-    studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (strcmp(temp.stuaccout_.user, username) != 0)
-        {
-            fwrite(&temp, sizeof(studentInfo), 1, temp_fp);
-        }
-    }
-    
-    fclose(fp);
-    fclose(temp_fp);
-    
-    remove(DATA_FILE);
-    rename("data/temp.dat", DATA_FILE);
-    
     printf("%s\n学生信息已删除！%s\n", COLOR_GREEN, COLOR_RESET);
 }
 
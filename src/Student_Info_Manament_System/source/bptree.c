@@ -0,0 +1,482 @@
+#include "bptree.h"
+#include "config.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BPT_MAGIC "SBT1"
+#define BPT_VERSION 1
+#define PAGE_SIZE 4096
+
+typedef struct
+{
+    long long id;
+    uint32_t slot;
+    uint32_t pad;
+} BPKey;
+
+#define LEAF_MAX ((PAGE_SIZE - 8) / sizeof(BPKey))
+#define INNER_MAX ((PAGE_SIZE - 12) / (sizeof(BPKey) + sizeof(uint32_t)))
+// 批量构建时每页的装填数，留出空间给之后的插入，避免马上分裂
+#define LEAF_FILL (LEAF_MAX - LEAF_MAX / 8)
+#define INNER_FILL (INNER_MAX - INNER_MAX / 8)
+
+typedef struct
+{
+    uint16_t leaf;
+    uint16_t count;
+    uint32_t next;      // 叶子页：右边的叶子页号，0 表示没有
+    union
+    {
+        BPKey keys[LEAF_MAX];
+        struct
+        {
+            BPKey keys[INNER_MAX];
+            uint32_t child[INNER_MAX + 1];  // child[i] 中的键都小于 keys[i]
+        } inner;
+    } u;
+} BPNode;
+
+typedef union
+{
+    BPNode node;
+    char raw[PAGE_SIZE];
+} BPPage;
+
+// 第 0 页的文件头
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t root;
+    uint32_t pages;
+    uint32_t height;
+    uint32_t records;   // 索引对应的数据文件记录数
+    uint32_t clean;     // 正常关闭时为 1，打开后置 0；异常退出后重建
+} BPHeader;
+
+static int key_cmp(const BPKey *a, const BPKey *b)
+{
+    if (a->id != b->id)
+    {
+        return a->id < b->id ? -1 : 1;
+    }
+    return a->slot < b->slot ? -1 : a->slot > b->slot;
+}
+
+static int key_qsort_cmp(const void *a, const void *b)
+{
+    return key_cmp(a, b);
+}
+
+static int read_page(BPTree *tree, uint32_t no, BPPage *page)
+{
+    return pread(tree->fd, page, PAGE_SIZE, (off_t)no * PAGE_SIZE) == PAGE_SIZE ? SUCCESS : FAILURE;
+}
+
+static int write_page(BPTree *tree, uint32_t no, const BPPage *page)
+{
+    return pwrite(tree->fd, page, PAGE_SIZE, (off_t)no * PAGE_SIZE) == PAGE_SIZE ? SUCCESS : FAILURE;
+}
+
+static int write_header(BPTree *tree, uint32_t records, uint32_t clean)
+{
+    BPPage page;
+    BPHeader hdr;
+
+    memset(&page, 0, sizeof(page));
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BPT_MAGIC, 4);
+    hdr.version = BPT_VERSION;
+    hdr.root = tree->root;
+    hdr.pages = tree->pages;
+    hdr.height = tree->height;
+    hdr.records = records;
+    hdr.clean = clean;
+    memcpy(page.raw, &hdr, sizeof(hdr));
+    return write_page(tree, 0, &page);
+}
+
+// 第一个大于 key 的位置（内部页用它选择子页）
+static int upper_bound(const BPKey *keys, int count, const BPKey *key)
+{
+    int lo = 0, hi = count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (key_cmp(&keys[mid], key) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// 第一个不小于 key 的位置
+static int lower_bound(const BPKey *keys, int count, const BPKey *key)
+{
+    int lo = 0, hi = count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (key_cmp(&keys[mid], key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int bptree_open(BPTree *tree, const char *path, uint32_t records)
+{
+    BPPage page;
+    BPHeader hdr;
+    struct stat st;
+
+    tree->fd = open(path, O_RDWR);
+    if (tree->fd == -1)
+    {
+        return FAILURE;
+    }
+    if (read_page(tree, 0, &page) == FAILURE)
+    {
+        close(tree->fd);
+        tree->fd = -1;
+        return FAILURE;
+    }
+    memcpy(&hdr, page.raw, sizeof(hdr));
+    if (memcmp(hdr.magic, BPT_MAGIC, 4) != 0 || hdr.version != BPT_VERSION || hdr.clean != 1
+        || hdr.records != records || hdr.root == 0 || hdr.root >= hdr.pages || hdr.height == 0
+        || fstat(tree->fd, &st) == -1 || st.st_size != (off_t)hdr.pages * PAGE_SIZE)
+    {
+        close(tree->fd);
+        tree->fd = -1;
+        return FAILURE;
+    }
+    tree->root = hdr.root;
+    tree->pages = hdr.pages;
+    tree->height = hdr.height;
+    // 使用期间标记为不一致，异常退出后下次打开会重建
+    return write_header(tree, records, 0);
+}
+
+int bptree_build(BPTree *tree, const char *path, const long long *ids, uint32_t records)
+{
+    BPKey *keys = malloc((records ? records : 1) * sizeof(BPKey));
+    BPKey *firsts = NULL;       // 当前这一层每页的最小键
+    uint32_t *pages_of = NULL;  // 当前这一层每页的页号
+    BPPage page;
+    uint32_t level_count, nodes;
+    int ret = FAILURE;
+
+    tree->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (keys == NULL || tree->fd == -1)
+    {
+        free(keys);
+        return FAILURE;
+    }
+    for (uint32_t i = 0; i < records; i++)
+    {
+        keys[i].id = ids[i];
+        keys[i].slot = i;
+        keys[i].pad = 0;
+    }
+    qsort(keys, records, sizeof(BPKey), key_qsort_cmp);
+
+    // 叶子层：把有序的键平均分到各页，页号从 1 开始连续分配
+    nodes = records == 0 ? 1 : (uint32_t)((records + LEAF_FILL - 1) / LEAF_FILL);
+    firsts = malloc(nodes * sizeof(BPKey));
+    pages_of = malloc(nodes * sizeof(uint32_t));
+    if (firsts == NULL || pages_of == NULL)
+    {
+        goto out;
+    }
+    tree->pages = 1;
+    for (uint32_t n = 0; n < nodes; n++)
+    {
+        uint32_t start = (uint32_t)((uint64_t)n * records / nodes);
+        uint32_t count = (uint32_t)((uint64_t)(n + 1) * records / nodes) - start;
+
+        memset(&page, 0, sizeof(page));
+        page.node.leaf = 1;
+        page.node.count = (uint16_t)count;
+        page.node.next = n + 1 < nodes ? tree->pages + 1 : 0;
+        memcpy(page.node.u.keys, keys + start, count * sizeof(BPKey));
+        if (count > 0)
+        {
+            firsts[n] = keys[start];
+        }
+        pages_of[n] = tree->pages;
+        if (write_page(tree, tree->pages++, &page) == FAILURE)
+        {
+            goto out;
+        }
+    }
+    tree->height = 1;
+
+    // 内部层：逐层向上，直到只剩一页
+    level_count = nodes;
+    while (level_count > 1)
+    {
+        nodes = (uint32_t)((level_count + INNER_FILL) / (INNER_FILL + 1));
+        for (uint32_t n = 0; n < nodes; n++)
+        {
+            uint32_t start = (uint32_t)((uint64_t)n * level_count / nodes);
+            uint32_t count = (uint32_t)((uint64_t)(n + 1) * level_count / nodes) - start;
+
+            memset(&page, 0, sizeof(page));
+            page.node.count = (uint16_t)(count - 1);
+            for (uint32_t c = 0; c < count; c++)
+            {
+                page.node.u.inner.child[c] = pages_of[start + c];
+                if (c > 0)
+                {
+                    page.node.u.inner.keys[c - 1] = firsts[start + c];
+                }
+            }
+            // 上一层的数组按顺序原地覆盖，n <= start 所以不会覆盖还没读的项
+            firsts[n] = firsts[start];
+            pages_of[n] = tree->pages;
+            if (write_page(tree, tree->pages++, &page) == FAILURE)
+            {
+                goto out;
+            }
+        }
+        level_count = nodes;
+        tree->height++;
+    }
+    tree->root = pages_of[0];
+    ret = write_header(tree, records, 0);
+
+out:
+    free(keys);
+    free(firsts);
+    free(pages_of);
+    return ret;
+}
+
+// 在以 no 为根的子树中插入 key
+// 返回值: 1 表示该页分裂，*sep 为右页的最小键，*right 为右页页号；0 表示未分裂；-1 表示出错
+static int insert_rec(BPTree *tree, uint32_t no, const BPKey *key, BPKey *sep, uint32_t *right)
+{
+    BPPage page, sibling;
+    BPNode *node = &page.node;
+
+    if (read_page(tree, no, &page) == FAILURE)
+    {
+        return -1;
+    }
+
+    if (node->leaf)
+    {
+        BPKey all[LEAF_MAX + 1];
+        int pos = lower_bound(node->u.keys, node->count, key);
+        int total = node->count + 1;
+
+        if (pos < node->count && key_cmp(&node->u.keys[pos], key) == 0)
+        {
+            return 0;
+        }
+        if (node->count < LEAF_MAX)
+        {
+            memmove(&node->u.keys[pos + 1], &node->u.keys[pos], (size_t)(node->count - pos) * sizeof(BPKey));
+            node->u.keys[pos] = *key;
+            node->count++;
+            return write_page(tree, no, &page) == SUCCESS ? 0 : -1;
+        }
+
+        // 叶子页已满：对半分裂，右页接在原页后面
+        memcpy(all, node->u.keys, (size_t)pos * sizeof(BPKey));
+        all[pos] = *key;
+        memcpy(&all[pos + 1], &node->u.keys[pos], (size_t)(node->count - pos) * sizeof(BPKey));
+        memset(&sibling, 0, sizeof(sibling));
+        sibling.node.leaf = 1;
+        sibling.node.count = (uint16_t)(total - total / 2);
+        sibling.node.next = node->next;
+        memcpy(sibling.node.u.keys, &all[total / 2], sibling.node.count * sizeof(BPKey));
+        node->count = (uint16_t)(total / 2);
+        memcpy(node->u.keys, all, node->count * sizeof(BPKey));
+        *right = tree->pages++;
+        node->next = *right;
+        *sep = sibling.node.u.keys[0];
+        if (write_page(tree, *right, &sibling) == FAILURE || write_page(tree, no, &page) == FAILURE)
+        {
+            return -1;
+        }
+        return 1;
+    }
+
+    BPKey child_sep;
+    uint32_t child_right;
+    int pos = upper_bound(node->u.inner.keys, node->count, key);
+    int split = insert_rec(tree, node->u.inner.child[pos], key, &child_sep, &child_right);
+
+    if (split != 1)
+    {
+        return split;
+    }
+    if (node->count < INNER_MAX)
+    {
+        memmove(&node->u.inner.keys[pos + 1], &node->u.inner.keys[pos], (size_t)(node->count - pos) * sizeof(BPKey));
+        memmove(&node->u.inner.child[pos + 2], &node->u.inner.child[pos + 1],
+                (size_t)(node->count - pos) * sizeof(uint32_t));
+        node->u.inner.keys[pos] = child_sep;
+        node->u.inner.child[pos + 1] = child_right;
+        node->count++;
+        return write_page(tree, no, &page) == SUCCESS ? 0 : -1;
+    }
+
+    // 内部页已满：中间的键上移，两边各成一页
+    BPKey keys[INNER_MAX + 1];
+    uint32_t child[INNER_MAX + 2];
+    int total = node->count + 1;
+    int mid = total / 2;
+
+    memcpy(keys, node->u.inner.keys, (size_t)pos * sizeof(BPKey));
+    keys[pos] = child_sep;
+    memcpy(&keys[pos + 1], &node->u.inner.keys[pos], (size_t)(node->count - pos) * sizeof(BPKey));
+    memcpy(child, node->u.inner.child, (size_t)(pos + 1) * sizeof(uint32_t));
+    child[pos + 1] = child_right;
+    memcpy(&child[pos + 2], &node->u.inner.child[pos + 1], (size_t)(node->count - pos) * sizeof(uint32_t));
+
+    memset(&sibling, 0, sizeof(sibling));
+    sibling.node.count = (uint16_t)(total - mid - 1);
+    memcpy(sibling.node.u.inner.keys, &keys[mid + 1], sibling.node.count * sizeof(BPKey));
+    memcpy(sibling.node.u.inner.child, &child[mid + 1], (sibling.node.count + 1) * sizeof(uint32_t));
+    node->count = (uint16_t)mid;
+    memcpy(node->u.inner.keys, keys, (size_t)mid * sizeof(BPKey));
+    memcpy(node->u.inner.child, child, (size_t)(mid + 1) * sizeof(uint32_t));
+    *sep = keys[mid];
+    *right = tree->pages++;
+    if (write_page(tree, *right, &sibling) == FAILURE || write_page(tree, no, &page) == FAILURE)
+    {
+        return -1;
+    }
+    return 1;
+}
+
+int bptree_insert(BPTree *tree, long long id, uint32_t slot)
+{
+    BPKey key = {id, slot, 0};
+    BPKey sep;
+    uint32_t right;
+    int split = insert_rec(tree, tree->root, &key, &sep, &right);
+
+    if (split == -1)
+    {
+        return FAILURE;
+    }
+    if (split == 1)
+    {
+        // 根分裂：新建一个只有一个键的根
+        BPPage page;
+        memset(&page, 0, sizeof(page));
+        page.node.count = 1;
+        page.node.u.inner.keys[0] = sep;
+        page.node.u.inner.child[0] = tree->root;
+        page.node.u.inner.child[1] = right;
+        if (write_page(tree, tree->pages, &page) == FAILURE)
+        {
+            return FAILURE;
+        }
+        tree->root = tree->pages++;
+        tree->height++;
+    }
+    return SUCCESS;
+}
+
+// 从根走到 key 所在（或应在）的叶子页
+static int find_leaf(BPTree *tree, const BPKey *key, uint32_t *no, BPPage *page)
+{
+    *no = tree->root;
+    while (1)
+    {
+        if (read_page(tree, *no, page) == FAILURE)
+        {
+            return FAILURE;
+        }
+        if (page->node.leaf)
+        {
+            return SUCCESS;
+        }
+        *no = page->node.u.inner.child[upper_bound(page->node.u.inner.keys, page->node.count, key)];
+    }
+}
+
+int bptree_remove(BPTree *tree, long long id, uint32_t slot)
+{
+    BPKey key = {id, slot, 0};
+    BPPage page;
+    BPNode *node = &page.node;
+    uint32_t no;
+    int pos;
+
+    if (find_leaf(tree, &key, &no, &page) == FAILURE)
+    {
+        return FAILURE;
+    }
+    pos = lower_bound(node->u.keys, node->count, &key);
+    if (pos == node->count || key_cmp(&node->u.keys[pos], &key) != 0)
+    {
+        return FAILURE;
+    }
+    memmove(&node->u.keys[pos], &node->u.keys[pos + 1], (size_t)(node->count - pos - 1) * sizeof(BPKey));
+    node->count--;
+    return write_page(tree, no, &page);
+}
+
+int bptree_find(BPTree *tree, long long id, int (*fn)(uint32_t slot, void *ctx), void *ctx)
+{
+    BPKey key = {id, 0, 0};
+    BPPage page;
+    uint32_t no;
+    int pos;
+
+    if (find_leaf(tree, &key, &no, &page) == FAILURE)
+    {
+        return -1;
+    }
+    pos = lower_bound(page.node.u.keys, page.node.count, &key);
+    // 同一学号的键可能跨越多个叶子页，沿叶子链表往右找
+    while (1)
+    {
+        for (; pos < page.node.count; pos++)
+        {
+            if (page.node.u.keys[pos].id != id)
+            {
+                return 0;
+            }
+            int ret = fn(page.node.u.keys[pos].slot, ctx);
+            if (ret != 0)
+            {
+                return ret;
+            }
+        }
+        if (page.node.next == 0)
+        {
+            return 0;
+        }
+        if (read_page(tree, page.node.next, &page) == FAILURE)
+        {
+            return -1;
+        }
+        pos = 0;
+    }
+}
+
+void bptree_close(BPTree *tree, uint32_t records)
+{
+    if (tree->fd == -1)
+    {
+        return;
+    }
+    // 页先落盘，再写表示一致的文件头
+    if (fdatasync(tree->fd) == 0)
+    {
+        write_header(tree, records, 1);
+    }
+    close(tree->fd);
+    tree->fd = -1;
+}
@@ -0,0 +1,248 @@
+#include "data_file.h"
+#include "config.h"
+#include "migrate.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MIN_CAPACITY 1024       // 最少映射这么多槽
+#define RESERVE_SLOTS 1024      // 预留时每次多分配这么多槽
+
+static off_t slot_offset(const DataFile *df, uint32_t slot)
+{
+    return (off_t)df->header_size + (off_t)slot * STUDENT_RECORD_SIZE;
+}
+
+static int write_header(DataFile *df, uint32_t count)
+{
+    unsigned char buf[FILE_HEADER_SIZE + MAX_FIELDS * FIELD_DESC_SIZE];
+    FileHeader hdr = {FORMAT_VERSION, df->header_size, count, student_schema};
+
+    file_header_encode(buf, &hdr);
+    return pwrite(df->fd, buf, df->header_size, 0) == (ssize_t)df->header_size ? SUCCESS : FAILURE;
+}
+
+// 映射能容纳 capacity 个槽的区域；文件可以比映射短，只是不能访问文件末尾之后的槽
+static int map_records(DataFile *df, uint32_t capacity)
+{
+    size_t len = (size_t)slot_offset(df, capacity);
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, df->fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        return FAILURE;
+    }
+    if (df->map != NULL)
+    {
+        munmap(df->map, df->map_len);
+    }
+    df->map = map;
+    df->map_len = len;
+    df->capacity = capacity;
+    df->records = (const unsigned char *)map + df->header_size;
+    return SUCCESS;
+}
+
+// 不是当前格式的文件：流式转换到临时文件，再替换原文件
+static int upgrade(const char *path)
+{
+    char temp[256];
+    MigrateSource src;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    if (migrate_file(path, temp, NULL, &src) == FAILURE)
+    {
+        return FAILURE;
+    }
+    if (rename(temp, path) == -1)
+    {
+        unlink(temp);
+        return FAILURE;
+    }
+    if (src.format_version == 0)
+    {
+        printf("%s数据文件没有文件头，已升级为格式 %d（%u 条记录）%s\n", COLOR_YELLOW, FORMAT_VERSION, src.count,
+               COLOR_RESET);
+    }
+    else
+    {
+        printf("%s数据文件已从格式 %u（结构版本 %u）升级为格式 %d（结构版本 %d，%u 条记录）%s\n", COLOR_YELLOW,
+               src.format_version, src.schema.version, FORMAT_VERSION, STUDENT_SCHEMA_VERSION, src.count, COLOR_RESET);
+    }
+    return SUCCESS;
+}
+
+int data_file_open(DataFile *df, const char *path)
+{
+    unsigned char buf[FILE_HEADER_SIZE + MAX_FIELDS * FIELD_DESC_SIZE];
+    FileHeader hdr;
+    struct stat st;
+
+    memset(df, 0, sizeof(*df));
+    df->header_size = file_header_size(&student_schema);
+    df->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (df->fd == -1 || fstat(df->fd, &st) == -1)
+    {
+        return FAILURE;
+    }
+
+    if (st.st_size == 0)
+    {
+        // 新文件
+        if (write_header(df, 0) == FAILURE || fdatasync(df->fd) == -1)
+        {
+            return FAILURE;
+        }
+        return map_records(df, MIN_CAPACITY);
+    }
+
+    ssize_t len = pread(df->fd, buf, sizeof(buf), 0);
+    int decoded = len > 0 && file_header_decode(buf, (size_t)len, &hdr) == SUCCESS;
+    if (decoded && hdr.schema.version > STUDENT_SCHEMA_VERSION)
+    {
+        printf("%s%s 由更新的版本创建（结构版本 %u），请升级程序%s\n", COLOR_RED, path, hdr.schema.version,
+               COLOR_RESET);
+        return FAILURE;
+    }
+    if (!decoded || !schema_equal(&hdr.schema, &student_schema))
+    {
+        close(df->fd);
+        df->fd = -1;
+        if (upgrade(path) == FAILURE)
+        {
+            printf("%s%s 不是能识别的数据文件；没有文件头的旧文件请先用 migrate_data -f 指定布局迁移%s\n", COLOR_RED,
+                   path, COLOR_RESET);
+            return FAILURE;
+        }
+        return data_file_open(df, path);
+    }
+    if (slot_offset(df, hdr.count) > st.st_size)
+    {
+        printf("%s%s 不完整：文件头记录了 %u 条记录%s\n", COLOR_RED, path, hdr.count, COLOR_RESET);
+        return FAILURE;
+    }
+
+    df->count = hdr.count;
+    df->header_count = hdr.count;
+    uint32_t capacity = MIN_CAPACITY;
+    while (capacity < df->count)
+    {
+        capacity *= 2;
+    }
+    return map_records(df, capacity);
+}
+
+int data_file_read(const DataFile *df, uint32_t slot, studentInfo *record)
+{
+    if (slot >= df->count)
+    {
+        return FAILURE;
+    }
+    record_decode(df->records + (size_t)slot * STUDENT_RECORD_SIZE, record);
+    return SUCCESS;
+}
+
+int data_file_write(DataFile *df, uint32_t slot, const studentInfo *record)
+{
+    unsigned char buf[STUDENT_RECORD_SIZE];
+
+    // 只能覆盖已有的槽或在末尾追加
+    if (slot > df->count)
+    {
+        return FAILURE;
+    }
+    if (slot == df->capacity && map_records(df, df->capacity * 2) == FAILURE)
+    {
+        return FAILURE;
+    }
+    record_encode(buf, record);
+    if (pwrite(df->fd, buf, sizeof(buf), slot_offset(df, slot)) != sizeof(buf))
+    {
+        return FAILURE;
+    }
+    if (slot == df->count)
+    {
+        df->count++;
+    }
+    return SUCCESS;
+}
+
+int data_file_reserve(DataFile *df, uint32_t count)
+{
+    uint32_t capacity = df->capacity;
+    struct stat st;
+
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    if (capacity != df->capacity && map_records(df, capacity) == FAILURE)
+    {
+        return FAILURE;
+    }
+    if (fstat(df->fd, &st) == -1)
+    {
+        return FAILURE;
+    }
+    if (st.st_size < slot_offset(df, count))
+    {
+        // 一次多分配一些，连续追加时不用每条都 fallocate；多出的部分在 data_file_sync 时截掉
+        off_t end = slot_offset(df, count + RESERVE_SLOTS);
+        if (posix_fallocate(df->fd, st.st_size, end - st.st_size) != 0
+            && posix_fallocate(df->fd, st.st_size, slot_offset(df, count) - st.st_size) != 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+void data_file_truncate(DataFile *df, uint32_t count)
+{
+    if (count < df->count)
+    {
+        df->count = count;
+    }
+}
+
+int data_file_sync(DataFile *df)
+{
+    struct stat st;
+
+    if (fdatasync(df->fd) == -1)
+    {
+        return FAILURE;
+    }
+    if (df->header_count != df->count)
+    {
+        if (write_header(df, df->count) == FAILURE || fdatasync(df->fd) == -1)
+        {
+            return FAILURE;
+        }
+        df->header_count = df->count;
+    }
+    // 截断或崩溃留下的、记录数之外的部分
+    if (fstat(df->fd, &st) == 0 && st.st_size > slot_offset(df, df->count))
+    {
+        return ftruncate(df->fd, slot_offset(df, df->count)) == 0 ? SUCCESS : FAILURE;
+    }
+    return SUCCESS;
+}
+
+void data_file_close(DataFile *df)
+{
+    if (df->map != NULL)
+    {
+        munmap(df->map, df->map_len);
+        df->map = NULL;
+        df->records = NULL;
+    }
+    if (df->fd != -1)
+    {
+        close(df->fd);
+        df->fd = -1;
+    }
+}
@@ -0,0 +1,316 @@
+#include "hash_index.h"
+#include "config.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HASH_MAGIC "SHX1"
+#define HASH_VERSION 1
+#define HASH_MIN_CAPACITY 64
+#define HASH_EMPTY 0xFFFFFFFFu
+#define PROBE_BATCH 8           // 每次 pread 读取的连续槽数
+
+// 索引文件头，固定 64 字节
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t records;   // 索引对应的数据文件记录数
+    uint32_t clean;     // 正常关闭时为 1，打开后置 0；异常退出后重建
+    char reserved[40];
+} HashHeader;
+
+typedef struct
+{
+    char user[HASH_USER_LEN];
+    uint32_t slot;
+} HashEntry;
+
+// FNV-1a
+static uint32_t hash_user(const char *user)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < HASH_USER_LEN && user[i] != '\0'; i++)
+    {
+        h ^= (unsigned char)user[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static off_t entry_offset(uint32_t pos)
+{
+    return (off_t)sizeof(HashHeader) + (off_t)pos * (off_t)sizeof(HashEntry);
+}
+
+static int write_header(HashIndex *idx, uint32_t records, uint32_t clean)
+{
+    HashHeader hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HASH_MAGIC, 4);
+    hdr.version = HASH_VERSION;
+    hdr.capacity = idx->capacity;
+    hdr.count = idx->count;
+    hdr.records = records;
+    hdr.clean = clean;
+    return pwrite(idx->fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) ? SUCCESS : FAILURE;
+}
+
+// 在内存中的槽数组里插入（构建和扩容时使用），已存在时不覆盖
+static int table_insert(HashEntry *table, uint32_t capacity, const char *user, uint32_t slot)
+{
+    uint32_t pos = hash_user(user) & (capacity - 1);
+
+    while (table[pos].slot != HASH_EMPTY)
+    {
+        if (strncmp(table[pos].user, user, HASH_USER_LEN) == 0)
+        {
+            return 0;
+        }
+        pos = (pos + 1) & (capacity - 1);
+    }
+    memset(table[pos].user, 0, HASH_USER_LEN);
+    memcpy(table[pos].user, user, strnlen(user, HASH_USER_LEN));
+    table[pos].slot = slot;
+    return 1;
+}
+
+static HashEntry *table_alloc(uint32_t capacity)
+{
+    HashEntry *table = malloc((size_t)capacity * sizeof(HashEntry));
+    if (table != NULL)
+    {
+        for (uint32_t i = 0; i < capacity; i++)
+        {
+            table[i].slot = HASH_EMPTY;
+        }
+    }
+    return table;
+}
+
+static int table_write(HashIndex *idx, const HashEntry *table)
+{
+    size_t len = (size_t)idx->capacity * sizeof(HashEntry);
+    return pwrite(idx->fd, table, len, entry_offset(0)) == (ssize_t)len ? SUCCESS : FAILURE;
+}
+
+int hash_index_open(HashIndex *idx, const char *path, uint32_t records)
+{
+    HashHeader hdr;
+    struct stat st;
+
+    idx->fd = open(path, O_RDWR);
+    if (idx->fd == -1)
+    {
+        return FAILURE;
+    }
+    if (pread(idx->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr.magic, HASH_MAGIC, 4) != 0
+        || hdr.version != HASH_VERSION || hdr.clean != 1 || hdr.records != records
+        || hdr.capacity < HASH_MIN_CAPACITY || (hdr.capacity & (hdr.capacity - 1)) != 0
+        || fstat(idx->fd, &st) == -1 || st.st_size != entry_offset(hdr.capacity))
+    {
+        close(idx->fd);
+        idx->fd = -1;
+        return FAILURE;
+    }
+    idx->capacity = hdr.capacity;
+    idx->count = hdr.count;
+    // 使用期间标记为不一致，异常退出后下次打开会重建
+    return write_header(idx, records, 0);
+}
+
+int hash_index_build(HashIndex *idx, const char *path, const char (*users)[HASH_USER_LEN], uint32_t records)
+{
+    HashEntry *table;
+    uint32_t capacity = HASH_MIN_CAPACITY;
+    int ret;
+
+    while (capacity < records * 2)
+    {
+        capacity *= 2;
+    }
+    table = table_alloc(capacity);
+    if (table == NULL)
+    {
+        return FAILURE;
+    }
+    idx->capacity = capacity;
+    idx->count = 0;
+    for (uint32_t i = 0; i < records; i++)
+    {
+        if (users[i][0] != '\0')
+        {
+            idx->count += (uint32_t)table_insert(table, capacity, users[i], i);
+        }
+    }
+
+    idx->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ret = idx->fd != -1 && table_write(idx, table) == SUCCESS && write_header(idx, records, 0) == SUCCESS;
+    free(table);
+    return ret ? SUCCESS : FAILURE;
+}
+
+// 从 pos 开始探测 user
+// 返回值: 找到返回 SUCCESS，*found 为所在的槽；没找到返回 FAILURE，*found 为探测到的第一个空槽
+static int probe(HashIndex *idx, const char *user, uint32_t *found, HashEntry *entry)
+{
+    HashEntry batch[PROBE_BATCH];
+    uint32_t pos = hash_user(user) & (idx->capacity - 1);
+
+    for (uint32_t probed = 0; probed < idx->capacity;)
+    {
+        uint32_t n = idx->capacity - pos < PROBE_BATCH ? idx->capacity - pos : PROBE_BATCH;
+        ssize_t len = (ssize_t)(n * sizeof(HashEntry));
+
+        if (pread(idx->fd, batch, (size_t)len, entry_offset(pos)) != len)
+        {
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (batch[i].slot == HASH_EMPTY || strncmp(batch[i].user, user, HASH_USER_LEN) == 0)
+            {
+                *found = pos + i;
+                *entry = batch[i];
+                return batch[i].slot == HASH_EMPTY ? FAILURE : SUCCESS;
+            }
+        }
+        probed += n;
+        pos = (pos + n) & (idx->capacity - 1);
+    }
+    return -1;
+}
+
+int hash_index_find(HashIndex *idx, const char *user, uint32_t *slot)
+{
+    HashEntry entry;
+    uint32_t pos;
+
+    if (probe(idx, user, &pos, &entry) != SUCCESS)
+    {
+        return FAILURE;
+    }
+    *slot = entry.slot;
+    return SUCCESS;
+}
+
+// 容量翻倍：读出全部槽，在内存中重新散列后整体写回
+static int grow(HashIndex *idx)
+{
+    uint32_t old_capacity = idx->capacity;
+    size_t len = (size_t)old_capacity * sizeof(HashEntry);
+    HashEntry *old_table = malloc(len);
+    HashEntry *table = table_alloc(old_capacity * 2);
+    int ret = FAILURE;
+
+    if (old_table != NULL && table != NULL && pread(idx->fd, old_table, len, entry_offset(0)) == (ssize_t)len)
+    {
+        for (uint32_t i = 0; i < old_capacity; i++)
+        {
+            if (old_table[i].slot != HASH_EMPTY)
+            {
+                table_insert(table, old_capacity * 2, old_table[i].user, old_table[i].slot);
+            }
+        }
+        idx->capacity = old_capacity * 2;
+        ret = table_write(idx, table);
+    }
+    free(old_table);
+    free(table);
+    return ret;
+}
+
+int hash_index_insert(HashIndex *idx, const char *user, uint32_t slot)
+{
+    HashEntry entry;
+    uint32_t pos;
+    int found;
+
+    if ((idx->count + 1) * 4 > idx->capacity * 3 && grow(idx) == FAILURE)
+    {
+        return FAILURE;
+    }
+    found = probe(idx, user, &pos, &entry);
+    if (found == -1)
+    {
+        return FAILURE;
+    }
+    memset(entry.user, 0, HASH_USER_LEN);
+    memcpy(entry.user, user, strnlen(user, HASH_USER_LEN));
+    entry.slot = slot;
+    if (pwrite(idx->fd, &entry, sizeof(entry), entry_offset(pos)) != sizeof(entry))
+    {
+        return FAILURE;
+    }
+    if (found == FAILURE)
+    {
+        idx->count++;
+    }
+    return SUCCESS;
+}
+
+int hash_index_remove(HashIndex *idx, const char *user)
+{
+    HashEntry entry;
+    uint32_t mask = idx->capacity - 1;
+    uint32_t hole, pos;
+
+    if (probe(idx, user, &hole, &entry) != SUCCESS)
+    {
+        return FAILURE;
+    }
+
+    // 后移删除：把探测链上后面的、本应在空洞之前的项挪进空洞，保证查找不会提前遇到空槽
+    pos = hole;
+    while (1)
+    {
+        pos = (pos + 1) & mask;
+        if (pread(idx->fd, &entry, sizeof(entry), entry_offset(pos)) != sizeof(entry))
+        {
+            return FAILURE;
+        }
+        if (entry.slot == HASH_EMPTY)
+        {
+            break;
+        }
+        uint32_t home = hash_user(entry.user) & mask;
+        int movable = hole <= pos ? (home <= hole || home > pos) : (home <= hole && home > pos);
+        if (movable)
+        {
+            if (pwrite(idx->fd, &entry, sizeof(entry), entry_offset(hole)) != sizeof(entry))
+            {
+                return FAILURE;
+            }
+            hole = pos;
+        }
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.slot = HASH_EMPTY;
+    if (pwrite(idx->fd, &entry, sizeof(entry), entry_offset(hole)) != sizeof(entry))
+    {
+        return FAILURE;
+    }
+    idx->count--;
+    return SUCCESS;
+}
+
+void hash_index_close(HashIndex *idx, uint32_t records)
+{
+    if (idx->fd == -1)
+    {
+        return;
+    }
+    // 槽先落盘，再写表示一致的文件头
+    if (fdatasync(idx->fd) == 0)
+    {
+        write_header(idx, records, 1);
+    }
+    close(idx->fd);
+    idx->fd = -1;
+}
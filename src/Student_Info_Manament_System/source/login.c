@@ -5,6 +5,7 @@
 #include "ui_display.h"
 #include "admin.h"
 #include "student.h"
+#include "storage.h"
 
 /*
 登陆需求分析：
@@ -80,30 +81,16 @@ void login_flow(studentInfo *stuinfo, studentInfo *stutemp)
 
 int login_judge(studentInfo *stuinfo)
 {
-    FILE *fp = fopen(DATA_FILE, "r");
-    if (fp == NULL)
-    {
-        printf("无法打开数据文件，可能还没有注册用户。\n");
-        return FAILURE;
-    }
-    
     studentInfo temp;
-    int found = 0;
-    
-    // 读取文件中的所有用户信息并进行比对
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
+
+    // 按用户名在哈希索引中查找，再比对密码
+    if (storage_find_by_username(stuinfo->stuaccout_.user, &temp) == FAILURE ||
+        strcmp(temp.stuaccout_.password, stuinfo->stuaccout_.password) != 0)
     {
-        if (strcmp(temp.stuaccout_.user, stuinfo->stuaccout_.user) == 0 &&
-            strcmp(temp.stuaccout_.password, stuinfo->stuaccout_.password) == 0)
-        {
-            found = 1;
-            // 将完整的用户信息复制回stuinfo
-            memcpy(stuinfo, &temp, sizeof(studentInfo));
-            break;
-        }
+        return FAILURE;
     }
     
-    fclose(fp);
-    
-    return found ? SUCCESS : FAILURE;
+    // 将完整的用户信息复制回stuinfo
+    memcpy(stuinfo, &temp, sizeof(studentInfo));
+    return SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "migrate.h"
+#include "config.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_CHUNK_RECORDS 16384 // 每块记录数，两块缓冲区合计约 2MB
+#define MAX_THREADS 16
+#define PROBE_SIZE (FILE_HEADER_SIZE + MAX_FIELDS * FIELD_DESC_SIZE)
+#define SAMPLE_RECORDS 64       // 猜测旧文件布局时抽查的记录数
+
+// 没有自描述文件头的旧布局（x86-64 上 gcc 的结构体布局）
+static const Schema legacy_v1 = {
+    0, 64, 9,
+    {
+        {"id", FIELD_INT, 4, 0},
+        {"name", FIELD_CHARS, 10, 4},
+        {"sex", FIELD_CHARS, 1, 14},
+        {"age", FIELD_INT, 4, 16},
+        {"chinese", FIELD_INT, 4, 20},
+        {"maths", FIELD_INT, 4, 24},
+        {"english", FIELD_INT, 4, 28},
+        {"user", FIELD_CHARS, 16, 32},
+        {"password", FIELD_CHARS, 16, 48},
+    },
+};
+
+static const Schema legacy_v2 = {
+    0, 68, 10,
+    {
+        {"id", FIELD_INT, 4, 0},
+        {"name", FIELD_CHARS, 10, 4},
+        {"sex", FIELD_CHARS, 1, 14},
+        {"age", FIELD_INT, 4, 16},
+        {"chinese", FIELD_INT, 4, 20},
+        {"maths", FIELD_INT, 4, 24},
+        {"english", FIELD_INT, 4, 28},
+        {"user", FIELD_CHARS, 16, 32},
+        {"password", FIELD_CHARS, 16, 48},
+        {"role", FIELD_INT, 4, 64},
+    },
+};
+
+static const Schema legacy_v3 = {
+    0, 72, 10,
+    {
+        {"id", FIELD_INT, 8, 0},
+        {"name", FIELD_CHARS, 10, 8},
+        {"sex", FIELD_CHARS, 1, 18},
+        {"age", FIELD_INT, 4, 20},
+        {"chinese", FIELD_INT, 4, 24},
+        {"maths", FIELD_INT, 4, 28},
+        {"english", FIELD_INT, 4, 32},
+        {"user", FIELD_CHARS, 16, 36},
+        {"password", FIELD_CHARS, 16, 52},
+        {"role", FIELD_INT, 4, 68},
+    },
+};
+
+static int read_full(int fd, void *buf, size_t len, off_t offset)
+{
+    char *p = buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n <= 0)
+        {
+            return FAILURE;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return SUCCESS;
+}
+
+static int write_full(int fd, const void *buf, size_t len, off_t offset)
+{
+    const char *p = buf;
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n <= 0)
+        {
+            return FAILURE;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return SUCCESS;
+}
+
+static const FieldDesc *find_field(const Schema *schema, const char *name)
+{
+    for (uint32_t i = 0; i < schema->field_count; i++)
+    {
+        if (strncmp(schema->fields[i].name, name, FIELD_NAME_LEN) == 0)
+        {
+            return &schema->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// 抽样检查按 schema 读出的记录像不像真的：用户名以 '\0' 结尾，角色在已知范围内
+// 布局猜错时字段错位，这两项几乎不可能都对
+static int looks_plausible(int fd, off_t size, const Schema *schema)
+{
+    const FieldDesc *user = find_field(schema, "user");
+    const FieldDesc *role = find_field(schema, "role");
+    unsigned char record[128];
+    off_t count = size / schema->record_size;
+    off_t step = count > SAMPLE_RECORDS ? count / SAMPLE_RECORDS : 1;
+
+    for (off_t i = 0; i < count; i += step)
+    {
+        if (read_full(fd, record, schema->record_size, i * schema->record_size) == FAILURE)
+        {
+            return 0;
+        }
+        if (memchr(record + user->offset, '\0', user->size) == NULL)
+        {
+            return 0;
+        }
+        if (role != NULL)
+        {
+            int64_t value = field_get_int(role, record);
+            if (value < ROLE_STUDENT || value > ROLE_DELETED)
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// 没有文件头的旧文件：指定了布局就照办；否则只有一种记录大小能整除文件大小、且抽样合理时才接受，
+// 有多种可能（例如 9 条 v1 记录和 8 条 v3 记录都是 576 字节）时宁可失败，要求用 -f 指定
+static const Schema *legacy_schema(int fd, LegacyLayout legacy, off_t size)
+{
+    static const Schema *const layouts[] = {&legacy_v3, &legacy_v2, &legacy_v1};
+    const Schema *found = NULL;
+
+    switch (legacy)
+    {
+    case LEGACY_V1:
+        return &legacy_v1;
+    case LEGACY_V2:
+        return &legacy_v2;
+    case LEGACY_V3:
+        return &legacy_v3;
+    default:
+        break;
+    }
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+    {
+        if (size % layouts[i]->record_size != 0)
+        {
+            continue;
+        }
+        if (found != NULL)
+        {
+            return NULL;
+        }
+        found = layouts[i];
+    }
+    return found != NULL && looks_plausible(fd, size, found) ? found : NULL;
+}
+
+int migrate_probe(int fd, off_t size, LegacyLayout legacy, MigrateSource *src)
+{
+    unsigned char buf[PROBE_SIZE];
+    size_t len = size < (off_t)sizeof(buf) ? (size_t)size : sizeof(buf);
+    FileHeader hdr;
+
+    memset(src, 0, sizeof(*src));
+    if (len > 0 && read_full(fd, buf, len, 0) == FAILURE)
+    {
+        return FAILURE;
+    }
+
+    if (len >= 4 && memcmp(buf, DATA_MAGIC, 4) == 0)
+    {
+        int ok = file_header_decode(buf, len, &hdr);
+        src->format_version = hdr.format_version;
+        src->count = hdr.count;
+        if (ok == SUCCESS)
+        {
+            src->data_offset = hdr.header_size;
+            src->schema = hdr.schema;
+        }
+        else if (hdr.format_version == 1 && hdr.header_size == FILE_HEADER_SIZE
+                 && hdr.schema.record_size == legacy_v3.record_size)
+        {
+            // 格式 1：文件头后面是本机 studentInfo
+            src->data_offset = FILE_HEADER_SIZE;
+            src->schema = legacy_v3;
+        }
+        else
+        {
+            return FAILURE;
+        }
+    }
+    else
+    {
+        const Schema *schema = legacy_schema(fd, legacy, size);
+        if (schema == NULL || size % schema->record_size != 0)
+        {
+            return FAILURE;
+        }
+        src->schema = *schema;
+        src->count = (uint32_t)(size / schema->record_size);
+    }
+    // 文件比记录数短说明数据不完整，不能转换
+    return (off_t)src->data_offset + (off_t)src->count * src->schema.record_size <= size ? SUCCESS : FAILURE;
+}
+
+int migrate_is_current(const MigrateSource *src)
+{
+    return src->format_version == FORMAT_VERSION && schema_equal(&src->schema, &student_schema);
+}
+
+typedef struct
+{
+    int src_fd;
+    int dst_fd;
+    const MigrateSource *source;
+    Conversion conv;
+    uint32_t dst_offset;
+    uint32_t chunk_records;
+    uint32_t next_chunk;        // 下一个待领取的块
+    int failed;
+    pthread_mutex_t lock;
+} MigrateJob;
+
+// 转换线程：领取一块，读入、逐条转换、写到目标文件中对应的位置
+static void *migrate_worker(void *arg)
+{
+    MigrateJob *job = arg;
+    const MigrateSource *source = job->source;
+    uint32_t src_size = source->schema.record_size, dst_size = student_schema.record_size;
+    unsigned char *in = malloc((size_t)job->chunk_records * src_size);
+    unsigned char *out = malloc((size_t)job->chunk_records * dst_size);
+    int ok = in != NULL && out != NULL;
+
+    while (ok)
+    {
+        pthread_mutex_lock(&job->lock);
+        uint64_t first = (uint64_t)job->next_chunk++ * job->chunk_records;
+        int stop = job->failed || first >= source->count;
+        pthread_mutex_unlock(&job->lock);
+        if (stop)
+        {
+            break;
+        }
+
+        uint32_t n = source->count - first < job->chunk_records ? (uint32_t)(source->count - first) : job->chunk_records;
+        ok = read_full(job->src_fd, in, (size_t)n * src_size, (off_t)source->data_offset + (off_t)first * src_size)
+             == SUCCESS;
+        for (uint32_t i = 0; ok && i < n; i++)
+        {
+            record_convert(&job->conv, in + (size_t)i * src_size, out + (size_t)i * dst_size);
+        }
+        ok = ok && write_full(job->dst_fd, out, (size_t)n * dst_size, (off_t)job->dst_offset + (off_t)first * dst_size)
+                       == SUCCESS;
+    }
+
+    if (!ok)
+    {
+        pthread_mutex_lock(&job->lock);
+        job->failed = 1;
+        pthread_mutex_unlock(&job->lock);
+    }
+    free(in);
+    free(out);
+    return NULL;
+}
+
+// 起线程转换全部块并等待完成
+static int run_job(MigrateJob *job, int threads)
+{
+    pthread_t tid[MAX_THREADS];
+    int started = 0;
+
+    pthread_mutex_init(&job->lock, NULL);
+    threads = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+    for (; started < threads; started++)
+    {
+        if (pthread_create(&tid[started], NULL, migrate_worker, job) != 0)
+        {
+            break;
+        }
+    }
+    // 一个线程都没起来时在当前线程里转换
+    if (started == 0)
+    {
+        migrate_worker(job);
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+    pthread_mutex_destroy(&job->lock);
+    return job->failed ? FAILURE : SUCCESS;
+}
+
+int migrate_file(const char *src_path, const char *dst_path, const MigrateOptions *opts, MigrateSource *source)
+{
+    MigrateOptions defaults = {0, 0, LEGACY_AUTO};
+    MigrateSource src;
+    MigrateJob job;
+    struct stat st;
+    int ret = FAILURE;
+
+    if (opts == NULL)
+    {
+        opts = &defaults;
+    }
+    memset(&job, 0, sizeof(job));
+    job.src_fd = open(src_path, O_RDONLY);
+    if (job.src_fd == -1 || fstat(job.src_fd, &st) == -1
+        || migrate_probe(job.src_fd, st.st_size, opts->legacy, &src) == FAILURE)
+    {
+        if (job.src_fd != -1)
+        {
+            close(job.src_fd);
+        }
+        return FAILURE;
+    }
+    if (source != NULL)
+    {
+        *source = src;
+    }
+
+    // 目标文件：先写好文件头并把大小定下来，各线程再往各自的位置写
+    FileHeader hdr = {FORMAT_VERSION, file_header_size(&student_schema), src.count, student_schema};
+    unsigned char header[PROBE_SIZE];
+    file_header_encode(header, &hdr);
+    job.source = &src;
+    job.dst_offset = hdr.header_size;
+    job.chunk_records = opts->chunk_records ? opts->chunk_records : DEFAULT_CHUNK_RECORDS;
+    conversion_init(&job.conv, &src.schema, &student_schema);
+
+    job.dst_fd = open(dst_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (job.dst_fd != -1
+        && ftruncate(job.dst_fd, (off_t)hdr.header_size + (off_t)src.count * student_schema.record_size) == 0
+        && write_full(job.dst_fd, header, hdr.header_size, 0) == SUCCESS && run_job(&job, opts->threads) == SUCCESS
+        && fdatasync(job.dst_fd) == 0)
+    {
+        ret = SUCCESS;
+    }
+
+    close(job.src_fd);
+    if (job.dst_fd != -1)
+    {
+        close(job.dst_fd);
+    }
+    if (ret == FAILURE)
+    {
+        unlink(dst_path);
+    }
+    return ret;
+}
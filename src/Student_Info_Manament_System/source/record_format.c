@@ -0,0 +1,247 @@
+#include "record_format.h"
+#include "config.h"
+#include <string.h>
+
+// 当前记录布局：68 字节，无填充
+#define LEN_NAME 10
+#define LEN_USER 16
+#define LEN_PASSWORD 16
+
+#define OFF_ID 0
+#define OFF_NAME 8
+#define OFF_SEX (OFF_NAME + LEN_NAME)
+#define OFF_AGE (OFF_SEX + 1)
+#define OFF_CHINESE (OFF_AGE + 4)
+#define OFF_MATHS (OFF_CHINESE + 4)
+#define OFF_ENGLISH (OFF_MATHS + 4)
+#define OFF_USER (OFF_ENGLISH + 4)
+#define OFF_PASSWORD (OFF_USER + LEN_USER)
+#define OFF_ROLE (OFF_PASSWORD + LEN_PASSWORD)
+
+// 文件格式不能跟着结构体悄悄变：改了 studentInfo 的字段长度，要同时改这里的布局并把 STUDENT_SCHEMA_VERSION 加一
+#define MEMBER_SIZE(member) sizeof(((studentInfo *)0)->member)
+_Static_assert(MEMBER_SIZE(stubase_.name) == LEN_NAME, "studentInfo name size changed: update record layout and STUDENT_SCHEMA_VERSION");
+_Static_assert(MEMBER_SIZE(stuaccout_.user) == LEN_USER, "studentInfo user size changed: update record layout and STUDENT_SCHEMA_VERSION");
+_Static_assert(MEMBER_SIZE(stuaccout_.password) == LEN_PASSWORD, "studentInfo password size changed: update record layout and STUDENT_SCHEMA_VERSION");
+_Static_assert(MEMBER_SIZE(stubase_.id) <= 8, "student id wider than 8 bytes");
+_Static_assert(OFF_ROLE + 1 == STUDENT_RECORD_SIZE, "STUDENT_RECORD_SIZE does not match the record layout");
+
+const Schema student_schema = {
+    STUDENT_SCHEMA_VERSION,
+    STUDENT_RECORD_SIZE,
+    10,
+    {
+        {"id", FIELD_INT, 8, OFF_ID},
+        {"name", FIELD_CHARS, LEN_NAME, OFF_NAME},
+        {"sex", FIELD_CHARS, 1, OFF_SEX},
+        {"age", FIELD_INT, 4, OFF_AGE},
+        {"chinese", FIELD_INT, 4, OFF_CHINESE},
+        {"maths", FIELD_INT, 4, OFF_MATHS},
+        {"english", FIELD_INT, 4, OFF_ENGLISH},
+        {"user", FIELD_CHARS, LEN_USER, OFF_USER},
+        {"password", FIELD_CHARS, LEN_PASSWORD, OFF_PASSWORD},
+        {"role", FIELD_INT, 1, OFF_ROLE},
+    },
+};
+
+static void put_le(unsigned char *out, int64_t value, int size)
+{
+    uint64_t v = (uint64_t)value;
+    for (int i = 0; i < size; i++)
+    {
+        out[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+// 读 size 字节的小端有符号整数并做符号扩展
+static int64_t get_le(const unsigned char *in, int size)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < size; i++)
+    {
+        v |= (uint64_t)in[i] << (8 * i);
+    }
+    if (size < 8 && (v >> (8 * size - 1)) & 1)
+    {
+        v |= ~0ULL << (8 * size);
+    }
+    return (int64_t)v;
+}
+
+uint32_t file_header_size(const Schema *schema)
+{
+    return FILE_HEADER_SIZE + schema->field_count * FIELD_DESC_SIZE;
+}
+
+void file_header_encode(unsigned char *buf, const FileHeader *hdr)
+{
+    const Schema *schema = &hdr->schema;
+
+    memset(buf, 0, file_header_size(schema));
+    memcpy(buf, DATA_MAGIC, 4);
+    put_le(buf + 4, hdr->format_version, 4);
+    put_le(buf + 8, file_header_size(schema), 4);
+    put_le(buf + 12, schema->record_size, 4);
+    put_le(buf + 16, hdr->count, 4);
+    put_le(buf + 20, schema->version, 4);
+    put_le(buf + 24, schema->field_count, 4);
+    for (uint32_t i = 0; i < schema->field_count; i++)
+    {
+        unsigned char *desc = buf + FILE_HEADER_SIZE + i * FIELD_DESC_SIZE;
+        const FieldDesc *field = &schema->fields[i];
+        memcpy(desc, field->name, strnlen(field->name, FIELD_NAME_LEN));
+        desc[16] = field->type;
+        put_le(desc + 18, field->size, 2);
+        put_le(desc + 20, field->offset, 4);
+    }
+}
+
+static int field_valid(const FieldDesc *field, uint32_t record_size)
+{
+    if (field->name[0] == '\0' || field->offset + field->size > record_size)
+    {
+        return 0;
+    }
+    if (field->type == FIELD_INT)
+    {
+        return field->size == 1 || field->size == 2 || field->size == 4 || field->size == 8;
+    }
+    return field->type == FIELD_CHARS && field->size > 0;
+}
+
+int file_header_decode(const unsigned char *buf, size_t len, FileHeader *hdr)
+{
+    Schema *schema = &hdr->schema;
+
+    memset(hdr, 0, sizeof(*hdr));
+    if (len < FILE_HEADER_SIZE || memcmp(buf, DATA_MAGIC, 4) != 0)
+    {
+        return FAILURE;
+    }
+    hdr->format_version = (uint32_t)get_le(buf + 4, 4);
+    hdr->header_size = (uint32_t)get_le(buf + 8, 4);
+    hdr->count = (uint32_t)get_le(buf + 16, 4);
+    schema->record_size = (uint32_t)get_le(buf + 12, 4);
+    if (hdr->format_version != FORMAT_VERSION)
+    {
+        return FAILURE;
+    }
+
+    schema->version = (uint32_t)get_le(buf + 20, 4);
+    schema->field_count = (uint32_t)get_le(buf + 24, 4);
+    if (schema->field_count == 0 || schema->field_count > MAX_FIELDS || schema->record_size == 0
+        || hdr->header_size != file_header_size(schema) || len < hdr->header_size)
+    {
+        return FAILURE;
+    }
+    for (uint32_t i = 0; i < schema->field_count; i++)
+    {
+        const unsigned char *desc = buf + FILE_HEADER_SIZE + i * FIELD_DESC_SIZE;
+        FieldDesc *field = &schema->fields[i];
+        memcpy(field->name, desc, FIELD_NAME_LEN);
+        field->name[FIELD_NAME_LEN - 1] = '\0';
+        field->type = desc[16];
+        field->size = (uint16_t)get_le(desc + 18, 2);
+        field->offset = (uint32_t)get_le(desc + 20, 4);
+        if (!field_valid(field, schema->record_size))
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+int schema_equal(const Schema *a, const Schema *b)
+{
+    if (a->version != b->version || a->record_size != b->record_size || a->field_count != b->field_count)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < a->field_count; i++)
+    {
+        const FieldDesc *x = &a->fields[i], *y = &b->fields[i];
+        if (strncmp(x->name, y->name, FIELD_NAME_LEN) != 0 || x->type != y->type || x->size != y->size
+            || x->offset != y->offset)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void record_encode(unsigned char *out, const studentInfo *record)
+{
+    put_le(out + OFF_ID, record->stubase_.id, 8);
+    memcpy(out + OFF_NAME, record->stubase_.name, LEN_NAME);
+    out[OFF_SEX] = (unsigned char)record->stubase_.sex;
+    put_le(out + OFF_AGE, record->stubase_.age, 4);
+    put_le(out + OFF_CHINESE, record->studscore_.Chinese, 4);
+    put_le(out + OFF_MATHS, record->studscore_.Maths, 4);
+    put_le(out + OFF_ENGLISH, record->studscore_.English, 4);
+    memcpy(out + OFF_USER, record->stuaccout_.user, LEN_USER);
+    memcpy(out + OFF_PASSWORD, record->stuaccout_.password, LEN_PASSWORD);
+    put_le(out + OFF_ROLE, record->stuaccout_.role, 1);
+}
+
+void record_decode(const unsigned char *in, studentInfo *record)
+{
+    memset(record, 0, sizeof(studentInfo));
+    record->stubase_.id = get_le(in + OFF_ID, 8);
+    memcpy(record->stubase_.name, in + OFF_NAME, LEN_NAME);
+    record->stubase_.sex = (char)in[OFF_SEX];
+    record->stubase_.age = (int)get_le(in + OFF_AGE, 4);
+    record->studscore_.Chinese = (int)get_le(in + OFF_CHINESE, 4);
+    record->studscore_.Maths = (int)get_le(in + OFF_MATHS, 4);
+    record->studscore_.English = (int)get_le(in + OFF_ENGLISH, 4);
+    memcpy(record->stuaccout_.user, in + OFF_USER, LEN_USER);
+    memcpy(record->stuaccout_.password, in + OFF_PASSWORD, LEN_PASSWORD);
+    record->stuaccout_.role = (UserRole)get_le(in + OFF_ROLE, 1);
+}
+
+void conversion_init(Conversion *conv, const Schema *from, const Schema *to)
+{
+    conv->from = from;
+    conv->to = to;
+    for (uint32_t i = 0; i < to->field_count; i++)
+    {
+        conv->source[i] = -1;
+        for (uint32_t j = 0; j < from->field_count; j++)
+        {
+            if (strncmp(to->fields[i].name, from->fields[j].name, FIELD_NAME_LEN) == 0
+                && to->fields[i].type == from->fields[j].type)
+            {
+                conv->source[i] = (int)j;
+                break;
+            }
+        }
+    }
+}
+
+void record_convert(const Conversion *conv, const unsigned char *in, unsigned char *out)
+{
+    const Schema *to = conv->to;
+
+    memset(out, 0, to->record_size);
+    for (uint32_t i = 0; i < to->field_count; i++)
+    {
+        if (conv->source[i] < 0)
+        {
+            continue;
+        }
+        const FieldDesc *dst = &to->fields[i];
+        const FieldDesc *src = &conv->from->fields[conv->source[i]];
+        if (dst->type == FIELD_INT)
+        {
+            put_le(out + dst->offset, get_le(in + src->offset, src->size), dst->size);
+        }
+        else
+        {
+            memcpy(out + dst->offset, in + src->offset, src->size < dst->size ? src->size : dst->size);
+        }
+    }
+}
+
+int64_t field_get_int(const FieldDesc *field, const unsigned char *record)
+{
+    return get_le(record + field->offset, field->size);
+}
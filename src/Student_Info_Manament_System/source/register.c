@@ -4,6 +4,7 @@
 #include "global.h"
 #include "config.h"
 #include "ui_display.h"
+#include "storage.h"
 
 /*
 注册需求分析：
@@ -33,20 +34,11 @@ void Register_Flow(studentInfo *stuinfo, studentInfo *stutemp)
     clear_input_buffer(); // 清理输入缓冲区
     
     // 检查用户名是否已存在
-    FILE *fp = fopen(DATA_FILE, "r");
-    if (fp != NULL)
+    studentInfo temp;
+    if (storage_find_by_username(username, &temp) == SUCCESS)
     {
-        studentInfo temp;
-        while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-        {
-            if (strcmp(temp.stuaccout_.user, username) == 0)
-            {
-                printf("\n用户名已存在，请使用其他用户名！\n");
-                fclose(fp);
-                return;
-            }
-        }
-        fclose(fp);
+        printf("\n用户名已存在，请使用其他用户名！\n");
+        return;
     }
     
     printf("请输入密码：");
@@ -73,22 +65,12 @@ void Register_Flow(studentInfo *stuinfo, studentInfo *stutemp)
     stutemp->stuaccout_.role = ROLE_STUDENT;  // 设置为学生角色
     
     // 写入文件
-    fp = fopen(DATA_FILE, "a");
-    if (fp == NULL)
-    {
-        printf("\n无法打开数据文件，注册失败！\n");
-        return;
-    }
-    
-    if (fwrite(stutemp, sizeof(studentInfo), 1, fp) != 1)
+    if (storage_insert(stutemp) == FAILURE)
     {
         printf("\n写入文件失败，注册失败！\n");
-        fclose(fp);
         return;
     }
     
-    fclose(fp);
-    
     Register_Success_Display();
     printf("\n注册成功！用户名：%s\n", username);
     printf("请返回主菜单进行登录。\n");
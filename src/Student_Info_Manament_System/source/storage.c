@@ -0,0 +1,818 @@
+#include "storage.h"
+#include "bptree.h"
+#include "config.h"
+#include "data_file.h"
+#include "hash_index.h"
+#include "wal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static DataFile data = {.fd = -1};   // 槽数 data.count 含墓碑
+static uint32_t free_count;     // 墓碑槽数
+static HashIndex user_index = {-1, 0, 0};
+static BPTree id_index = {-1, 0, 0, 0};
+static Wal wal = {.fd = -1};
+static uint64_t last_lsn;       // 最近一次修改写入的日志序号
+static int read_only;           // 日志写失败后不再接受修改
+
+// 所有接口和后台线程共用一把锁
+static pthread_mutex_t storage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t worker;
+static int worker_running;
+static SyncPolicy sync_policy = STORAGE_SYNC_DEFAULT;
+
+// 一批修改暂存的数据文件写入：整批日志提交之后才写进数据文件
+typedef struct
+{
+    uint32_t slot;
+    studentInfo record;
+} StagedWrite;
+
+static StagedWrite *staged;
+static uint32_t staged_count;
+static uint32_t staged_cap;
+static uint32_t slot_count;     // 算上暂存的追加后的槽数，不在一批修改中时等于 data.count
+
+// 等待执行的修改：第一个到达的线程成为 leader，把排队的修改作为一批执行并一次提交日志
+enum
+{
+    OP_INSERT,
+    OP_UPDATE,
+    OP_DELETE
+};
+
+typedef struct WriteOp
+{
+    int type;
+    const studentInfo *record;  // 插入、更新
+    const char *username;       // 删除
+    int ret;
+    int done;
+    struct WriteOp *next;
+} WriteOp;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static WriteOp *queue_head;
+static WriteOp **queue_tail = &queue_head;
+static int queue_busy;          // 有 leader 正在执行一批修改
+
+// 本批暂存的写入优先，其余直接从映射中解码，没有系统调用
+static int read_record(uint32_t slot, studentInfo *record)
+{
+    for (uint32_t i = staged_count; i-- > 0;)
+    {
+        if (staged[i].slot == slot)
+        {
+            memcpy(record, &staged[i].record, sizeof(studentInfo));
+            return SUCCESS;
+        }
+    }
+    return data_file_read(&data, slot, record);
+}
+
+// 日志写失败是致命的：之后的修改无法保证持久，引擎转为只读，查询照常
+// 调用时持有 storage_lock
+static void enter_read_only(void)
+{
+    if (!read_only)
+    {
+        read_only = 1;
+        printf("%s写日志 " WAL_FILE " 失败，存储引擎已转为只读，请检查磁盘后重启程序%s\n", COLOR_RED, COLOR_RESET);
+    }
+}
+
+// 写一条记录到它的槽：追加日志并暂存，数据文件等这一批的日志提交后才写（apply_batch）
+// 可能失败的步骤（分配暂存区、预留追加的槽）都在追加日志之前，日志里只有一定会提交的修改
+static int write_record(uint32_t slot, const studentInfo *record)
+{
+    if (read_only || wal_failed(&wal))
+    {
+        enter_read_only();
+        return FAILURE;
+    }
+    if (slot > slot_count || (slot == slot_count && data_file_reserve(&data, slot + 1) == FAILURE))
+    {
+        return FAILURE;
+    }
+    if (staged_count == staged_cap)
+    {
+        uint32_t cap = staged_cap ? staged_cap * 2 : 16;
+        StagedWrite *grown = realloc(staged, cap * sizeof(StagedWrite));
+        if (grown == NULL)
+        {
+            return FAILURE;
+        }
+        staged = grown;
+        staged_cap = cap;
+    }
+    uint64_t lsn = wal_append(&wal, WAL_OP_WRITE, slot, record);
+    if (lsn == 0)
+    {
+        enter_read_only();
+        return FAILURE;
+    }
+    last_lsn = lsn;
+    staged[staged_count].slot = slot;
+    memcpy(&staged[staged_count].record, record, sizeof(studentInfo));
+    staged_count++;
+    if (slot == slot_count)
+    {
+        slot_count++;
+    }
+    return SUCCESS;
+}
+
+static void make_tombstone(studentInfo *record)
+{
+    memset(record, 0, sizeof(studentInfo));
+    record->stubase_.id = FREE_SLOT_ID;
+    record->stuaccout_.role = ROLE_DELETED;
+}
+
+// 按记录号顺序遍历全部记录（含墓碑和本批暂存的写入），对每条调用 fn(记录号, 记录)，fn 返回非 0 时停止
+static void scan_records(int (*fn)(uint32_t slot, const studentInfo *record, void *ctx), void *ctx)
+{
+    studentInfo record;
+
+    for (uint32_t slot = 0; slot < slot_count; slot++)
+    {
+        read_record(slot, &record);
+        if (fn(slot, &record, ctx) != 0)
+        {
+            return;
+        }
+    }
+}
+
+typedef struct
+{
+    char (*users)[HASH_USER_LEN];
+    long long *ids;
+} IndexKeys;
+
+static int collect_keys(uint32_t slot, const studentInfo *record, void *ctx)
+{
+    IndexKeys *keys = ctx;
+    memcpy(keys->users[slot], record->stuaccout_.user, HASH_USER_LEN);
+    keys->ids[slot] = record->stubase_.id;
+    return 0;
+}
+
+static int count_slot(uint32_t slot, void *ctx)
+{
+    (void)slot;
+    (*(uint32_t *)ctx)++;
+    return 0;
+}
+
+// 扫描数据文件（含本批暂存的写入）重建索引；墓碑的学号是 FREE_SLOT_ID，空闲槽随 B+ 树一起重建
+static int rebuild_indexes(void)
+{
+    IndexKeys keys;
+    int ret;
+
+    hash_index_close(&user_index, slot_count);
+    bptree_close(&id_index, slot_count);
+
+    keys.users = calloc(slot_count ? slot_count : 1, HASH_USER_LEN);
+    keys.ids = calloc(slot_count ? slot_count : 1, sizeof(long long));
+    if (keys.users == NULL || keys.ids == NULL)
+    {
+        free(keys.users);
+        free(keys.ids);
+        return FAILURE;
+    }
+    scan_records(collect_keys, &keys);
+    ret = hash_index_build(&user_index, INDEX_USER_FILE, (const char (*)[HASH_USER_LEN])keys.users, slot_count)
+          == SUCCESS
+          && bptree_build(&id_index, INDEX_ID_FILE, keys.ids, slot_count) == SUCCESS;
+    free(keys.users);
+    free(keys.ids);
+    return ret ? SUCCESS : FAILURE;
+}
+
+// 取编号最小的空闲槽
+static int first_free(uint32_t slot, void *ctx)
+{
+    *(uint32_t *)ctx = slot;
+    return 1;
+}
+
+typedef struct
+{
+    uint32_t *slots;
+    uint32_t count;
+    uint32_t max;
+} FreeSlots;
+
+// 按编号从小到大收集空闲槽
+static int collect_free(uint32_t slot, void *ctx)
+{
+    FreeSlots *list = ctx;
+    list->slots[list->count++] = slot;
+    return list->count == list->max;
+}
+
+typedef struct
+{
+    uint32_t from;              // 文件末尾的槽
+    uint32_t to;                // 搬去的空闲槽；末尾是墓碑时为 UINT32_MAX，直接截掉
+    studentInfo record;
+} CompactStep;
+
+// 把末尾的有效记录搬进编号最小的空闲槽，截掉末尾的墓碑，最多处理 max_steps 个槽
+// 多个槽的修改必须一起生效：先把全部副本和截断写进日志并落盘，再改数据文件和索引
+static void compact_locked(uint32_t max_steps)
+{
+    uint32_t n = free_count < max_steps ? free_count : max_steps;
+    FreeSlots free_list = {NULL, 0, n};
+    CompactStep *steps;
+    uint32_t count = data.count, nsteps = 0, next_free = 0;
+
+    if (n == 0 || read_only)
+    {
+        return;
+    }
+    free_list.slots = malloc(n * sizeof(uint32_t));
+    steps = malloc(n * sizeof(CompactStep));
+    if (free_list.slots == NULL || steps == NULL
+        || bptree_find(&id_index, FREE_SLOT_ID, collect_free, &free_list) == -1)
+    {
+        free(free_list.slots);
+        free(steps);
+        return;
+    }
+
+    // 从末尾往前规划
+    while (nsteps < n && count > 0)
+    {
+        CompactStep *step = &steps[nsteps];
+        if (read_record(count - 1, &step->record) == FAILURE)
+        {
+            break;
+        }
+        step->from = count - 1;
+        if (step->record.stuaccout_.role == ROLE_DELETED)
+        {
+            step->to = UINT32_MAX;
+        }
+        else if (next_free < free_list.count && free_list.slots[next_free] < step->from)
+        {
+            step->to = free_list.slots[next_free++];
+        }
+        else
+        {
+            break;
+        }
+        nsteps++;
+        count--;
+    }
+
+    if (nsteps > 0)
+    {
+        for (uint32_t i = 0; i < nsteps; i++)
+        {
+            if (steps[i].to != UINT32_MAX)
+            {
+                last_lsn = wal_append(&wal, WAL_OP_WRITE, steps[i].to, &steps[i].record);
+            }
+        }
+        last_lsn = wal_append(&wal, WAL_OP_TRUNCATE, count, NULL);
+        if (last_lsn != 0 && wal_commit(&wal, last_lsn, 1) == SUCCESS)
+        {
+            for (uint32_t i = 0; i < nsteps; i++)
+            {
+                CompactStep *step = &steps[i];
+                if (step->to == UINT32_MAX)
+                {
+                    bptree_remove(&id_index, FREE_SLOT_ID, step->from);
+                    continue;
+                }
+                if (data_file_write(&data, step->to, &step->record) == FAILURE)
+                {
+                    perror("compact " DATA_FILE);
+                }
+                bptree_remove(&id_index, FREE_SLOT_ID, step->to);
+                bptree_remove(&id_index, step->record.stubase_.id, step->from);
+                bptree_insert(&id_index, step->record.stubase_.id, step->to);
+                hash_index_insert(&user_index, step->record.stuaccout_.user, step->to);
+            }
+            // 文件在下次检查点时才变短
+            data_file_truncate(&data, count);
+            slot_count = data.count;
+            free_count -= nsteps;
+        }
+        else
+        {
+            enter_read_only();
+        }
+    }
+    free(free_list.slots);
+    free(steps);
+}
+
+static int need_compact(void)
+{
+    return free_count >= COMPACT_MIN_FREE && free_count * 4 >= data.count;
+}
+
+// 后台线程：按 SYNC_INTERVAL 策略定期提交日志，日志太大时做检查点，定期检查并分批整理
+static void *storage_worker(void *arg)
+{
+    uint64_t ticks = 0;
+
+    (void)arg;
+    pthread_mutex_lock(&storage_lock);
+    while (worker_running)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += SYNC_INTERVAL_SEC;
+        if (pthread_cond_timedwait(&worker_cond, &storage_lock, &deadline) != ETIMEDOUT)
+        {
+            continue;
+        }
+        ticks++;
+        if (sync_policy == SYNC_INTERVAL)
+        {
+            // fdatasync 期间不持锁，前台修改照常进行
+            uint64_t lsn = last_lsn;
+            pthread_mutex_unlock(&storage_lock);
+            int ok = wal_commit(&wal, lsn, 1);
+            pthread_mutex_lock(&storage_lock);
+            if (ok == FAILURE)
+            {
+                enter_read_only();
+            }
+        }
+        if (worker_running && wal_size(&wal) >= WAL_CHECKPOINT_SIZE && wal_checkpoint(&wal, &data) == FAILURE)
+        {
+            perror("checkpoint " WAL_FILE);
+        }
+        if (ticks % (COMPACT_INTERVAL_SEC / SYNC_INTERVAL_SEC) != 0)
+        {
+            continue;
+        }
+        // 每批之间放开锁，整理不会长时间挡住前台操作
+        while (worker_running && need_compact())
+        {
+            compact_locked(COMPACT_BATCH);
+            pthread_mutex_unlock(&storage_lock);
+            sched_yield();
+            pthread_mutex_lock(&storage_lock);
+        }
+    }
+    pthread_mutex_unlock(&storage_lock);
+    return NULL;
+}
+
+static int open_locked(void)
+{
+    if (data.fd != -1)
+    {
+        return SUCCESS;
+    }
+    read_only = 0;
+    if (data_file_open(&data, DATA_FILE) == FAILURE)
+    {
+        perror("open " DATA_FILE);
+        data_file_close(&data);
+        return FAILURE;
+    }
+
+    // 先把上次没做检查点的修改从日志重放到数据文件
+    uint32_t replayed;
+    if (wal_open(&wal, WAL_FILE, &data, &replayed) == FAILURE)
+    {
+        perror("open " WAL_FILE);
+        wal_close(&wal);
+        data_file_close(&data);
+        return FAILURE;
+    }
+    if (replayed > 0)
+    {
+        printf("%s从日志恢复了 %u 次修改%s\n", COLOR_YELLOW, replayed, COLOR_RESET);
+    }
+
+    slot_count = data.count;
+
+    // 重放过日志时数据文件变了，索引一律重建
+    int user_ok = replayed == 0 && hash_index_open(&user_index, INDEX_USER_FILE, data.count) == SUCCESS;
+    int id_ok = replayed == 0 && bptree_open(&id_index, INDEX_ID_FILE, data.count) == SUCCESS;
+    if (!user_ok || !id_ok)
+    {
+        printf("%s正在重建索引（%u 条记录）...%s\n", COLOR_YELLOW, data.count, COLOR_RESET);
+        if (rebuild_indexes() == FAILURE)
+        {
+            perror("rebuild index");
+            wal_close(&wal);
+            data_file_close(&data);
+            return FAILURE;
+        }
+    }
+    free_count = 0;
+    bptree_find(&id_index, FREE_SLOT_ID, count_slot, &free_count);
+
+    worker_running = 1;
+    if (pthread_create(&worker, NULL, storage_worker, NULL) != 0)
+    {
+        worker_running = 0;
+    }
+    return SUCCESS;
+}
+
+int storage_open(void)
+{
+    pthread_mutex_lock(&storage_lock);
+    int ret = open_locked();
+    pthread_mutex_unlock(&storage_lock);
+    return ret;
+}
+
+void storage_close(void)
+{
+    pthread_mutex_lock(&storage_lock);
+    if (data.fd == -1)
+    {
+        pthread_mutex_unlock(&storage_lock);
+        return;
+    }
+    if (worker_running)
+    {
+        worker_running = 0;
+        pthread_cond_signal(&worker_cond);
+        pthread_mutex_unlock(&storage_lock);
+        pthread_join(worker, NULL);
+        pthread_mutex_lock(&storage_lock);
+    }
+    // 检查点：日志和数据先落盘，索引才能标记为与它一致
+    if (wal_checkpoint(&wal, &data) == FAILURE)
+    {
+        perror("checkpoint " WAL_FILE);
+    }
+    hash_index_close(&user_index, data.count);
+    bptree_close(&id_index, data.count);
+    wal_close(&wal);
+    data_file_close(&data);
+    pthread_mutex_unlock(&storage_lock);
+}
+
+
+int storage_find_by_username(const char *username, studentInfo *result)
+{
+    uint32_t slot;
+    int ret = FAILURE;
+
+    pthread_mutex_lock(&storage_lock);
+    if (open_locked() == SUCCESS && hash_index_find(&user_index, username, &slot) == SUCCESS)
+    {
+        ret = read_record(slot, result);
+    }
+    pthread_mutex_unlock(&storage_lock);
+    return ret;
+}
+
+typedef struct
+{
+    long long id;
+    studentInfo *result;
+} IdLookup;
+
+static int match_student(uint32_t slot, void *ctx)
+{
+    IdLookup *lookup = ctx;
+    studentInfo record;
+
+    if (read_record(slot, &record) == SUCCESS && record.stubase_.id == lookup->id
+        && record.stuaccout_.role == ROLE_STUDENT)
+    {
+        memcpy(lookup->result, &record, sizeof(studentInfo));
+        return 1;
+    }
+    return 0;
+}
+
+int storage_find_by_id(long long id, studentInfo *result)
+{
+    IdLookup lookup = {id, result};
+    int ret = FAILURE;
+
+    pthread_mutex_lock(&storage_lock);
+    if (open_locked() == SUCCESS && bptree_find(&id_index, id, match_student, &lookup) == 1)
+    {
+        ret = SUCCESS;
+    }
+    pthread_mutex_unlock(&storage_lock);
+    return ret;
+}
+
+// 写入已经暂存，这次修改一定随本批提交；索引更新失败时按数据和暂存的写入重建索引，修改仍算成功
+static int repair_indexes(void)
+{
+    if (rebuild_indexes() == FAILURE)
+    {
+        perror("rebuild index");
+    }
+    return SUCCESS;
+}
+
+static int insert_locked(const studentInfo *record)
+{
+    uint32_t slot;
+
+    if (open_locked() == FAILURE || record->stuaccout_.role == ROLE_DELETED
+        || hash_index_find(&user_index, record->stuaccout_.user, &slot) == SUCCESS)
+    {
+        return FAILURE;
+    }
+
+    // 优先复用编号最小的空闲槽，没有时追加到末尾
+    if (free_count > 0 && bptree_find(&id_index, FREE_SLOT_ID, first_free, &slot) == 1)
+    {
+        if (write_record(slot, record) == FAILURE)
+        {
+            return FAILURE;
+        }
+        free_count--;
+        if (bptree_remove(&id_index, FREE_SLOT_ID, slot) == FAILURE)
+        {
+            return repair_indexes();
+        }
+    }
+    else
+    {
+        slot = slot_count;
+        if (write_record(slot, record) == FAILURE)
+        {
+            return FAILURE;
+        }
+    }
+
+    if (hash_index_insert(&user_index, record->stuaccout_.user, slot) == FAILURE
+        || bptree_insert(&id_index, record->stubase_.id, slot) == FAILURE)
+    {
+        return repair_indexes();
+    }
+    return SUCCESS;
+}
+
+static int update_locked(const studentInfo *record)
+{
+    studentInfo old;
+    uint32_t slot;
+
+    if (open_locked() == FAILURE || hash_index_find(&user_index, record->stuaccout_.user, &slot) == FAILURE
+        || read_record(slot, &old) == FAILURE)
+    {
+        return FAILURE;
+    }
+    // 原地写回它的槽
+    if (write_record(slot, record) == FAILURE)
+    {
+        return FAILURE;
+    }
+    // 记录号不变，只有学号变了时需要更新 B+ 树
+    if (old.stubase_.id != record->stubase_.id
+        && (bptree_remove(&id_index, old.stubase_.id, slot) == FAILURE
+            || bptree_insert(&id_index, record->stubase_.id, slot) == FAILURE))
+    {
+        return repair_indexes();
+    }
+    return SUCCESS;
+}
+
+static int delete_locked(const char *username)
+{
+    studentInfo old, tombstone;
+    uint32_t slot;
+
+    if (open_locked() == FAILURE || hash_index_find(&user_index, username, &slot) == FAILURE
+        || read_record(slot, &old) == FAILURE)
+    {
+        return FAILURE;
+    }
+    // 槽里写入墓碑，登记为空闲槽
+    make_tombstone(&tombstone);
+    if (write_record(slot, &tombstone) == FAILURE)
+    {
+        return FAILURE;
+    }
+    free_count++;
+    if (hash_index_remove(&user_index, username) == FAILURE
+        || bptree_remove(&id_index, old.stubase_.id, slot) == FAILURE
+        || bptree_insert(&id_index, FREE_SLOT_ID, slot) == FAILURE)
+    {
+        return repair_indexes();
+    }
+    return SUCCESS;
+}
+
+// 日志提交后把暂存的写入依次写进数据文件
+// 日志已经提交，这里失败时数据文件与日志不一致：转为只读，重启时由日志重放补上，修改仍算成功
+static void apply_batch(void)
+{
+    for (uint32_t i = 0; i < staged_count; i++)
+    {
+        if (data_file_write(&data, staged[i].slot, &staged[i].record) == FAILURE)
+        {
+            perror("write " DATA_FILE);
+            enter_read_only();
+            break;
+        }
+    }
+    staged_count = 0;
+    slot_count = data.count;
+}
+
+// 日志提交失败：丢掉暂存的写入，数据文件没有动过，按它重建索引和空闲槽数
+static void discard_batch(void)
+{
+    staged_count = 0;
+    slot_count = data.count;
+    enter_read_only();
+    if (rebuild_indexes() == FAILURE)
+    {
+        perror("rebuild index");
+    }
+    free_count = 0;
+    bptree_find(&id_index, FREE_SLOT_ID, count_slot, &free_count);
+}
+
+// 执行一批修改：逐个修改只追加日志并暂存写入，然后整批提交一次日志（SYNC_EACH 时 fdatasync），
+// 提交成功后才写数据文件。整批持有存储锁，其他线程看不到还没提交的修改
+static void run_batch(WriteOp *batch)
+{
+    int staged_ops = 0;
+
+    pthread_mutex_lock(&storage_lock);
+    for (WriteOp *op = batch; op != NULL; op = op->next)
+    {
+        if (op->type == OP_INSERT)
+        {
+            op->ret = insert_locked(op->record);
+        }
+        else if (op->type == OP_UPDATE)
+        {
+            op->ret = update_locked(op->record);
+        }
+        else
+        {
+            op->ret = delete_locked(op->username);
+        }
+        staged_ops += op->ret == SUCCESS;
+    }
+    if (staged_ops > 0)
+    {
+        if (wal_commit(&wal, last_lsn, sync_policy == SYNC_EACH) == SUCCESS)
+        {
+            apply_batch();
+        }
+        else
+        {
+            discard_batch();
+            for (WriteOp *op = batch; op != NULL; op = op->next)
+            {
+                op->ret = FAILURE;
+            }
+        }
+    }
+    pthread_mutex_unlock(&storage_lock);
+}
+
+// 排队等待执行：没有 leader 时自己成为 leader，带走队列里所有的修改作为一批执行；
+// leader 提交日志期间到达的修改继续排队，由下一个 leader 一起提交（组提交）
+static int submit_write(WriteOp *op)
+{
+    pthread_mutex_lock(&queue_lock);
+    *queue_tail = op;
+    queue_tail = &op->next;
+    while (!op->done)
+    {
+        if (queue_busy)
+        {
+            pthread_cond_wait(&queue_cond, &queue_lock);
+            continue;
+        }
+        WriteOp *batch = queue_head;
+        queue_head = NULL;
+        queue_tail = &queue_head;
+        queue_busy = 1;
+        pthread_mutex_unlock(&queue_lock);
+
+        run_batch(batch);
+
+        pthread_mutex_lock(&queue_lock);
+        for (WriteOp *done = batch; done != NULL; done = done->next)
+        {
+            done->done = 1;
+        }
+        queue_busy = 0;
+        pthread_cond_broadcast(&queue_cond);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return op->ret;
+}
+
+int storage_insert(const studentInfo *record)
+{
+    WriteOp op = {OP_INSERT, record, NULL, FAILURE, 0, NULL};
+    return submit_write(&op);
+}
+
+int storage_update(const studentInfo *record)
+{
+    WriteOp op = {OP_UPDATE, record, NULL, FAILURE, 0, NULL};
+    return submit_write(&op);
+}
+
+int storage_delete(const char *username)
+{
+    WriteOp op = {OP_DELETE, NULL, username, FAILURE, 0, NULL};
+    return submit_write(&op);
+}
+
+typedef struct
+{
+    int (*fn)(const studentInfo *record, void *ctx);
+    void *ctx;
+} ScanAdapter;
+
+static int scan_adapter(uint32_t slot, const studentInfo *record, void *ctx)
+{
+    ScanAdapter *adapter = ctx;
+    (void)slot;
+    if (record->stuaccout_.role == ROLE_DELETED)
+    {
+        return 0;
+    }
+    return adapter->fn(record, adapter->ctx);
+}
+
+void storage_scan(int (*fn)(const studentInfo *record, void *ctx), void *ctx)
+{
+    ScanAdapter adapter = {fn, ctx};
+
+    pthread_mutex_lock(&storage_lock);
+    if (open_locked() == SUCCESS)
+    {
+        scan_records(scan_adapter, &adapter);
+    }
+    pthread_mutex_unlock(&storage_lock);
+}
+
+uint32_t storage_count(void)
+{
+    uint32_t count = 0;
+
+    pthread_mutex_lock(&storage_lock);
+    if (open_locked() == SUCCESS)
+    {
+        count = data.count - free_count;
+    }
+    pthread_mutex_unlock(&storage_lock);
+    return count;
+}
+
+void storage_set_sync_policy(SyncPolicy policy)
+{
+    pthread_mutex_lock(&storage_lock);
+    if (data.fd != -1 && policy == SYNC_EACH)
+    {
+        wal_commit(&wal, last_lsn, 1);
+    }
+    sync_policy = policy;
+    pthread_mutex_unlock(&storage_lock);
+}
+
+void storage_compact(void)
+{
+    pthread_mutex_lock(&storage_lock);
+    if (open_locked() == SUCCESS)
+    {
+        compact_locked(UINT32_MAX);
+    }
+    pthread_mutex_unlock(&storage_lock);
+}
+
+void storage_wal_stats(uint64_t *records, uint64_t *syncs)
+{
+    *records = 0;
+    *syncs = 0;
+    pthread_mutex_lock(&storage_lock);
+    if (data.fd != -1)
+    {
+        pthread_mutex_lock(&wal.lock);
+        *records = wal.records;
+        *syncs = wal.syncs;
+        pthread_mutex_unlock(&wal.lock);
+    }
+    pthread_mutex_unlock(&storage_lock);
+}
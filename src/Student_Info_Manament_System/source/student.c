@@ -1,5 +1,6 @@
 #include "student.h"
 #include "config.h"
+#include "storage.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -163,34 +164,5 @@ void view_my_scores(studentInfo *student)
 // 更新学生信息到文件
 int update_student_to_file(studentInfo *student)
 {
-    FILE *fp = fopen(DATA_FILE, "r");
-    FILE *temp_fp = fopen("data/temp.dat", "w");
-    
-    if (fp == NULL || temp_fp == NULL)
-    {
-        if (fp) fclose(fp);
-        if (temp_fp) fclose(temp_fp);
-        return FAILURE;
-    }
-    
-    studentInfo temp;
-    while (fread(&temp, sizeof(studentInfo), 1, fp) == 1)
-    {
-        if (strcmp(temp.stuaccout_.user, student->stuaccout_.user) == 0)
-        {
-            fwrite(student, sizeof(studentInfo), 1, temp_fp);
-        }
-        else
-        {
-            fwrite(&temp, sizeof(studentInfo), 1, temp_fp);
-        }
-    }
-    
-    fclose(fp);
-    fclose(temp_fp);
-    
-    remove(DATA_FILE);
-    rename("data/temp.dat", DATA_FILE);
-    
-    return SUCCESS;
+    return storage_update(student);
 }
@@ -0,0 +1,330 @@
+#include "wal.h"
+#include "config.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAL_MAGIC "SWL1"
+#define WAL_VERSION 1
+#define REPLAY_BATCH 256        // 重放时每次读取的日志条数
+
+// 日志文件头，固定 64 字节
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;       // sizeof(WalRecord)
+    uint32_t data_record_size;  // sizeof(studentInfo)，结构体变了的旧日志不能重放
+    uint64_t start_lsn;         // 第一条日志的序号
+    char reserved[40];
+} WalHeader;
+
+typedef struct
+{
+    uint64_t lsn;
+    uint32_t op;
+    uint32_t slot;
+    studentInfo record;
+    uint32_t crc;               // 前面所有字段的 CRC32
+    uint32_t reserved;
+} WalRecord;
+
+static uint32_t crc32(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(const WalRecord *rec)
+{
+    return crc32(rec, offsetof(WalRecord, crc));
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0)
+        {
+            return FAILURE;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return SUCCESS;
+}
+
+// 把日志清空，只留下从 next_lsn 开始的文件头（日志文件以 O_APPEND 打开，不能用 pwrite 覆盖）
+static int reset_log(Wal *wal)
+{
+    WalHeader hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, WAL_MAGIC, 4);
+    hdr.version = WAL_VERSION;
+    hdr.record_size = sizeof(WalRecord);
+    hdr.data_record_size = sizeof(studentInfo);
+    hdr.start_lsn = wal->next_lsn;
+    if (ftruncate(wal->fd, 0) == -1 || write_all(wal->fd, (const char *)&hdr, sizeof(hdr)) == FAILURE
+        || fdatasync(wal->fd) == -1)
+    {
+        return FAILURE;
+    }
+    wal->size = sizeof(hdr);
+    return SUCCESS;
+}
+
+static int apply(DataFile *data, const WalRecord *rec)
+{
+    if (rec->op == WAL_OP_WRITE)
+    {
+        return data_file_write(data, rec->slot, &rec->record);
+    }
+    data_file_truncate(data, rec->slot);
+    return SUCCESS;
+}
+
+// 按顺序重放日志，遇到序号不连续或校验失败（上次写了一半）就停止
+static int replay(Wal *wal, DataFile *data, uint64_t start_lsn, uint32_t *replayed)
+{
+    WalRecord *batch = malloc(REPLAY_BATCH * sizeof(WalRecord));
+    off_t offset = sizeof(WalHeader);
+    uint64_t lsn = start_lsn;
+    int ret = SUCCESS;
+
+    if (batch == NULL)
+    {
+        return FAILURE;
+    }
+    *replayed = 0;
+    while (1)
+    {
+        ssize_t n = pread(wal->fd, batch, REPLAY_BATCH * sizeof(WalRecord), offset);
+        int count = n > 0 ? (int)((size_t)n / sizeof(WalRecord)) : 0;
+        int i;
+
+        for (i = 0; i < count; i++)
+        {
+            const WalRecord *rec = &batch[i];
+            if (rec->lsn != lsn || rec->crc != record_crc(rec)
+                || (rec->op != WAL_OP_WRITE && rec->op != WAL_OP_TRUNCATE))
+            {
+                break;
+            }
+            if (apply(data, rec) == FAILURE)
+            {
+                ret = FAILURE;
+                break;
+            }
+            lsn++;
+            (*replayed)++;
+        }
+        if (i < count || count < REPLAY_BATCH || ret == FAILURE)
+        {
+            break;
+        }
+        offset += (off_t)(count * sizeof(WalRecord));
+    }
+    free(batch);
+    wal->next_lsn = lsn;
+    wal->written_lsn = lsn - 1;
+    wal->synced_lsn = lsn - 1;
+    return ret;
+}
+
+int wal_open(Wal *wal, const char *path, DataFile *data, uint32_t *replayed)
+{
+    WalHeader hdr;
+    struct stat st;
+
+    memset(wal, 0, sizeof(*wal));
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->cond, NULL);
+    wal->next_lsn = 1;
+    *replayed = 0;
+
+    wal->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (wal->fd == -1 || fstat(wal->fd, &st) == -1)
+    {
+        return FAILURE;
+    }
+    // 新建的日志，或者上次创建时只写了一半的文件头
+    if (st.st_size < (off_t)sizeof(hdr))
+    {
+        return reset_log(wal);
+    }
+    if (pread(wal->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr.magic, WAL_MAGIC, 4) != 0
+        || hdr.version != WAL_VERSION || hdr.record_size != sizeof(WalRecord)
+        || hdr.data_record_size != sizeof(studentInfo) || hdr.start_lsn == 0)
+    {
+        return FAILURE;
+    }
+    if (replay(wal, data, hdr.start_lsn, replayed) == FAILURE)
+    {
+        return FAILURE;
+    }
+    // 重放的修改落盘后日志就没用了
+    if (data_file_sync(data) == FAILURE)
+    {
+        return FAILURE;
+    }
+    return reset_log(wal);
+}
+
+uint64_t wal_append(Wal *wal, uint32_t op, uint32_t slot, const studentInfo *record)
+{
+    WalRecord *rec;
+    uint64_t lsn;
+
+    pthread_mutex_lock(&wal->lock);
+    if (wal->len + sizeof(WalRecord) > wal->cap)
+    {
+        size_t cap = wal->cap ? wal->cap * 2 : 64 * sizeof(WalRecord);
+        char *buf = realloc(wal->buf, cap);
+        if (buf == NULL)
+        {
+            wal->failed = 1;
+            pthread_mutex_unlock(&wal->lock);
+            return 0;
+        }
+        wal->buf = buf;
+        wal->cap = cap;
+    }
+    rec = (WalRecord *)(wal->buf + wal->len);
+    memset(rec, 0, sizeof(*rec));
+    lsn = wal->next_lsn++;
+    rec->lsn = lsn;
+    rec->op = op;
+    rec->slot = slot;
+    if (record != NULL)
+    {
+        memcpy(&rec->record, record, sizeof(studentInfo));
+    }
+    rec->crc = record_crc(rec);
+    wal->len += sizeof(WalRecord);
+    wal->records++;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+int wal_commit(Wal *wal, uint64_t lsn, int sync)
+{
+    int ret = SUCCESS;
+
+    pthread_mutex_lock(&wal->lock);
+    while ((sync ? wal->synced_lsn : wal->written_lsn) < lsn)
+    {
+        if (wal->failed)
+        {
+            ret = FAILURE;
+            break;
+        }
+        if (wal->flushing)
+        {
+            pthread_cond_wait(&wal->cond, &wal->lock);
+            continue;
+        }
+
+        // 成为 leader：带走缓冲区中所有线程追加的日志，换上另一块缓冲区继续接收
+        char *batch = wal->buf;
+        size_t len = wal->len, cap = wal->cap;
+        uint64_t last = wal->next_lsn - 1;
+        wal->buf = wal->flush_buf;
+        wal->cap = wal->flush_cap;
+        wal->len = 0;
+        wal->flushing = 1;
+        pthread_mutex_unlock(&wal->lock);
+
+        int ok = write_all(wal->fd, batch, len) == SUCCESS && (!sync || fdatasync(wal->fd) == 0);
+
+        pthread_mutex_lock(&wal->lock);
+        wal->flush_buf = batch;
+        wal->flush_cap = cap;
+        wal->flushing = 0;
+        if (ok)
+        {
+            wal->size += (off_t)len;
+            wal->written_lsn = last;
+            if (sync)
+            {
+                wal->synced_lsn = last;
+                wal->syncs++;
+            }
+        }
+        else
+        {
+            wal->failed = 1;
+        }
+        pthread_cond_broadcast(&wal->cond);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
+
+int wal_checkpoint(Wal *wal, DataFile *data)
+{
+    int ret;
+
+    pthread_mutex_lock(&wal->lock);
+    uint64_t last = wal->next_lsn - 1;
+    pthread_mutex_unlock(&wal->lock);
+
+    // 先保证日志里有的修改都已经写进数据文件并落盘，才能丢弃日志
+    if (wal_commit(wal, last, 1) == FAILURE || data_file_sync(data) == FAILURE)
+    {
+        return FAILURE;
+    }
+    pthread_mutex_lock(&wal->lock);
+    while (wal->flushing)
+    {
+        pthread_cond_wait(&wal->cond, &wal->lock);
+    }
+    ret = wal->len == 0 ? reset_log(wal) : SUCCESS;
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
+
+int wal_failed(Wal *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    int failed = wal->failed;
+    pthread_mutex_unlock(&wal->lock);
+    return failed;
+}
+
+off_t wal_size(Wal *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    off_t size = wal->size + (off_t)wal->len;
+    pthread_mutex_unlock(&wal->lock);
+    return size;
+}
+
+void wal_close(Wal *wal)
+{
+    if (wal->fd != -1)
+    {
+        close(wal->fd);
+        wal->fd = -1;
+    }
+    free(wal->buf);
+    free(wal->flush_buf);
+    wal->buf = NULL;
+    wal->flush_buf = NULL;
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->cond);
+}
@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+#include "async_log.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_CACHELINE 64
+#define LOG_BATCH_RECORDS 500 /* 每条记录两个 iovec，不超过 IOV_MAX（1024） */
+#define LOG_PREFIX_MAX 32
+#define LOG_IDLE_NS (10 * 1000 * 1000) /* 所有队列都为空时的休眠间隔 */
+
+typedef struct {
+  struct timespec ts;
+  int level;
+  uint32_t len; /* 含结尾换行 */
+  char msg[LOG_MSG_MAX];
+} LogRecord;
+
+/*
+ * 单生产者单消费者环形队列：head 只由所属线程推进，tail 只由写线程推进，
+ * 两者各占一个缓存行
+ */
+typedef struct {
+  _Alignas(LOG_CACHELINE) _Atomic size_t head;
+  _Atomic uint64_t dropped;
+  _Alignas(LOG_CACHELINE) _Atomic size_t tail;
+  _Alignas(LOG_CACHELINE) LogRecord slots[LOG_RING_SIZE];
+} LogRing;
+
+typedef struct {
+  LogRing *ring;
+  size_t tail; /* 写出成功后要发布的新 tail */
+} LogPending;
+
+typedef struct {
+  int fd;
+  _Atomic int min_level;
+  _Atomic int started;
+  _Atomic int stop;
+  pthread_t writer;
+
+  /* 以下只由写线程使用 */
+  struct iovec iov[LOG_BATCH_RECORDS * 2];
+  char prefix[LOG_BATCH_RECORDS][LOG_PREFIX_MAX];
+  int count;
+  LogPending pending[LOG_MAX_THREADS];
+  int pending_count;
+  uint64_t reported_drops;
+  char drop_line[96];
+  time_t stamp_sec;
+  char stamp[24];
+} LogWriter;
+
+static const char *const kLevelNames[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+static _Atomic(LogRing *) g_rings[LOG_MAX_THREADS];
+static _Atomic int g_ring_count;
+static __thread LogRing *t_ring;
+static __thread int t_ring_failed;
+static LogWriter g_writer = {.fd = STDERR_FILENO};
+
+static LogRing *ring_register(void) {
+  LogRing *ring;
+  int idx;
+
+  idx = atomic_fetch_add(&g_ring_count, 1);
+  if (idx >= LOG_MAX_THREADS) {
+    t_ring_failed = 1;
+    return NULL;
+  }
+  ring = (LogRing *)aligned_alloc(LOG_CACHELINE, sizeof(LogRing));
+  if (ring == NULL) {
+    t_ring_failed = 1;
+    return NULL;
+  }
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->dropped, 0);
+  atomic_store_explicit(&g_rings[idx], ring, memory_order_release);
+  t_ring = ring;
+  return ring;
+}
+
+static int ring_count(void) {
+  int count = atomic_load_explicit(&g_ring_count, memory_order_acquire);
+
+  return count < LOG_MAX_THREADS ? count : LOG_MAX_THREADS;
+}
+
+/* 把 fmt 格式化为以换行结尾的消息，返回长度（含换行） */
+static uint32_t format_message(char *msg, const char *fmt, va_list ap) {
+  int n = vsnprintf(msg, LOG_MSG_MAX - 1, fmt, ap);
+
+  if (n < 0) {
+    n = 0;
+  } else if (n > LOG_MSG_MAX - 2) {
+    n = LOG_MSG_MAX - 2;
+  }
+  msg[n] = '\n';
+  return (uint32_t)n + 1;
+}
+
+/* 写线程未启动时的同步路径，一次 write 写出整行 */
+static void write_sync(int level, const char *fmt, va_list ap) {
+  char line[LOG_PREFIX_MAX + LOG_MSG_MAX];
+  size_t prefix_len = (size_t)snprintf(line, LOG_PREFIX_MAX, "%s ",
+                                       kLevelNames[level]);
+  uint32_t len = format_message(line + prefix_len, fmt, ap);
+  ssize_t ret;
+
+  ret = write(g_writer.fd, line, prefix_len + len);
+  (void)ret;
+}
+
+void log_write(int level, const char *fmt, ...) {
+  int saved_errno = errno;
+  LogRing *ring;
+  LogRecord *rec;
+  size_t head;
+  va_list ap;
+
+  if (level < atomic_load_explicit(&g_writer.min_level, memory_order_relaxed)) {
+    return;
+  }
+
+  if (!atomic_load_explicit(&g_writer.started, memory_order_acquire)) {
+    va_start(ap, fmt);
+    errno = saved_errno;
+    write_sync(level, fmt, ap);
+    va_end(ap);
+    errno = saved_errno;
+    return;
+  }
+
+  ring = t_ring;
+  if (ring == NULL) {
+    if (t_ring_failed || (ring = ring_register()) == NULL) {
+      errno = saved_errno;
+      return;
+    }
+  }
+
+  head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >=
+      LOG_RING_SIZE) {
+    atomic_store_explicit(
+        &ring->dropped,
+        atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+    errno = saved_errno;
+    return;
+  }
+
+  rec = &ring->slots[head & (LOG_RING_SIZE - 1)];
+  clock_gettime(CLOCK_REALTIME, &rec->ts);
+  rec->level = level;
+  va_start(ap, fmt);
+  /* 恢复 errno，保证 %m 输出的是调用方看到的错误 */
+  errno = saved_errno;
+  rec->len = format_message(rec->msg, fmt, ap);
+  va_end(ap);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  errno = saved_errno;
+}
+
+uint64_t log_dropped(void) {
+  uint64_t total = 0;
+  int count = ring_count();
+  int i;
+
+  for (i = 0; i < count; i++) {
+    LogRing *ring = atomic_load_explicit(&g_rings[i], memory_order_acquire);
+    if (ring != NULL) {
+      total += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+  }
+  return total;
+}
+
+static void writev_all(int fd, struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, count);
+
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    while (count > 0 && (size_t)n >= iov->iov_len) {
+      n -= (ssize_t)iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= (size_t)n;
+    }
+  }
+}
+
+/* 写出当前批次，然后把已写出的槽位还给各个生产者 */
+static void writer_flush(LogWriter *w) {
+  int i;
+
+  if (w->count > 0) {
+    writev_all(w->fd, w->iov, w->count);
+  }
+  for (i = 0; i < w->pending_count; i++) {
+    atomic_store_explicit(&w->pending[i].ring->tail, w->pending[i].tail,
+                          memory_order_release);
+  }
+  w->count = 0;
+  w->pending_count = 0;
+}
+
+static void writer_add(LogWriter *w, const LogRecord *rec) {
+  char *prefix = w->prefix[w->count / 2];
+  struct tm tm;
+  int prefix_len;
+
+  if (rec->ts.tv_sec != w->stamp_sec) {
+    w->stamp_sec = rec->ts.tv_sec;
+    localtime_r(&w->stamp_sec, &tm);
+    strftime(w->stamp, sizeof(w->stamp), "%Y-%m-%d %H:%M:%S", &tm);
+  }
+  prefix_len = snprintf(prefix, LOG_PREFIX_MAX, "%s.%03ld %s ", w->stamp,
+                        rec->ts.tv_nsec / 1000000, kLevelNames[rec->level]);
+  if (prefix_len >= LOG_PREFIX_MAX) {
+    prefix_len = LOG_PREFIX_MAX - 1;
+  }
+
+  w->iov[w->count].iov_base = prefix;
+  w->iov[w->count].iov_len = (size_t)prefix_len;
+  w->iov[w->count + 1].iov_base = (void *)rec->msg;
+  w->iov[w->count + 1].iov_len = rec->len;
+  w->count += 2;
+}
+
+/* 丢弃数有增长时补一行提示 */
+static void writer_report_drops(LogWriter *w) {
+  uint64_t dropped = log_dropped();
+  int len;
+
+  if (dropped == w->reported_drops) {
+    return;
+  }
+  len = snprintf(w->drop_line, sizeof(w->drop_line),
+                 "WARN  log: %llu records dropped (ring full)\n",
+                 (unsigned long long)(dropped - w->reported_drops));
+  w->reported_drops = dropped;
+  w->iov[w->count].iov_base = w->drop_line;
+  w->iov[w->count].iov_len = (size_t)len;
+  w->count++;
+  writer_flush(w);
+}
+
+/* 轮询一遍所有队列，返回本轮取到的记录数 */
+static size_t writer_drain(LogWriter *w) {
+  int count = ring_count();
+  size_t total = 0;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    LogRing *ring = atomic_load_explicit(&g_rings[i], memory_order_acquire);
+    size_t tail;
+    size_t head;
+
+    if (ring == NULL) {
+      continue;
+    }
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    while (tail != head) {
+      writer_add(w, &ring->slots[tail & (LOG_RING_SIZE - 1)]);
+      tail++;
+      total++;
+      /* 槽位在写出之前不能还给生产者，批次满了先写出 */
+      if (tail == head || w->count == LOG_BATCH_RECORDS * 2) {
+        w->pending[w->pending_count].ring = ring;
+        w->pending[w->pending_count].tail = tail;
+        w->pending_count++;
+      }
+      if (w->count == LOG_BATCH_RECORDS * 2) {
+        writer_flush(w);
+      }
+    }
+  }
+  writer_flush(w);
+  writer_report_drops(w);
+  return total;
+}
+
+static void *log_writer_routine(void *arg) {
+  LogWriter *w = (LogWriter *)arg;
+  const struct timespec idle = {0, LOG_IDLE_NS};
+
+  while (1) {
+    if (writer_drain(w) > 0) {
+      continue;
+    }
+    if (atomic_load(&w->stop)) {
+      break;
+    }
+    nanosleep(&idle, NULL);
+  }
+  /* stop 之后提交的日志不会再有人写出，最后再取一遍 */
+  writer_drain(w);
+  return NULL;
+}
+
+int log_init(int fd, int min_level) {
+  g_writer.fd = fd;
+  g_writer.stamp_sec = (time_t)-1;
+  atomic_store(&g_writer.min_level, min_level);
+  atomic_store(&g_writer.stop, 0);
+  if (pthread_create(&g_writer.writer, NULL, log_writer_routine, &g_writer) !=
+      0) {
+    return -1;
+  }
+  atomic_store_explicit(&g_writer.started, 1, memory_order_release);
+  return 0;
+}
+
+void log_shutdown(void) {
+  if (!atomic_load(&g_writer.started)) {
+    return;
+  }
+  atomic_store(&g_writer.stop, 1);
+  pthread_join(g_writer.writer, NULL);
+  atomic_store(&g_writer.started, 0);
+}
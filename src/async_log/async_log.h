@@ -0,0 +1,68 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdint.h>
+
+/*
+ * 异步批量日志：
+ * - 每个线程首次写日志时登记一个 SPSC 环形队列，只有本线程写入，无锁
+ * - 后台线程轮询所有队列，把记录拼成大块后一次 write 写出
+ * - 队列满时丢弃记录并计数，请求处理路径永远不会因为终端/管道写满而阻塞
+ *
+ * 格式化（vsnprintf）在调用线程完成，时间戳与行格式在后台线程生成
+ * 不同线程的日志之间只保证大致按时间顺序
+ */
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+/*
+ * 编译期日志级别：低于该级别的 log_xxx 调用展开为空，参数也不会求值
+ * 默认去掉 debug 日志，编译时加 -DLOG_COMPILE_LEVEL=0 打开
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_MAX_THREADS 256
+#define LOG_RING_SIZE 512 /* 每个线程的队列长度，必须是 2 的幂 */
+#define LOG_MSG_MAX 232   /* 单条消息长度上限，超出部分截断 */
+
+/*
+ * 启动后台写线程，日志写入 fd，低于 min_level 的日志在运行时丢弃
+ * 启动前（或启动失败时）的日志直接同步写入 fd 2
+ */
+int log_init(int fd, int min_level);
+
+/* 写出所有已提交的日志并停止后台线程 */
+void log_shutdown(void);
+
+void log_write(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* 因队列已满被丢弃的记录总数 */
+uint64_t log_dropped(void);
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define log_debug(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define log_info(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define log_info(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define log_warn(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define log_warn(...) ((void)0)
+#endif
+
+#define log_error(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif
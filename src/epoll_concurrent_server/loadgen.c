@@ -0,0 +1,356 @@
+/*
+ * loadgen - server_v2 的压测客户端（在 client.c 的基础上扩展为多连接）
+ * 保持 N 个连接，每个连接同时有 depth 条消息在途，收到一条回复立即补发一条，
+ * 统计每秒消息数与往返延迟（RTT）分位数
+ *
+ * 每条消息以换行结尾，服务器按读到的数据块回复 "Server received: " + 原数据，
+ * 不保证与消息边界对齐，但每条消息的换行在回复流中恰好出现一次，
+ * 因此按换行计数回复，同一连接上的回复与消息按顺序一一对应
+ *
+ * 用法: ./loadgen [-c 连接数=100] [-d 秒=10] [-w 预热秒=1]
+ *                 [-s 消息字节数=64] [-p 每连接在途消息数=1]
+ *                 [-H 服务器地址=127.0.0.1] [-P 端口=8990]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define RECV_BUF_SIZE 65536
+#define MAX_EVENTS 1024
+
+typedef struct {
+	int fd;
+	int head;           /* sent_ns 中最早一条在途消息的下标 */
+	int inflight;
+	size_t unsent;      /* 已计时但尚未写入 socket 的字节数 */
+	size_t woff;        /* 下一个要写的字节在消息中的偏移 */
+	uint64_t *sent_ns;  /* 在途消息的发出时刻，环形，长度为 depth */
+} LoadConn;
+
+typedef struct {
+	uint32_t *v;
+	size_t len;
+	size_t cap;
+} Samples;
+
+static int g_depth = 1;
+static size_t g_msg_size = 64;
+static char *g_stream;      /* 连续 depth + 1 条消息，发送时从任意偏移取一段 */
+static int g_measuring;
+static uint64_t g_messages;
+static uint64_t g_errors;
+static Samples g_samples;
+
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void samples_add(Samples *s, uint32_t us)
+{
+	if (s->len == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 1 << 20;
+		s->v = realloc(s->v, s->cap * sizeof(uint32_t));
+		if (s->v == NULL) {
+			perror("realloc samples");
+			exit(1);
+		}
+	}
+	s->v[s->len++] = us;
+}
+
+int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+uint32_t percentile(const Samples *s, double p)
+{
+	if (s->len == 0) {
+		return 0;
+	}
+	return s->v[(size_t)(p / 100.0 * (double)(s->len - 1) + 0.5)];
+}
+
+/*
+ * conn_issue - 发出一条新消息：记录发出时刻，字节由 conn_send 写出
+ */
+void conn_issue(LoadConn *c, uint64_t now)
+{
+	c->sent_ns[(c->head + c->inflight) % g_depth] = now;
+	c->inflight++;
+	c->unsent += g_msg_size;
+}
+
+/*
+ * conn_send - 尽量写出未发送的字节，发送队列满时等待 EPOLLOUT
+ * 返回值: 出错返回-1
+ */
+int conn_send(LoadConn *c)
+{
+	while (c->unsent > 0) {
+		ssize_t n = send(c->fd, g_stream + c->woff, c->unsent, MSG_NOSIGNAL);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			return -1;
+		}
+		c->unsent -= (size_t)n;
+		c->woff = (c->woff + (size_t)n) % g_msg_size;
+	}
+	return 0;
+}
+
+/*
+ * conn_recv - 读尽回复，每个换行结束一条消息并补发一条
+ * 返回值: 出错或服务器关闭连接时返回-1
+ */
+int conn_recv(LoadConn *c, char *buf)
+{
+	while (1) {
+		ssize_t n = recv(c->fd, buf, RECV_BUF_SIZE, 0);
+		uint64_t now;
+		char *p, *end;
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			return -1;
+		}
+
+		now = now_ns();
+		end = buf + n;
+		for (p = buf; (p = memchr(p, '\n', (size_t)(end - p))) != NULL; p++) {
+			if (c->inflight == 0) {
+				/* 回复比发出的消息多，说明服务器回复有误 */
+				return -1;
+			}
+			if (g_measuring) {
+				g_messages++;
+				samples_add(&g_samples,
+					    (uint32_t)((now - c->sent_ns[c->head]) / 1000));
+			}
+			c->head = (c->head + 1) % g_depth;
+			c->inflight--;
+			conn_issue(c, now);
+		}
+	}
+}
+
+/*
+ * conn_connect - 阻塞建立连接后切换为非阻塞
+ */
+int conn_connect(LoadConn *c, const struct sockaddr_in *addr, int epoll_fd)
+{
+	struct epoll_event ev;
+	int one = 1;
+
+	c->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (c->fd < 0) {
+		perror("socket fail");
+		return -1;
+	}
+	if (connect(c->fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+		perror("connect server fail");
+		close(c->fd);
+		return -1;
+	}
+	/* 小消息不等 Nagle 合并，否则 RTT 里会混入 ACK 延迟 */
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	ev.data.ptr = c;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+		perror("epoll_ctl add fail");
+		close(c->fd);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * run_loop - 处理事件直到 until_ns；出错的连接关闭后不再重连
+ */
+void run_loop(int epoll_fd, uint64_t until_ns, char *buf)
+{
+	struct epoll_event events[MAX_EVENTS];
+
+	while (now_ns() < until_ns) {
+		int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+
+		for (int i = 0; i < nfds; i++) {
+			LoadConn *c = events[i].data.ptr;
+
+			if (c->fd < 0) {
+				continue;
+			}
+			if (conn_recv(c, buf) < 0 || conn_send(c) < 0) {
+				g_errors++;
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+				close(c->fd);
+				c->fd = -1;
+			}
+		}
+	}
+}
+
+void print_usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c conns] [-d seconds] [-w warmup] [-s msg_size]\n"
+		"          [-p depth] [-H host] [-P port]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sockaddr_in saddr = {0};
+	const char *host = "127.0.0.1";
+	int port = 8990;
+	int conns = 100;
+	int duration = 10;
+	int warmup = 1;
+	LoadConn *pool;
+	char *buf;
+	int epoll_fd;
+	int alive = 0;
+	int opt;
+	uint64_t start, elapsed;
+
+	while ((opt = getopt(argc, argv, "c:d:w:s:p:H:P:")) != -1) {
+		switch (opt) {
+		case 'c': conns = atoi(optarg); break;
+		case 'd': duration = atoi(optarg); break;
+		case 'w': warmup = atoi(optarg); break;
+		case 's': g_msg_size = (size_t)atol(optarg); break;
+		case 'p': g_depth = atoi(optarg); break;
+		case 'H': host = optarg; break;
+		case 'P': port = atoi(optarg); break;
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (conns <= 0 || duration <= 0 || warmup < 0 || g_msg_size < 1 ||
+	    g_depth <= 0) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* 每个连接一个 fd，按需提高打开文件数上限 */
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)conns + 64) {
+		rl.rlim_cur = rl.rlim_max < (rlim_t)conns + 64 ? rl.rlim_max
+							       : (rlim_t)conns + 64;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	/* 消息为 msg_size - 1 个字母加换行，连续排 depth + 1 条 */
+	g_stream = malloc(g_msg_size * (size_t)(g_depth + 1));
+	buf = malloc(RECV_BUF_SIZE);
+	pool = calloc((size_t)conns, sizeof(LoadConn));
+	if (g_stream == NULL || buf == NULL || pool == NULL) {
+		perror("malloc fail");
+		return -1;
+	}
+	for (size_t i = 0; i < g_msg_size * (size_t)(g_depth + 1); i++) {
+		g_stream[i] = (i + 1) % g_msg_size == 0 ? '\n' : 'a' + (char)(i % 26);
+	}
+
+	saddr.sin_family = AF_INET;
+	saddr.sin_port = htons((uint16_t)port);
+	saddr.sin_addr.s_addr = inet_addr(host);
+
+	epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0) {
+		perror("epoll_create fail");
+		return -1;
+	}
+
+	start = now_ns();
+	for (int i = 0; i < conns; i++) {
+		pool[i].fd = -1;
+		pool[i].sent_ns = calloc((size_t)g_depth, sizeof(uint64_t));
+		if (pool[i].sent_ns == NULL || conn_connect(&pool[i], &saddr, epoll_fd) < 0) {
+			g_errors++;
+			continue;
+		}
+		alive++;
+	}
+	printf("connections %d/%d established in %.2f s\n", alive, conns,
+	       (double)(now_ns() - start) / 1e9);
+	if (alive == 0) {
+		return -1;
+	}
+
+	/* 每个连接先发出 depth 条消息 */
+	for (int i = 0; i < conns; i++) {
+		if (pool[i].fd < 0) {
+			continue;
+		}
+		for (int k = 0; k < g_depth; k++) {
+			conn_issue(&pool[i], now_ns());
+		}
+		conn_send(&pool[i]);
+	}
+
+	run_loop(epoll_fd, now_ns() + (uint64_t)warmup * 1000000000ULL, buf);
+	g_measuring = 1;
+	start = now_ns();
+	run_loop(epoll_fd, start + (uint64_t)duration * 1000000000ULL, buf);
+	elapsed = now_ns() - start;
+	g_measuring = 0;
+
+	qsort(g_samples.v, g_samples.len, sizeof(uint32_t), cmp_u32);
+	printf("messages    %llu in %.2f s (%.0f msgs/s, %.1f MB/s payload), errors %llu\n",
+	       (unsigned long long)g_messages, (double)elapsed / 1e9,
+	       (double)g_messages * 1e9 / (double)elapsed,
+	       (double)g_messages * (double)g_msg_size * 1e3 / (double)elapsed,
+	       (unsigned long long)g_errors);
+	printf("rtt us      p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+	       percentile(&g_samples, 50), percentile(&g_samples, 90),
+	       percentile(&g_samples, 99), percentile(&g_samples, 99.9),
+	       g_samples.len ? g_samples.v[g_samples.len - 1] : 0);
+
+	for (int i = 0; i < conns; i++) {
+		if (pool[i].fd >= 0) {
+			close(pool[i].fd);
+		}
+		free(pool[i].sent_ns);
+	}
+	free(pool);
+	free(buf);
+	free(g_stream);
+	close(epoll_fd);
+	return 0;
+}
@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <signal.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
@@ -11,9 +16,138 @@
 #include <fcntl.h>
 #include <sys/epoll.h>
 
+#include "async_log.h"
+#include "timer_wheel.h"
+
 #define MAX_CLIENTS 10000
 #define SERVER_PORT 8990
-#define BUFFER_SIZE 1024
+#define LISTEN_BACKLOG 1024
+#define REPLY_PREFIX "Server received: "
+#define REPLY_PREFIX_LEN (sizeof(REPLY_PREFIX) - 1)
+#define OUT_BLOCK_SIZE 16384            /* 输出队列块大小 */
+#define OUT_MIN_READ 1024               /* 块尾放不下 前缀+该长度 时换新块 */
+#define OUT_POOL_MAX 4096               /* 空闲块池上限，超出的块直接释放 */
+#define OUT_HIGH_WATERMARK (256 * 1024) /* 积压达到该值时暂停读取 */
+#define OUT_LOW_WATERMARK (64 * 1024)   /* 积压降到该值以下时恢复读取 */
+#define FLUSH_IOV_MAX 64                /* 一次 writev 最多合并的块数 */
+#define IDLE_TIMEOUT_SEC 60    /* 超过该时间没有收到数据的连接被关闭 */
+#define SEND_TIMEOUT_SEC 10    /* 回复积压超过该时间仍未发出的连接被关闭 */
+#define TIMER_TICK_MS 100
+
+/*
+ * 输出块：回复按到达顺序追加在块链表中，块从全局空闲池取用
+ */
+typedef struct OutBlock {
+	struct OutBlock *next;
+	size_t pos;             /* 已发送到的位置 */
+	size_t len;             /* 已写入的字节数 */
+	char data[OUT_BLOCK_SIZE];
+} OutBlock;
+
+/*
+ * 连接对象：输出队列、超时定时器与计数
+ * 每次读到的数据直接读进输出块中回复前缀之后，读完即成为一条待发回复；
+ * 空闲连接不持有任何块。积压达到高水位后暂停读取（数据留在内核中，
+ * 由 TCP 窗口让对端慢下来），EPOLLOUT 把积压发到低水位以下再恢复
+ */
+typedef struct Conn {
+	int fd;
+	struct Conn *next_free;
+	OutBlock *out_head;
+	OutBlock *out_tail;
+	size_t queued;          /* 输出队列中尚未发送的字节数 */
+	int throttled;          /* 因积压暂停读取 */
+	int peer_closed;        /* 对端已关闭写方向，积压发完后关闭 */
+	TimerNode timer;        /* 空闲/发送超时，挂在 ConnTable.timers 上 */
+	unsigned long messages; /* 已回复的消息数 */
+} Conn;
+
+/*
+ * 连接表：所有连接对象在启动时一次分配（arena），空闲对象串成链表；
+ * 事件通过 epoll data.ptr 直接找到连接对象；接入新连接只是从链表取一个对象，不调用 malloc，
+ * 缓冲区随对象在连接之间复用
+ * 所有连接的超时挂在同一个时间轮上，epoll_wait 只等到最近的截止时刻
+ */
+typedef struct {
+	Conn *arena;
+	Conn *free_list;
+	TimerWheel timers;
+} ConnTable;
+
+static OutBlock *g_block_pool;  /* 空闲输出块 */
+static int g_block_pool_size;
+
+/*
+ * now_ms - 单调时钟毫秒数，不受系统时间调整影响
+ */
+uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*
+ * block_get - 取一个空的输出块，池中没有时申请
+ */
+OutBlock *block_get(void)
+{
+	OutBlock *blk = g_block_pool;
+
+	if (blk != NULL) {
+		g_block_pool = blk->next;
+		g_block_pool_size--;
+	} else {
+		blk = malloc(sizeof(OutBlock));
+		if (blk == NULL) {
+			return NULL;
+		}
+	}
+	blk->next = NULL;
+	blk->pos = 0;
+	blk->len = 0;
+	return blk;
+}
+
+/*
+ * block_put - 归还输出块，池满时直接释放
+ */
+void block_put(OutBlock *blk)
+{
+	if (g_block_pool_size >= OUT_POOL_MAX) {
+		free(blk);
+		return;
+	}
+	blk->next = g_block_pool;
+	g_block_pool = blk;
+	g_block_pool_size++;
+}
+
+/*
+ * conn_consume - 从输出队列头部去掉已发送的 n 个字节，发完的块归还
+ * n 为 0 时只回收队首的空块，为 SIZE_MAX 时清空整个队列
+ */
+void conn_consume(Conn *conn, size_t n)
+{
+	while (conn->out_head != NULL) {
+		OutBlock *blk = conn->out_head;
+		size_t left = blk->len - blk->pos;
+
+		if (n < left) {
+			blk->pos += n;
+			conn->queued -= n;
+			return;
+		}
+		n -= left;
+		conn->queued -= left;
+		conn->out_head = blk->next;
+		if (conn->out_head == NULL) {
+			conn->out_tail = NULL;
+		}
+		block_put(blk);
+	}
+}
 
 /*
  * setnonblocking - 设置句柄为非阻塞方式
@@ -32,26 +166,234 @@ int setnonblocking(int sockfd)
 }
 
 /*
- * addfd - 将文件描述符添加到 epoll 实例中
+ * removefd - 从 epoll 实例中移除文件描述符
  */
-void addfd(int epoll_fd, int fd, uint32_t events)
+void removefd(int epoll_fd, int fd)
 {
-	struct epoll_event ev;
-	ev.events = events;
-	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
+		log_error("epoll_ctl del fd fail: %m");
+	}
+}
 
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
-		perror("epoll_ctl add fd fail");
+/*
+ * conn_table_init - 分配 capacity 个连接对象
+ * 返回值: 成功返回0，失败返回-1
+ */
+int conn_table_init(ConnTable *table, int capacity)
+{
+	int i;
+
+	table->arena = calloc((size_t)capacity, sizeof(Conn));
+	if (table->arena == NULL) {
+		return -1;
+	}
+
+	table->free_list = NULL;
+	for (i = capacity - 1; i >= 0; i--) {
+		table->arena[i].fd = -1;
+		table->arena[i].next_free = table->free_list;
+		table->free_list = &table->arena[i];
 	}
+	timer_wheel_init(&table->timers, now_ms(), TIMER_TICK_MS);
+	return 0;
 }
 
 /*
- * removefd - 从 epoll 实例中移除文件描述符
+ * conn_open - 为新连接取一个空闲对象
+ * 返回值: 连接已满时返回 NULL
  */
-void removefd(int epoll_fd, int fd)
+Conn *conn_open(ConnTable *table, int fd)
 {
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
-		perror("epoll_ctl del fd fail");
+	Conn *conn = table->free_list;
+
+	if (conn == NULL || fd < 0) {
+		return NULL;
+	}
+	table->free_list = conn->next_free;
+	conn->next_free = NULL;
+	conn->fd = fd;
+	conn->out_head = NULL;
+	conn->out_tail = NULL;
+	conn->queued = 0;
+	conn->throttled = 0;
+	conn->peer_closed = 0;
+	conn->messages = 0;
+	timer_node_init(&conn->timer);
+	return conn;
+}
+
+/*
+ * conn_close - 从 epoll 中移除并关闭连接，对象放回空闲链表
+ */
+void conn_close(ConnTable *table, int epoll_fd, Conn *conn)
+{
+	timer_cancel(&table->timers, &conn->timer);
+	conn_consume(conn, SIZE_MAX);
+	removefd(epoll_fd, conn->fd);
+	close(conn->fd);
+	conn->fd = -1;
+	conn->next_free = table->free_list;
+	table->free_list = conn;
+}
+
+/*
+ * conn_schedule_timeout - 按连接当前状态重设截止时刻
+ * 回复积压未发完时为 SEND_TIMEOUT_SEC，否则为 IDLE_TIMEOUT_SEC
+ */
+void conn_schedule_timeout(ConnTable *table, Conn *conn)
+{
+	int sec = conn->queued != 0 ? SEND_TIMEOUT_SEC : IDLE_TIMEOUT_SEC;
+
+	timer_schedule(&table->timers, &conn->timer, now_ms() + (uint64_t)sec * 1000);
+}
+
+/*
+ * conn_on_timeout - 时间轮到期回调，arg 指向 epoll fd
+ */
+void conn_on_timeout(TimerWheel *wheel, TimerNode *node, void *arg)
+{
+	ConnTable *table = (ConnTable *)((char *)wheel - offsetof(ConnTable, timers));
+	Conn *conn = (Conn *)((char *)node - offsetof(Conn, timer));
+
+	log_info("Client fd=%d timed out (%s) after %lu messages", conn->fd,
+		 conn->queued != 0 ? "send" : "idle", conn->messages);
+	conn_close(table, *(int *)arg, conn);
+}
+
+/*
+ * conn_flush - 用 writev 把输出队列中的多个块一次发出
+ * 返回值: 出错返回-1，否则返回0（发送队列满时保留剩余数据，等待 EPOLLOUT）
+ */
+int conn_flush(Conn *conn)
+{
+	struct iovec iov[FLUSH_IOV_MAX];
+
+	while (conn->queued > 0) {
+		OutBlock *blk;
+		ssize_t n;
+		int cnt = 0;
+
+		for (blk = conn->out_head; blk != NULL && cnt < FLUSH_IOV_MAX;
+		     blk = blk->next) {
+			if (blk->len > blk->pos) {
+				iov[cnt].iov_base = blk->data + blk->pos;
+				iov[cnt].iov_len = blk->len - blk->pos;
+				cnt++;
+			}
+		}
+
+		n = writev(conn->fd, iov, cnt);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			return -1;
+		}
+		conn_consume(conn, (size_t)n);
+	}
+	/* 释放读到 EAGAIN 时留下的空块 */
+	conn_consume(conn, 0);
+	return 0;
+}
+
+/*
+ * conn_read - 读尽 socket（ET 模式），每次读到的数据在输出队列中生成一条回复
+ * 数据直接读到回复前缀之后的位置，不经过中间缓冲区
+ * 返回值: 出错返回-1，读到 EAGAIN 或对端关闭返回0，积压达到高水位返回1
+ */
+int conn_read(Conn *conn)
+{
+	while (conn->queued < OUT_HIGH_WATERMARK) {
+		OutBlock *blk = conn->out_tail;
+		char *reply;
+		ssize_t ret;
+
+		if (blk == NULL ||
+		    OUT_BLOCK_SIZE - blk->len < REPLY_PREFIX_LEN + OUT_MIN_READ) {
+			blk = block_get();
+			if (blk == NULL) {
+				log_error("malloc output block fail");
+				return -1;
+			}
+			if (conn->out_tail != NULL) {
+				conn->out_tail->next = blk;
+			} else {
+				conn->out_head = blk;
+			}
+			conn->out_tail = blk;
+		}
+
+		reply = blk->data + blk->len;
+		ret = recv(conn->fd, reply + REPLY_PREFIX_LEN,
+			   OUT_BLOCK_SIZE - blk->len - REPLY_PREFIX_LEN, 0);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* 数据读取完毕 */
+				return 0;
+			}
+			log_warn("recv fail: %m");
+			return -1;
+		}
+		if (ret == 0) {
+			/* 客户端关闭连接，已收到的数据仍然回复 */
+			log_info("Client fd=%d disconnected after %lu messages",
+				 conn->fd, conn->messages);
+			conn->peer_closed = 1;
+			return 0;
+		}
+
+		log_debug("Received from fd=%d: %.*s (len=%d)", conn->fd,
+			  (int)ret, reply + REPLY_PREFIX_LEN, (int)ret);
+		memcpy(reply, REPLY_PREFIX, REPLY_PREFIX_LEN);
+		blk->len += REPLY_PREFIX_LEN + (size_t)ret;
+		conn->queued += REPLY_PREFIX_LEN + (size_t)ret;
+		conn->messages++;
+	}
+	return 1;
+}
+
+/*
+ * conn_on_event - 处理可读/可写事件（ET 模式下两者只是通知，统一处理）
+ * 先发积压的回复；未因积压暂停时读尽 socket，读到的回复一并发出
+ * 返回值: 连接应关闭时返回-1
+ */
+int conn_on_event(Conn *conn)
+{
+	int drained = 0;
+
+	while (1) {
+		int ret;
+
+		if (conn_flush(conn) < 0) {
+			log_warn("send fail: %m");
+			return -1;
+		}
+		if (conn->peer_closed) {
+			return conn->queued == 0 ? -1 : 0;
+		}
+		if (drained) {
+			return 0;
+		}
+		/* 达到高水位后要等积压降到低水位以下才继续读 */
+		if (conn->throttled) {
+			if (conn->queued > OUT_LOW_WATERMARK) {
+				return 0;
+			}
+			conn->throttled = 0;
+		}
+
+		ret = conn_read(conn);
+		if (ret < 0) {
+			return -1;
+		}
+		drained = (ret == 0);
+		conn->throttled = (ret == 1);
 	}
 }
 
@@ -61,22 +403,36 @@ int main()
 	struct sockaddr_in server_addr, client_addr;
 	socklen_t client_len;
 
-	char buffer[BUFFER_SIZE];
-	int ret;
+	ConnTable table;
+	Conn *conn;
+
+	/* 对端已关闭时 writev 返回 EPIPE 而不是终止进程 */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* 日志由后台线程批量写出，收发数据的路径不会被终端或管道阻塞 */
+	if (log_init(STDOUT_FILENO, LOG_LEVEL_DEBUG) == 0) {
+		atexit(log_shutdown);
+	}
+
+	/* 连接对象一次分配好，之后接入连接不再申请内存 */
+	if (conn_table_init(&table, MAX_CLIENTS) < 0) {
+		log_error("conn_table_init fail: %m");
+		return -1;
+	}
 
 	/* 创建 epoll 实例 */
 	int epoll_fd = epoll_create(MAX_CLIENTS);
 	if (epoll_fd < 0) {
-		perror("epoll_create fail");
+		log_error("epoll_create fail: %m");
 		return -1;
 	}
 
-	printf("Epoll fd: %d\n", epoll_fd);
+	log_info("Epoll fd: %d", epoll_fd);
 
 	/* 创建监听套接字 */
 	listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	if (listen_fd < 0) {
-		perror("socket fail");
+		log_error("socket fail: %m");
 		close(epoll_fd);
 		return -1;
 	}
@@ -95,56 +451,61 @@ int main()
 	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
 	if (bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-		perror("bind fail");
+		log_error("bind fail: %m");
 		close(listen_fd);
 		close(epoll_fd);
 		return -1;
 	}
 
-	printf("bind success.\n");
+	log_info("bind success.");
 
 	/* 开始监听 */
-	if (listen(listen_fd, 5) < 0) {
-		perror("listen fail");
+	if (listen(listen_fd, LISTEN_BACKLOG) < 0) {
+		log_error("listen fail: %m");
 		close(listen_fd);
 		close(epoll_fd);
 		return -1;
 	}
 
-	printf("Server listening on port %d...\n", SERVER_PORT);
+	log_info("Server listening on port %d...", SERVER_PORT);
 
 	/* 将监听套接字添加到 epoll，使用边缘触发(ET)模式 */
 	struct epoll_event ev;
+	/* 监听套接字的 data.ptr 为 NULL，客户端的 data.ptr 指向连接对象 */
 	ev.events = EPOLLIN | EPOLLET;  // 边缘触发 + 读事件
-	ev.data.fd = listen_fd;
+	ev.data.ptr = NULL;
 
 	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
-		perror("epoll_ctl add listen_fd fail");
+		log_error("epoll_ctl add listen_fd fail: %m");
 		close(listen_fd);
 		close(epoll_fd);
 		return -1;
 	}
 
-	printf("Listen socket added to epoll (ET mode)\n");
+	log_info("Listen socket added to epoll (ET mode)");
 
 	/* 事件数组 */
 	struct epoll_event events[MAX_CLIENTS];
 
 	/* 主循环 */
 	while (1) {
-		/* 等待事件发生，-1表示阻塞等待 */
-		int nfds = epoll_wait(epoll_fd, events, MAX_CLIENTS, -1);
+		/* 等待事件发生，最多等到最近一个连接超时（没有连接时为-1，阻塞等待） */
+		int timeout = timer_wheel_timeout_ms(&table.timers, now_ms());
+		int nfds = epoll_wait(epoll_fd, events, MAX_CLIENTS, timeout);
 		if (nfds < 0) {
-			perror("epoll_wait fail");
+			if (errno == EINTR) {
+				continue;
+			}
+			log_error("epoll_wait fail: %m");
 			break;
 		}
 
 		/* 遍历所有就绪的事件 */
 		for (int i = 0; i < nfds; i++) {
-			int fd = events[i].data.fd;
+			conn = events[i].data.ptr;
 
 			/* 监听套接字有事件 - 新客户端连接 */
-			if (fd == listen_fd) {
+			if (conn == NULL) {
 				/* ET模式需要循环接受所有连接 */
 				while (1) {
 					client_len = sizeof(client_addr);
@@ -155,72 +516,58 @@ int main()
 							/* 所有连接已接受完毕 */
 							break;
 						}
-						perror("accept fail");
+						log_error("accept fail: %m");
 						break;
 					}
 
 					/* 打印客户端信息 */
-					printf("New client: fd=%d, IP=%s, Port=%d\n",
-						   client_fd,
-						   inet_ntoa(client_addr.sin_addr),
-						   ntohs(client_addr.sin_port));
+					log_info("New client: fd=%d, IP=%s, Port=%d",
+						     client_fd,
+						     inet_ntoa(client_addr.sin_addr),
+						     ntohs(client_addr.sin_port));
 
 					/* 设置客户端套接字为非阻塞 */
 					setnonblocking(client_fd);
 
-					/* 添加客户端到 epoll */
-					ev.events = EPOLLIN | EPOLLET;  // 边缘触发
-					ev.data.fd = client_fd;
-					if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
-						perror("epoll_ctl add client_fd fail");
+					conn = conn_open(&table, client_fd);
+					if (conn == NULL) {
+						log_warn("Too many clients, fd=%d rejected", client_fd);
 						close(client_fd);
+						continue;
 					}
-				}
-			}
-			/* 客户端套接字有事件 - 接收数据 */
-			else {
-				/* ET模式需要循环读取所有数据 */
-				while (1) {
-					memset(buffer, 0, BUFFER_SIZE);
-					ret = recv(fd, buffer, BUFFER_SIZE - 1, 0);
 
-					if (ret < 0) {
-						if (errno == EAGAIN || errno == EWOULDBLOCK) {
-							/* 数据读取完毕 */
-							break;
-						}
-						perror("recv fail");
-						/* 发生错误，关闭连接 */
-						close(fd);
-						removefd(epoll_fd, fd);
-						printf("Client fd=%d error, closed\n", fd);
-						break;
-					}
-					else if (ret == 0) {
-						/* 客户端关闭连接 */
-						printf("Client fd=%d disconnected\n", fd);
-						close(fd);
-						removefd(epoll_fd, fd);
-						break;
-					}
-					else {
-						/* 收到数据 */
-						printf("Received from fd=%d: %s (len=%d)\n", fd, buffer, ret);
-
-						/* 回发响应 */
-						char send_buf[128];
-						int len = snprintf(send_buf, sizeof(send_buf),
-										   "Server received: %s", buffer);
-						send(fd, send_buf, len, 0);
+					/*
+					 * 添加客户端到 epoll：边缘触发下同时关注可读与可写，
+					 * 可写只在发送队列由满变为可写时通知一次，之后不再 MOD
+					 */
+					ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+					ev.data.ptr = conn;
+					if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+						log_error("epoll_ctl add client_fd fail: %m");
+						conn_close(&table, epoll_fd, conn);
+						continue;
 					}
+					conn_schedule_timeout(&table, conn);
+				}
+			}
+			/* 客户端套接字有事件 - 接收数据或继续发送积压的回复 */
+			else if (conn->fd >= 0) {
+				if (conn_on_event(conn) < 0) {
+					conn_close(&table, epoll_fd, conn);
+				} else {
+					conn_schedule_timeout(&table, conn);
 				}
 			}
 		}
+
+		/* 关闭到期的空闲连接与发送卡住的连接 */
+		timer_wheel_advance(&table.timers, now_ms(), conn_on_timeout, &epoll_fd);
 	}
 
 	/* 清理资源 */
 	close(listen_fd);
 	close(epoll_fd);
+	free(table.arena);
 
 	return 0;
 }
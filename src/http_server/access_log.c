@@ -0,0 +1,21 @@
+#include "access_log.h"
+
+#include "async_log.h"
+
+static unsigned int g_sample;
+static __thread unsigned int t_sample_seq;
+
+void access_log_init(unsigned int sample) {
+  g_sample = sample;
+}
+
+int access_log_sampled(void) {
+  return g_sample != 0 && ++t_sample_seq % g_sample == 0;
+}
+
+void access_log_write(const AccessLogRecord *rec) {
+  log_info("\"%s %s\" %d %llu first_byte=%lluus total=%lluus", rec->method,
+           rec->uri, rec->status, (unsigned long long)rec->bytes,
+           (unsigned long long)rec->first_byte_us,
+           (unsigned long long)rec->total_us);
+}
@@ -0,0 +1,28 @@
+#ifndef HTTP_ACCESS_LOG_H
+#define HTTP_ACCESS_LOG_H
+
+#include <stdint.h>
+
+/* 一条访问日志，方法与 URI 在处理请求时记下，其余字段在响应发完时补齐 */
+typedef struct {
+  int status;
+  uint64_t bytes;
+  uint64_t first_byte_us;
+  uint64_t total_us;
+  char method[8];
+  char uri[112];
+} AccessLogRecord;
+
+/*
+ * 设置抽样间隔：每个线程每 sample 个请求记录一条，0 表示关闭
+ * 应在工作线程启动之前调用
+ */
+void access_log_init(unsigned int sample);
+
+/* 当前请求是否需要记录（线程内计数，无共享状态） */
+int access_log_sampled(void);
+
+/* 经异步日志（INFO 级别）写出，队列已满时丢弃 */
+void access_log_write(const AccessLogRecord *rec);
+
+#endif
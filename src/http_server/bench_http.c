@@ -0,0 +1,588 @@
+/*
+ * bench_http - HTTP keep-alive 压测：保持 N 个并发连接，每个连接同一时刻
+ * 只有一个请求在途（收到完整响应后立即发下一个），统计吞吐与延迟分位数
+ * 服务器按 keep-alive 上限关闭连接后自动重连，重连耗时不计入请求延迟
+ *
+ * -T pid：测量窗口内用 ptrace 统计服务器进程（所有线程）的系统调用次数，
+ * 输出每请求系统调用数与调用分布；跟踪会大幅拖慢服务器，
+ * 延迟与吞吐应以不带 -T 的运行为准
+ *
+ * 用法: ./bench_http [-c 连接数=10000] [-d 秒=10] [-w 预热秒=2]
+ *                    [-u 路径=/hello] [-T 服务器pid]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_PORT 8080
+#define BENCH_RBUF 16384
+#define BENCH_MAX_CONNECTING 256 /* 同时进行中的 connect 数，避免挤爆 accept 队列 */
+#define BENCH_EVENTS 1024
+#define BENCH_MAX_SYSCALL 512
+
+enum { BC_DOWN = 0, BC_CONNECTING, BC_WAITING };
+
+typedef struct {
+  int fd;
+  int state;
+  uint64_t sent_ns;
+  size_t len;
+  char rbuf[BENCH_RBUF];
+} BenchConn;
+
+typedef struct {
+  uint32_t *v;
+  size_t len;
+  size_t cap;
+} Samples;
+
+static const char *g_path = "/hello";
+static char g_request[256];
+static size_t g_request_len;
+static int g_epoll_fd;
+static BenchConn **g_down; /* 等待（重新）连接的连接 */
+static int g_down_count;
+static int g_connecting;
+static int g_measuring;
+static uint64_t g_requests;
+static uint64_t g_errors;
+static uint64_t g_reconnects;
+static Samples g_samples;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void samples_add(Samples *s, uint32_t us) {
+  if (s->len == s->cap) {
+    s->cap = s->cap ? s->cap * 2 : 1 << 20;
+    s->v = realloc(s->v, s->cap * sizeof(uint32_t));
+    if (s->v == NULL) {
+      perror("realloc samples");
+      exit(1);
+    }
+  }
+  s->v[s->len++] = us;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const Samples *s, double p) {
+  size_t idx;
+
+  if (s->len == 0) {
+    return 0;
+  }
+  idx = (size_t)(p / 100.0 * (double)(s->len - 1) + 0.5);
+  return s->v[idx];
+}
+
+static void conn_down(BenchConn *c) {
+  if (c->fd >= 0) {
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+  }
+  if (c->state == BC_CONNECTING) {
+    g_connecting--;
+  }
+  c->state = BC_DOWN;
+  c->len = 0;
+  g_down[g_down_count++] = c;
+}
+
+static void conn_start(BenchConn *c) {
+  struct sockaddr_in addr;
+  struct epoll_event ev;
+
+  c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (c->fd < 0) {
+    perror("socket");
+    exit(1);
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(BENCH_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 &&
+      errno != EINPROGRESS) {
+    g_errors++;
+    close(c->fd);
+    c->fd = -1;
+    g_down[g_down_count++] = c;
+    return;
+  }
+  c->state = BC_CONNECTING;
+  g_connecting++;
+  ev.events = EPOLLOUT;
+  ev.data.ptr = c;
+  epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void conn_send(BenchConn *c) {
+  if (send(c->fd, g_request, g_request_len, MSG_NOSIGNAL) !=
+      (ssize_t)g_request_len) {
+    g_errors++;
+    conn_down(c);
+    return;
+  }
+  c->sent_ns = now_ns();
+  c->state = BC_WAITING;
+}
+
+static void conn_on_connected(BenchConn *c) {
+  struct epoll_event ev;
+  int err = 0;
+  socklen_t len = sizeof(err);
+
+  getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+  g_connecting--;
+  c->state = BC_WAITING;
+  if (err != 0) {
+    g_errors++;
+    c->state = BC_DOWN;
+    conn_down(c);
+    return;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = c;
+  epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+  conn_send(c);
+}
+
+/* 在 rbuf 中找完整响应，返回响应总长度，不完整返回 0，格式错误返回 -1 */
+static long response_length(BenchConn *c, int *close_after) {
+  char *end;
+  char *p;
+  long body = 0;
+
+  c->rbuf[c->len] = '\0';
+  end = strstr(c->rbuf, "\r\n\r\n");
+  if (end == NULL) {
+    return c->len >= BENCH_RBUF - 1 ? -1 : 0;
+  }
+  p = strcasestr(c->rbuf, "\r\nContent-Length:");
+  if (p != NULL && p < end) {
+    body = strtol(p + 17, NULL, 10);
+  }
+  p = strcasestr(c->rbuf, "\r\nConnection: close");
+  *close_after = p != NULL && p < end;
+  if ((size_t)(end + 4 - c->rbuf) + (size_t)body > c->len) {
+    /* 响应体超过缓冲区时只保留头部，其余字节按计数丢弃 */
+    return (size_t)(end + 4 - c->rbuf) + (size_t)body > BENCH_RBUF - 1 ? -1 : 0;
+  }
+  return (long)(end + 4 - c->rbuf) + body;
+}
+
+static void conn_on_readable(BenchConn *c) {
+  while (1) {
+    ssize_t n = recv(c->fd, c->rbuf + c->len, BENCH_RBUF - 1 - c->len, 0);
+    int close_after = 0;
+    long total;
+
+    if (n == 0) {
+      g_reconnects++;
+      conn_down(c);
+      return;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      g_errors++;
+      conn_down(c);
+      return;
+    }
+    c->len += (size_t)n;
+
+    total = response_length(c, &close_after);
+    if (total < 0) {
+      fprintf(stderr, "bad or oversized response (use a small path)\n");
+      exit(1);
+    }
+    if (total == 0) {
+      continue;
+    }
+    if (g_measuring) {
+      g_requests++;
+      samples_add(&g_samples, (uint32_t)((now_ns() - c->sent_ns) / 1000));
+    }
+    if (close_after) {
+      g_reconnects++;
+      conn_down(c);
+      return;
+    }
+    c->len = 0;
+    conn_send(c);
+    return;
+  }
+}
+
+static void pump_connects(void) {
+  while (g_down_count > 0 && g_connecting < BENCH_MAX_CONNECTING) {
+    conn_start(g_down[--g_down_count]);
+  }
+}
+
+static void run_loop(uint64_t until_ns) {
+  struct epoll_event events[BENCH_EVENTS];
+
+  while (now_ns() < until_ns) {
+    int n;
+    int i;
+
+    pump_connects();
+    n = epoll_wait(g_epoll_fd, events, BENCH_EVENTS, 10);
+    for (i = 0; i < n; i++) {
+      BenchConn *c = (BenchConn *)events[i].data.ptr;
+
+      if (c->state == BC_CONNECTING) {
+        conn_on_connected(c);
+      } else if (c->state == BC_WAITING) {
+        conn_on_readable(c);
+      }
+    }
+  }
+}
+
+/* ---- 系统调用计数（ptrace） ---- */
+
+static const struct {
+  long nr;
+  const char *name;
+} kSyscallNames[] = {
+    {SYS_read, "read"},
+    {SYS_write, "write"},
+    {SYS_close, "close"},
+    {SYS_fstat, "fstat"},
+    {SYS_writev, "writev"},
+    {SYS_sendfile, "sendfile"},
+    {SYS_accept, "accept"},
+    {SYS_accept4, "accept4"},
+    {SYS_sendto, "sendto"},
+    {SYS_recvfrom, "recvfrom"},
+    {SYS_sendmsg, "sendmsg"},
+    {SYS_recvmsg, "recvmsg"},
+    {SYS_futex, "futex"},
+    {SYS_epoll_wait, "epoll_wait"},
+    {SYS_epoll_ctl, "epoll_ctl"},
+    {SYS_epoll_pwait, "epoll_pwait"},
+    {SYS_openat, "openat"},
+    {SYS_newfstatat, "newfstatat"},
+    {SYS_nanosleep, "nanosleep"},
+    {SYS_clock_nanosleep, "clock_nanosleep"},
+    {SYS_io_uring_enter, "io_uring_enter"},
+    {SYS_shutdown, "shutdown"},
+};
+
+static volatile sig_atomic_t g_trace_stop;
+
+static void on_trace_stop(int sig) {
+  (void)sig;
+  g_trace_stop = 1;
+}
+
+static const char *syscall_name(long nr) {
+  size_t i;
+
+  for (i = 0; i < sizeof(kSyscallNames) / sizeof(kSyscallNames[0]); i++) {
+    if (kSyscallNames[i].nr == nr) {
+      return kSyscallNames[i].name;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * 跟踪进程：附加到目标进程的所有线程（含之后创建的线程），
+ * 在每次系统调用入口计数，收到 SIGUSR1 后把计数写入 out_fd 并退出
+ * （跟踪进程退出时内核自动解除跟踪）
+ */
+static void tracer_main(pid_t pid, int ready_fd, int out_fd) {
+  static uint64_t counts[BENCH_MAX_SYSCALL];
+  struct sigaction sa;
+  char path[64];
+  struct dirent *de;
+  DIR *dir;
+  int attached = 0;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_trace_stop;
+  sigaction(SIGUSR1, &sa, NULL); /* 不带 SA_RESTART，waitpid 会被打断 */
+
+  snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+  dir = opendir(path);
+  if (dir == NULL) {
+    perror("opendir task");
+    _exit(1);
+  }
+  while ((de = readdir(dir)) != NULL) {
+    pid_t tid = (pid_t)atoi(de->d_name);
+
+    if (tid <= 0) {
+      continue;
+    }
+    if (ptrace(PTRACE_SEIZE, tid, NULL,
+               (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE)) <
+        0) {
+      perror("ptrace seize");
+      _exit(1);
+    }
+    ptrace(PTRACE_INTERRUPT, tid, NULL, NULL);
+    attached++;
+  }
+  closedir(dir);
+  if (write(ready_fd, &attached, sizeof(attached)) < 0) {
+    _exit(1);
+  }
+
+  while (!g_trace_stop) {
+    int status;
+    pid_t tid = waitpid(-1, &status, __WALL);
+    int sig = 0;
+
+    if (tid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (!WIFSTOPPED(status)) {
+      continue;
+    }
+    if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+      struct __ptrace_syscall_info info;
+
+      if (ptrace(PTRACE_GET_SYSCALL_INFO, tid, (void *)sizeof(info), &info) >
+              0 &&
+          info.op == PTRACE_SYSCALL_INFO_ENTRY &&
+          info.entry.nr < BENCH_MAX_SYSCALL) {
+        counts[info.entry.nr]++;
+      }
+    } else if (status >> 16 == 0 && WSTOPSIG(status) != SIGTRAP) {
+      /* 普通信号投递，原样转交 */
+      sig = WSTOPSIG(status);
+    }
+    ptrace(PTRACE_SYSCALL, tid, NULL, (void *)(long)sig);
+  }
+
+  if (write(out_fd, counts, sizeof(counts)) < 0) {
+    _exit(1);
+  }
+  _exit(0);
+}
+
+typedef struct {
+  pid_t pid;
+  int out_fd;
+} Tracer;
+
+static void tracer_start(Tracer *t, pid_t target) {
+  int ready[2];
+  int out[2];
+  int attached;
+
+  if (pipe(ready) < 0 || pipe(out) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  t->pid = fork();
+  if (t->pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (t->pid == 0) {
+    close(ready[0]);
+    close(out[0]);
+    tracer_main(target, ready[1], out[1]);
+  }
+  close(ready[1]);
+  close(out[1]);
+  if (read(ready[0], &attached, sizeof(attached)) != sizeof(attached)) {
+    fprintf(stderr, "tracer failed to attach to pid %d\n", (int)target);
+    exit(1);
+  }
+  close(ready[0]);
+  t->out_fd = out[0];
+  printf("tracing %d threads of pid %d\n", attached, (int)target);
+}
+
+static void tracer_stop(Tracer *t, uint64_t requests) {
+  static uint64_t counts[BENCH_MAX_SYSCALL];
+  size_t got = 0;
+  uint64_t total = 0;
+  int shown;
+  int i;
+
+  kill(t->pid, SIGUSR1);
+  while (got < sizeof(counts)) {
+    ssize_t n = read(t->out_fd, (char *)counts + got, sizeof(counts) - got);
+    if (n <= 0) {
+      fprintf(stderr, "tracer exited without results\n");
+      return;
+    }
+    got += (size_t)n;
+  }
+  waitpid(t->pid, NULL, 0);
+  close(t->out_fd);
+
+  for (i = 0; i < BENCH_MAX_SYSCALL; i++) {
+    total += counts[i];
+  }
+  printf("syscalls    %llu (%.2f per request)\n", (unsigned long long)total,
+         requests ? (double)total / (double)requests : 0.0);
+
+  /* 按次数从高到低列出前 10 项 */
+  for (shown = 0; shown < 10; shown++) {
+    const char *name;
+    int best = -1;
+
+    for (i = 0; i < BENCH_MAX_SYSCALL; i++) {
+      if (counts[i] > 0 && (best < 0 || counts[i] > counts[best])) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    name = syscall_name(best);
+    if (name != NULL) {
+      printf("  %-16s %10llu  %6.2f/req\n", name,
+             (unsigned long long)counts[best],
+             requests ? (double)counts[best] / (double)requests : 0.0);
+    } else {
+      printf("  #%-15d %10llu  %6.2f/req\n", best,
+             (unsigned long long)counts[best],
+             requests ? (double)counts[best] / (double)requests : 0.0);
+    }
+    counts[best] = 0;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  BenchConn *conns;
+  struct rlimit rl;
+  Tracer tracer;
+  pid_t trace_pid = 0;
+  int nconn = 10000;
+  double duration = 10;
+  double warmup = 2;
+  uint64_t start;
+  uint64_t elapsed;
+  int opt;
+  int i;
+
+  while ((opt = getopt(argc, argv, "c:d:w:u:T:")) != -1) {
+    switch (opt) {
+    case 'c':
+      nconn = atoi(optarg);
+      break;
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'w':
+      warmup = atof(optarg);
+      break;
+    case 'u':
+      g_path = optarg;
+      break;
+    case 'T':
+      trace_pid = (pid_t)atoi(optarg);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-c conns] [-d seconds] [-w warmup] [-u path] "
+              "[-T server_pid]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (nconn <= 0 || duration <= 0) {
+    fprintf(stderr, "invalid arguments\n");
+    return 1;
+  }
+
+  /* 每个连接一个 fd，尽量把软上限提到硬上限 */
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  g_request_len = (size_t)snprintf(g_request, sizeof(g_request),
+                                   "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n",
+                                   g_path);
+  g_epoll_fd = epoll_create1(0);
+  conns = calloc((size_t)nconn, sizeof(BenchConn));
+  g_down = calloc((size_t)nconn, sizeof(BenchConn *));
+  if (g_epoll_fd < 0 || conns == NULL || g_down == NULL) {
+    perror("init");
+    return 1;
+  }
+  for (i = 0; i < nconn; i++) {
+    conns[i].fd = -1;
+    g_down[g_down_count++] = &conns[i];
+  }
+
+  /* 预热：建立全部连接并跑满 warmup 秒 */
+  start = now_ns();
+  while (g_down_count > 0 || g_connecting > 0) {
+    run_loop(now_ns() + 100000000ULL);
+    if (now_ns() - start > 30000000000ULL) {
+      fprintf(stderr, "only %d of %d connections established\n",
+              nconn - g_down_count - g_connecting, nconn);
+      break;
+    }
+  }
+  printf("connections %d established in %.2f s\n", nconn,
+         (double)(now_ns() - start) / 1e9);
+  run_loop(now_ns() + (uint64_t)(warmup * 1e9));
+
+  if (trace_pid > 0) {
+    tracer_start(&tracer, trace_pid);
+  }
+  g_errors = 0;
+  g_reconnects = 0;
+  g_measuring = 1;
+  start = now_ns();
+  run_loop(start + (uint64_t)(duration * 1e9));
+  elapsed = now_ns() - start;
+  g_measuring = 0;
+  if (trace_pid > 0) {
+    tracer_stop(&tracer, g_requests);
+  }
+
+  qsort(g_samples.v, g_samples.len, sizeof(uint32_t), cmp_u32);
+  printf("requests    %llu in %.2f s (%.0f req/s), errors %llu, "
+         "reconnects %llu\n",
+         (unsigned long long)g_requests, (double)elapsed / 1e9,
+         (double)g_requests / ((double)elapsed / 1e9),
+         (unsigned long long)g_errors, (unsigned long long)g_reconnects);
+  printf("latency us  p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+         percentile(&g_samples, 50), percentile(&g_samples, 90),
+         percentile(&g_samples, 99), percentile(&g_samples, 99.9),
+         g_samples.len ? g_samples.v[g_samples.len - 1] : 0);
+  return 0;
+}
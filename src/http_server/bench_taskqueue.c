@@ -0,0 +1,219 @@
+/*
+ * bench_taskqueue - 对比线程池任务队列的两种实现
+ *   mutex    : 互斥锁 + 两个条件变量保护的定长数组（原 ThreadPool 实现）
+ *   lockfree : task_queue.c 中的无锁 MPMC 环形队列 + futex 休眠
+ * 线程数 n 从 1 翻倍到上限，每轮 n 个生产者与 n 个消费者
+ * 共传递固定数量的任务，统计每秒交接次数（handoffs/s）
+ *
+ * 用法: ./bench_taskqueue [每轮任务数=2000000] [最大线程数=64]
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "task_queue.h"
+
+#define BENCH_QUEUE_SIZE 1024
+
+/* 原 ThreadPool 的任务队列实现，作为对照组 */
+typedef struct {
+  void *queue[BENCH_QUEUE_SIZE];
+  int head;
+  int tail;
+  int count;
+  int stop;
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} MutexQueue;
+
+static void mutex_queue_init(MutexQueue *q) {
+  memset(q, 0, sizeof(*q));
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+}
+
+static void mutex_queue_destroy(MutexQueue *q) {
+  pthread_cond_destroy(&q->not_full);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_mutex_destroy(&q->mutex);
+}
+
+static void mutex_queue_push(MutexQueue *q, void *data) {
+  pthread_mutex_lock(&q->mutex);
+  while (!q->stop && q->count == BENCH_QUEUE_SIZE) {
+    pthread_cond_wait(&q->not_full, &q->mutex);
+  }
+  q->queue[q->tail] = data;
+  q->tail = (q->tail + 1) % BENCH_QUEUE_SIZE;
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+static void *mutex_queue_pop(MutexQueue *q) {
+  void *data;
+
+  pthread_mutex_lock(&q->mutex);
+  while (!q->stop && q->count == 0) {
+    pthread_cond_wait(&q->not_empty, &q->mutex);
+  }
+  if (q->stop && q->count == 0) {
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+  }
+  data = q->queue[q->head];
+  q->head = (q->head + 1) % BENCH_QUEUE_SIZE;
+  q->count--;
+  pthread_cond_signal(&q->not_full);
+  pthread_mutex_unlock(&q->mutex);
+  return data;
+}
+
+static void mutex_queue_stop(MutexQueue *q) {
+  pthread_mutex_lock(&q->mutex);
+  q->stop = 1;
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+typedef enum { QUEUE_MUTEX = 0, QUEUE_LOCKFREE } QueueKind;
+
+typedef struct {
+  QueueKind kind;
+  MutexQueue mutex_q;
+  TaskQueue lockfree_q;
+  long per_producer;
+} Bench;
+
+typedef struct {
+  Bench *bench;
+  long popped;
+} Worker;
+
+static void *producer_routine(void *arg) {
+  Worker *w = (Worker *)arg;
+  Bench *b = w->bench;
+  long i;
+
+  /* 任务指针不能为 NULL，用 i + 1 作为任务值 */
+  for (i = 0; i < b->per_producer; i++) {
+    void *task = (void *)(uintptr_t)(i + 1);
+    if (b->kind == QUEUE_MUTEX) {
+      mutex_queue_push(&b->mutex_q, task);
+    } else {
+      task_queue_push(&b->lockfree_q, task);
+    }
+  }
+  return NULL;
+}
+
+static void *consumer_routine(void *arg) {
+  Worker *w = (Worker *)arg;
+  Bench *b = w->bench;
+
+  while (1) {
+    void *task = (b->kind == QUEUE_MUTEX) ? mutex_queue_pop(&b->mutex_q)
+                                          : task_queue_pop(&b->lockfree_q);
+    if (task == NULL) {
+      break;
+    }
+    w->popped++;
+  }
+  return NULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* n 个生产者 + n 个消费者传递 total 个任务，返回每秒交接次数 */
+static double run(QueueKind kind, int n, long total) {
+  Bench *b = calloc(1, sizeof(Bench));
+  pthread_t *producers = calloc((size_t)n, sizeof(pthread_t));
+  pthread_t *consumers = calloc((size_t)n, sizeof(pthread_t));
+  Worker *workers = calloc((size_t)n, sizeof(Worker));
+  Worker producer_arg;
+  long popped = 0;
+  double t0, wall;
+  int i;
+
+  b->kind = kind;
+  b->per_producer = total / n;
+  if (kind == QUEUE_MUTEX) {
+    mutex_queue_init(&b->mutex_q);
+  } else if (task_queue_init(&b->lockfree_q, BENCH_QUEUE_SIZE) != 0) {
+    fprintf(stderr, "task_queue_init failed\n");
+    exit(1);
+  }
+  producer_arg.bench = b;
+
+  t0 = now_sec();
+  for (i = 0; i < n; i++) {
+    workers[i].bench = b;
+    pthread_create(&consumers[i], NULL, consumer_routine, &workers[i]);
+  }
+  for (i = 0; i < n; i++) {
+    pthread_create(&producers[i], NULL, producer_routine, &producer_arg);
+  }
+  for (i = 0; i < n; i++) {
+    pthread_join(producers[i], NULL);
+  }
+  /* 生产者全部结束后停止队列，消费者取完剩余任务后退出 */
+  if (kind == QUEUE_MUTEX) {
+    mutex_queue_stop(&b->mutex_q);
+  } else {
+    task_queue_stop(&b->lockfree_q);
+  }
+  for (i = 0; i < n; i++) {
+    pthread_join(consumers[i], NULL);
+    popped += workers[i].popped;
+  }
+  wall = now_sec() - t0;
+
+  if (popped != b->per_producer * n) {
+    fprintf(stderr, "lost tasks: pushed %ld popped %ld\n", b->per_producer * n,
+            popped);
+    exit(1);
+  }
+
+  if (kind == QUEUE_MUTEX) {
+    mutex_queue_destroy(&b->mutex_q);
+  } else {
+    task_queue_destroy(&b->lockfree_q);
+  }
+  free(workers);
+  free(consumers);
+  free(producers);
+  free(b);
+  return popped / wall;
+}
+
+int main(int argc, char *argv[]) {
+  long total = (argc > 1) ? atol(argv[1]) : 2000000;
+  int max_threads = (argc > 2) ? atoi(argv[2]) : 64;
+  int n;
+
+  if (total <= 0 || max_threads <= 0) {
+    fprintf(stderr, "usage: %s [tasks] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  printf("tasks=%ld queue=%d\n", total, BENCH_QUEUE_SIZE);
+  printf("%-8s %16s %16s %8s\n", "threads", "mutex (op/s)", "lockfree (op/s)",
+         "speedup");
+  for (n = 1; n <= max_threads; n *= 2) {
+    double m = run(QUEUE_MUTEX, n, total);
+    double l = run(QUEUE_LOCKFREE, n, total);
+    printf("%3d+%-4d %16.0f %16.0f %7.2fx\n", n, n, m, l, l / m);
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+#include "file_cache.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* FNV-1a */
+static unsigned int hash_key(const char *key) {
+  unsigned int h = 2166136261u;
+
+  while (*key != '\0') {
+    h ^= (unsigned char)*key++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static FileCacheShard *shard_of(FileCache *cache, unsigned int hash) {
+  return &cache->shards[hash % FILE_CACHE_SHARDS];
+}
+
+static FileCacheEntry **bucket_of(FileCacheShard *shard, unsigned int hash) {
+  return &shard->buckets[(hash / FILE_CACHE_SHARDS) & (FILE_CACHE_BUCKETS - 1)];
+}
+
+static void entry_free(FileCacheEntry *entry) {
+  free(entry->key);
+  free(entry->path);
+  free(entry->data);
+  free(entry->header);
+  free(entry);
+}
+
+static void lru_unlink(FileCacheShard *shard, FileCacheEntry *entry) {
+  if (entry->lru_prev != NULL) {
+    entry->lru_prev->lru_next = entry->lru_next;
+  } else {
+    shard->lru_head = entry->lru_next;
+  }
+  if (entry->lru_next != NULL) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+  } else {
+    shard->lru_tail = entry->lru_prev;
+  }
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+}
+
+static void lru_push_front(FileCacheShard *shard, FileCacheEntry *entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = shard->lru_head;
+  if (shard->lru_head != NULL) {
+    shard->lru_head->lru_prev = entry;
+  }
+  shard->lru_head = entry;
+  if (shard->lru_tail == NULL) {
+    shard->lru_tail = entry;
+  }
+}
+
+/* 从分片中摘除条目并释放缓存持有的引用，调用方需持有分片锁 */
+static void shard_remove_locked(FileCacheShard *shard, FileCacheEntry *entry) {
+  FileCacheEntry **pp = bucket_of(shard, entry->hash);
+
+  while (*pp != NULL && *pp != entry) {
+    pp = &(*pp)->hash_next;
+  }
+  if (*pp == NULL) {
+    return;
+  }
+  *pp = entry->hash_next;
+  entry->hash_next = NULL;
+  lru_unlink(shard, entry);
+  shard->bytes -= entry->size;
+  file_cache_release(entry);
+}
+
+static FileCacheEntry *shard_find_locked(FileCacheShard *shard,
+                                         unsigned int hash, const char *key) {
+  FileCacheEntry *entry = *bucket_of(shard, hash);
+
+  while (entry != NULL) {
+    if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+      return entry;
+    }
+    entry = entry->hash_next;
+  }
+  return NULL;
+}
+
+int file_cache_init(FileCache *cache, size_t budget, size_t max_file) {
+  int i;
+
+  memset(cache, 0, sizeof(*cache));
+  cache->shard_budget = budget / FILE_CACHE_SHARDS;
+  cache->max_file = (max_file < cache->shard_budget) ? max_file
+                                                      : cache->shard_budget;
+  for (i = 0; i < FILE_CACHE_SHARDS; i++) {
+    if (pthread_mutex_init(&cache->shards[i].mutex, NULL) != 0) {
+      while (i-- > 0) {
+        pthread_mutex_destroy(&cache->shards[i].mutex);
+      }
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void file_cache_destroy(FileCache *cache) {
+  int i;
+
+  for (i = 0; i < FILE_CACHE_SHARDS; i++) {
+    FileCacheShard *shard = &cache->shards[i];
+
+    pthread_mutex_lock(&shard->mutex);
+    while (shard->lru_head != NULL) {
+      shard_remove_locked(shard, shard->lru_head);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    pthread_mutex_destroy(&shard->mutex);
+  }
+}
+
+int file_cache_accepts(const FileCache *cache, const struct stat *st) {
+  return cache->shard_budget > 0 && S_ISREG(st->st_mode) &&
+         (size_t)st->st_size <= cache->max_file;
+}
+
+FileCacheEntry *file_cache_lookup(FileCache *cache, const char *key) {
+  unsigned int hash = hash_key(key);
+  FileCacheShard *shard = shard_of(cache, hash);
+  FileCacheEntry *entry;
+  time_t now;
+  struct stat st;
+
+  if (cache->shard_budget == 0) {
+    return NULL;
+  }
+
+  now = time(NULL);
+  pthread_mutex_lock(&shard->mutex);
+  entry = shard_find_locked(shard, hash, key);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&shard->mutex);
+    return NULL;
+  }
+  lru_unlink(shard, entry);
+  lru_push_front(shard, entry);
+  atomic_fetch_add(&entry->refs, 1);
+  if (now - entry->checked_at < FILE_CACHE_REVALIDATE_SEC) {
+    pthread_mutex_unlock(&shard->mutex);
+    return entry;
+  }
+  pthread_mutex_unlock(&shard->mutex);
+
+  /* 校验在锁外进行，stat 变慢不会阻塞同分片的其他命中 */
+  if (stat(entry->path, &st) == 0 && st.st_dev == entry->dev &&
+      st.st_ino == entry->ino && (size_t)st.st_size == entry->size &&
+      st.st_mtim.tv_sec == entry->mtime.tv_sec &&
+      st.st_mtim.tv_nsec == entry->mtime.tv_nsec) {
+    pthread_mutex_lock(&shard->mutex);
+    entry->checked_at = now;
+    pthread_mutex_unlock(&shard->mutex);
+    return entry;
+  }
+
+  pthread_mutex_lock(&shard->mutex);
+  shard_remove_locked(shard, entry);
+  pthread_mutex_unlock(&shard->mutex);
+  file_cache_release(entry);
+  return NULL;
+}
+
+FileCacheEntry *file_cache_insert(FileCache *cache, const char *key,
+                                  const char *path, int fd,
+                                  const struct stat *st, const char *header,
+                                  size_t header_len) {
+  unsigned int hash = hash_key(key);
+  FileCacheShard *shard = shard_of(cache, hash);
+  FileCacheEntry *entry;
+  FileCacheEntry *old;
+  size_t size = (size_t)st->st_size;
+  size_t got = 0;
+
+  if (!file_cache_accepts(cache, st)) {
+    return NULL;
+  }
+
+  entry = (FileCacheEntry *)calloc(1, sizeof(FileCacheEntry));
+  if (entry == NULL) {
+    return NULL;
+  }
+  entry->key = strdup(key);
+  entry->path = strdup(path);
+  entry->data = (char *)malloc(size > 0 ? size : 1);
+  entry->header = (char *)malloc(header_len);
+  if (entry->key == NULL || entry->path == NULL || entry->data == NULL ||
+      entry->header == NULL) {
+    entry_free(entry);
+    return NULL;
+  }
+
+  while (got < size) {
+    ssize_t n = pread(fd, entry->data + got, size - got, (off_t)got);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      /* 读取期间文件被截断或出错，不缓存 */
+      entry_free(entry);
+      return NULL;
+    }
+    got += (size_t)n;
+  }
+
+  memcpy(entry->header, header, header_len);
+  entry->header_len = header_len;
+  entry->size = size;
+  entry->dev = st->st_dev;
+  entry->ino = st->st_ino;
+  entry->mtime = st->st_mtim;
+  entry->checked_at = time(NULL);
+  entry->hash = hash;
+  /* 一个引用属于缓存，一个返回给调用方 */
+  atomic_init(&entry->refs, 2);
+
+  pthread_mutex_lock(&shard->mutex);
+  old = shard_find_locked(shard, hash, key);
+  if (old != NULL) {
+    shard_remove_locked(shard, old);
+  }
+  while (shard->bytes + size > cache->shard_budget && shard->lru_tail != NULL) {
+    shard_remove_locked(shard, shard->lru_tail);
+  }
+  entry->hash_next = *bucket_of(shard, hash);
+  *bucket_of(shard, hash) = entry;
+  lru_push_front(shard, entry);
+  shard->bytes += size;
+  pthread_mutex_unlock(&shard->mutex);
+
+  return entry;
+}
+
+void file_cache_release(FileCacheEntry *entry) {
+  if (entry != NULL && atomic_fetch_sub(&entry->refs, 1) == 1) {
+    entry_free(entry);
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef HTTP_FILE_CACHE_H
+#define HTTP_FILE_CACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define FILE_CACHE_SHARDS 16
+#define FILE_CACHE_BUCKETS 256 /* 每个分片的哈希桶数，必须是 2 的幂 */
+/* 距上次校验超过该秒数的条目在命中时重新 stat，期间命中不产生文件系统调用 */
+#define FILE_CACHE_REVALIDATE_SEC 1
+
+/*
+ * 缓存条目：文件内容与预先生成的 200 响应头（以 "Connection: " 结尾，
+ * 由调用方按连接语义补上 keep-alive/close）
+ * 条目按引用计数共享，淘汰后仍被连接引用的内容直到发送完毕才释放
+ */
+typedef struct FileCacheEntry {
+  char *key;  /* 解码后的 URI */
+  char *path; /* 已通过安全检查的文件路径 */
+  char *data;
+  size_t size;
+  char *header;
+  size_t header_len;
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  time_t checked_at;
+  unsigned int hash;
+  atomic_int refs;
+  struct FileCacheEntry *hash_next;
+  struct FileCacheEntry *lru_prev;
+  struct FileCacheEntry *lru_next;
+} FileCacheEntry;
+
+/* 按 URI 哈希分片，每个分片独立加锁、独立 LRU 与字节预算 */
+typedef struct {
+  pthread_mutex_t mutex;
+  FileCacheEntry *buckets[FILE_CACHE_BUCKETS];
+  FileCacheEntry *lru_head; /* 最近使用 */
+  FileCacheEntry *lru_tail; /* 最久未使用，优先淘汰 */
+  size_t bytes;
+} FileCacheShard;
+
+typedef struct {
+  FileCacheShard shards[FILE_CACHE_SHARDS];
+  size_t shard_budget;
+  size_t max_file; /* 超过该大小的文件不缓存，继续走 sendfile */
+} FileCache;
+
+/* budget 为总字节预算（0 表示禁用缓存），成功返回 0 */
+int file_cache_init(FileCache *cache, size_t budget, size_t max_file);
+void file_cache_destroy(FileCache *cache);
+
+/* 文件是否适合缓存：启用缓存、普通文件且不超过 max_file */
+int file_cache_accepts(const FileCache *cache, const struct stat *st);
+
+/*
+ * 按 URI 查找，命中时返回持有一个引用的条目（用完调用 file_cache_release）
+ * 条目超过 FILE_CACHE_REVALIDATE_SEC 未校验时重新 stat，
+ * 文件已被修改、替换或删除则移出缓存并返回 NULL
+ */
+FileCacheEntry *file_cache_lookup(FileCache *cache, const char *key);
+
+/*
+ * 读入 fd 的全部内容并插入缓存，返回持有一个引用的条目，失败返回 NULL
+ * header 为预先生成的响应头，同 key 的旧条目会被替换
+ */
+FileCacheEntry *file_cache_insert(FileCache *cache, const char *key,
+                                  const char *path, int fd,
+                                  const struct stat *st, const char *header,
+                                  size_t header_len);
+
+void file_cache_release(FileCacheEntry *entry);
+
+#endif
@@ -0,0 +1,179 @@
+#include "http_parser.h"
+
+#include <string.h>
+#include <strings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* 在 [p, end) 中查找 LF，x86-64 上每次比较 16 字节 */
+static const char *find_lf(const char *p, const char *end) {
+#if defined(__SSE2__)
+  const __m128i lf = _mm_set1_epi8('\n');
+
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf));
+    if (mask != 0) {
+      return p + __builtin_ctz((unsigned int)mask);
+    }
+    p += 16;
+  }
+#endif
+  return (const char *)memchr(p, '\n', (size_t)(end - p));
+}
+
+static HttpSpan make_span(const char *buf, const char *start, const char *end) {
+  HttpSpan span;
+
+  span.off = (uint32_t)(start - buf);
+  span.len = (uint32_t)(end - start);
+  return span;
+}
+
+/* token 字符（RFC 9110），用于方法名和请求头名称 */
+static int is_token_char(unsigned char c) {
+  if (c <= 0x20 || c >= 0x7f) {
+    return 0;
+  }
+  return strchr("\"(),/:;<=>?@[\\]{}", c) == NULL;
+}
+
+/* 请求行：METHOD SP URI SP VERSION */
+static int parse_request_line(HttpRequest *req, const char *buf,
+                              const char *line, const char *end) {
+  const char *sp1 = memchr(line, ' ', (size_t)(end - line));
+  const char *sp2;
+  const char *p;
+
+  if (sp1 == NULL || sp1 == line) {
+    return HTTP_PARSE_ERROR;
+  }
+  for (p = line; p < sp1; p++) {
+    if (!is_token_char((unsigned char)*p)) {
+      return HTTP_PARSE_ERROR;
+    }
+  }
+
+  sp2 = memchr(sp1 + 1, ' ', (size_t)(end - sp1 - 1));
+  if (sp2 == NULL || sp2 == sp1 + 1 || end - sp2 - 1 < 8 ||
+      memcmp(sp2 + 1, "HTTP/", 5) != 0) {
+    return HTTP_PARSE_ERROR;
+  }
+  for (p = sp1 + 1; p < sp2; p++) {
+    if ((unsigned char)*p <= 0x20 || (unsigned char)*p == 0x7f) {
+      return HTTP_PARSE_ERROR;
+    }
+  }
+
+  req->method = make_span(buf, line, sp1);
+  req->uri = make_span(buf, sp1 + 1, sp2);
+  req->version = make_span(buf, sp2 + 1, end);
+  return HTTP_PARSE_INCOMPLETE;
+}
+
+/* 请求头：name ":" OWS value OWS，不支持已废弃的折行 */
+static int parse_header_line(HttpRequest *req, const char *buf,
+                             const char *line, const char *end) {
+  const char *colon = memchr(line, ':', (size_t)(end - line));
+  const char *value;
+  const char *p;
+  HttpHeader *header;
+
+  if (colon == NULL || colon == line) {
+    return HTTP_PARSE_ERROR;
+  }
+  for (p = line; p < colon; p++) {
+    if (!is_token_char((unsigned char)*p)) {
+      return HTTP_PARSE_ERROR;
+    }
+  }
+  if (req->header_count >= HTTP_MAX_HEADERS) {
+    return HTTP_PARSE_ERROR;
+  }
+
+  value = colon + 1;
+  while (value < end && (*value == ' ' || *value == '\t')) {
+    value++;
+  }
+  while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+    end--;
+  }
+
+  header = &req->headers[req->header_count++];
+  header->name = make_span(buf, line, colon);
+  header->value = make_span(buf, value, end);
+  return HTTP_PARSE_INCOMPLETE;
+}
+
+void http_request_reset(HttpRequest *req) {
+  req->state = HTTP_PARSE_REQUEST_LINE;
+  req->line_start = 0;
+  req->scan = 0;
+  req->head_len = 0;
+  req->header_count = 0;
+}
+
+int http_parse_request(HttpRequest *req, const char *buf, size_t len) {
+  const char *end = buf + len;
+
+  while (req->state != HTTP_PARSE_DONE) {
+    const char *line = buf + req->line_start;
+    const char *lf = find_lf(buf + req->scan, end);
+    const char *line_end;
+    int ret;
+
+    if (lf == NULL) {
+      req->scan = (uint32_t)len;
+      return HTTP_PARSE_INCOMPLETE;
+    }
+
+    /* 行以 CRLF 结尾，宽容处理单独的 LF */
+    line_end = (lf > line && lf[-1] == '\r') ? lf - 1 : lf;
+    req->line_start = (uint32_t)(lf + 1 - buf);
+    req->scan = req->line_start;
+
+    if (req->state == HTTP_PARSE_REQUEST_LINE) {
+      /* 容忍请求之间多余的空行（RFC 9112 2.2） */
+      if (line_end == line) {
+        continue;
+      }
+      ret = parse_request_line(req, buf, line, line_end);
+      req->state = HTTP_PARSE_HEADERS;
+    } else if (line_end == line) {
+      req->state = HTTP_PARSE_DONE;
+      req->head_len = req->line_start;
+      ret = HTTP_PARSE_INCOMPLETE;
+    } else {
+      ret = parse_header_line(req, buf, line, line_end);
+    }
+
+    if (ret == HTTP_PARSE_ERROR) {
+      return HTTP_PARSE_ERROR;
+    }
+  }
+
+  return HTTP_PARSE_COMPLETE;
+}
+
+int http_span_eq(const char *buf, HttpSpan span, const char *str) {
+  return strlen(str) == span.len && memcmp(buf + span.off, str, span.len) == 0;
+}
+
+int http_span_case_eq(const char *buf, HttpSpan span, const char *str) {
+  return strlen(str) == span.len &&
+         strncasecmp(buf + span.off, str, span.len) == 0;
+}
+
+const HttpHeader *http_find_header(const HttpRequest *req, const char *buf,
+                                   const char *name) {
+  int i;
+
+  for (i = 0; i < req->header_count; i++) {
+    if (http_span_case_eq(buf, req->headers[i].name, name)) {
+      return &req->headers[i];
+    }
+  }
+  return NULL;
+}
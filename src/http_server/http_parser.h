@@ -0,0 +1,61 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_HEADERS 64
+
+/* 接收缓冲区中的一段 [off, off + len)，缓冲区扩容后依然有效 */
+typedef struct {
+  uint32_t off;
+  uint32_t len;
+} HttpSpan;
+
+typedef struct {
+  HttpSpan name;
+  HttpSpan value;
+} HttpHeader;
+
+enum { HTTP_PARSE_REQUEST_LINE = 0, HTTP_PARSE_HEADERS, HTTP_PARSE_DONE };
+
+enum {
+  HTTP_PARSE_ERROR = -1,
+  HTTP_PARSE_INCOMPLETE = 0,
+  HTTP_PARSE_COMPLETE = 1
+};
+
+/*
+ * 增量解析状态：只保存偏移，不拷贝、不修改接收缓冲区
+ * 新数据到达后从 scan 处继续查找行尾，已扫描过的字节不会重复扫描
+ */
+typedef struct {
+  int state;
+  uint32_t line_start; /* 当前未完成行的起点 */
+  uint32_t scan;       /* 当前行中已确认没有 LF 的位置 */
+  uint32_t head_len;   /* 解析完成时请求头（含空行）的总长度 */
+  HttpSpan method;
+  HttpSpan uri;
+  HttpSpan version;
+  int header_count;
+  HttpHeader headers[HTTP_MAX_HEADERS];
+} HttpRequest;
+
+void http_request_reset(HttpRequest *req);
+
+/*
+ * 解析 buf[0, len) 中的请求头，可在每次收到新数据后重复调用
+ * 返回 HTTP_PARSE_COMPLETE（req->head_len 为请求头长度）、
+ * HTTP_PARSE_INCOMPLETE 或 HTTP_PARSE_ERROR
+ */
+int http_parse_request(HttpRequest *req, const char *buf, size_t len);
+
+/* 按名称查找请求头（大小写不敏感），未找到返回 NULL */
+const HttpHeader *http_find_header(const HttpRequest *req, const char *buf,
+                                   const char *name);
+
+/* span 是否等于 str（大小写敏感 / 不敏感） */
+int http_span_eq(const char *buf, HttpSpan span, const char *str);
+int http_span_case_eq(const char *buf, HttpSpan span, const char *str);
+
+#endif
@@ -0,0 +1,294 @@
+#include "metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Prometheus 直方图输出的 le 边界：2^k 微秒，k 取该范围（16us..33.5s） */
+#define METRICS_LE_MIN_EXP 4
+#define METRICS_LE_MAX_EXP 25
+
+typedef struct {
+  const char *name;
+  const char *help;
+} MetricDesc;
+
+/* 下标与 MetricCounter 一一对应 */
+static const MetricDesc kCounterDescs[METRIC_COUNTER_COUNT] = {
+    {"http_server_connections_accepted_total", "Accepted connections."},
+    {"http_server_connections_closed_total", "Closed connections."},
+    {"http_server_connection_timeouts_total",
+     "Connections closed by header, idle or send timeout."},
+    {"http_server_requests_total", "Completed responses."},
+    {"http_server_bad_requests_total",
+     "Requests rejected before routing (malformed or too large)."},
+    {"http_server_sent_bytes_total", "Response bytes written to sockets."},
+};
+
+/* 下标与 MetricHistogram 一一对应 */
+static const MetricDesc kHistDescs[METRIC_HIST_COUNT] = {
+    {"http_server_first_byte_seconds",
+     "From request arrival (accept for the first request) to the first "
+     "response byte."},
+    {"http_server_transfer_seconds",
+     "From the first to the last response byte."},
+};
+
+static _Atomic(MetricsShard *) g_shards[METRICS_MAX_THREADS];
+static _Atomic int g_shard_count;
+static __thread MetricsShard *t_shard;
+static __thread int t_shard_failed;
+
+uint64_t metrics_now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static MetricsShard *shard_register(void) {
+  size_t size = (sizeof(MetricsShard) + METRICS_CACHELINE - 1) &
+                ~(size_t)(METRICS_CACHELINE - 1);
+  MetricsShard *shard;
+  int idx;
+
+  idx = atomic_fetch_add(&g_shard_count, 1);
+  if (idx >= METRICS_MAX_THREADS) {
+    t_shard_failed = 1;
+    return NULL;
+  }
+  shard = (MetricsShard *)aligned_alloc(METRICS_CACHELINE, size);
+  if (shard == NULL) {
+    t_shard_failed = 1;
+    return NULL;
+  }
+  memset(shard, 0, size);
+  atomic_store_explicit(&g_shards[idx], shard, memory_order_release);
+  t_shard = shard;
+  return shard;
+}
+
+static MetricsShard *shard_get(void) {
+  if (t_shard != NULL) {
+    return t_shard;
+  }
+  if (t_shard_failed) {
+    return NULL;
+  }
+  return shard_register();
+}
+
+/* 分片只有一个写者，读改写不需要原子指令，读者按 relaxed 读到的是某个完整值 */
+static void shard_add(_Atomic uint64_t *cell, uint64_t value) {
+  atomic_store_explicit(
+      cell, atomic_load_explicit(cell, memory_order_relaxed) + value,
+      memory_order_relaxed);
+}
+
+static int hist_bucket(uint64_t value_us) {
+  int exp;
+
+  if (value_us < METRICS_HIST_SUB_COUNT) {
+    return (int)value_us;
+  }
+  if (value_us >> (METRICS_HIST_MAX_EXP + 1) != 0) {
+    value_us = ((uint64_t)1 << (METRICS_HIST_MAX_EXP + 1)) - 1;
+  }
+  exp = 63 - __builtin_clzll(value_us);
+  return (exp - METRICS_HIST_SUB_BITS + 1) * METRICS_HIST_SUB_COUNT +
+         (int)(value_us >> (exp - METRICS_HIST_SUB_BITS)) -
+         METRICS_HIST_SUB_COUNT;
+}
+
+void metrics_add(MetricCounter counter, uint64_t value) {
+  MetricsShard *shard = shard_get();
+
+  if (shard != NULL) {
+    shard_add(&shard->counters[counter], value);
+  }
+}
+
+void metrics_count_status(int status) {
+  MetricsShard *shard = shard_get();
+
+  if (shard != NULL && status >= METRICS_STATUS_MIN &&
+      status <= METRICS_STATUS_MAX) {
+    shard_add(&shard->status[status - METRICS_STATUS_MIN], 1);
+  }
+}
+
+void metrics_observe(MetricHistogram hist, uint64_t value_us) {
+  MetricsShard *shard = shard_get();
+
+  if (shard != NULL) {
+    shard_add(&shard->hist[hist].buckets[hist_bucket(value_us)], 1);
+    shard_add(&shard->hist[hist].sum_us, value_us);
+  }
+}
+
+static int shard_snapshot_count(void) {
+  int count = atomic_load_explicit(&g_shard_count, memory_order_acquire);
+
+  return count < METRICS_MAX_THREADS ? count : METRICS_MAX_THREADS;
+}
+
+static MetricsShard *shard_at(int idx) {
+  return atomic_load_explicit(&g_shards[idx], memory_order_acquire);
+}
+
+uint64_t metrics_counter_total(MetricCounter counter) {
+  uint64_t total = 0;
+  int count = shard_snapshot_count();
+  int i;
+
+  for (i = 0; i < count; i++) {
+    MetricsShard *shard = shard_at(i);
+    if (shard != NULL) {
+      total += atomic_load_explicit(&shard->counters[counter],
+                                    memory_order_relaxed);
+    }
+  }
+  return total;
+}
+
+/* 微秒写成秒的十进制小数，保留 6 位 */
+static void append_seconds(ResponseBuilder *rb, uint64_t us) {
+  char frac[6];
+  uint64_t rem = us % 1000000u;
+  int i;
+
+  response_append_uint(rb, us / 1000000u);
+  for (i = 5; i >= 0; i--) {
+    frac[i] = (char)('0' + rem % 10);
+    rem /= 10;
+  }
+  response_append_lit(rb, ".");
+  response_append(rb, frac, sizeof(frac));
+}
+
+static void append_family(ResponseBuilder *rb, const char *name,
+                          const char *help, const char *type) {
+  response_append_lit(rb, "# HELP ");
+  response_append_str(rb, name);
+  response_append_lit(rb, " ");
+  response_append_str(rb, help);
+  response_append_lit(rb, "\n# TYPE ");
+  response_append_str(rb, name);
+  response_append_lit(rb, " ");
+  response_append_str(rb, type);
+  response_append_lit(rb, "\n");
+}
+
+static void render_status(ResponseBuilder *rb, int count) {
+  int code;
+
+  append_family(rb, "http_server_responses_total",
+                "Completed responses by status code.", "counter");
+  for (code = METRICS_STATUS_MIN; code <= METRICS_STATUS_MAX; code++) {
+    uint64_t total = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+      MetricsShard *shard = shard_at(i);
+      if (shard != NULL) {
+        total += atomic_load_explicit(&shard->status[code - METRICS_STATUS_MIN],
+                                      memory_order_relaxed);
+      }
+    }
+    if (total == 0) {
+      continue;
+    }
+    response_append_lit(rb, "http_server_responses_total{code=\"");
+    response_append_uint(rb, (unsigned long long)code);
+    response_append_lit(rb, "\"} ");
+    response_append_uint(rb, total);
+    response_append_lit(rb, "\n");
+  }
+}
+
+/* 汇总各分片的细粒度桶，只在 2 的幂边界上输出累计值 */
+static void render_histogram(ResponseBuilder *rb, MetricHistogram hist,
+                             int count) {
+  uint64_t merged[METRICS_HIST_BUCKETS];
+  const char *name = kHistDescs[hist].name;
+  uint64_t sum_us = 0;
+  uint64_t cumulative = 0;
+  int bucket = 0;
+  int exp;
+  int i;
+
+  memset(merged, 0, sizeof(merged));
+  for (i = 0; i < count; i++) {
+    MetricsShard *shard = shard_at(i);
+    if (shard == NULL) {
+      continue;
+    }
+    for (bucket = 0; bucket < METRICS_HIST_BUCKETS; bucket++) {
+      merged[bucket] += atomic_load_explicit(&shard->hist[hist].buckets[bucket],
+                                             memory_order_relaxed);
+    }
+    sum_us += atomic_load_explicit(&shard->hist[hist].sum_us,
+                                   memory_order_relaxed);
+  }
+
+  append_family(rb, name, kHistDescs[hist].help, "histogram");
+  bucket = 0;
+  for (exp = METRICS_LE_MIN_EXP; exp <= METRICS_LE_MAX_EXP; exp++) {
+    /* 小于 2^exp 的值全部落在前 (exp - SUB_BITS + 1) 组子桶中 */
+    int end = (exp - METRICS_HIST_SUB_BITS + 1) * METRICS_HIST_SUB_COUNT;
+
+    for (; bucket < end; bucket++) {
+      cumulative += merged[bucket];
+    }
+    response_append_str(rb, name);
+    response_append_lit(rb, "_bucket{le=\"");
+    append_seconds(rb, (uint64_t)1 << exp);
+    response_append_lit(rb, "\"} ");
+    response_append_uint(rb, cumulative);
+    response_append_lit(rb, "\n");
+  }
+  for (; bucket < METRICS_HIST_BUCKETS; bucket++) {
+    cumulative += merged[bucket];
+  }
+
+  response_append_str(rb, name);
+  response_append_lit(rb, "_bucket{le=\"+Inf\"} ");
+  response_append_uint(rb, cumulative);
+  response_append_lit(rb, "\n");
+  response_append_str(rb, name);
+  response_append_lit(rb, "_sum ");
+  append_seconds(rb, sum_us);
+  response_append_lit(rb, "\n");
+  response_append_str(rb, name);
+  response_append_lit(rb, "_count ");
+  response_append_uint(rb, cumulative);
+  response_append_lit(rb, "\n");
+}
+
+void metrics_render(ResponseBuilder *rb) {
+  int count = shard_snapshot_count();
+  int counter;
+  int hist;
+
+  for (counter = 0; counter < METRIC_COUNTER_COUNT; counter++) {
+    append_family(rb, kCounterDescs[counter].name, kCounterDescs[counter].help,
+                  "counter");
+    response_append_str(rb, kCounterDescs[counter].name);
+    response_append_lit(rb, " ");
+    response_append_uint(rb, metrics_counter_total((MetricCounter)counter));
+    response_append_lit(rb, "\n");
+  }
+  render_status(rb, count);
+  for (hist = 0; hist < METRIC_HIST_COUNT; hist++) {
+    render_histogram(rb, (MetricHistogram)hist, count);
+  }
+}
+
+void metrics_render_value(ResponseBuilder *rb, const char *name,
+                          const char *help, const char *type, uint64_t value) {
+  append_family(rb, name, help, type);
+  response_append_str(rb, name);
+  response_append_lit(rb, " ");
+  response_append_uint(rb, value);
+  response_append_lit(rb, "\n");
+}
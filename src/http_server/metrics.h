@@ -0,0 +1,82 @@
+#ifndef HTTP_METRICS_H
+#define HTTP_METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "response.h"
+
+#define METRICS_MAX_THREADS 256
+#define METRICS_CACHELINE 64
+
+/*
+ * 延迟直方图（HDR 风格，单位微秒）：每个 2 的幂区间再均分为 8 个子桶，
+ * 相对误差不超过 12.5%，覆盖 0 到约 2^36 微秒（19 小时），更大的值计入最后一个桶
+ */
+#define METRICS_HIST_SUB_BITS 3
+#define METRICS_HIST_SUB_COUNT (1 << METRICS_HIST_SUB_BITS)
+#define METRICS_HIST_MAX_EXP 35
+#define METRICS_HIST_BUCKETS                                                   \
+  ((METRICS_HIST_MAX_EXP - METRICS_HIST_SUB_BITS + 2) * METRICS_HIST_SUB_COUNT)
+
+/* 状态码计数覆盖 100..599 */
+#define METRICS_STATUS_MIN 100
+#define METRICS_STATUS_MAX 599
+
+typedef enum {
+  METRIC_CONN_ACCEPTED = 0,
+  METRIC_CONN_CLOSED,
+  METRIC_CONN_TIMEOUTS,
+  METRIC_REQUESTS,
+  METRIC_BAD_REQUESTS,
+  METRIC_BYTES_SENT,
+  METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum {
+  METRIC_HIST_FIRST_BYTE = 0, /* 接收到请求（首个请求从 accept 算起）到响应首字节 */
+  METRIC_HIST_TRANSFER,       /* 响应首字节到末字节 */
+  METRIC_HIST_COUNT
+} MetricHistogram;
+
+typedef struct {
+  _Atomic uint64_t buckets[METRICS_HIST_BUCKETS];
+  _Atomic uint64_t sum_us;
+} MetricsHistogram;
+
+/*
+ * 每个线程独占一个分片，只有所属线程写入（普通 load + store，无锁无原子 RMW），
+ * /metrics 请求读取时汇总所有分片
+ * 分片按缓存行对齐分配，不同线程的计数不会伪共享
+ */
+typedef struct {
+  _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+  _Atomic uint64_t status[METRICS_STATUS_MAX - METRICS_STATUS_MIN + 1];
+  MetricsHistogram hist[METRIC_HIST_COUNT];
+} MetricsShard;
+
+/* 单调时钟，微秒 */
+uint64_t metrics_now_us(void);
+
+/*
+ * 计数接口，首次调用时为当前线程登记分片
+ * 登记的线程数超过 METRICS_MAX_THREADS 时，多出来的线程不计数
+ */
+void metrics_add(MetricCounter counter, uint64_t value);
+void metrics_count_status(int status);
+void metrics_observe(MetricHistogram hist, uint64_t value_us);
+
+/* 所有分片中某个计数的总和 */
+uint64_t metrics_counter_total(MetricCounter counter);
+
+/* 以 Prometheus 文本格式追加全部计数与直方图 */
+void metrics_render(ResponseBuilder *rb);
+
+/*
+ * 追加一个单值指标（type 为 "gauge" 或 "counter"），
+ * 供调用方输出模块外部的状态（队列深度等）
+ */
+void metrics_render_value(ResponseBuilder *rb, const char *name,
+                          const char *help, const char *type, uint64_t value);
+
+#endif
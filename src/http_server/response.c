@@ -0,0 +1,135 @@
+#include "response.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *status;
+  const char *content_type;
+  const char *body;
+} StaticResponseSpec;
+
+/* 下标与 StaticResponseId 一一对应 */
+static const StaticResponseSpec kStaticSpecs[RESP_STATIC_COUNT] = {
+    {"200 OK", "text/plain; charset=utf-8",
+     "Hello from C HTTP Server!\n"
+     "Try: /image and /video\n"},
+    {"400 Bad Request", "text/plain; charset=utf-8", "Malformed request line\n"},
+    {"400 Bad Request", "text/plain; charset=utf-8", "Invalid URI encoding\n"},
+    {"400 Bad Request", "text/plain; charset=utf-8", "Invalid path\n"},
+    {"403 Forbidden", "text/plain; charset=utf-8", "Forbidden path\n"},
+    {"404 Not Found", "text/html; charset=utf-8", "<h1>404 Not Found</h1>"},
+    {"405 Method Not Allowed", "text/html; charset=utf-8",
+     "<h1>405 Method Not Allowed</h1>"},
+    {"431 Request Header Fields Too Large", "text/plain; charset=utf-8",
+     "Request header too large\n"},
+    {"500 Internal Server Error", "text/html; charset=utf-8",
+     "<h1>500 Internal Server Error</h1>"},
+    {"500 Internal Server Error", "text/plain; charset=utf-8",
+     "Path resolution failed\n"},
+};
+
+typedef struct {
+  char *data;
+  size_t header_len;
+  size_t total_len;
+  int status;
+} StaticResponse;
+
+/* [id][keep_alive] */
+static StaticResponse g_static[RESP_STATIC_COUNT][2];
+
+void response_builder_init(ResponseBuilder *rb, char *buf, size_t cap) {
+  rb->buf = buf;
+  rb->cap = cap;
+  rb->len = 0;
+  rb->overflow = 0;
+}
+
+void response_append(ResponseBuilder *rb, const char *data, size_t len) {
+  if (rb->overflow || len > rb->cap - rb->len) {
+    rb->overflow = 1;
+    return;
+  }
+  memcpy(rb->buf + rb->len, data, len);
+  rb->len += len;
+}
+
+void response_append_str(ResponseBuilder *rb, const char *str) {
+  response_append(rb, str, strlen(str));
+}
+
+void response_append_uint(ResponseBuilder *rb, unsigned long long value) {
+  char digits[20];
+  char *p = digits + sizeof(digits);
+
+  do {
+    *--p = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  response_append(rb, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+void response_begin(ResponseBuilder *rb, const char *status,
+                    const char *content_type, unsigned long long content_len) {
+  response_append_lit(rb, "HTTP/1.1 ");
+  response_append_str(rb, status);
+  response_append_lit(rb, "\r\nContent-Type: ");
+  response_append_str(rb, content_type);
+  response_append_lit(rb, "\r\nContent-Length: ");
+  response_append_uint(rb, content_len);
+  response_append_lit(rb, "\r\n");
+}
+
+void response_end_headers(ResponseBuilder *rb, int keep_alive) {
+  if (keep_alive) {
+    response_append_lit(rb, "Connection: keep-alive\r\n\r\n");
+  } else {
+    response_append_lit(rb, "Connection: close\r\n\r\n");
+  }
+}
+
+int static_responses_init(void) {
+  int id;
+  int keep_alive;
+
+  for (id = 0; id < RESP_STATIC_COUNT; id++) {
+    const StaticResponseSpec *spec = &kStaticSpecs[id];
+    size_t body_len = strlen(spec->body);
+
+    for (keep_alive = 0; keep_alive < 2; keep_alive++) {
+      StaticResponse *resp = &g_static[id][keep_alive];
+      size_t cap = 256 + strlen(spec->status) + strlen(spec->content_type) +
+                   body_len;
+      ResponseBuilder rb;
+
+      resp->data = (char *)malloc(cap);
+      if (resp->data == NULL) {
+        return -1;
+      }
+      response_builder_init(&rb, resp->data, cap);
+      response_begin(&rb, spec->status, spec->content_type, body_len);
+      response_end_headers(&rb, keep_alive);
+      resp->header_len = rb.len;
+      response_append(&rb, spec->body, body_len);
+      if (rb.overflow) {
+        return -1;
+      }
+      resp->total_len = rb.len;
+      resp->status = atoi(spec->status);
+    }
+  }
+  return 0;
+}
+
+const char *static_response(StaticResponseId id, int keep_alive, int with_body,
+                            size_t *len) {
+  const StaticResponse *resp = &g_static[id][keep_alive ? 1 : 0];
+
+  *len = with_body ? resp->total_len : resp->header_len;
+  return resp->data;
+}
+
+int static_response_status(StaticResponseId id) {
+  return g_static[id][0].status;
+}
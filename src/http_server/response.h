@@ -0,0 +1,58 @@
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <stddef.h>
+
+/*
+ * 响应构建器：在调用方提供的缓冲区末尾追加字节
+ * 空间不足时置 overflow 并停止写入，调用方最后统一检查一次
+ */
+typedef struct {
+  char *buf;
+  size_t cap;
+  size_t len;
+  int overflow;
+} ResponseBuilder;
+
+void response_builder_init(ResponseBuilder *rb, char *buf, size_t cap);
+void response_append(ResponseBuilder *rb, const char *data, size_t len);
+void response_append_str(ResponseBuilder *rb, const char *str);
+/* 十进制整数，不经过 snprintf */
+void response_append_uint(ResponseBuilder *rb, unsigned long long value);
+
+/* 追加字符串字面量，长度在编译期确定 */
+#define response_append_lit(rb, lit) response_append((rb), (lit), sizeof(lit) - 1)
+
+/* 状态行 + Content-Type + Content-Length，status 形如 "200 OK" */
+void response_begin(ResponseBuilder *rb, const char *status,
+                    const char *content_type, unsigned long long content_len);
+/* Connection 头与空行，结束响应头 */
+void response_end_headers(ResponseBuilder *rb, int keep_alive);
+
+/* 内容固定的响应，启动时生成完整字节（含 keep-alive 与 close 两种版本） */
+typedef enum {
+  RESP_HELLO = 0,
+  RESP_400_MALFORMED,
+  RESP_400_BAD_ENCODING,
+  RESP_400_BAD_PATH,
+  RESP_403_PATH,
+  RESP_404,
+  RESP_405,
+  RESP_431,
+  RESP_500,
+  RESP_500_PATH,
+  RESP_STATIC_COUNT
+} StaticResponseId;
+
+int static_responses_init(void);
+
+/*
+ * 返回预先生成的完整响应，*len 为发送长度
+ * with_body 为 0（HEAD 请求）时只包含响应头
+ */
+const char *static_response(StaticResponseId id, int keep_alive, int with_body,
+                            size_t *len);
+/* 固定响应的状态码 */
+int static_response_status(StaticResponseId id);
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <arpa/inet.h>
 #include <asm-generic/errno-base.h>
 #include <asm-generic/errno.h>
@@ -7,6 +8,9 @@
 #include <limits.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,29 +19,72 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
-#define HTTP_PORT 8080
-#define BUFFER_SIZE 4096
+#include "async_log.h"
+#include "metrics.h"
+#include "server.h"
+#include "task_queue.h"
+#include "uring_engine.h"
+
 #define MAX_CLIENTS 10
 #define THREAD_POOL_SIZE 4
-#define TASK_QUEUE_SIZE 1024
+#define TASK_QUEUE_SIZE 1024 /* 必须是 2 的幂 */
+#define MAX_CONNECTIONS 65536
+#define EPOLL_WAIT_TIMEOUT_MS 1000 /* 线程池模式下 epoll_wait 的最长等待 */
+#define CONN_SLAB_SIZE 256 /* 连接对象按块分配，每块的对象数 */
+#define FILE_CACHE_DEFAULT_MB 64
+#define FILE_CACHE_MAX_FILE (1 << 20) /* 超过 1MB 的文件不缓存，走 sendfile */
 
+/*
+ * 事件循环（reactor）：独立的 epoll 实例、监听 socket 与连接表
+ * - 线程池模式：只有一个 reactor，就绪连接投递给 ThreadPool 处理
+ * - 多 reactor 模式：每个线程一个 reactor，连接在本线程内直接处理，
+ *   各自的监听 socket 通过 SO_REUSEPORT 由内核分摊新连接，
+ *   请求处理路径上没有跨线程共享的队列和锁竞争
+ */
+/*
+ * 连接对象与初始接收缓冲区成块分配，块只增不减：
+ * 对象按 fd 下标绑定后一直复用，接入新连接时不再调用 malloc
+ */
+typedef struct ConnSlab {
+  struct ConnSlab *next;
+  Connection conns[CONN_SLAB_SIZE];
+  char buffers[CONN_SLAB_SIZE][BUFFER_SIZE];
+} ConnSlab;
+
+typedef struct Reactor {
+  int id;
+  int epoll_fd;
+  int listen_fd;
+  int cpu;       /* 绑定的 CPU，-1 表示不绑定 */
+  int use_pool;  /* 1：投递到线程池（EPOLLONESHOT）；0：本线程处理 */
+  Connection **conns; /* 按 fd 下标索引，仅属于本 reactor 的连接 */
+  ConnSlab *slabs;    /* 最新的块在链表头 */
+  int slab_used;      /* 最新的块中已分出的对象数 */
+  /*
+   * 本 reactor 所有连接的超时，由 reactor 线程推进；
+   * 线程池模式下工作线程也会改期，用 timer_mutex 保护
+   * 加锁顺序：conn->mutex -> timer_mutex，reactor 持有 timer_mutex 时
+   * 只能 trylock 连接
+   */
+  TimerWheel timers;
+  pthread_mutex_t timer_mutex;
+  pthread_t thread;
+} Reactor;
+
+/* 任务队列为无锁 MPMC 环形队列，空闲工作线程在 futex 上休眠 */
 typedef struct {
-  int queue[TASK_QUEUE_SIZE];
-  int head;
-  int tail;
-  int count;
-  int stop;
+  TaskQueue tasks;
   pthread_t workers[THREAD_POOL_SIZE];
-  pthread_mutex_t mutex;
-  pthread_cond_t not_empty;
-  pthread_cond_t not_full;
 } ThreadPool;
 
-void handle_request(int client_fd, char *request);
+int thread_pool_submit(ThreadPool *pool, Connection *conn);
 
 static ThreadPool g_pool;
+static int g_pool_enabled;
+static FileCache g_file_cache;
 
 typedef struct {
   const char *ext;
@@ -76,22 +123,69 @@ const char *get_content_type(const char *filepath) {
   return "application/octet-stream";
 }
 
-int parse_range_header(const char *request, off_t file_size, off_t *start,
-                       off_t *end) {
-  const char *range = strstr(request, "\r\nRange: bytes=");
-  char *parse_end = NULL;
+/*
+ * 判断请求是否希望保持连接：
+ * HTTP/1.1 默认 keep-alive，除非 Connection: close；
+ * HTTP/1.0 仅在显式 Connection: keep-alive 时保持
+ */
+int request_wants_keep_alive(const HttpRequest *req, const char *buf) {
+  const HttpHeader *header = http_find_header(req, buf, "Connection");
+
+  if (header != NULL) {
+    if (http_span_case_eq(buf, header->value, "close")) {
+      return 0;
+    }
+    if (http_span_case_eq(buf, header->value, "keep-alive")) {
+      return 1;
+    }
+  }
+
+  return http_span_eq(buf, req->version, "HTTP/1.1");
+}
+
+/* 解析 [*p, end) 开头的十进制数，没有数字或溢出返回 -1 */
+int parse_decimal(const char **p, const char *end, long long *value) {
+  const char *start = *p;
+  long long v = 0;
+
+  while (*p < end && **p >= '0' && **p <= '9') {
+    if (v > (LLONG_MAX - 9) / 10) {
+      return -1;
+    }
+    v = v * 10 + (**p - '0');
+    (*p)++;
+  }
+  if (*p == start) {
+    return -1;
+  }
+  *value = v;
+  return 0;
+}
+
+/*
+ * 解析 Range 头的值（单段 bytes=a-b / a- / -n）
+ * range 为 NULL 或单位不是 bytes 返回 0，合法范围返回 1，不合法返回 -1
+ */
+int parse_range_header(const char *range, size_t range_len, off_t file_size,
+                       off_t *start, off_t *end) {
+  const char *p;
+  const char *limit;
   long long a;
   long long b;
 
   if (range == NULL) {
     return 0;
   }
+  /* 不认识的范围单位按 RFC 9110 忽略，返回完整内容 */
+  if (range_len < 6 || strncasecmp(range, "bytes=", 6) != 0) {
+    return 0;
+  }
+  p = range + 6;
+  limit = range + range_len;
 
-  range += strlen("\r\nRange: bytes=");
-
-  if (*range == '-') {
-    a = strtoll(range + 1, &parse_end, 10);
-    if (parse_end == range + 1 || a <= 0) {
+  if (p < limit && *p == '-') {
+    p++;
+    if (parse_decimal(&p, limit, &a) < 0 || p != limit || a <= 0) {
       return -1;
     }
     if (a >= (long long)file_size) {
@@ -100,20 +194,19 @@ int parse_range_header(const char *request, off_t file_size, off_t *start,
       *start = file_size - (off_t)a;
     }
     *end = file_size - 1;
-    return 1;
+    return (file_size > 0) ? 1 : -1;
   }
 
-  a = strtoll(range, &parse_end, 10);
-  if (parse_end == range || a < 0 || *parse_end != '-') {
+  if (parse_decimal(&p, limit, &a) < 0 || p == limit || *p != '-') {
     return -1;
   }
+  p++;
 
-  if (parse_end[1] == '\r') {
+  if (p == limit) {
     *start = (off_t)a;
     *end = file_size - 1;
   } else {
-    b = strtoll(parse_end + 1, &parse_end, 10);
-    if (parse_end == NULL || b < a) {
+    if (parse_decimal(&p, limit, &b) < 0 || p != limit || b < a) {
       return -1;
     }
     *start = (off_t)a;
@@ -160,11 +253,12 @@ int hex_value(char c) {
   return -1;
 }
 
-int decode_uri_path(const char *raw_uri, char *decoded, size_t decoded_size) {
+int decode_uri_path(const char *raw_uri, size_t raw_len, char *decoded,
+                    size_t decoded_size) {
   size_t i = 0;
   size_t j = 0;
 
-  while (raw_uri[i] != '\0' && raw_uri[i] != '?' && raw_uri[i] != '#') {
+  while (i < raw_len && raw_uri[i] != '?' && raw_uri[i] != '#') {
     if (j + 1 >= decoded_size) {
       return -1;
     }
@@ -173,7 +267,7 @@ int decode_uri_path(const char *raw_uri, char *decoded, size_t decoded_size) {
       int hi;
       int lo;
 
-      if (raw_uri[i + 1] == '\0' || raw_uri[i + 2] == '\0') {
+      if (i + 2 >= raw_len) {
         return -1;
       }
 
@@ -250,100 +344,131 @@ int build_safe_file_path(const char *decoded_uri, char *filepath,
   return 0;
 }
 
-int send_all(int fd, const void *buf, size_t len) {
-  const char *p = (const char *)buf;
-  size_t sent = 0;
-
-  while (sent < len) {
-    ssize_t n = send(fd, p + sent, len - sent, 0);
-    if (n > 0) {
-      sent += (size_t)n;
-      continue;
-    }
+/*
+ * 发送预先生成的固定响应：直接引用静态字节，不拷贝也不格式化
+ * send_body 为 0（HEAD 请求）时只发送响应头
+ */
+void send_static_response(Connection *conn, StaticResponseId id,
+                          int send_body) {
+  conn->body = static_response(id, conn->keep_alive, send_body,
+                               &conn->body_len);
+  conn->body_pos = 0;
+  conn->status = static_response_status(id);
+}
 
-    if (n < 0 && (errno == EINTR)) {
-      continue;
-    }
-    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-      usleep(1000);
-      continue;
-    }
+/* 提交构建器中的响应头，输出缓冲区不足时放弃该响应并关闭连接 */
+int conn_commit_header(Connection *conn, const ResponseBuilder *rb,
+                       int status) {
+  if (rb->overflow) {
+    log_error("response header too large, fd=%d", conn->fd);
+    conn->keep_alive = 0;
     return -1;
   }
-
+  conn->out_len += rb->len;
+  conn->status = status;
   return 0;
 }
 
+void conn_header_builder(Connection *conn, ResponseBuilder *rb) {
+  response_builder_init(rb, conn->out + conn->out_len,
+                        sizeof(conn->out) - conn->out_len);
+}
+
+void send_range_not_satisfiable(Connection *conn, const char *content_type,
+                                 off_t file_size) {
+  ResponseBuilder rb;
+
+  conn_header_builder(conn, &rb);
+  response_begin(&rb, "416 Range Not Satisfiable", content_type, 0);
+  response_append_lit(&rb, "Content-Range: bytes */");
+  response_append_uint(&rb, (unsigned long long)file_size);
+  response_append_lit(&rb, "\r\n");
+  response_end_headers(&rb, conn->keep_alive);
+  conn_commit_header(conn, &rb, 416);
+}
+
 /*
- * 发送 HTTP 响应
+ * 200 文件响应头中不含 Connection 的前缀，可被文件缓存预先生成并复用，
+ * 发送时再由 response_end_headers 补上 Connection 头
  */
-void send_response_ex(int client_fd, const char *status, const char *content_type,
-                      const char *extra_headers, const char *body, int body_len,
-                      int send_body) {
-  char header[BUFFER_SIZE];
-  int header_len;
-
-  /* 构建 HTTP 响应头 */
-  if (extra_headers && extra_headers[0] != '\0') {
-    header_len = snprintf(header, BUFFER_SIZE,
-                          "HTTP/1.1 %s\r\n"
-                          "Content-Type: %s\r\n"
-                          "Content-Length: %d\r\n"
-                          "%s"
-                          "Connection: close\r\n"
-                          "\r\n",
-                          status, content_type, body_len, extra_headers);
-  } else {
-    header_len = snprintf(header, BUFFER_SIZE,
-                          "HTTP/1.1 %s\r\n"
-                          "Content-Type: %s\r\n"
-                          "Content-Length: %d\r\n"
-                          "Connection: close\r\n"
-                          "\r\n",
-                          status, content_type, body_len);
-  }
+void file_header_prefix(ResponseBuilder *rb, const char *content_type,
+                        off_t file_size) {
+  response_begin(rb, "200 OK", content_type, (unsigned long long)file_size);
+  response_append_lit(rb, "Accept-Ranges: bytes\r\n");
+}
+
+void file_header_partial(ResponseBuilder *rb, const char *content_type,
+                         off_t file_size, off_t range_start, off_t range_end) {
+  response_begin(rb, "206 Partial Content", content_type,
+                 (unsigned long long)(range_end - range_start + 1));
+  response_append_lit(rb, "Content-Range: bytes ");
+  response_append_uint(rb, (unsigned long long)range_start);
+  response_append_lit(rb, "-");
+  response_append_uint(rb, (unsigned long long)range_end);
+  response_append_lit(rb, "/");
+  response_append_uint(rb, (unsigned long long)file_size);
+  response_append_lit(rb, "\r\nAccept-Ranges: bytes\r\n");
+}
 
-  /* 发送响应头 */
-  if (header_len <= 0) {
+/*
+ * 从文件缓存发送：200 响应直接复用预先生成的响应头，不产生文件系统调用
+ * 响应体直接引用缓存内容，由 conn_flush 与响应头一次 sendmsg 发出
+ * 调用方持有的条目引用转交给连接，响应结束时释放
+ */
+void send_cached_file(Connection *conn, FileCacheEntry *entry, int send_body,
+                      const char *range, size_t range_len) {
+  off_t file_size = (off_t)entry->size;
+  off_t range_start = 0;
+  off_t range_end = file_size - 1;
+  int range_result = 0;
+  ResponseBuilder rb;
+
+  range_result =
+      parse_range_header(range, range_len, file_size, &range_start, &range_end);
+  if (range_result < 0) {
+    send_range_not_satisfiable(conn, get_content_type(entry->path), file_size);
+    file_cache_release(entry);
     return;
   }
+  if (range_result != 1) {
+    range_start = 0;
+    range_end = file_size - 1;
+  }
 
-  if (send_all(client_fd, header, (size_t)header_len) < 0) {
-    perror("send header failed");
+  conn_header_builder(conn, &rb);
+  if (range_result == 1) {
+    file_header_partial(&rb, get_content_type(entry->path), file_size,
+                        range_start, range_end);
+  } else {
+    response_append(&rb, entry->header, entry->header_len);
+  }
+  response_end_headers(&rb, conn->keep_alive);
+  if (conn_commit_header(conn, &rb, range_result == 1 ? 206 : 200) < 0) {
+    file_cache_release(entry);
     return;
   }
 
-  /* 发送响应体 */
-  if (send_body && body && body_len > 0) {
-    if (send_all(client_fd, body, (size_t)body_len) < 0) {
-      perror("send body failed");
-    }
+  if (!send_body || file_size == 0) {
+    file_cache_release(entry);
+    return;
   }
-}
-
-void send_response(int client_fd, const char *status, const char *content_type,
-                   const char *body, int body_len) {
-  send_response_ex(client_fd, status, content_type, NULL, body, body_len, 1);
-}
 
-void send_response_head(int client_fd, const char *status,
-                        const char *content_type, int body_len,
-                        const char *extra_headers) {
-  send_response_ex(client_fd, status, content_type, extra_headers, NULL, body_len,
-                   0);
+  conn->body = entry->data + range_start;
+  conn->body_len = (size_t)(range_end - range_start + 1);
+  conn->body_pos = 0;
+  conn->body_ref = entry;
 }
 
 /*
  * 发送文件
+ * 小文件首次访问时读入文件缓存（以 uri 为键），之后从内存发送；
+ * 其余文件走 sendfile
  */
-void send_file(int client_fd, const char *filepath, int send_body,
-               int enable_range, const char *request) {
+void send_file(Connection *conn, const char *uri, const char *filepath,
+               int send_body, const char *range, size_t range_len) {
   int file_fd;
-  char buffer[BUFFER_SIZE];
   struct stat file_stat;
-  char header[BUFFER_SIZE];
-  int header_len;
-  int read_bytes;
+  ResponseBuilder rb;
   const char *content_type;
   off_t range_start = 0;
   off_t range_end = 0;
@@ -355,41 +480,44 @@ void send_file(int client_fd, const char *filepath, int send_body,
   file_fd = open(filepath, O_RDONLY);
   if (file_fd < 0) {
     /* 文件不存在，返回 404 */
-    send_response(client_fd, "404 Not Found", "text/html; charset=utf-8",
-                  "<h1>404 Not Found</h1>", strlen("<h1>404 Not Found</h1>"));
+    send_static_response(conn, RESP_404, 1);
     return;
   }
 
   /* 获取文件大小 */
   if (fstat(file_fd, &file_stat) < 0) {
     close(file_fd);
-    send_response(client_fd, "500 Internal Server Error",
-                  "text/html; charset=utf-8",
-                  "<h1>500 Internal Server Error</h1>",
-                  strlen("<h1>500 Internal Server Error</h1>"));
+    send_static_response(conn, RESP_500, 1);
     return;
   }
 
   content_type = get_content_type(filepath);
 
-  if (enable_range && request != NULL) {
-    range_result = parse_range_header(request, file_stat.st_size, &range_start,
-                                      &range_end);
-    if (range_result < 0) {
-      char range_hdr[128];
-      int hdr_len = snprintf(range_hdr, sizeof(range_hdr),
-                             "Content-Range: bytes */%ld\r\n",
-                             (long)file_stat.st_size);
-      if (hdr_len < 0) {
-        hdr_len = 0;
-      }
-      send_response_head(client_fd, "416 Range Not Satisfiable", content_type, 0,
-                         range_hdr);
+  if (file_cache_accepts(&g_file_cache, &file_stat)) {
+    char prefix[512];
+    FileCacheEntry *entry = NULL;
+
+    response_builder_init(&rb, prefix, sizeof(prefix));
+    file_header_prefix(&rb, content_type, file_stat.st_size);
+    if (!rb.overflow) {
+      entry = file_cache_insert(&g_file_cache, uri, filepath, file_fd,
+                                &file_stat, prefix, rb.len);
+    }
+    if (entry != NULL) {
       close(file_fd);
+      send_cached_file(conn, entry, send_body, range, range_len);
       return;
     }
   }
 
+  range_result = parse_range_header(range, range_len, file_stat.st_size,
+                                    &range_start, &range_end);
+  if (range_result < 0) {
+    send_range_not_satisfiable(conn, content_type, file_stat.st_size);
+    close(file_fd);
+    return;
+  }
+
   if (range_result == 1) {
     is_partial = 1;
     content_len = range_end - range_start + 1;
@@ -399,153 +527,219 @@ void send_file(int client_fd, const char *filepath, int send_body,
     content_len = file_stat.st_size;
   }
 
-  /* 发送响应头 */
+  /* 生成响应头 */
+  conn_header_builder(conn, &rb);
   if (is_partial) {
-    header_len = snprintf(header, BUFFER_SIZE,
-                          "HTTP/1.1 206 Partial Content\r\n"
-                          "Content-Type: %s\r\n"
-                          "Content-Length: %ld\r\n"
-                          "Content-Range: bytes %ld-%ld/%ld\r\n"
-                          "Accept-Ranges: bytes\r\n"
-                          "Connection: close\r\n"
-                          "\r\n",
-                          content_type, (long)content_len, (long)range_start,
-                          (long)range_end, (long)file_stat.st_size);
+    file_header_partial(&rb, content_type, file_stat.st_size, range_start,
+                        range_end);
   } else {
-    header_len = snprintf(header, BUFFER_SIZE,
-                          "HTTP/1.1 200 OK\r\n"
-                          "Content-Type: %s\r\n"
-                          "Content-Length: %ld\r\n"
-                          "Accept-Ranges: bytes\r\n"
-                          "Connection: close\r\n"
-                          "\r\n",
-                          content_type, (long)content_len);
-  }
-
-  if (header_len <= 0 || send_all(client_fd, header, (size_t)header_len) < 0) {
-    perror("send file header failed");
+    file_header_prefix(&rb, content_type, file_stat.st_size);
+  }
+  response_end_headers(&rb, conn->keep_alive);
+  if (conn_commit_header(conn, &rb, is_partial ? 206 : 200) < 0) {
     close(file_fd);
     return;
   }
 
-  if (!send_body) {
+  if (!send_body || content_len == 0) {
     close(file_fd);
     return;
   }
 
-  if (lseek(file_fd, range_start, SEEK_SET) < 0) {
-    perror("lseek file failed");
-    close(file_fd);
+  /* 文件内容交给输出状态机：优先 sendfile 零拷贝，源不支持时回退到拷贝 */
+  conn->file_fd = file_fd;
+  conn->file_offset = range_start;
+  conn->file_remaining = content_len;
+  conn->file_mode = TRANSFER_SENDFILE;
+}
+
+/*
+ * 发送静态文件：先按 uri 查文件缓存，命中时跳过路径解析和 open/fstat
+ * filepath 为 NULL 时在 ./files 下按 uri 做安全路径解析
+ * range 为 Range 头的值，NULL 表示不做范围请求
+ */
+void serve_static(Connection *conn, const char *uri, const char *filepath,
+                  int send_body, const char *range, size_t range_len) {
+  char resolved[512];
+  FileCacheEntry *entry = file_cache_lookup(&g_file_cache, uri);
+  int path_status;
+
+  if (entry != NULL) {
+    send_cached_file(conn, entry, send_body, range, range_len);
     return;
   }
 
-  /* 发送文件内容 */
-  while (content_len > 0 &&
-         (read_bytes = read(file_fd, buffer,
-                            (content_len > BUFFER_SIZE) ? BUFFER_SIZE
-                                                        : (size_t)content_len)) >
-             0) {
-    if (send_all(client_fd, buffer, (size_t)read_bytes) < 0) {
-      perror("send file chunk failed");
-      break;
+  if (filepath == NULL) {
+    path_status = build_safe_file_path(uri, resolved, sizeof(resolved));
+    if (path_status == 403) {
+      send_static_response(conn, RESP_403_PATH, 1);
+      return;
     }
-    content_len -= (off_t)read_bytes;
+    if (path_status == 500) {
+      send_static_response(conn, RESP_500_PATH, 1);
+      return;
+    }
+    if (path_status != 0) {
+      send_static_response(conn, RESP_400_BAD_PATH, 1);
+      return;
+    }
+    filepath = resolved;
   }
 
-  close(file_fd);
+  send_file(conn, uri, filepath, send_body, range, range_len);
+}
+
+/* /metrics 页面：全部计数与直方图，再加上只有 server.c 知道的状态 */
+void render_metrics_page(ResponseBuilder *rb) {
+  uint64_t accepted = metrics_counter_total(METRIC_CONN_ACCEPTED);
+  uint64_t closed = metrics_counter_total(METRIC_CONN_CLOSED);
+
+  metrics_render(rb);
+  /* 两个计数分别汇总，瞬间可能读到关闭数大于接入数 */
+  metrics_render_value(rb, "http_server_connections_active",
+                       "Open client connections.", "gauge",
+                       accepted > closed ? accepted - closed : 0);
+  if (g_pool_enabled) {
+    metrics_render_value(rb, "http_server_task_queue_depth",
+                         "Connections waiting in the thread pool queue.",
+                         "gauge", task_queue_size(&g_pool.tasks));
+  }
+  metrics_render_value(rb, "http_server_log_dropped_total",
+                       "Log records dropped because a log ring was full.",
+                       "counter", log_dropped());
 }
 
 /*
- * 解析 HTTP 请求
+ * Prometheus 文本格式的监控页，响应体写入连接自己的 scratch 缓冲区，
+ * 空间不够时倍增后重新生成
  */
-void handle_request(int client_fd, char *request) {
-  int is_head;
-  char method[16], uri[256], version[16];
-  char decoded_uri[256];
-  char filepath[512];
-  int parsed;
-  int path_status;
+void send_metrics(Connection *conn, int send_body) {
+  ResponseBuilder body;
+  ResponseBuilder rb;
+
+  while (1) {
+    size_t new_cap;
+    char *scratch;
+
+    response_builder_init(&body, conn->scratch, conn->scratch_cap);
+    render_metrics_page(&body);
+    if (!body.overflow) {
+      break;
+    }
+    new_cap = conn->scratch_cap ? conn->scratch_cap * 2 : 16 * 1024;
+    scratch = (char *)realloc(conn->scratch, new_cap);
+    if (scratch == NULL) {
+      send_static_response(conn, RESP_500, 1);
+      return;
+    }
+    conn->scratch = scratch;
+    conn->scratch_cap = new_cap;
+  }
 
-  /* 解析请求行 */
-  parsed = sscanf(request, "%15s %255s %15s", method, uri, version);
-  if (parsed != 3) {
-    send_response(client_fd, "400 Bad Request", "text/plain; charset=utf-8",
-                  "Malformed request line\n",
-                  strlen("Malformed request line\n"));
+  conn_header_builder(conn, &rb);
+  response_begin(&rb, "200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                 body.len);
+  response_end_headers(&rb, conn->keep_alive);
+  if (conn_commit_header(conn, &rb, 200) < 0 || !send_body) {
     return;
   }
+  conn->body = conn->scratch;
+  conn->body_len = body.len;
+  conn->body_pos = 0;
+}
+
+/* 抽样到的请求先记下方法和 URI，响应发完时补齐其余字段再提交 */
+void conn_sample_request(Connection *conn, const char *uri) {
+  const HttpRequest *req = &conn->req;
+  size_t method_len = req->method.len;
+
+  conn->log_sampled = access_log_sampled();
+  if (!conn->log_sampled) {
+    return;
+  }
+  if (method_len >= sizeof(conn->log_rec.method)) {
+    method_len = sizeof(conn->log_rec.method) - 1;
+  }
+  memcpy(conn->log_rec.method, conn->buffer + req->method.off, method_len);
+  conn->log_rec.method[method_len] = '\0';
+  strncpy(conn->log_rec.uri, uri, sizeof(conn->log_rec.uri) - 1);
+  conn->log_rec.uri[sizeof(conn->log_rec.uri) - 1] = '\0';
+}
+
+/*
+ * 处理一个已解析完成的请求（conn->req 中的偏移指向 conn->buffer）
+ * 调用方在 conn->keep_alive 中给出是否允许复用连接（例如未达到请求数上限），
+ * 这里再结合请求版本与 Connection 头决定最终的连接语义
+ */
+void handle_request(Connection *conn) {
+  const HttpRequest *req = &conn->req;
+  const char *buf = conn->buffer;
+  const HttpHeader *range_header;
+  const char *range = NULL;
+  size_t range_len = 0;
+  char decoded_uri[256];
+  int is_head;
+
+  conn->keep_alive = conn->keep_alive && request_wants_keep_alive(req, buf);
 
-  if (decode_uri_path(uri, decoded_uri, sizeof(decoded_uri)) < 0) {
-    send_response(client_fd, "400 Bad Request", "text/plain; charset=utf-8",
-                  "Invalid URI encoding\n",
-                  strlen("Invalid URI encoding\n"));
+  if (decode_uri_path(buf + req->uri.off, req->uri.len, decoded_uri,
+                      sizeof(decoded_uri)) < 0) {
+    send_static_response(conn, RESP_400_BAD_ENCODING, 1);
     return;
   }
 
-  printf("Request: %s %s %s\n", method, decoded_uri, version);
+  conn_sample_request(conn, decoded_uri);
+  log_debug("Request fd=%d: %.*s %s", conn->fd, (int)req->method.len,
+            buf + req->method.off, decoded_uri);
 
-  is_head = (strcmp(method, "HEAD") == 0);
+  is_head = http_span_eq(buf, req->method, "HEAD");
 
   /* 处理 GET/HEAD 方法 */
-  if (strcmp(method, "GET") != 0 && !is_head) {
-    send_response(client_fd, "405 Method Not Allowed",
-                  "text/html; charset=utf-8", "<h1>405 Method Not Allowed</h1>",
-                  strlen("<h1>405 Method Not Allowed</h1>"));
+  if (!http_span_eq(buf, req->method, "GET") && !is_head) {
+    /* 不解析请求体，无法确定下一个请求的起点，只能关闭连接 */
+    conn->keep_alive = 0;
+    send_static_response(conn, RESP_405, 1);
     return;
   }
 
+  range_header = http_find_header(req, buf, "Range");
+  if (range_header != NULL) {
+    range = buf + range_header->value.off;
+    range_len = range_header->value.len;
+  }
+
   /* 处理根路径 */
   if (strcmp(decoded_uri, "/") == 0) {
-    send_file(client_fd, "./files/html/default.html", !is_head, 0, request);
+    serve_static(conn, decoded_uri, "./files/html/default.html", !is_head,
+                 NULL, 0);
     return;
   }
 
   if (strcmp(decoded_uri, "/hello") == 0) {
-    const char *text =
-        "Hello from C HTTP Server!\n"
-        "Try: /image and /video\n";
-    if (is_head) {
-      send_response_head(client_fd, "200 OK", "text/plain; charset=utf-8",
-                         strlen(text), NULL);
-    } else {
-      send_response(client_fd, "200 OK", "text/plain; charset=utf-8", text,
-                    strlen(text));
-    }
+    send_static_response(conn, RESP_HELLO, !is_head);
     return;
   }
 
-  if (strcmp(decoded_uri, "/image") == 0) {
-    send_file(client_fd, "./files/image/阿能.jpg", !is_head, 0, request);
+  if (strcmp(decoded_uri, "/metrics") == 0) {
+    send_metrics(conn, !is_head);
     return;
   }
 
-  if (strcmp(decoded_uri, "/video") == 0) {
-    send_file(client_fd,
-              "./files/video/video_写出这样的重定位算法可以找到工作..._0.mp4",
-              !is_head, 1, request);
+  if (strcmp(decoded_uri, "/image") == 0) {
+    serve_static(conn, decoded_uri, "./files/image/阿能.jpg", !is_head, range,
+                 range_len);
     return;
   }
 
-  path_status = build_safe_file_path(decoded_uri, filepath, sizeof(filepath));
-  if (path_status == 403) {
-    send_response(client_fd, "403 Forbidden", "text/plain; charset=utf-8",
-                  "Forbidden path\n", strlen("Forbidden path\n"));
-    return;
-  }
-  if (path_status == 500) {
-    send_response(client_fd, "500 Internal Server Error",
-                  "text/plain; charset=utf-8", "Path resolution failed\n",
-                  strlen("Path resolution failed\n"));
-    return;
-  }
-  if (path_status != 0) {
-    send_response(client_fd, "400 Bad Request", "text/plain; charset=utf-8",
-                  "Invalid path\n", strlen("Invalid path\n"));
+  if (strcmp(decoded_uri, "/video") == 0) {
+    serve_static(conn, decoded_uri,
+                 "./files/video/video_写出这样的重定位算法可以找到工作..._0.mp4",
+                 !is_head, range, range_len);
     return;
   }
 
   /* 发送文件 */
-  send_file(client_fd, filepath, !is_head, 0, request);
+  serve_static(conn, decoded_uri, NULL, !is_head, range, range_len);
 }
 
 int setnonblocking(int sockfd) {
@@ -562,7 +756,7 @@ int setnonblocking(int sockfd) {
 void removefd(int epoll_fd, int fd) {
   if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
     if (errno != EBADF && errno != ENOENT) {
-      perror("epoll_ctl del fd failed!");
+      log_error("epoll_ctl del fd failed: %m");
     }
   }
 }
@@ -573,28 +767,479 @@ void close_client_fd(int fd) {
   }
 }
 
-void process_client_connection(int fd) {
-  char buffer[BUFFER_SIZE];
-  int total = 0;
+/* 为新接入的 fd 重置连接状态，接收缓冲区沿用上一个连接留下的 */
+void conn_init(Connection *conn, int fd) {
+  conn->fd = fd;
+  conn->keep_alive = 1;
+  conn->requests = 0;
+  conn->len = 0;
+  http_request_reset(&conn->req);
+  conn->out_len = 0;
+  conn->out_pos = 0;
+  conn->body = NULL;
+  conn->body_len = 0;
+  conn->body_pos = 0;
+  conn->body_ref = NULL;
+  conn->file_fd = -1;
+  conn->file_remaining = 0;
+  timer_node_init(&conn->timer);
+  conn->req_start_us = metrics_now_us();
+  conn->first_byte_us = 0;
+  conn->resp_bytes = 0;
+  conn->status = 0;
+  conn->log_sampled = 0;
+}
+
+/* 从当前块中分出一个连接对象，块用完时再申请一块 */
+Connection *conn_slab_alloc(Reactor *reactor) {
+  Connection *conn;
+
+  if (reactor->slabs == NULL || reactor->slab_used == CONN_SLAB_SIZE) {
+    ConnSlab *slab = (ConnSlab *)calloc(1, sizeof(ConnSlab));
+    if (slab == NULL) {
+      return NULL;
+    }
+    slab->next = reactor->slabs;
+    reactor->slabs = slab;
+    reactor->slab_used = 0;
+  }
+
+  conn = &reactor->slabs->conns[reactor->slab_used];
+  if (pthread_mutex_init(&conn->mutex, NULL) != 0) {
+    return NULL;
+  }
+  conn->buffer = reactor->slabs->buffers[reactor->slab_used];
+  conn->cap = BUFFER_SIZE;
+  conn->buffer_heap = 0;
+  reactor->slab_used++;
+  return conn;
+}
+
+/*
+ * 为新接入的 fd 准备连接对象（仅所属 reactor 线程调用）
+ * 对象按 fd 下标复用，fd 超出表范围时返回 NULL
+ */
+Connection *conn_open(Reactor *reactor, int fd) {
+  Connection *conn;
+
+  if (fd < 0 || fd >= MAX_CONNECTIONS) {
+    return NULL;
+  }
+
+  conn = reactor->conns[fd];
+  if (conn == NULL) {
+    conn = conn_slab_alloc(reactor);
+    if (conn == NULL) {
+      return NULL;
+    }
+    reactor->conns[fd] = conn;
+  }
+
+  pthread_mutex_lock(&conn->mutex);
+  conn_init(conn, fd);
+  conn->state = CONN_IDLE;
+  conn->reactor = reactor;
+  conn->events = 0;
+  conn->rx_drained = 1;
+  pthread_mutex_unlock(&conn->mutex);
+  return conn;
+}
+
+/*
+ * 接收缓冲区倍增，不超过 MAX_REQUEST_SIZE
+ * 解析状态只保存偏移，realloc 后无需调整
+ */
+int conn_grow_buffer(Connection *conn) {
+  int new_cap = conn->cap * 2;
+  char *buffer;
+
+  if (conn->cap >= MAX_REQUEST_SIZE) {
+    return -1;
+  }
+  if (new_cap > MAX_REQUEST_SIZE) {
+    new_cap = MAX_REQUEST_SIZE;
+  }
+  if (conn->buffer_heap) {
+    buffer = (char *)realloc(conn->buffer, (size_t)new_cap);
+  } else {
+    /* 块内的初始缓冲区不能 realloc，第一次扩容时搬到堆上 */
+    buffer = (char *)malloc((size_t)new_cap);
+    if (buffer != NULL) {
+      memcpy(buffer, conn->buffer, (size_t)conn->len);
+    }
+  }
+  if (buffer == NULL) {
+    return -1;
+  }
+  conn->buffer = buffer;
+  conn->buffer_heap = 1;
+  conn->cap = new_cap;
+  return 0;
+}
+
+/* 结束当前响应：清空输出缓冲区，释放缓存条目并关闭响应体文件 */
+void conn_reset_output(Connection *conn) {
+  conn->out_len = 0;
+  conn->out_pos = 0;
+  if (conn->body_ref != NULL) {
+    file_cache_release(conn->body_ref);
+    conn->body_ref = NULL;
+  }
+  conn->body = NULL;
+  conn->body_len = 0;
+  conn->body_pos = 0;
+  if (conn->file_fd >= 0) {
+    close(conn->file_fd);
+    conn->file_fd = -1;
+  }
+  conn->file_remaining = 0;
+}
+
+uint64_t conn_deadline_ms(const Connection *conn, int writing,
+                          uint64_t now_ms) {
+  if (writing) {
+    return now_ms + SEND_TIMEOUT_SEC * 1000;
+  }
+  /* 请求头分多次慢慢发送（slowloris）不会推迟截止时刻 */
+  if (conn->req_start_us != 0) {
+    return conn->req_start_us / 1000 + HEADER_TIMEOUT_SEC * 1000;
+  }
+  if (conn->len > 0) {
+    return now_ms + HEADER_TIMEOUT_SEC * 1000;
+  }
+  return now_ms + KEEPALIVE_TIMEOUT_SEC * 1000;
+}
+
+void reactor_timer_lock(Reactor *reactor) {
+  if (reactor->use_pool) {
+    pthread_mutex_lock(&reactor->timer_mutex);
+  }
+}
+
+void reactor_timer_unlock(Reactor *reactor) {
+  if (reactor->use_pool) {
+    pthread_mutex_unlock(&reactor->timer_mutex);
+  }
+}
+
+/* 按连接即将进入的状态设置超时，调用方需持有 conn->mutex */
+void conn_schedule_timeout(Connection *conn, int state) {
+  Reactor *reactor = conn->reactor;
+  uint64_t deadline = conn_deadline_ms(conn, state == CONN_WRITING,
+                                       metrics_now_us() / 1000);
+
+  reactor_timer_lock(reactor);
+  timer_schedule(&reactor->timers, &conn->timer, deadline);
+  reactor_timer_unlock(reactor);
+}
+
+/* 关闭连接，调用方需持有 conn->mutex，且连接已不在时间轮上 */
+void conn_teardown_locked(Connection *conn) {
+  log_debug("Client fd=%d closed after %d requests", conn->fd, conn->requests);
+  removefd(conn->reactor->epoll_fd, conn->fd);
+  close_client_fd(conn->fd);
+  conn_reset_output(conn);
+  conn->state = CONN_CLOSED;
+  conn->events = 0;
+  conn->len = 0;
+  http_request_reset(&conn->req);
+  conn->status = 0;
+  metrics_add(METRIC_CONN_CLOSED, 1);
+}
+
+/* 关闭连接，调用方需持有 conn->mutex */
+void conn_close_locked(Connection *conn) {
+  Reactor *reactor = conn->reactor;
+
+  reactor_timer_lock(reactor);
+  timer_cancel(&reactor->timers, &conn->timer);
+  reactor_timer_unlock(reactor);
+  conn_teardown_locked(conn);
+}
+
+/*
+ * 把连接挂回 epoll
+ * - 线程池模式使用 EPOLLONESHOT，每次都需要 EPOLL_CTL_MOD 重新激活
+ * - 多 reactor 模式不用 ONESHOT，关注事件未变且输入已读尽时省掉这次系统调用
+ *   （未读尽时 MOD 会让内核重新检查就绪状态，避免边沿触发丢事件）
+ * 等待可写时不关注 EPOLLRDHUP，否则对端半关闭后会反复唤醒
+ * 同时按新状态重设超时
+ */
+int conn_wait(Connection *conn, int state) {
+  struct epoll_event ev;
+  uint32_t events;
+
+  conn->state = state;
+  conn_schedule_timeout(conn, state);
+  if (state == CONN_WRITING) {
+    events = EPOLLOUT | EPOLLET;
+  } else {
+    events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+  }
+
+  if (conn->reactor->use_pool) {
+    events |= EPOLLONESHOT;
+  } else if (events == conn->events &&
+             (state == CONN_WRITING || conn->rx_drained)) {
+    return 0;
+  }
+
+  ev.events = events;
+  ev.data.ptr = conn;
+  if (epoll_ctl(conn->reactor->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+    return -1;
+  }
+  conn->events = events;
+  return 0;
+}
+
+/* 当前是否有未发完的响应 */
+int conn_has_output(const Connection *conn) {
+  return conn->out_pos < conn->out_len || conn->body_pos < conn->body_len ||
+         conn->file_fd >= 0;
+}
+
+/* 记录本次发送推进的字节数，第一次有进度时记下首字节时间 */
+void conn_note_sent(Connection *conn, uint64_t sent) {
+  if (sent == 0) {
+    return;
+  }
+  if (conn->first_byte_us == 0) {
+    conn->first_byte_us = metrics_now_us();
+  }
+  conn->resp_bytes += sent;
+  metrics_add(METRIC_BYTES_SENT, sent);
+}
+
+/* 响应发完：写入计数与延迟直方图，抽样到的请求提交访问日志 */
+void conn_finish_response(Connection *conn) {
+  uint64_t now;
+
+  if (conn->status == 0) {
+    return;
+  }
+  now = metrics_now_us();
+  if (conn->first_byte_us == 0) {
+    conn->first_byte_us = now;
+  }
+  metrics_add(METRIC_REQUESTS, 1);
+  metrics_count_status(conn->status);
+  if (conn->req_start_us != 0 && conn->first_byte_us >= conn->req_start_us) {
+    metrics_observe(METRIC_HIST_FIRST_BYTE,
+                    conn->first_byte_us - conn->req_start_us);
+  }
+  metrics_observe(METRIC_HIST_TRANSFER, now - conn->first_byte_us);
+
+  if (conn->log_sampled) {
+    AccessLogRecord *rec = &conn->log_rec;
+
+    rec->status = conn->status;
+    rec->bytes = conn->resp_bytes;
+    rec->first_byte_us = conn->req_start_us != 0
+                             ? conn->first_byte_us - conn->req_start_us
+                             : 0;
+    rec->total_us = conn->req_start_us != 0 ? now - conn->req_start_us : 0;
+    access_log_write(rec);
+    conn->log_sampled = 0;
+  }
+
+  conn->status = 0;
+  conn->req_start_us = 0;
+  conn->first_byte_us = 0;
+  conn->resp_bytes = 0;
+}
+
+/*
+ * 推进当前响应的发送：先发输出缓冲区和缓存响应体（一次 sendmsg），
+ * 再发文件响应体
+ * 返回 TRANSFER_DONE / TRANSFER_AGAIN / TRANSFER_ERROR
+ */
+int conn_flush(Connection *conn) {
+  int ret;
+
+  if (conn->out_pos < conn->out_len || conn->body_pos < conn->body_len) {
+    size_t before = conn->out_pos + conn->body_pos;
+
+    /* 后面还有 sendfile 响应体时带 MSG_MORE，让响应头与文件首段合并成满包 */
+    ret = transfer_send_buffers(conn->fd, conn->out, conn->out_len,
+                                &conn->out_pos, conn->body, conn->body_len,
+                                &conn->body_pos,
+                                conn->file_fd >= 0 ? MSG_MORE : 0);
+    conn_note_sent(conn, conn->out_pos + conn->body_pos - before);
+    if (ret != TRANSFER_DONE) {
+      return ret;
+    }
+  }
+
+  if (conn->file_fd >= 0 && conn->file_remaining > 0) {
+    off_t before = conn->file_remaining;
+
+    ret = transfer_send_file(conn->fd, conn->file_fd, &conn->file_offset,
+                             &conn->file_remaining, &conn->file_mode);
+    conn_note_sent(conn, (uint64_t)(before - conn->file_remaining));
+    if (ret != TRANSFER_DONE) {
+      return ret;
+    }
+  }
+
+  conn_reset_output(conn);
+  conn_finish_response(conn);
+  return TRANSFER_DONE;
+}
+
+/*
+ * 时间轮到期回调（reactor 线程，持有 timer_mutex）：
+ * 等待请求或等待可写的连接超过截止时刻，直接关闭
+ * 正在被工作线程处理的连接持有 mutex 或处于 BUSY，跳过即可，
+ * 工作线程挂回 epoll 时会重新设置超时
+ */
+void conn_on_timeout(TimerWheel *wheel, TimerNode *node, void *arg) {
+  Connection *conn =
+      (Connection *)((char *)node - offsetof(Connection, timer));
+
+  (void)wheel;
+  (void)arg;
+  if (pthread_mutex_trylock(&conn->mutex) != 0) {
+    return;
+  }
+  if (conn->state == CONN_IDLE || conn->state == CONN_WRITING) {
+    log_debug("Client fd=%d timed out (%s)", conn->fd,
+              conn->state == CONN_WRITING ? "send" : "idle");
+    metrics_add(METRIC_CONN_TIMEOUTS, 1);
+    conn_teardown_locked(conn);
+  }
+  pthread_mutex_unlock(&conn->mutex);
+}
+
+/* 推进时间轮并返回下一次 epoll_wait 的超时 */
+int reactor_expire_timers(Reactor *reactor) {
+  uint64_t now = metrics_now_us() / 1000;
+  int timeout;
+
+  reactor_timer_lock(reactor);
+  timer_wheel_advance(&reactor->timers, now, conn_on_timeout, NULL);
+  timeout = timer_wheel_timeout_ms(&reactor->timers, now);
+  reactor_timer_unlock(reactor);
+
+  /* 线程池模式下工作线程随时会加入新的超时，等待时间不能无限长 */
+  if (reactor->use_pool &&
+      (timeout < 0 || timeout > EPOLL_WAIT_TIMEOUT_MS)) {
+    timeout = EPOLL_WAIT_TIMEOUT_MS;
+  }
+  return timeout;
+}
+
+/*
+ * 发送当前响应并决定连接去向
+ * 返回 1 表示可以继续处理下一个请求，0 表示连接已挂回 epoll 等待可写
+ * 或已关闭，调用方应直接返回
+ */
+int conn_send_response(Connection *conn) {
+  int ret = conn_flush(conn);
+
+  if (ret == TRANSFER_AGAIN) {
+    if (conn_wait(conn, CONN_WRITING) < 0) {
+      log_error("epoll_ctl mod client_fd fail: %m");
+      conn_close_locked(conn);
+    }
+    return 0;
+  }
+
+  if (ret == TRANSFER_ERROR) {
+    log_warn("send response failed: %m");
+    conn_close_locked(conn);
+    return 0;
+  }
+
+  if (!conn->keep_alive) {
+    conn_close_locked(conn);
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * 从接收缓冲区开头取出一个完整请求并生成响应：
+ * 无法确定请求边界时回复 400，缓冲区已到上限仍不完整时回复 431，
+ * 两者都取消 keep-alive，剩余数据丢弃
+ */
+int conn_next_request(Connection *conn) {
+  int status = http_parse_request(&conn->req, conn->buffer, (size_t)conn->len);
+  int req_len;
+
+  if (status == HTTP_PARSE_INCOMPLETE && conn->len < MAX_REQUEST_SIZE) {
+    return 0;
+  }
+
+  if (status != HTTP_PARSE_COMPLETE) {
+    conn->keep_alive = 0;
+    send_static_response(conn,
+                         status == HTTP_PARSE_ERROR ? RESP_400_MALFORMED
+                                                    : RESP_431,
+                         1);
+    metrics_add(METRIC_BAD_REQUESTS, 1);
+    conn->len = 0;
+    http_request_reset(&conn->req);
+    return 1;
+  }
+
+  req_len = (int)conn->req.head_len;
+  conn->requests++;
+  conn->keep_alive = conn->requests < KEEPALIVE_MAX_REQUESTS;
+  /* 流水线中后续请求的数据早已收到，从开始处理时计时 */
+  if (conn->req_start_us == 0) {
+    conn->req_start_us = metrics_now_us();
+  }
+  handle_request(conn);
+
+  memmove(conn->buffer, conn->buffer + req_len, (size_t)(conn->len - req_len));
+  conn->len -= req_len;
+  http_request_reset(&conn->req);
+  return 1;
+}
+
+/*
+ * 处理一次就绪事件：
+ * 1. 若上一个响应未发完（EPOLLOUT 唤醒），先续传
+ * 2. 读尽 socket 数据后依次处理缓冲区中所有完整请求（支持流水线），
+ *    每个响应发完才处理下一个，残留的半个请求保留到下次可读事件
+ */
+void process_client_connection(Connection *conn) {
+  int fd = conn->fd;
+  int peer_closed = 0;
+
+  pthread_mutex_lock(&conn->mutex);
+
+  if (conn_has_output(conn)) {
+    if (!conn_send_response(conn)) {
+      pthread_mutex_unlock(&conn->mutex);
+      return;
+    }
+  }
 
-  memset(buffer, 0, sizeof(buffer));
+  conn->rx_drained = 0;
+  while (1) {
+    int ret;
+
+    /* 缓冲区满时倍增，已到上限则先处理已收到的数据 */
+    if (conn->len == conn->cap && conn_grow_buffer(conn) < 0) {
+      break;
+    }
 
-  while (total < BUFFER_SIZE - 1) {
-    int ret = recv(fd, buffer + total, BUFFER_SIZE - 1 - total, 0);
+    ret = recv(fd, conn->buffer + conn->len, (size_t)(conn->cap - conn->len), 0);
 
     if (ret > 0) {
-      total += ret;
-      buffer[total] = '\0';
-      if (strstr(buffer, "\r\n\r\n") != NULL) {
-        break;
+      if (conn->req_start_us == 0) {
+        conn->req_start_us = metrics_now_us();
       }
+      conn->len += ret;
       continue;
     }
 
     if (ret == 0) {
-      printf("Client=%d disconnected and closed\n", fd);
-      close_client_fd(fd);
-      return;
+      peer_closed = 1;
+      break;
     }
 
     if (errno == EINTR) {
@@ -602,81 +1247,79 @@ void process_client_connection(int fd) {
     }
 
     if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      conn->rx_drained = 1;
       break;
     }
 
-    perror("recv fail");
-    printf("Client=%d error, closed\n", fd);
-    close_client_fd(fd);
+    log_warn("recv fail: %m");
+    conn_close_locked(conn);
+    pthread_mutex_unlock(&conn->mutex);
     return;
   }
 
-  if (total <= 0 || strstr(buffer, "\r\n\r\n") == NULL) {
-    send_response(fd, "400 Bad Request", "text/plain; charset=utf-8",
-                  "Incomplete HTTP request\n",
-                  strlen("Incomplete HTTP request\n"));
-    printf("Client=%d bad request, closed\n", fd);
-    close_client_fd(fd);
-    return;
+  while (conn_next_request(conn)) {
+    if (!conn_send_response(conn)) {
+      pthread_mutex_unlock(&conn->mutex);
+      return;
+    }
   }
 
-  printf("Received request from client fd=%d %s len=%d\n", fd, buffer, total);
-  handle_request(fd, buffer);
-  close_client_fd(fd);
-  printf("Client=%d response sent and closed\n", fd);
-}
-
-int thread_pool_submit(ThreadPool *pool, int client_fd) {
-  pthread_mutex_lock(&pool->mutex);
-  while (!pool->stop && pool->count == TASK_QUEUE_SIZE) {
-    pthread_cond_wait(&pool->not_full, &pool->mutex);
+  if (peer_closed) {
+    conn_close_locked(conn);
+    pthread_mutex_unlock(&conn->mutex);
+    return;
   }
 
-  if (pool->stop) {
-    pthread_mutex_unlock(&pool->mutex);
-    return -1;
+  if (conn_wait(conn, CONN_IDLE) < 0) {
+    log_error("epoll_ctl mod client_fd fail: %m");
+    conn_close_locked(conn);
   }
-
-  pool->queue[pool->tail] = client_fd;
-  pool->tail = (pool->tail + 1) % TASK_QUEUE_SIZE;
-  pool->count++;
-
-  pthread_cond_signal(&pool->not_empty);
-  pthread_mutex_unlock(&pool->mutex);
-  return 0;
+  pthread_mutex_unlock(&conn->mutex);
 }
 
-int thread_pool_take(ThreadPool *pool) {
-  int client_fd;
+/*
+ * reactor 线程把就绪连接标记为 BUSY 后交给处理方：
+ * 线程池模式投递到任务队列，多 reactor 模式直接在本线程处理
+ * 连接对象不释放，同一批事件中已关闭（或已被新连接复用）的对象由状态检查过滤
+ */
+void conn_dispatch(Reactor *reactor, Connection *conn) {
+  pthread_mutex_lock(&conn->mutex);
+  if (conn->state != CONN_IDLE && conn->state != CONN_WRITING) {
+    pthread_mutex_unlock(&conn->mutex);
+    return;
+  }
+  conn->state = CONN_BUSY;
+  pthread_mutex_unlock(&conn->mutex);
 
-  pthread_mutex_lock(&pool->mutex);
-  while (!pool->stop && pool->count == 0) {
-    pthread_cond_wait(&pool->not_empty, &pool->mutex);
+  if (!reactor->use_pool) {
+    process_client_connection(conn);
+    return;
   }
 
-  if (pool->stop && pool->count == 0) {
-    pthread_mutex_unlock(&pool->mutex);
-    return -1;
+  if (thread_pool_submit(&g_pool, conn) != 0) {
+    pthread_mutex_lock(&conn->mutex);
+    conn_close_locked(conn);
+    pthread_mutex_unlock(&conn->mutex);
   }
+}
 
-  client_fd = pool->queue[pool->head];
-  pool->head = (pool->head + 1) % TASK_QUEUE_SIZE;
-  pool->count--;
+int thread_pool_submit(ThreadPool *pool, Connection *conn) {
+  return task_queue_push(&pool->tasks, conn);
+}
 
-  pthread_cond_signal(&pool->not_full);
-  pthread_mutex_unlock(&pool->mutex);
-  return client_fd;
+Connection *thread_pool_take(ThreadPool *pool) {
+  return (Connection *)task_queue_pop(&pool->tasks);
 }
 
 void *worker_routine(void *arg) {
   ThreadPool *pool = (ThreadPool *)arg;
 
   while (1) {
-    int client_fd = thread_pool_take(pool);
-    if (client_fd < 0) {
+    Connection *conn = thread_pool_take(pool);
+    if (conn == NULL) {
       break;
     }
-    process_client_connection(client_fd);
+    process_client_connection(conn);
   }
 
   return NULL;
@@ -686,30 +1329,17 @@ int thread_pool_init(ThreadPool *pool) {
   int i;
 
   memset(pool, 0, sizeof(*pool));
-  if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
-    return -1;
-  }
-  if (pthread_cond_init(&pool->not_empty, NULL) != 0) {
-    pthread_mutex_destroy(&pool->mutex);
-    return -1;
-  }
-  if (pthread_cond_init(&pool->not_full, NULL) != 0) {
-    pthread_cond_destroy(&pool->not_empty);
-    pthread_mutex_destroy(&pool->mutex);
+  if (task_queue_init(&pool->tasks, TASK_QUEUE_SIZE) != 0) {
     return -1;
   }
 
   for (i = 0; i < THREAD_POOL_SIZE; i++) {
     if (pthread_create(&pool->workers[i], NULL, worker_routine, pool) != 0) {
-      pool->stop = 1;
-      pthread_cond_broadcast(&pool->not_empty);
-      pthread_cond_broadcast(&pool->not_full);
+      task_queue_stop(&pool->tasks);
       while (i-- > 0) {
         pthread_join(pool->workers[i], NULL);
       }
-      pthread_cond_destroy(&pool->not_full);
-      pthread_cond_destroy(&pool->not_empty);
-      pthread_mutex_destroy(&pool->mutex);
+      task_queue_destroy(&pool->tasks);
       return -1;
     }
   }
@@ -720,53 +1350,36 @@ int thread_pool_init(ThreadPool *pool) {
 void thread_pool_destroy(ThreadPool *pool) {
   int i;
 
-  pthread_mutex_lock(&pool->mutex);
-  pool->stop = 1;
-  pthread_cond_broadcast(&pool->not_empty);
-  pthread_cond_broadcast(&pool->not_full);
-  pthread_mutex_unlock(&pool->mutex);
-
+  task_queue_stop(&pool->tasks);
   for (i = 0; i < THREAD_POOL_SIZE; i++) {
     pthread_join(pool->workers[i], NULL);
   }
-
-  pthread_cond_destroy(&pool->not_full);
-  pthread_cond_destroy(&pool->not_empty);
-  pthread_mutex_destroy(&pool->mutex);
+  task_queue_destroy(&pool->tasks);
 }
 
-int main() {
-  int server_fd, client_fd;
-  struct sockaddr_in server_addr, client_addr;
-  socklen_t client_len;
-  int ret;
-
-  int epoll_fd = epoll_create(MAX_CLIENTS);
-  if (epoll_fd < 0) {
-    fprintf(stderr, "Failed to create epoll file descriptor\n");
-    return -1;
-  }
-  printf("Epoll fd: %d\n", epoll_fd);
-
-  if (thread_pool_init(&g_pool) != 0) {
-    fprintf(stderr, "Failed to initialize thread pool\n");
-    close(epoll_fd);
-    return -1;
-  }
-  printf("Thread pool initialized with %d workers\n", THREAD_POOL_SIZE);
-
-  /* 创建 TCP 套接字 */
+/*
+ * 创建非阻塞监听 socket
+ * reuseport 为 1 时设置 SO_REUSEPORT，多个 reactor 各自绑定同一端口
+ */
+int create_listen_socket(int reuseport) {
+  struct sockaddr_in server_addr;
+  int server_fd;
+  int opt = 1;
 
   server_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
   if (server_fd < 0) {
-    perror("socket fail");
-    close(epoll_fd);
+    log_error("socket fail: %m");
     return -1;
   }
 
   /* 设置端口复用 */
-  int opt = 1;
   setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  if (reuseport &&
+      setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+    log_error("setsockopt SO_REUSEPORT fail: %m");
+    close(server_fd);
+    return -1;
+  }
 
   setnonblocking(server_fd);
 
@@ -776,96 +1389,354 @@ int main() {
   server_addr.sin_port = htons(HTTP_PORT);
   server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-  ret = bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
-  if (ret < 0) {
-    perror("bind fail");
+  if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
+      0) {
+    log_error("bind fail: %m");
     close(server_fd);
-    close(epoll_fd);
     return -1;
   }
 
-  printf("bind successfully!\n");
-
   /* 开始监听 */
-  ret = listen(server_fd, 10);
-  if (ret < 0) {
-    perror("listen fail");
+  if (listen(server_fd, LISTEN_BACKLOG) < 0) {
+    log_error("listen fail: %m");
     close(server_fd);
     return -1;
   }
 
+  return server_fd;
+}
+
+/*
+ * 初始化 reactor：连接表、epoll 实例与监听 socket
+ * 失败时释放已申请的资源并返回 -1
+ */
+int reactor_init(Reactor *reactor, int id, int use_pool, int reuseport,
+                 int cpu) {
   struct epoll_event ev;
-  ev.events = EPOLLIN | EPOLLET;
-  ev.data.fd = server_fd;
 
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
-    perror("epoll_ctl add server_fd fail!");
-    close(server_fd);
-    close(epoll_fd);
+  memset(reactor, 0, sizeof(*reactor));
+  reactor->id = id;
+  reactor->cpu = cpu;
+  reactor->use_pool = use_pool;
+  reactor->listen_fd = -1;
+
+  reactor->conns = (Connection **)calloc(MAX_CONNECTIONS, sizeof(Connection *));
+  if (reactor->conns == NULL) {
     return -1;
   }
+  timer_wheel_init(&reactor->timers, metrics_now_us() / 1000,
+                   CONN_TIMER_TICK_MS);
+  pthread_mutex_init(&reactor->timer_mutex, NULL);
 
-  printf("server_fd added to epoll_fd successfully!");
+  reactor->epoll_fd = epoll_create(MAX_CLIENTS);
+  if (reactor->epoll_fd < 0) {
+    log_error("Failed to create epoll file descriptor");
+    free(reactor->conns);
+    return -1;
+  }
 
-  struct epoll_event events[MAX_CLIENTS];
+  reactor->listen_fd = create_listen_socket(reuseport);
+  if (reactor->listen_fd < 0) {
+    close(reactor->epoll_fd);
+    free(reactor->conns);
+    return -1;
+  }
+
+  /* 监听 socket 的 data.ptr 为 NULL，连接的 data.ptr 指向连接对象 */
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->listen_fd, &ev) <
+      0) {
+    log_error("epoll_ctl add server_fd fail: %m");
+    close(reactor->listen_fd);
+    close(reactor->epoll_fd);
+    free(reactor->conns);
+    return -1;
+  }
 
-  printf("HTTP Server listening on port %d...\n", HTTP_PORT);
-  printf("Open browser: http://127.0.0.1:%d\n", HTTP_PORT);
+  log_info("Reactor %d: epoll fd=%d, listen fd=%d", id, reactor->epoll_fd,
+           reactor->listen_fd);
+  return 0;
+}
+
+/* 接收监听 socket 上所有待处理的新连接（ET 模式需要一次取完） */
+void reactor_accept(Reactor *reactor) {
+  struct sockaddr_in client_addr;
+  socklen_t client_len;
+  struct epoll_event ev;
+  Connection *conn;
+  int client_fd;
 
   while (1) {
-    int nfds = epoll_wait(epoll_fd, events, MAX_CLIENTS, -1);
+    client_len = sizeof(client_addr);
+    client_fd = accept(reactor->listen_fd, (struct sockaddr *)&client_addr,
+                       &client_len);
+    if (client_fd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        /* ET + nonblocking: no more pending connections in this round */
+        break;
+      } else {
+        log_warn("accept fail: %m");
+        break;
+      }
+    }
+
+    if (setnonblocking(client_fd) < 0) {
+      log_error("setnonblocking client_fd fail: %m");
+      close(client_fd);
+      continue;
+    }
+
+    conn = conn_open(reactor, client_fd);
+    if (conn == NULL) {
+      log_warn("Too many connections, fd=%d rejected", client_fd);
+      close(client_fd);
+      continue;
+    }
+
+    ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+    if (reactor->use_pool) {
+      ev.events |= EPOLLONESHOT;
+    }
+    ev.data.ptr = conn;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+      log_error("epoll_ctl add client_fd fail: %m");
+      conn->state = CONN_CLOSED;
+      close(client_fd);
+      continue;
+    }
+    conn->events = ev.events;
+    /* 新连接在 HEADER_TIMEOUT_SEC 内必须发来完整的请求头 */
+    conn_schedule_timeout(conn, CONN_IDLE);
+    metrics_add(METRIC_CONN_ACCEPTED, 1);
+    log_debug("Client connected: fd=%d, IP=%s, Port=%d, reactor=%d", client_fd,
+              inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
+              reactor->id);
+  }
+}
+
+/*
+ * 事件循环：接收新连接、分发就绪连接，并关闭超时连接
+ * epoll_wait 的超时取自时间轮，只在最近的截止时刻醒来，
+ * 空闲连接再多也不需要逐个扫描
+ */
+void reactor_run(Reactor *reactor) {
+  struct epoll_event events[MAX_CLIENTS];
+
+  while (1) {
+    int timeout = reactor_expire_timers(reactor);
+    int nfds = epoll_wait(reactor->epoll_fd, events, MAX_CLIENTS, timeout);
     if (nfds < 0) {
-      perror("epoll_wait fail!");
+      if (errno == EINTR) {
+        continue;
+      }
+      log_error("epoll_wait fail: %m");
       break;
     }
 
     for (int i = 0; i < nfds; i++) {
-      int fd = events[i].data.fd;
-
-      if (fd == server_fd) {
-        while (1) {
-          client_len = sizeof(client_addr);
-          client_fd =
-              accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
-          if (client_fd < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-              /* ET + nonblocking: no more pending connections in this round */
-              break;
-            } else {
-              perror("accept fail");
-              break;
-            }
-          }
-
-          printf("Client connected: fd=%d, IP=%s, Port=%d\n", client_fd,
-                 inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-
-          if (setnonblocking(client_fd) < 0) {
-            perror("setnonblocking client_fd fail");
-            close(client_fd);
-            continue;
-          }
-
-          ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
-          ev.data.fd = client_fd;
-          if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
-            perror("epoll_ctl add client_fd fail!");
-            close(client_fd);
-            continue;
-          }
-        }
+      Connection *conn = (Connection *)events[i].data.ptr;
+
+      if (conn == NULL) {
+        reactor_accept(reactor);
       } else {
-        removefd(epoll_fd, fd);
-        if (thread_pool_submit(&g_pool, fd) != 0) {
-          close(fd);
-        }
+        conn_dispatch(reactor, conn);
+      }
+    }
+  }
+}
+
+void *reactor_routine(void *arg) {
+  Reactor *reactor = (Reactor *)arg;
+
+  if (reactor->cpu >= 0) {
+    cpu_set_t cpus;
+    int err;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(reactor->cpu, &cpus);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0) {
+      log_error("Reactor %d: pin to cpu %d failed: %s", reactor->id,
+                reactor->cpu, strerror(err));
+    }
+  }
+
+  reactor_run(reactor);
+  return NULL;
+}
+
+void print_usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-r | -u] [-n threads] [-p] [-c cache_mb] [-a sample]\n"
+          "  (default)     one epoll loop + %d-thread pool\n"
+          "  -r            multi-reactor mode, one epoll loop per thread\n"
+          "  -u            io_uring engine, one ring per thread\n"
+          "                (falls back to -r if the kernel lacks support)\n"
+          "  -n threads    loop count in -r/-u mode (default: online CPUs)\n"
+          "  -p            pin loop i to CPU i %% online CPUs\n"
+          "  -c cache_mb   static file cache budget (default: %d, 0: off)\n"
+          "  -a sample     access log 1 of every <sample> requests per thread\n"
+          "                to stdout (default: 0, off); see /metrics for stats\n",
+          prog, THREAD_POOL_SIZE, FILE_CACHE_DEFAULT_MB);
+}
+
+/*
+ * 线程池模式：主线程运行唯一的 reactor
+ * 多 reactor 模式：每个 reactor 一个线程，主线程只负责等待
+ */
+int main(int argc, char *argv[]) {
+  Reactor *reactors;
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int multi_reactor = 0;
+  int use_uring = 0;
+  int reactor_count = 0;
+  int pin_cpu = 0;
+  long cache_mb = FILE_CACHE_DEFAULT_MB;
+  long log_sample = 0;
+  int opt;
+  int i;
+
+  if (ncpu < 1) {
+    ncpu = 1;
+  }
+
+  while ((opt = getopt(argc, argv, "run:pc:a:")) != -1) {
+    switch (opt) {
+    case 'r':
+      multi_reactor = 1;
+      break;
+    case 'u':
+      use_uring = 1;
+      break;
+    case 'n':
+      reactor_count = atoi(optarg);
+      if (reactor_count <= 0) {
+        print_usage(argv[0]);
+        return -1;
+      }
+      break;
+    case 'p':
+      pin_cpu = 1;
+      break;
+    case 'c':
+      cache_mb = atol(optarg);
+      if (cache_mb < 0) {
+        print_usage(argv[0]);
+        return -1;
+      }
+      break;
+    case 'a':
+      log_sample = atol(optarg);
+      if (log_sample < 0) {
+        print_usage(argv[0]);
+        return -1;
       }
+      break;
+    default:
+      print_usage(argv[0]);
+      return -1;
     }
   }
 
-  close(server_fd);
-  close(epoll_fd);
-  thread_pool_destroy(&g_pool);
+  if (use_uring) {
+    multi_reactor = 1;
+  }
+  if (!multi_reactor) {
+    reactor_count = 1;
+  } else if (reactor_count == 0) {
+    reactor_count = (int)ncpu;
+  }
+
+  /* 日志由后台线程批量写入 stdout，进程退出时写完剩余日志 */
+  if (log_init(STDOUT_FILENO, LOG_LEVEL_DEBUG) == 0) {
+    atexit(log_shutdown);
+  }
+
+  /* 对端已关闭时 send/sendfile 返回 EPIPE 而不是终止进程 */
+  signal(SIGPIPE, SIG_IGN);
+
+  if (static_responses_init() != 0) {
+    log_error("Failed to build static responses");
+    return -1;
+  }
+
+  if (file_cache_init(&g_file_cache, (size_t)cache_mb << 20,
+                      FILE_CACHE_MAX_FILE) != 0) {
+    log_error("Failed to initialize file cache");
+    return -1;
+  }
+  log_info("File cache: %ld MB", cache_mb);
+
+  /* 在任何工作线程启动之前设置，之后抽样间隔只读 */
+  access_log_init((unsigned int)log_sample);
+  if (log_sample > 0) {
+    log_info("Access log: 1 of every %ld requests", log_sample);
+  }
+
+  if (use_uring) {
+    if (uring_engine_probe() == 0) {
+      log_info("HTTP Server listening on port %d...", HTTP_PORT);
+      log_info("io_uring mode: %d workers%s", reactor_count,
+               pin_cpu ? ", pinned to CPUs" : "");
+      i = uring_engine_run(reactor_count, pin_cpu);
+      file_cache_destroy(&g_file_cache);
+      return i;
+    }
+    log_warn("Falling back to multi-reactor epoll mode");
+  }
+
+  reactors = (Reactor *)calloc((size_t)reactor_count, sizeof(Reactor));
+  if (reactors == NULL) {
+    log_error("calloc reactors fail: %m");
+    return -1;
+  }
+
+  for (i = 0; i < reactor_count; i++) {
+    int cpu = pin_cpu ? (int)(i % ncpu) : -1;
+
+    if (reactor_init(&reactors[i], i, !multi_reactor, multi_reactor, cpu) !=
+        0) {
+      log_error("Failed to initialize reactor %d", i);
+      return -1;
+    }
+  }
+
+  log_info("HTTP Server listening on port %d...", HTTP_PORT);
+  log_info("Open browser: http://127.0.0.1:%d", HTTP_PORT);
+
+  if (!multi_reactor) {
+    if (thread_pool_init(&g_pool) != 0) {
+      log_error("Failed to initialize thread pool");
+      return -1;
+    }
+    g_pool_enabled = 1;
+    log_info("Thread pool initialized with %d workers", THREAD_POOL_SIZE);
+
+    reactor_routine(&reactors[0]);
+    thread_pool_destroy(&g_pool);
+  } else {
+    log_info("Multi-reactor mode: %d reactors%s", reactor_count,
+             pin_cpu ? ", pinned to CPUs" : "");
+
+    for (i = 0; i < reactor_count; i++) {
+      if (pthread_create(&reactors[i].thread, NULL, reactor_routine,
+                         &reactors[i]) != 0) {
+        log_error("Failed to start reactor %d", i);
+        return -1;
+      }
+    }
+    for (i = 0; i < reactor_count; i++) {
+      pthread_join(reactors[i].thread, NULL);
+    }
+  }
+
+  for (i = 0; i < reactor_count; i++) {
+    close(reactors[i].listen_fd);
+    close(reactors[i].epoll_fd);
+  }
+  free(reactors);
+  file_cache_destroy(&g_file_cache);
   return 0;
 }
 
@@ -0,0 +1,128 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "access_log.h"
+#include "file_cache.h"
+#include "http_parser.h"
+#include "response.h"
+#include "timer_wheel.h"
+#include "transfer.h"
+
+/*
+ * epoll 引擎（server.c）与 io_uring 引擎（uring_engine.c）共用的连接状态：
+ * 请求解析、路由与响应生成只写输出状态机，由各引擎自己决定怎么发送
+ */
+
+#define HTTP_PORT 8080
+#define BUFFER_SIZE 4096
+#define MAX_REQUEST_SIZE (64 * 1024) /* 接收缓冲区按需倍增的上限 */
+#define HEADER_TIMEOUT_SEC 10 /* 请求开始到完整收到请求头的上限 */
+#define KEEPALIVE_TIMEOUT_SEC 5
+#define KEEPALIVE_MAX_REQUESTS 100
+#define SEND_TIMEOUT_SEC 30
+#define LISTEN_BACKLOG 1024
+#define CONN_TIMER_TICK_MS 100 /* 连接超时时间轮的精度 */
+
+/*
+ * 连接状态（epoll 引擎）：
+ * IDLE    挂在 epoll 中等待请求数据（EPOLLIN）
+ * WRITING 响应未发完，挂在 epoll 中等待可写（EPOLLOUT）
+ * BUSY    在任务队列或工作线程中
+ */
+enum { CONN_CLOSED = 0, CONN_IDLE, CONN_WRITING, CONN_BUSY };
+
+struct Reactor;
+
+/*
+ * 每个 fd 对应一个连接对象，按 fd 下标惰性分配并复用（不释放），
+ * 工作线程与主线程（超时回收）通过 mutex 协调状态切换。
+ * io_uring 引擎把它嵌在自己的连接对象里，不使用 reactor/events/mutex。
+ *
+ * 输出状态机：响应头（及短响应体）先写入 out，缓存命中的文件响应体
+ * 记录为 body（引用缓存条目），其余文件响应体记录为 file_fd + 偏移/剩余长度；
+ * 发送遇到 EAGAIN 时保存进度并等待 EPOLLOUT，工作线程不会在 socket 上睡眠等待。
+ */
+typedef struct {
+  int fd;
+  int state;
+  struct Reactor *reactor;
+  uint32_t events; /* 当前在 epoll 中登记的事件 */
+  int rx_drained;  /* 最近一次读取是否已读到 EAGAIN */
+  int keep_alive;
+  int requests;
+  int len;
+  TimerNode timer; /* 挂在所属事件循环的时间轮上，到期即关闭连接 */
+  pthread_mutex_t mutex;
+  char *buffer; /* 接收缓冲区，从 BUFFER_SIZE 按需倍增到 MAX_REQUEST_SIZE */
+  int cap;
+  int buffer_heap; /* buffer 是否为 malloc 所得（否则属于预分配的块） */
+  HttpRequest req; /* 缓冲区开头那个请求的增量解析状态 */
+
+  char out[BUFFER_SIZE];
+  size_t out_len;
+  size_t out_pos;
+  const char *body;
+  size_t body_len;
+  size_t body_pos;
+  FileCacheEntry *body_ref;
+  int file_fd;
+  off_t file_offset;
+  off_t file_remaining;
+  TransferMode file_mode;
+
+  /* 请求计时（单调时钟微秒）与统计，响应发完时写入 metrics */
+  uint64_t req_start_us; /* 0 表示下一个请求的数据还没到 */
+  uint64_t first_byte_us;
+  uint64_t resp_bytes;
+  int status; /* 当前响应的状态码，0 表示没有待统计的响应 */
+  int log_sampled;
+  AccessLogRecord log_rec;
+  char *scratch; /* /metrics 响应体，按需分配并复用 */
+  size_t scratch_cap;
+} Connection;
+
+/* 为新接入的 fd 重置连接状态，接收缓冲区需已分配 */
+void conn_init(Connection *conn, int fd);
+
+/*
+ * 从接收缓冲区开头取出一个完整请求并生成响应（只写输出状态机，不发送）
+ * 返回 1 表示已生成响应，0 表示请求还不完整
+ * 无法解析或请求头超过 MAX_REQUEST_SIZE 时生成 400/431 并取消 keep-alive
+ */
+int conn_next_request(Connection *conn);
+
+/*
+ * 连接当前阶段的截止时刻（单调时钟毫秒）：
+ * 发送响应时为 SEND_TIMEOUT_SEC 内必须有进度，
+ * 请求已开始（含刚接入的连接）时为开始后 HEADER_TIMEOUT_SEC 内收齐请求头，
+ * 否则为 keep-alive 空闲 KEEPALIVE_TIMEOUT_SEC
+ */
+uint64_t conn_deadline_ms(const Connection *conn, int writing, uint64_t now_ms);
+
+/* 接收缓冲区倍增，已到 MAX_REQUEST_SIZE 时返回 -1 */
+int conn_grow_buffer(Connection *conn);
+
+/* 当前是否有未发完的响应 */
+int conn_has_output(const Connection *conn);
+
+/* 记录本次发送推进的字节数 */
+void conn_note_sent(Connection *conn, uint64_t sent);
+
+/* 结束当前响应：释放缓存条目、关闭响应体文件 */
+void conn_reset_output(Connection *conn);
+
+/* 响应发完：写入计数、延迟直方图与访问日志 */
+void conn_finish_response(Connection *conn);
+
+/*
+ * 创建非阻塞监听 socket
+ * reuseport 为 1 时设置 SO_REUSEPORT，多个事件循环各自绑定同一端口
+ */
+int create_listen_socket(int reuseport);
+
+#endif
@@ -0,0 +1,242 @@
+#include "task_queue.h"
+
+#include <limits.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* 多核下休眠前的自旋次数，覆盖任务短暂到达不及时的情况；单核不自旋 */
+#define TASK_QUEUE_SPIN 64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __asm__ __volatile__("pause")
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+/* 等待其他线程完成槽位写入/读取：先自旋，对方可能已被调度出去时让出 CPU */
+static void backoff(const TaskQueue *q, int *spins) {
+  if (++*spins < q->spin) {
+    cpu_relax();
+  } else {
+    sched_yield();
+  }
+}
+
+static void futex_wait(_Atomic uint32_t *addr, uint32_t expected) {
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT_PRIVATE, expected, NULL,
+          NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *addr, int count) {
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL,
+          0);
+}
+
+static int task_sema_try_wait(TaskSema *sema) {
+  int count = atomic_load_explicit(&sema->count, memory_order_relaxed);
+
+  while (count > 0) {
+    if (atomic_compare_exchange_weak_explicit(&sema->count, &count, count - 1,
+                                              memory_order_acquire,
+                                              memory_order_relaxed)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* 先自旋尝试拿令牌，失败后登记为等待者并在 wakeups 上休眠直到被 post 唤醒 */
+static void task_sema_wait(TaskSema *sema, int spin) {
+  int i;
+
+  for (i = 0; i < spin; i++) {
+    if (task_sema_try_wait(sema)) {
+      return;
+    }
+    cpu_relax();
+  }
+
+  if (atomic_fetch_sub(&sema->count, 1) > 0) {
+    return;
+  }
+
+  while (1) {
+    uint32_t wakeups = atomic_load(&sema->wakeups);
+
+    if (wakeups > 0) {
+      if (atomic_compare_exchange_weak(&sema->wakeups, &wakeups,
+                                       wakeups - 1)) {
+        return;
+      }
+      continue;
+    }
+    futex_wait(&sema->wakeups, 0);
+  }
+}
+
+static void task_sema_post(TaskSema *sema) {
+  if (atomic_fetch_add(&sema->count, 1) < 0) {
+    atomic_fetch_add(&sema->wakeups, 1);
+    futex_wake(&sema->wakeups, 1);
+  }
+}
+
+/* 停止时发放足够多的唤醒，放行所有正在或将要休眠的线程 */
+static void task_sema_release_all(TaskSema *sema) {
+  atomic_fetch_add(&sema->wakeups, 1u << 30);
+  futex_wake(&sema->wakeups, INT_MAX);
+}
+
+int task_queue_init(TaskQueue *q, size_t capacity) {
+  size_t i;
+
+  if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+    return -1;
+  }
+
+  q->slots = (TaskSlot *)calloc(capacity, sizeof(TaskSlot));
+  if (q->slots == NULL) {
+    return -1;
+  }
+  for (i = 0; i < capacity; i++) {
+    atomic_init(&q->slots[i].seq, i);
+  }
+  q->mask = capacity - 1;
+  q->spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? TASK_QUEUE_SPIN : 0;
+  atomic_init(&q->enqueue_pos, 0);
+  atomic_init(&q->dequeue_pos, 0);
+  atomic_init(&q->items.count, 0);
+  atomic_init(&q->items.wakeups, 0);
+  atomic_init(&q->slots_free.count, (int)capacity);
+  atomic_init(&q->slots_free.wakeups, 0);
+  atomic_init(&q->stop, 0);
+  return 0;
+}
+
+void task_queue_destroy(TaskQueue *q) {
+  free(q->slots);
+  q->slots = NULL;
+}
+
+/*
+ * 槽位序号 seq 与下标 pos 的关系：
+ * seq == pos      槽位空闲，可以写入第 pos 个任务
+ * seq == pos + 1  槽位已写入，可以被第 pos 个出队者读取
+ * 读取后 seq 置为 pos + capacity，留给下一圈的入队者
+ */
+static int task_queue_try_push(TaskQueue *q, void *data) {
+  size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+  TaskSlot *slot;
+
+  while (1) {
+    size_t seq;
+    intptr_t diff;
+
+    slot = &q->slots[pos & q->mask];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  slot->data = data;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+  return 0;
+}
+
+static void *task_queue_try_pop(TaskQueue *q) {
+  size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+  TaskSlot *slot;
+  void *data;
+
+  while (1) {
+    size_t seq;
+    intptr_t diff;
+
+    slot = &q->slots[pos & q->mask];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  data = slot->data;
+  atomic_store_explicit(&slot->seq, pos + q->mask + 1, memory_order_release);
+  return data;
+}
+
+/*
+ * 拿到 slots_free 令牌后一定有空槽位，拿到 items 令牌后一定有任务；
+ * 个别情况下槽位还在被前一个线程写入/读取，短暂自旋等待其完成
+ */
+int task_queue_push(TaskQueue *q, void *data) {
+  int spins = 0;
+
+  if (atomic_load_explicit(&q->stop, memory_order_relaxed)) {
+    return -1;
+  }
+
+  task_sema_wait(&q->slots_free, q->spin);
+  while (task_queue_try_push(q, data) != 0) {
+    if (atomic_load(&q->stop)) {
+      return -1;
+    }
+    backoff(q, &spins);
+  }
+  task_sema_post(&q->items);
+  return 0;
+}
+
+void *task_queue_pop(TaskQueue *q) {
+  int spins = 0;
+  void *data;
+
+  task_sema_wait(&q->items, q->spin);
+  while ((data = task_queue_try_pop(q)) == NULL) {
+    /* 停止后放行的线程拿到的不是真正的任务令牌 */
+    if (atomic_load(&q->stop)) {
+      return NULL;
+    }
+    backoff(q, &spins);
+  }
+  task_sema_post(&q->slots_free);
+  return data;
+}
+
+size_t task_queue_size(TaskQueue *q) {
+  /* 先读出队下标：入队下标只增不减且不小于出队下标，差值不会为负 */
+  size_t dequeue = atomic_load_explicit(&q->dequeue_pos, memory_order_acquire);
+  size_t enqueue = atomic_load_explicit(&q->enqueue_pos, memory_order_acquire);
+
+  return enqueue - dequeue;
+}
+
+void task_queue_stop(TaskQueue *q) {
+  atomic_store(&q->stop, 1);
+  task_sema_release_all(&q->items);
+  task_sema_release_all(&q->slots_free);
+}
@@ -0,0 +1,59 @@
+#ifndef HTTP_TASK_QUEUE_H
+#define HTTP_TASK_QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASK_QUEUE_CACHELINE 64
+
+/*
+ * 轻量信号量（futex 休眠）：
+ * count > 0 为可用令牌数，count < 0 为已登记休眠的线程数，
+ * 只有确实有线程休眠时 post 才发起 futex 系统调用
+ */
+typedef struct {
+  _Atomic int count;
+  _Atomic uint32_t wakeups; /* futex 字：已发出但尚未被领取的唤醒 */
+} TaskSema;
+
+typedef struct {
+  _Atomic size_t seq;
+  void *data;
+} TaskSlot;
+
+/*
+ * 有界无锁 MPMC 环形队列（每个槽位带序号，入队/出队各自 CAS 推进下标）
+ * 入队与出队下标分别独占缓存行，避免生产者和消费者之间的伪共享
+ * 阻塞版本用两个信号量计数：items 为已入队任务数，slots_free 为空闲槽位数
+ */
+typedef struct {
+  TaskSlot *slots;
+  size_t mask;
+  int spin; /* 休眠前的自旋次数 */
+  _Alignas(TASK_QUEUE_CACHELINE) _Atomic size_t enqueue_pos;
+  _Alignas(TASK_QUEUE_CACHELINE) _Atomic size_t dequeue_pos;
+  _Alignas(TASK_QUEUE_CACHELINE) TaskSema items;
+  _Alignas(TASK_QUEUE_CACHELINE) TaskSema slots_free;
+  _Atomic int stop;
+} TaskQueue;
+
+/* capacity 必须是 2 的幂，成功返回 0 */
+int task_queue_init(TaskQueue *q, size_t capacity);
+void task_queue_destroy(TaskQueue *q);
+
+/*
+ * 阻塞入队/出队（data 不能为 NULL）：先短暂自旋，仍不满足条件时在 futex 上休眠
+ * 队列停止后 push 返回 -1，pop 在取完剩余任务后返回 NULL
+ * （应在所有生产者结束后再调用 task_queue_stop）
+ */
+int task_queue_push(TaskQueue *q, void *data);
+void *task_queue_pop(TaskQueue *q);
+
+/* 当前排队的任务数（近似值，供监控使用） */
+size_t task_queue_size(TaskQueue *q);
+
+/* 停止队列并唤醒所有休眠的生产者和消费者 */
+void task_queue_stop(TaskQueue *q);
+
+#endif
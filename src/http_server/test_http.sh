@@ -1,3 +1,6 @@
 #!/usr/bin/env bash
 curl --noproxy '*' -i --max-time 3 http://127.0.0.1:8080/ | head -n 20
 curl --noproxy '*' -i --max-time 3 http://127.0.0.1:8080/hello | head -n 20
+# keep-alive：同一次 curl 访问两个 URL 应复用连接
+curl --noproxy '*' -sv --max-time 3 -o /dev/null -o /dev/null \
+  http://127.0.0.1:8080/hello http://127.0.0.1:8080/ 2>&1 | grep -E "Re-using|Connection:"
@@ -0,0 +1,151 @@
+#include "transfer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define TRANSFER_CHUNK_SIZE 4096
+/* 单次 sendfile 的上限，避免一次调用长时间占用工作线程 */
+#define SENDFILE_MAX_CHUNK (1 << 20)
+
+int transfer_send_buffer(int sock_fd, const char *buf, size_t len,
+                         size_t *pos) {
+  while (*pos < len) {
+    ssize_t n = send(sock_fd, buf + *pos, len - *pos, MSG_NOSIGNAL);
+    if (n > 0) {
+      *pos += (size_t)n;
+      continue;
+    }
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return TRANSFER_AGAIN;
+    }
+    return TRANSFER_ERROR;
+  }
+
+  return TRANSFER_DONE;
+}
+
+int transfer_send_buffers(int sock_fd, const char *a, size_t a_len,
+                          size_t *a_pos, const char *b, size_t b_len,
+                          size_t *b_pos, int flags) {
+  while (*a_pos < a_len || *b_pos < b_len) {
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t a_left = a_len - *a_pos;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    if (a_left > 0) {
+      iov[msg.msg_iovlen].iov_base = (void *)(a + *a_pos);
+      iov[msg.msg_iovlen].iov_len = a_left;
+      msg.msg_iovlen++;
+    }
+    if (*b_pos < b_len) {
+      iov[msg.msg_iovlen].iov_base = (void *)(b + *b_pos);
+      iov[msg.msg_iovlen].iov_len = b_len - *b_pos;
+      msg.msg_iovlen++;
+    }
+
+    n = sendmsg(sock_fd, &msg, MSG_NOSIGNAL | flags);
+    if (n > 0) {
+      size_t sent = (size_t)n;
+      size_t from_a = (sent < a_left) ? sent : a_left;
+
+      *a_pos += from_a;
+      *b_pos += sent - from_a;
+      continue;
+    }
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return TRANSFER_AGAIN;
+    }
+    return TRANSFER_ERROR;
+  }
+
+  return TRANSFER_DONE;
+}
+
+/*
+ * 拷贝路径：每轮 pread 一块再 send，只按实际发出的字节推进 offset，
+ * 部分发送时下一轮从页缓存重新读取剩余部分，无需额外保存缓冲区
+ */
+static int transfer_copy_step(int sock_fd, int file_fd, off_t *offset,
+                              off_t *remaining) {
+  char buffer[TRANSFER_CHUNK_SIZE];
+
+  while (*remaining > 0) {
+    size_t want = (*remaining > TRANSFER_CHUNK_SIZE) ? TRANSFER_CHUNK_SIZE
+                                                     : (size_t)*remaining;
+    ssize_t n = pread(file_fd, buffer, want, *offset);
+    size_t pos = 0;
+    int ret;
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      /* 文件被截断或读错误，无法发满 Content-Length */
+      return TRANSFER_ERROR;
+    }
+
+    ret = transfer_send_buffer(sock_fd, buffer, (size_t)n, &pos);
+    *offset += (off_t)pos;
+    *remaining -= (off_t)pos;
+    if (ret != TRANSFER_DONE) {
+      return ret;
+    }
+  }
+
+  return TRANSFER_DONE;
+}
+
+static int transfer_sendfile_step(int sock_fd, int file_fd, off_t *offset,
+                                  off_t *remaining, TransferMode *mode) {
+  while (*remaining > 0) {
+    size_t want = (*remaining > SENDFILE_MAX_CHUNK) ? SENDFILE_MAX_CHUNK
+                                                    : (size_t)*remaining;
+    off_t before = *offset;
+    ssize_t n = sendfile(sock_fd, file_fd, offset, want);
+
+    if (n > 0) {
+      *remaining -= *offset - before;
+      continue;
+    }
+    if (n == 0) {
+      return TRANSFER_ERROR;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return TRANSFER_AGAIN;
+    }
+    /* EINVAL/ENOSYS：源 fd 不支持 sendfile（如管道、部分伪文件系统） */
+    if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP) {
+      *mode = TRANSFER_COPY;
+      return transfer_copy_step(sock_fd, file_fd, offset, remaining);
+    }
+    return TRANSFER_ERROR;
+  }
+
+  return TRANSFER_DONE;
+}
+
+int transfer_send_file(int sock_fd, int file_fd, off_t *offset,
+                       off_t *remaining, TransferMode *mode) {
+  if (*mode == TRANSFER_SENDFILE) {
+    return transfer_sendfile_step(sock_fd, file_fd, offset, remaining, mode);
+  }
+  return transfer_copy_step(sock_fd, file_fd, offset, remaining);
+}
@@ -0,0 +1,40 @@
+#ifndef HTTP_TRANSFER_H
+#define HTTP_TRANSFER_H
+
+#include <sys/types.h>
+
+/*
+ * 文件发送路径
+ * - TRANSFER_COPY：pread() 到用户态缓冲区再 send()，适用于任意可读 fd
+ * - TRANSFER_SENDFILE：sendfile(2) 在内核内直接从页缓存发送，零拷贝
+ */
+typedef enum { TRANSFER_COPY = 0, TRANSFER_SENDFILE } TransferMode;
+
+/*
+ * 非阻塞发送结果：
+ * TRANSFER_DONE 全部发送完毕；TRANSFER_AGAIN socket 发送队列已满，
+ * 进度已记录在输出参数中，等 EPOLLOUT 后再次调用即可续传
+ */
+enum { TRANSFER_ERROR = -1, TRANSFER_DONE = 0, TRANSFER_AGAIN = 1 };
+
+/* 发送 buf[*pos, len)，*pos 随发送进度前移 */
+int transfer_send_buffer(int sock_fd, const char *buf, size_t len, size_t *pos);
+
+/*
+ * 用一次 sendmsg 依次发送 a[*a_pos, a_len) 与 b[*b_pos, b_len)，
+ * 例如响应头加缓存中的文件内容，两个进度各自前移
+ * flags 为附加的发送标志（如 MSG_MORE）
+ */
+int transfer_send_buffers(int sock_fd, const char *a, size_t a_len,
+                          size_t *a_pos, const char *b, size_t b_len,
+                          size_t *b_pos, int flags);
+
+/*
+ * 发送 file_fd 中 [*offset, *offset + *remaining)，两者随进度更新
+ * *mode 为 TRANSFER_SENDFILE 时源 fd 不支持 sendfile（EINVAL/ENOSYS）
+ * 会被改写为 TRANSFER_COPY 并从断点继续
+ */
+int transfer_send_file(int sock_fd, int file_fd, off_t *offset,
+                       off_t *remaining, TransferMode *mode);
+
+#endif
@@ -0,0 +1,329 @@
+#define _GNU_SOURCE
+#include "uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, void *arg, size_t argsz) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/*
+ * 映射 SQ/CQ 环与 SQE 数组
+ * 内核支持 IORING_FEAT_SINGLE_MMAP 时 SQ 与 CQ 共用一次映射
+ */
+static int uring_map(Uring *ring, const struct io_uring_params *p) {
+  size_t sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+  size_t cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+  char *sq;
+  char *cq;
+  unsigned i;
+
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    if (cq_size > sq_size) {
+      sq_size = cq_size;
+    }
+    cq_size = sq_size;
+  }
+
+  sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring->fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return -errno;
+  }
+  ring->sq_ring = sq;
+  ring->sq_ring_size = sq_size;
+
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              ring->fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return -errno;
+    }
+  }
+  ring->cq_ring = cq;
+  ring->cq_ring_size = cq_size;
+
+  ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq.sqes =
+      mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sq.sqes == MAP_FAILED) {
+    ring->sq.sqes = NULL;
+    return -errno;
+  }
+
+  ring->sq.head = (unsigned *)(sq + p->sq_off.head);
+  ring->sq.tail = (unsigned *)(sq + p->sq_off.tail);
+  ring->sq.ring_mask = (unsigned *)(sq + p->sq_off.ring_mask);
+  ring->sq.array = (unsigned *)(sq + p->sq_off.array);
+  ring->sq.entries = p->sq_entries;
+  ring->sq.sqe_tail = *ring->sq.tail;
+
+  ring->cq.head = (unsigned *)(cq + p->cq_off.head);
+  ring->cq.tail = (unsigned *)(cq + p->cq_off.tail);
+  ring->cq.ring_mask = (unsigned *)(cq + p->cq_off.ring_mask);
+  ring->cq.cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+  /* SQE 按下标顺序使用，间接数组固定为恒等映射 */
+  for (i = 0; i < p->sq_entries; i++) {
+    ring->sq.array[i] = i;
+  }
+  return 0;
+}
+
+int uring_init(Uring *ring, unsigned entries, unsigned flags) {
+  struct io_uring_params p;
+  int ret;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&p, 0, sizeof(p));
+  p.flags = flags | IORING_SETUP_CQSIZE;
+  /* multishot 请求一次提交产生多个 CQE，CQ 开到 SQ 的 4 倍 */
+  p.cq_entries = entries * 4;
+
+  ring->fd = sys_io_uring_setup(entries, &p);
+  if (ring->fd < 0) {
+    return -errno;
+  }
+  ring->flags = p.flags;
+
+  ret = uring_map(ring, &p);
+  if (ret < 0) {
+    uring_destroy(ring);
+    return ret;
+  }
+  return 0;
+}
+
+void uring_destroy(Uring *ring) {
+  if (ring->sq.sqes != NULL) {
+    munmap(ring->sq.sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sq_ring != NULL) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+struct io_uring_sqe *uring_get_sqe(Uring *ring) {
+  UringSq *sq = &ring->sq;
+  unsigned head = __atomic_load_n(sq->head, __ATOMIC_ACQUIRE);
+  struct io_uring_sqe *sqe;
+
+  if (sq->sqe_tail - head >= sq->entries) {
+    return NULL;
+  }
+  sqe = &sq->sqes[sq->sqe_tail & *sq->ring_mask];
+  sq->sqe_tail++;
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+unsigned uring_sq_space(Uring *ring) {
+  UringSq *sq = &ring->sq;
+
+  return sq->entries -
+         (sq->sqe_tail - __atomic_load_n(sq->head, __ATOMIC_ACQUIRE));
+}
+
+int uring_submit_and_wait_timeout(Uring *ring, unsigned wait_nr,
+                                  int timeout_ms) {
+  UringSq *sq = &ring->sq;
+  unsigned to_submit = sq->sqe_tail - *sq->tail;
+  unsigned flags = 0;
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  int ret;
+
+  if (to_submit > 0) {
+    /* 发布 SQE：内核看到新 tail 之前，SQE 内容必须已经写好 */
+    __atomic_store_n(sq->tail, sq->sqe_tail, __ATOMIC_RELEASE);
+  }
+  /* DEFER_TASKRUN 模式下完成事件只在带 GETEVENTS 进入内核时处理 */
+  if (wait_nr > 0 || (ring->flags & IORING_SETUP_DEFER_TASKRUN)) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+  if (to_submit == 0 && flags == 0) {
+    return 0;
+  }
+
+  ring->enters++;
+  if (wait_nr > 0 && timeout_ms >= 0) {
+    /* 等待超时通过扩展参数传入，不占用 SQE */
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+                             flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+  } else {
+    ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr, flags, NULL, 0);
+  }
+  return ret < 0 ? -errno : ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(Uring *ring) {
+  UringCq *cq = &ring->cq;
+  unsigned head = *cq->head;
+
+  if (head == __atomic_load_n(cq->tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &cq->cqes[head & *cq->ring_mask];
+}
+
+void uring_cqe_seen(Uring *ring) {
+  __atomic_store_n(ring->cq.head, *ring->cq.head + 1, __ATOMIC_RELEASE);
+}
+
+int uring_buf_ring_init(Uring *ring, UringBufRing *br, uint16_t group,
+                        unsigned count, unsigned size) {
+  struct io_uring_buf_reg reg;
+  unsigned i;
+
+  memset(br, 0, sizeof(*br));
+  br->count = count;
+  br->size = size;
+  br->group = group;
+  br->ring_size = count * sizeof(struct io_uring_buf);
+
+  br->ring = mmap(NULL, br->ring_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (br->ring == MAP_FAILED) {
+    br->ring = NULL;
+    return -errno;
+  }
+  br->bufs = (char *)malloc((size_t)count * size);
+  if (br->bufs == NULL) {
+    munmap(br->ring, br->ring_size);
+    br->ring = NULL;
+    return -ENOMEM;
+  }
+
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)br->ring;
+  reg.ring_entries = count;
+  reg.bgid = group;
+  if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    int err = errno;
+
+    free(br->bufs);
+    munmap(br->ring, br->ring_size);
+    br->ring = NULL;
+    br->bufs = NULL;
+    return -err;
+  }
+
+  for (i = 0; i < count; i++) {
+    uring_buf_ring_recycle(br, i);
+  }
+  uring_buf_ring_publish(br);
+  return 0;
+}
+
+void uring_buf_ring_destroy(Uring *ring, UringBufRing *br) {
+  struct io_uring_buf_reg reg;
+
+  if (br->ring == NULL) {
+    return;
+  }
+  memset(&reg, 0, sizeof(reg));
+  reg.bgid = br->group;
+  sys_io_uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+  munmap(br->ring, br->ring_size);
+  free(br->bufs);
+  br->ring = NULL;
+  br->bufs = NULL;
+}
+
+void uring_buf_ring_recycle(UringBufRing *br, unsigned bid) {
+  struct io_uring_buf *buf = &br->ring->bufs[br->tail & (br->count - 1)];
+
+  buf->addr = (uint64_t)(uintptr_t)uring_buf_ring_buffer(br, bid);
+  buf->len = br->size;
+  buf->bid = (uint16_t)bid;
+  br->tail++;
+}
+
+void uring_buf_ring_publish(UringBufRing *br) {
+  __atomic_store_n(&br->ring->tail, br->tail, __ATOMIC_RELEASE);
+}
+
+void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int listen_fd,
+                                 uint64_t user_data) {
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+}
+
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd,
+                               uint16_t group, uint64_t user_data) {
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = group;
+  sqe->user_data = user_data;
+}
+
+void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf,
+                     size_t len, int flags, uint64_t user_data) {
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->msg_flags = (uint32_t)flags;
+  sqe->user_data = user_data;
+}
+
+void uring_prep_read(struct io_uring_sqe *sqe, int fd, void *buf, size_t len,
+                     uint64_t offset, uint64_t user_data) {
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->off = offset;
+  sqe->user_data = user_data;
+}
+
+void uring_prep_cancel_fd(struct io_uring_sqe *sqe, int fd,
+                          uint64_t user_data) {
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = fd;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe->user_data = user_data;
+}
+
+void uring_prep_close(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+}
@@ -0,0 +1,123 @@
+#ifndef HTTP_URING_H
+#define HTTP_URING_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * io_uring 的最小封装（不依赖 liburing）：直接调用 io_uring_setup/enter/register，
+ * 只覆盖 io_uring 引擎用到的操作
+ * 需要 Linux 6.0+（multishot recv、provided buffer ring）
+ *
+ * 所有函数只能在拥有该 ring 的线程中调用
+ */
+
+typedef struct {
+  unsigned *head;
+  unsigned *tail;
+  unsigned *ring_mask;
+  unsigned *array;
+  struct io_uring_sqe *sqes;
+  unsigned sqe_tail; /* 已取出但尚未发布到 *tail 的 SQE 截止位置 */
+  unsigned entries;
+} UringSq;
+
+typedef struct {
+  unsigned *head;
+  unsigned *tail;
+  unsigned *ring_mask;
+  struct io_uring_cqe *cqes;
+} UringCq;
+
+typedef struct {
+  int fd;
+  unsigned flags;
+  UringSq sq;
+  UringCq cq;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  uint64_t enters; /* io_uring_enter 调用次数 */
+} Uring;
+
+/*
+ * 内核管理的接收缓冲区池（provided buffer ring）：
+ * count 个 size 字节的缓冲区，recv 完成时由内核挑选一个填入，
+ * 应用用完后放回，放回操作只是写共享内存，不需要系统调用
+ */
+typedef struct {
+  struct io_uring_buf_ring *ring;
+  size_t ring_size;
+  char *bufs;
+  unsigned count;
+  unsigned size;
+  uint16_t group;
+  uint16_t tail;
+} UringBufRing;
+
+/*
+ * 创建 ring，flags 为 IORING_SETUP_* 组合
+ * 成功返回 0，失败返回 -errno（例如内核不支持某个 flag 时为 -EINVAL）
+ */
+int uring_init(Uring *ring, unsigned entries, unsigned flags);
+void uring_destroy(Uring *ring);
+
+/* 取一个空闲 SQE（已清零），SQ 已满时返回 NULL，调用方应先 uring_submit */
+struct io_uring_sqe *uring_get_sqe(Uring *ring);
+
+/*
+ * SQ 中还能取出的 SQE 数
+ * 链接请求（IOSQE_IO_LINK）必须在同一次提交中，取整条链之前先确认空间足够
+ */
+unsigned uring_sq_space(Uring *ring);
+
+/*
+ * 提交已取出的 SQE，并等待至少 wait_nr 个 CQE，最多等待 timeout_ms 毫秒
+ * （-1 表示不限；需要 IORING_FEAT_EXT_ARG，Linux 5.11+）
+ * 返回提交的 SQE 数，失败返回 -errno（被信号打断时为 -EINTR，超时为 -ETIME）
+ */
+int uring_submit_and_wait_timeout(Uring *ring, unsigned wait_nr,
+                                  int timeout_ms);
+
+static inline int uring_submit_and_wait(Uring *ring, unsigned wait_nr) {
+  return uring_submit_and_wait_timeout(ring, wait_nr, -1);
+}
+
+static inline int uring_submit(Uring *ring) {
+  return uring_submit_and_wait(ring, 0);
+}
+
+/* 取下一个 CQE，没有时返回 NULL；处理完后调用 uring_cqe_seen 归还 */
+struct io_uring_cqe *uring_peek_cqe(Uring *ring);
+void uring_cqe_seen(Uring *ring);
+
+/* 注册缓冲区池，group 为 recv SQE 中引用的缓冲区组号，count 必须是 2 的幂 */
+int uring_buf_ring_init(Uring *ring, UringBufRing *br, uint16_t group,
+                        unsigned count, unsigned size);
+void uring_buf_ring_destroy(Uring *ring, UringBufRing *br);
+
+static inline char *uring_buf_ring_buffer(UringBufRing *br, unsigned bid) {
+  return br->bufs + (size_t)bid * br->size;
+}
+
+/* 把缓冲区 bid 放回池中，调用 uring_buf_ring_publish 后对内核可见 */
+void uring_buf_ring_recycle(UringBufRing *br, unsigned bid);
+void uring_buf_ring_publish(UringBufRing *br);
+
+/* 准备各类请求，user_data 原样出现在对应 CQE 中 */
+void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int listen_fd,
+                                 uint64_t user_data);
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd,
+                               uint16_t group, uint64_t user_data);
+void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf,
+                     size_t len, int flags, uint64_t user_data);
+void uring_prep_read(struct io_uring_sqe *sqe, int fd, void *buf, size_t len,
+                     uint64_t offset, uint64_t user_data);
+void uring_prep_cancel_fd(struct io_uring_sqe *sqe, int fd,
+                          uint64_t user_data);
+void uring_prep_close(struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+
+#endif
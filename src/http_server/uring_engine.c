@@ -0,0 +1,612 @@
+#define _GNU_SOURCE
+#include "uring_engine.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "async_log.h"
+#include "metrics.h"
+#include "server.h"
+#include "uring.h"
+
+#define URING_ENTRIES 4096        /* 每个线程的 SQ 大小 */
+#define URING_RECV_BUFS 4096      /* 每个线程的接收缓冲区数，必须是 2 的幂 */
+#define URING_RECV_BUF_SIZE 4096
+#define URING_BUF_GROUP 0
+#define URING_CHUNK_SIZE (64 * 1024) /* 文件响应体每次读取并发送的大小 */
+
+/*
+ * user_data 编码：连接对象指针（按 64 字节对齐）低 4 位放操作类型，
+ * 监听请求不属于任何连接，指针部分为 0
+ */
+enum {
+  OP_ACCEPT = 1,
+  OP_RECV,
+  OP_SEND_HEAD,  /* conn->out */
+  OP_SEND_BODY,  /* conn->body（静态响应、缓存文件） */
+  OP_READ,       /* 文件 -> chunk */
+  OP_SEND_CHUNK, /* chunk -> socket */
+  OP_CANCEL,
+  OP_CLOSE,
+};
+#define OP_MASK 0xfULL
+
+/*
+ * io_uring 连接：共用的请求/响应状态加上在途请求的计数
+ * 发送链（chain）在途期间不处理后续请求，链上的 CQE 全部回来后
+ * 按输出状态机的进度提交下一段，或结束当前响应
+ * 关闭时先取消该 fd 上的所有请求，在途计数归零后再提交 close，
+ * close 完成才回收对象，内核不会再引用连接中的缓冲区
+ */
+typedef struct UringConn {
+  Connection conn;
+  struct UringConn *next; /* 空闲链表 */
+  int inflight;    /* 已提交、最终 CQE 未到的请求数 */
+  int chain;       /* 当前发送链中未完成的请求数 */
+  int chain_failed;
+  int recv_armed;
+  int responding;  /* 已生成响应，尚未发完 */
+  int peer_closed;
+  int rx_overflow; /* 接收缓冲区已满又有数据到达，之后的数据全部丢弃 */
+  int closing;
+  int close_submitted;
+  char *chunk;     /* 文件读取缓冲区，第一次发送大文件时分配 */
+  size_t chunk_len;
+  size_t chunk_pos;
+} UringConn;
+
+typedef struct {
+  int id;
+  int cpu;
+  int listen_fd;
+  Uring ring;
+  UringBufRing bufs;
+  UringConn *free_list;
+  TimerWheel timers; /* 本线程所有连接的超时，等待 CQE 的超时取自这里 */
+  uint64_t now_ms;   /* 本轮事件循环开始时的单调时钟 */
+  pthread_t thread;
+} UringWorker;
+
+static uint64_t op_data(UringConn *uc, unsigned op) {
+  return (uint64_t)(uintptr_t)uc | op;
+}
+
+/* 取一个 SQE，SQ 已满时先把已有的提交掉 */
+static struct io_uring_sqe *worker_sqe(UringWorker *w) {
+  struct io_uring_sqe *sqe;
+
+  while ((sqe = uring_get_sqe(&w->ring)) == NULL) {
+    uring_submit(&w->ring);
+  }
+  return sqe;
+}
+
+static void worker_arm_accept(UringWorker *w) {
+  uring_prep_accept_multishot(worker_sqe(w), w->listen_fd,
+                              op_data(NULL, OP_ACCEPT));
+}
+
+static void uconn_arm_recv(UringWorker *w, UringConn *uc) {
+  uring_prep_recv_multishot(worker_sqe(w), uc->conn.fd, URING_BUF_GROUP,
+                            op_data(uc, OP_RECV));
+  uc->recv_armed = 1;
+  uc->inflight++;
+}
+
+/* 连接对象优先取自本线程的空闲链表，接收缓冲区随对象复用 */
+static UringConn *uconn_open(UringWorker *w, int fd) {
+  UringConn *uc = w->free_list;
+
+  if (uc != NULL) {
+    w->free_list = uc->next;
+  } else {
+    uc = (UringConn *)aligned_alloc(64, sizeof(UringConn));
+    if (uc == NULL) {
+      return NULL;
+    }
+    memset(uc, 0, sizeof(*uc));
+    uc->conn.buffer = (char *)malloc(BUFFER_SIZE);
+    if (uc->conn.buffer == NULL) {
+      free(uc);
+      return NULL;
+    }
+    uc->conn.cap = BUFFER_SIZE;
+    uc->conn.buffer_heap = 1;
+  }
+
+  conn_init(&uc->conn, fd);
+  uc->inflight = 0;
+  uc->chain = 0;
+  uc->chain_failed = 0;
+  uc->recv_armed = 0;
+  uc->responding = 0;
+  uc->peer_closed = 0;
+  uc->rx_overflow = 0;
+  uc->closing = 0;
+  uc->close_submitted = 0;
+  uc->chunk_len = 0;
+  uc->chunk_pos = 0;
+  /* 新连接在 HEADER_TIMEOUT_SEC 内必须发来完整的请求头 */
+  timer_schedule(&w->timers, &uc->conn.timer,
+                 conn_deadline_ms(&uc->conn, 0, w->now_ms));
+  return uc;
+}
+
+/* close 完成：释放响应资源，对象放回空闲链表 */
+static void uconn_free(UringWorker *w, UringConn *uc) {
+  conn_reset_output(&uc->conn);
+  uc->conn.status = 0;
+  uc->next = w->free_list;
+  w->free_list = uc;
+}
+
+/* 在途请求全部结束后提交 close */
+static void uconn_try_release(UringWorker *w, UringConn *uc) {
+  if (!uc->closing || uc->inflight > 0 || uc->close_submitted) {
+    return;
+  }
+  uring_prep_close(worker_sqe(w), uc->conn.fd, op_data(uc, OP_CLOSE));
+  uc->close_submitted = 1;
+  uc->inflight++;
+}
+
+static void uconn_close(UringWorker *w, UringConn *uc) {
+  if (uc->closing) {
+    return;
+  }
+  log_debug("Client fd=%d closed after %d requests", uc->conn.fd,
+            uc->conn.requests);
+  uc->closing = 1;
+  timer_cancel(&w->timers, &uc->conn.timer);
+  metrics_add(METRIC_CONN_CLOSED, 1);
+  if (uc->inflight > 0) {
+    uring_prep_cancel_fd(worker_sqe(w), uc->conn.fd, op_data(uc, OP_CANCEL));
+    uc->inflight++;
+  }
+  uconn_try_release(w, uc);
+}
+
+/*
+ * 按输出状态机的当前进度提交一条发送链：
+ * [响应头] -> [缓存/静态响应体] 或 [响应头] -> [读文件 -> 发送]
+ * 发送带 MSG_WAITALL，内核在 socket 可写时自行续传，整段发完才完成；
+ * 文件读取不足一块时链接被截断，后面的发送以 -ECANCELED 结束，
+ * 下一轮从已读到的数据继续
+ * 没有剩余输出时返回 0
+ */
+static int uconn_submit_output(UringWorker *w, UringConn *uc) {
+  Connection *conn = &uc->conn;
+  struct io_uring_sqe *sqe = NULL;
+  int more_file =
+      conn->file_fd >= 0 &&
+      (conn->file_remaining > 0 || uc->chunk_pos < uc->chunk_len);
+  int count = 0;
+
+  if (uring_sq_space(&w->ring) < 3) {
+    uring_submit(&w->ring);
+  }
+
+  if (conn->out_pos < conn->out_len) {
+    int more = conn->body_pos < conn->body_len || more_file;
+
+    sqe = worker_sqe(w);
+    uring_prep_send(sqe, conn->fd, conn->out + conn->out_pos,
+                    conn->out_len - conn->out_pos,
+                    MSG_WAITALL | (more ? MSG_MORE : 0),
+                    op_data(uc, OP_SEND_HEAD));
+    count++;
+  }
+
+  if (conn->body_pos < conn->body_len) {
+    if (sqe != NULL) {
+      sqe->flags |= IOSQE_IO_LINK;
+    }
+    sqe = worker_sqe(w);
+    uring_prep_send(sqe, conn->fd, conn->body + conn->body_pos,
+                    conn->body_len - conn->body_pos, MSG_WAITALL,
+                    op_data(uc, OP_SEND_BODY));
+    count++;
+  } else if (more_file) {
+    size_t len = uc->chunk_len - uc->chunk_pos;
+    const char *data = uc->chunk + uc->chunk_pos;
+    off_t after = conn->file_remaining; /* 这次发送之后文件还剩的字节数 */
+
+    if (uc->chunk == NULL) {
+      uc->chunk = (char *)malloc(URING_CHUNK_SIZE);
+      if (uc->chunk == NULL) {
+        log_error("malloc chunk fail, fd=%d", conn->fd);
+        uconn_close(w, uc);
+        return 1;
+      }
+    }
+    if (len == 0) {
+      len = conn->file_remaining < URING_CHUNK_SIZE ? (size_t)conn->file_remaining
+                                                    : URING_CHUNK_SIZE;
+      data = uc->chunk;
+      after -= (off_t)len;
+      if (sqe != NULL) {
+        sqe->flags |= IOSQE_IO_LINK;
+      }
+      sqe = worker_sqe(w);
+      uring_prep_read(sqe, conn->file_fd, uc->chunk, len,
+                      (uint64_t)conn->file_offset, op_data(uc, OP_READ));
+      count++;
+    }
+    if (sqe != NULL) {
+      sqe->flags |= IOSQE_IO_LINK;
+    }
+    sqe = worker_sqe(w);
+    uring_prep_send(sqe, conn->fd, data, len,
+                    MSG_WAITALL | (after > 0 ? MSG_MORE : 0),
+                    op_data(uc, OP_SEND_CHUNK));
+    count++;
+  }
+
+  uc->chain = count;
+  uc->chain_failed = 0;
+  uc->inflight += count;
+  return count > 0;
+}
+
+/*
+ * 推进连接：发送当前响应，发完后依次处理缓冲区中已收到的后续请求
+ * 提交了发送链就返回，链上的 CQE 全部回来后再次进入
+ * 每次提交发送链都重设发送超时，停下来等待请求时重设请求头/空闲超时
+ */
+static void uconn_run(UringWorker *w, UringConn *uc) {
+  Connection *conn = &uc->conn;
+
+  while (!uc->closing && uc->chain == 0) {
+    if (uconn_submit_output(w, uc)) {
+      if (!uc->closing) {
+        timer_schedule(&w->timers, &conn->timer,
+                       conn_deadline_ms(conn, 1, w->now_ms));
+      }
+      return;
+    }
+    if (uc->responding) {
+      uc->responding = 0;
+      conn_reset_output(conn);
+      conn_finish_response(conn);
+      if (!conn->keep_alive) {
+        uconn_close(w, uc);
+        return;
+      }
+    }
+    if (!conn_next_request(conn)) {
+      if (uc->peer_closed || uc->rx_overflow) {
+        uconn_close(w, uc);
+      } else {
+        timer_schedule(&w->timers, &conn->timer,
+                       conn_deadline_ms(conn, 0, w->now_ms));
+      }
+      return;
+    }
+    uc->responding = 1;
+  }
+}
+
+/*
+ * 把 provided buffer 中的数据追加到接收缓冲区
+ * 缓冲区已到 MAX_REQUEST_SIZE 仍放不下时标记溢出：
+ * 已完整收到的请求照常处理，之后关闭连接（单个请求头过大时先回复 431）
+ */
+static void uconn_append(UringConn *uc, const char *data, size_t len) {
+  Connection *conn = &uc->conn;
+  size_t room;
+
+  if (uc->rx_overflow) {
+    return;
+  }
+  if (conn->req_start_us == 0) {
+    conn->req_start_us = metrics_now_us();
+  }
+  while ((size_t)(conn->cap - conn->len) < len && conn_grow_buffer(conn) == 0) {
+  }
+  room = (size_t)(conn->cap - conn->len);
+  if (room < len) {
+    uc->rx_overflow = 1;
+    len = room;
+  }
+  memcpy(conn->buffer + conn->len, data, len);
+  conn->len += (int)len;
+}
+
+static void uconn_on_recv(UringWorker *w, UringConn *uc, int res,
+                          unsigned flags) {
+  if (!(flags & IORING_CQE_F_MORE)) {
+    uc->recv_armed = 0;
+    uc->inflight--;
+  }
+
+  if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+    unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+    if (!uc->closing) {
+      uconn_append(uc, uring_buf_ring_buffer(&w->bufs, bid), (size_t)res);
+    }
+    uring_buf_ring_recycle(&w->bufs, bid);
+  } else if (res == 0) {
+    uc->peer_closed = 1;
+  } else if (res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+    log_debug("recv fail, fd=%d: %s", uc->conn.fd, strerror(-res));
+    uconn_close(w, uc);
+  }
+
+  if (uc->closing) {
+    uconn_try_release(w, uc);
+    return;
+  }
+  /* multishot 在缓冲区耗尽等情况下会停止，需要重新提交 */
+  if (!uc->recv_armed && !uc->peer_closed) {
+    uconn_arm_recv(w, uc);
+  }
+  uconn_run(w, uc);
+}
+
+/* 发送链上的一个 CQE：按操作类型推进对应的进度 */
+static void uconn_on_chain(UringWorker *w, UringConn *uc, unsigned op,
+                           int res) {
+  Connection *conn = &uc->conn;
+
+  uc->inflight--;
+  uc->chain--;
+
+  if (res < 0) {
+    /* 链中前一个请求失败或读取不足时，后面的请求以 -ECANCELED 结束 */
+    if (res != -ECANCELED) {
+      log_debug("uring op %u fail, fd=%d: %s", op, conn->fd, strerror(-res));
+      uc->chain_failed = 1;
+    }
+  } else if (op == OP_READ) {
+    if (res == 0) {
+      log_warn("file truncated while sending, fd=%d", conn->fd);
+      uc->chain_failed = 1;
+    }
+    uc->chunk_len = (size_t)res;
+    uc->chunk_pos = 0;
+    conn->file_offset += res;
+    conn->file_remaining -= res;
+  } else {
+    if (op == OP_SEND_HEAD) {
+      conn->out_pos += (size_t)res;
+    } else if (op == OP_SEND_BODY) {
+      conn->body_pos += (size_t)res;
+    } else {
+      uc->chunk_pos += (size_t)res;
+      if (uc->chunk_pos == uc->chunk_len) {
+        uc->chunk_pos = 0;
+        uc->chunk_len = 0;
+      }
+    }
+    conn_note_sent(conn, (uint64_t)res);
+  }
+
+  if (uc->chain > 0) {
+    return;
+  }
+  if (uc->closing) {
+    uconn_try_release(w, uc);
+  } else if (uc->chain_failed) {
+    uconn_close(w, uc);
+  } else {
+    uconn_run(w, uc);
+  }
+}
+
+static void worker_on_accept(UringWorker *w, int res, unsigned flags) {
+  UringConn *uc;
+
+  if (!(flags & IORING_CQE_F_MORE)) {
+    worker_arm_accept(w);
+  }
+  if (res < 0) {
+    log_warn("accept fail: %s", strerror(-res));
+    return;
+  }
+
+  uc = uconn_open(w, res);
+  if (uc == NULL) {
+    log_warn("Out of memory, fd=%d rejected", res);
+    close(res);
+    return;
+  }
+  metrics_add(METRIC_CONN_ACCEPTED, 1);
+  log_debug("Client connected: fd=%d, worker=%d", res, w->id);
+  uconn_arm_recv(w, uc);
+}
+
+/* 时间轮到期：等待请求或发送链超过截止时刻没有进度 */
+static void worker_on_timeout(TimerWheel *wheel, TimerNode *node, void *arg) {
+  UringConn *uc = (UringConn *)((char *)node - offsetof(UringConn, conn.timer));
+
+  (void)wheel;
+  log_debug("Client fd=%d timed out", uc->conn.fd);
+  metrics_add(METRIC_CONN_TIMEOUTS, 1);
+  uconn_close((UringWorker *)arg, uc);
+}
+
+static void worker_complete(UringWorker *w, uint64_t user_data, int res,
+                            unsigned flags) {
+  unsigned op = (unsigned)(user_data & OP_MASK);
+  UringConn *uc = (UringConn *)(uintptr_t)(user_data & ~OP_MASK);
+
+  switch (op) {
+  case OP_ACCEPT:
+    worker_on_accept(w, res, flags);
+    break;
+  case OP_RECV:
+    uconn_on_recv(w, uc, res, flags);
+    break;
+  case OP_SEND_HEAD:
+  case OP_SEND_BODY:
+  case OP_READ:
+  case OP_SEND_CHUNK:
+    uconn_on_chain(w, uc, op, res);
+    break;
+  case OP_CANCEL:
+    uc->inflight--;
+    uconn_try_release(w, uc);
+    break;
+  case OP_CLOSE:
+    uconn_free(w, uc);
+    break;
+  default:
+    log_error("unknown uring op %u", op);
+    break;
+  }
+}
+
+/*
+ * 优先使用 SINGLE_ISSUER + DEFER_TASKRUN（完成处理推迟到本线程进入内核时，
+ * 减少中断上下文切换），内核不支持时退回默认模式
+ */
+static int worker_init(UringWorker *w) {
+  int ret;
+
+  ret = uring_init(&w->ring, URING_ENTRIES,
+                   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN);
+  if (ret == -EINVAL) {
+    ret = uring_init(&w->ring, URING_ENTRIES, 0);
+  }
+  if (ret < 0) {
+    log_error("Worker %d: io_uring_setup fail: %s", w->id, strerror(-ret));
+    return -1;
+  }
+
+  ret = uring_buf_ring_init(&w->ring, &w->bufs, URING_BUF_GROUP,
+                            URING_RECV_BUFS, URING_RECV_BUF_SIZE);
+  if (ret < 0) {
+    log_error("Worker %d: register buffer ring fail: %s", w->id,
+              strerror(-ret));
+    uring_destroy(&w->ring);
+    return -1;
+  }
+
+  w->listen_fd = create_listen_socket(1);
+  if (w->listen_fd < 0) {
+    uring_buf_ring_destroy(&w->ring, &w->bufs);
+    uring_destroy(&w->ring);
+    return -1;
+  }
+
+  w->now_ms = metrics_now_us() / 1000;
+  timer_wheel_init(&w->timers, w->now_ms, CONN_TIMER_TICK_MS);
+  log_info("Worker %d: io_uring fd=%d, listen fd=%d", w->id, w->ring.fd,
+           w->listen_fd);
+  return 0;
+}
+
+/*
+ * 事件循环：一次 io_uring_enter 提交上一轮产生的全部 SQE 并等待新的 CQE，
+ * 等待时间取自时间轮，到最近的截止时刻为止
+ */
+static void worker_run(UringWorker *w) {
+  struct io_uring_cqe *cqe;
+
+  worker_arm_accept(w);
+
+  while (1) {
+    int timeout = timer_wheel_timeout_ms(&w->timers, w->now_ms);
+    int ret = uring_submit_and_wait_timeout(&w->ring, 1, timeout);
+
+    if (ret < 0 && ret != -EINTR && ret != -EBUSY && ret != -ETIME) {
+      log_error("Worker %d: io_uring_enter fail: %s", w->id, strerror(-ret));
+      break;
+    }
+
+    w->now_ms = metrics_now_us() / 1000;
+    timer_wheel_advance(&w->timers, w->now_ms, worker_on_timeout, w);
+    while ((cqe = uring_peek_cqe(&w->ring)) != NULL) {
+      uint64_t user_data = cqe->user_data;
+      int res = cqe->res;
+      unsigned flags = cqe->flags;
+
+      uring_cqe_seen(&w->ring);
+      worker_complete(w, user_data, res, flags);
+    }
+    /* 本轮回收的接收缓冲区一次性还给内核 */
+    uring_buf_ring_publish(&w->bufs);
+  }
+}
+
+static void *worker_routine(void *arg) {
+  UringWorker *w = (UringWorker *)arg;
+
+  if (w->cpu >= 0) {
+    cpu_set_t cpus;
+    int err;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(w->cpu, &cpus);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0) {
+      log_error("Worker %d: pin to cpu %d failed: %s", w->id, w->cpu,
+                strerror(err));
+    }
+  }
+
+  /* SINGLE_ISSUER 要求 ring 由提交请求的线程创建 */
+  if (worker_init(w) == 0) {
+    worker_run(w);
+  }
+  return NULL;
+}
+
+int uring_engine_probe(void) {
+  UringBufRing bufs;
+  Uring ring;
+  int ret;
+
+  ret = uring_init(&ring, 8, 0);
+  if (ret < 0) {
+    log_warn("io_uring unavailable: %s", strerror(-ret));
+    return -1;
+  }
+  ret = uring_buf_ring_init(&ring, &bufs, URING_BUF_GROUP, 8, 64);
+  if (ret < 0) {
+    log_warn("io_uring provided buffer ring unavailable: %s", strerror(-ret));
+    uring_destroy(&ring);
+    return -1;
+  }
+  uring_buf_ring_destroy(&ring, &bufs);
+  uring_destroy(&ring);
+  return 0;
+}
+
+int uring_engine_run(int threads, int pin_cpu) {
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  UringWorker *workers;
+  int i;
+
+  if (ncpu < 1) {
+    ncpu = 1;
+  }
+  workers = (UringWorker *)calloc((size_t)threads, sizeof(UringWorker));
+  if (workers == NULL) {
+    log_error("calloc workers fail: %m");
+    return -1;
+  }
+
+  for (i = 0; i < threads; i++) {
+    workers[i].id = i;
+    workers[i].cpu = pin_cpu ? (int)(i % ncpu) : -1;
+    workers[i].listen_fd = -1;
+    if (pthread_create(&workers[i].thread, NULL, worker_routine,
+                       &workers[i]) != 0) {
+      log_error("Failed to start worker %d", i);
+      return -1;
+    }
+  }
+  for (i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  free(workers);
+  return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef HTTP_URING_ENGINE_H
+#define HTTP_URING_ENGINE_H
+
+/*
+ * io_uring 引擎（-u）：每个线程一个 ring 与一个 SO_REUSEPORT 监听 socket
+ * - multishot accept / multishot recv，接收数据落在内核挑选的 provided buffer 中
+ * - 响应头、响应体（或文件读取 + 发送）组成一条链接请求，一次提交
+ * - 每轮事件循环只进入内核一次：提交本轮所有 SQE 并等待下一批 CQE
+ * 请求解析、路由与响应生成与 epoll 引擎共用（server.h）
+ */
+
+/* 检查内核是否支持引擎用到的特性，不支持时返回 -1 */
+int uring_engine_probe(void);
+
+/*
+ * 启动 threads 个事件循环线程并等待它们退出
+ * pin_cpu 为 1 时线程 i 绑定到 CPU i % 在线 CPU 数
+ */
+int uring_engine_run(int threads, int pin_cpu);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C（Castagnoli 多项式，与 iSCSI / ext4 相同）
+// x86-64 上支持 SSE4.2 时用 crc32 指令，aarch64 上用 CRC 扩展指令，
+// 否则用查表法（slice-by-8）；首次调用时自动选择
+//
+// 可以分段计算：crc32c(crc32c(0, a, n), b, m) == crc32c(0, a+b, n+m)
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+// 当前使用的实现："sse4.2"、"armv8-crc" 或 "table"
+const char *crc32c_impl(void);
+
+#endif
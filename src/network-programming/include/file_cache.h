@@ -0,0 +1,40 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "transfer.h"
+
+// 服务器打开文件的共享缓存
+//
+// 同一个文件被多个客户端同时下载时共用一个 fd，
+// 每个 256KB 块的 CRC32C 也只算一次；sendfile 和 pread 使用各自的 offset，不改变共享 fd 的文件位置
+// 每次打开都会 stat 一次，文件被替换或修改（inode、大小、修改时间变化）后换成新的缓存项，
+// 旧的缓存项在最后一个使用者释放后关闭
+
+#define FILE_CACHE_SLOTS 16
+
+typedef struct CachedFile
+{
+    char name[TRANSFER_NAME_MAX + 1];
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    FileIdentity ident;
+    uint32_t *chunk_crc;        // 每块的 CRC32C，chunk_ready 置位后有效
+    unsigned char *chunk_ready;
+    int refs;                   // 缓存表持有一个引用，每个使用者各持有一个
+    uint64_t last_used;
+} CachedFile;
+
+// 打开 dir 下的 name，返回带引用的缓存项，用完后调用 file_cache_release
+// 返回值: 失败返回 NULL，errno 为 open / fstat 的错误
+CachedFile *file_cache_open(const char *dir, const char *name);
+void file_cache_release(CachedFile *file);
+
+// [offset, offset + len) 的 CRC32C；完整的对齐块从缓存取，其他情况用 pread 读出来计算
+// 返回值: 成功返回 0；文件被截断等读不满时返回 -1，只影响这一次请求
+int file_cache_crc(CachedFile *file, uint64_t offset, uint32_t len, uint32_t *crc);
+
+#endif
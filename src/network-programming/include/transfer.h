@@ -0,0 +1,79 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 分块文件传输协议
+//
+// 所有消息都是「帧头 + 负载」，帧头 24 字节，整数按网络字节序：
+//   magic(4) type(2) flags(2) length(4) crc(4) offset(8)
+//
+// 一次下载（整个文件或其中的一段 [offset, end)）：
+//   客户端 -> REQUEST  offset = 续传位置，负载 = 文件标识(16) + end(8) + 文件名
+//                      end 为 0 表示到文件末尾；flags 带 REQUEST_INFO_ONLY 时只要文件信息
+//   服务器 -> INFO     offset = 实际开始位置，负载 = 文件标识(16)
+//                      文件标识与请求中的不一致（文件变了或第一次下载）时从 0 开始
+//   服务器 -> DATA ... offset = 块在文件中的位置，length = 块大小，
+//                      crc = 块数据的 CRC32C，负载 = 块数据
+//   服务器 -> DONE     offset = 这一段的结束位置
+// 出错时服务器回 ERROR，负载为错误信息
+//
+// 客户端只把校验通过的块写入 .part 文件，断线后用 .part 的大小作为续传位置；
+// 多连接下载时每个连接请求一段，各段的进度另存，分别续传
+
+#define TRANSFER_MAGIC 0x58465231u           // "XFR1"
+#define TRANSFER_CHUNK_SIZE (256 * 1024)     // 每个 DATA 帧的最大负载
+#define TRANSFER_NAME_MAX 255
+#define FRAME_HEADER_SIZE 24
+#define FILE_IDENTITY_SIZE 16
+#define REQUEST_FIXED_SIZE (FILE_IDENTITY_SIZE + 8)  // REQUEST 负载中文件名之前的部分
+
+#define REQUEST_INFO_ONLY 0x1   // REQUEST flags：只回 INFO 和 DONE，不发数据
+
+enum
+{
+    FRAME_REQUEST = 1,
+    FRAME_INFO,
+    FRAME_DATA,
+    FRAME_DONE,
+    FRAME_ERROR,
+};
+
+typedef struct
+{
+    uint16_t type;
+    uint16_t flags;     // REQUEST：REQUEST_INFO_ONLY 等标志；其他帧填 0
+    uint32_t length;    // 负载长度
+    uint32_t crc;       // DATA：负载的 CRC32C
+    uint64_t offset;
+} FrameHeader;
+
+// 文件标识：大小 + 修改时间，用来判断续传时服务器上的文件是否还是同一个
+typedef struct
+{
+    uint64_t size;
+    int64_t mtime_ns;
+} FileIdentity;
+
+// 读满 / 写满 len 字节，处理 EINTR 和短读写
+// 返回值: 成功返回0；出错返回-1，对端关闭时 errno 为 ECONNRESET
+int read_full(int fd, void *buf, size_t len);
+int write_full(int fd, const void *buf, size_t len);
+
+// 发送帧头和 payload_len 字节的负载
+// payload_len 小于 hdr->length 时其余负载由调用方随后发送（如 sendfile），
+// 帧头带 MSG_MORE 与后续数据合并成满的 TCP 段
+int frame_send(int fd, const FrameHeader *hdr, const void *payload, size_t payload_len);
+
+// 接收并校验帧头（magic），负载由调用方读取
+int frame_recv(int fd, FrameHeader *hdr);
+
+// 64 位整数按网络字节序读写，用于帧负载
+void put_be64(unsigned char *out, uint64_t value);
+uint64_t get_be64(const unsigned char *in);
+
+void identity_encode(const FileIdentity *id, unsigned char out[FILE_IDENTITY_SIZE]);
+void identity_decode(FileIdentity *id, const unsigned char in[FILE_IDENTITY_SIZE]);
+
+#endif
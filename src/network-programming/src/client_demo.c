@@ -2,77 +2,637 @@
 // Created by idris-24-04 on 2026/3/16.
 //
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include "crc32c.h"
+#include "transfer.h"
+
 #define SERVER_PORT 9999
 #define MAX_CNT 1024
 #define DOWNLOAD_DIR "./downloads/"
+#define MAX_RETRY 10           // 断线后最多重连次数
+#define RETRY_INTERVAL_SEC 1
+#define PROGRESS_INTERVAL_MS 200   // 进度输出的最小间隔
+#define MAX_STREAMS 16             // 多连接下载的最大连接数
 
-// 从服务器接收文件
-int receive_file(int client_fd, const char *expected_filename)
+// 连接服务器
+// 返回值: 成功返回套接字，失败返回-1
+int connect_server(const struct sockaddr_in *server_addr)
 {
-    char file_buf[MAX_CNT];
-    int write_cnt;
-    long file_size = 0;
-    
-    // 先接收文件大小
-    read(client_fd, &file_size, sizeof(file_size));
-    printf("File size: %ld bytes\n", file_size);
-    
-    if (file_size <= 0)
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
     {
-        printf("Invalid file size\n");
+        perror("socket fail");
         return -1;
     }
-    
-    // 构建保存路径
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s", DOWNLOAD_DIR, expected_filename);
-    
-    // 创建下载目录
-    mkdir(DOWNLOAD_DIR, 0755);
-    
-    // 打开文件准备写入
-    int file_fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (file_fd == -1)
+    if (connect(fd, (const struct sockaddr *)server_addr, sizeof(*server_addr)) == -1)
     {
-        perror("open file fail");
+        perror("connect fail");
+        close(fd);
         return -1;
     }
-    
-    printf("Saving to: %s\n", filepath);
-    
-    // 接收文件内容
-    long total_received = 0;
-    while (total_received < file_size)
+    return fd;
+}
+
+// 从 fd 的 offset 处写满 len 字节
+int pwrite_full(int fd, const void *buf, size_t len, off_t offset)
+{
+    const char *p = buf;
+
+    while (len > 0)
     {
-        int to_read = (file_size - total_received) > MAX_CNT ? MAX_CNT : (file_size - total_received);
-        write_cnt = read(client_fd, file_buf, to_read);
-        if (write_cnt <= 0)
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0)
         {
-            perror("read file data fail");
-            close(file_fd);
+            if (errno == EINTR)
+            {
+                continue;
+            }
             return -1;
         }
-        write(file_fd, file_buf, write_cnt);
-        total_received += write_cnt;
-        printf("\rProgress: %ld/%ld bytes (%.1f%%)", total_received, file_size, 
-               (double)total_received / file_size * 100);
-        fflush(stdout);
+        p += n;
+        len -= (size_t)n;
+        offset += n;
     }
-    
-    close(file_fd);
+    return 0;
+}
+
+// 毫秒级单调时钟，用于限制进度输出频率
+uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// 打印进度，两次输出至少间隔 PROGRESS_INTERVAL_MS（force 时立即输出）
+void print_progress(uint64_t done, uint64_t total, int force)
+{
+    static uint64_t last_ms;
+    uint64_t now = now_ms();
+
+    if (!force && now - last_ms < PROGRESS_INTERVAL_MS)
+    {
+        return;
+    }
+    last_ms = now;
+    printf("\rProgress: %lu/%lu bytes (%.1f%%)", (unsigned long)done, (unsigned long)total,
+           total ? (double)done / (double)total * 100 : 100.0);
+    fflush(stdout);
+}
+
+// 发送 REQUEST 并接收 INFO：请求 [offset, end)（end 为 0 表示到文件末尾）
+// ident 传入上次的文件标识，返回时为服务器当前的文件标识；*start 为服务器实际的开始位置
+// 返回值: 成功返回0；连接出错返回-1；服务器报错返回-2
+int request_file(int client_fd, const char *remote_name, uint64_t offset, uint64_t end,
+                 uint16_t flags, FileIdentity *ident, uint64_t *start)
+{
+    unsigned char req[REQUEST_FIXED_SIZE + TRANSFER_NAME_MAX];
+    size_t name_len = strlen(remote_name);
+    FrameHeader hdr = {.type = FRAME_REQUEST, .flags = flags, .offset = offset};
+
+    // 发送请求：续传位置 + 上次的文件标识 + 结束位置 + 文件名
+    identity_encode(ident, req);
+    put_be64(req + FILE_IDENTITY_SIZE, end);
+    memcpy(req + REQUEST_FIXED_SIZE, remote_name, name_len);
+    hdr.length = (uint32_t)(REQUEST_FIXED_SIZE + name_len);
+    if (frame_send(client_fd, &hdr, req, hdr.length) == -1 || frame_recv(client_fd, &hdr) == -1)
+    {
+        perror("request fail");
+        return -1;
+    }
+
+    if (hdr.type == FRAME_ERROR)
+    {
+        char msg[MAX_CNT] = {0};
+        if (hdr.length >= sizeof(msg) || read_full(client_fd, msg, hdr.length) == -1)
+        {
+            return -1;
+        }
+        printf("Server error: %s\n", msg);
+        return -2;
+    }
+    if (hdr.type != FRAME_INFO || hdr.length != FILE_IDENTITY_SIZE || read_full(client_fd, req, FILE_IDENTITY_SIZE) == -1)
+    {
+        printf("Invalid file info\n");
+        return -1;
+    }
+    identity_decode(ident, req);
+    *start = hdr.offset;
+    return 0;
+}
+
+// 接收 DATA 直到 DONE，校验通过的块写入 file_fd 并推进 *offset
+// total 非 0 时打印整个文件的下载进度
+// 返回值: 收到 DONE 且数据完整返回0；连接断开或数据损坏返回-1（可以重连续传）；写文件失败返回-2
+int receive_chunks(int client_fd, int file_fd, uint64_t *offset, uint64_t total)
+{
+    unsigned char *chunk = malloc(TRANSFER_CHUNK_SIZE);
+    FrameHeader hdr;
+    int ret = -1;
+
+    if (chunk == NULL)
+    {
+        return -2;
+    }
+    while (1)
+    {
+        if (frame_recv(client_fd, &hdr) == -1)
+        {
+            perror("\nread frame fail");
+            break;
+        }
+        if (hdr.type == FRAME_DONE)
+        {
+            ret = hdr.offset == *offset ? 0 : -1;
+            break;
+        }
+        if (hdr.type != FRAME_DATA || hdr.offset != *offset || hdr.length > TRANSFER_CHUNK_SIZE)
+        {
+            printf("\nUnexpected frame: type %u, offset %lu\n", hdr.type, (unsigned long)hdr.offset);
+            break;
+        }
+        if (read_full(client_fd, chunk, hdr.length) == -1)
+        {
+            perror("\nread file data fail");
+            break;
+        }
+        if (crc32c(0, chunk, hdr.length) != hdr.crc)
+        {
+            printf("\nChecksum mismatch at offset %lu\n", (unsigned long)hdr.offset);
+            break;
+        }
+        if (pwrite_full(file_fd, chunk, hdr.length, (off_t)hdr.offset) == -1)
+        {
+            perror("\nwrite file fail");
+            ret = -2;
+            break;
+        }
+        // 多连接下载时主线程会并发读取各段进度
+        __atomic_store_n(offset, *offset + hdr.length, __ATOMIC_RELAXED);
+        if (total > 0)
+        {
+            print_progress(*offset, total, 0);
+        }
+    }
+    free(chunk);
+    return ret;
+}
+
+// 请求文件并接收到 part_fd，*offset 为续传位置，收到的每个块校验通过后才写入并推进
+// ident 为上次下载时服务器的文件标识，服务器决定从头发送时会更新它
+// 返回值: 完成返回0；连接断开或数据损坏返回-1（可以重连续传）；服务器报错返回-2
+int receive_file(int client_fd, const char *remote_name, int part_fd, const char *info_path,
+                 uint64_t *offset, FileIdentity *ident)
+{
+    unsigned char buf[FILE_IDENTITY_SIZE];
+    uint64_t start;
+    int ret;
+
+    ret = request_file(client_fd, remote_name, *offset, 0, 0, ident, &start);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    // 服务器从头发送（第一次下载，或者服务器上的文件已经变了）：丢弃已下载的部分
+    if (start != *offset)
+    {
+        if (start != 0 || ftruncate(part_fd, 0) == -1)
+        {
+            printf("Unexpected start offset %lu\n", (unsigned long)start);
+            return -1;
+        }
+        *offset = 0;
+    }
+    identity_encode(ident, buf);
+    int info_fd = open(info_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (info_fd == -1 || write_full(info_fd, buf, FILE_IDENTITY_SIZE) == -1)
+    {
+        perror("write resume info fail");
+    }
+    if (info_fd != -1)
+    {
+        close(info_fd);
+    }
+
+    printf("File size: %lu bytes, start at %lu\n", (unsigned long)ident->size, (unsigned long)*offset);
+
+    // 接收文件内容
+    ret = receive_chunks(client_fd, part_fd, offset, ident->size);
+    if (ret == 0)
+    {
+        print_progress(*offset, ident->size, 1);
+    }
+    return ret;
+}
+
+// 下载文件的保存路径：最终文件、下载中的 .part、单连接续传信息、多连接各段进度
+typedef struct
+{
+    char file[256];
+    char part[300];
+    char info[320];
+    char ranges[320];
+} DownloadPaths;
+
+void download_paths(DownloadPaths *paths, const char *local_name)
+{
+    snprintf(paths->file, sizeof(paths->file), "%s%s", DOWNLOAD_DIR, local_name);
+    snprintf(paths->part, sizeof(paths->part), "%s.part", paths->file);
+    snprintf(paths->info, sizeof(paths->info), "%s.info", paths->part);
+    snprintf(paths->ranges, sizeof(paths->ranges), "%s.ranges", paths->part);
+}
+
+// 下载完成：落盘后把 .part 改名为最终文件，删除续传信息
+int finish_download(int part_fd, const DownloadPaths *paths)
+{
+    if (fsync(part_fd) == -1 || rename(paths->part, paths->file) == -1)
+    {
+        perror("save file fail");
+        return -1;
+    }
+    unlink(paths->info);
+    unlink(paths->ranges);
     printf("\nFile received successfully!\n");
     return 0;
 }
 
+// 下载文件，断线或校验失败时重连并从已收到的位置续传
+// 已收到的数据保存在 <文件名>.part，服务器的文件标识保存在 <文件名>.part.info，
+// 程序退出后再次下载同一个文件也能续传
+int download_file(int *client_fd, const struct sockaddr_in *server_addr,
+                  const char *remote_name, const char *local_name)
+{
+    DownloadPaths paths;
+    unsigned char buf[FILE_IDENTITY_SIZE];
+    FileIdentity ident = {0, 0};
+    uint64_t offset = 0;
+    struct stat st;
+    int ret = -1;
+
+    download_paths(&paths, local_name);
+
+    // 上次是多连接下载时 .part 中间可能有空洞，不能按大小续传
+    if (unlink(paths.ranges) == 0)
+    {
+        unlink(paths.info);
+    }
+
+    // 打开文件准备写入，已有 .part 和文件标识时从 .part 的末尾续传
+    int part_fd = open(paths.part, O_WRONLY | O_CREAT, 0644);
+    if (part_fd == -1)
+    {
+        perror("open file fail");
+        return -1;
+    }
+    int info_fd = open(paths.info, O_RDONLY);
+    if (info_fd != -1)
+    {
+        if (read_full(info_fd, buf, sizeof(buf)) == 0 && fstat(part_fd, &st) == 0)
+        {
+            identity_decode(&ident, buf);
+            offset = (uint64_t)st.st_size;
+        }
+        close(info_fd);
+    }
+    if (offset > 0)
+    {
+        printf("Resuming %s from %lu bytes\n", paths.part, (unsigned long)offset);
+    }
+    else if (ftruncate(part_fd, 0) == -1)
+    {
+        // 没有续传信息时 .part 里的内容不可信（如多连接下载预分配的整个文件），从头下载前清空
+        perror("truncate file fail");
+        close(part_fd);
+        return -1;
+    }
+
+    printf("Saving to: %s\n", paths.file);
+
+    for (int attempt = 0; attempt <= MAX_RETRY; attempt++)
+    {
+        if (*client_fd == -1)
+        {
+            if (attempt > 0)
+            {
+                sleep(RETRY_INTERVAL_SEC);
+                printf("Reconnecting (%d/%d)...\n", attempt, MAX_RETRY);
+            }
+            *client_fd = connect_server(server_addr);
+            if (*client_fd == -1)
+            {
+                continue;
+            }
+        }
+
+        ret = receive_file(*client_fd, remote_name, part_fd, paths.info, &offset, &ident);
+        if (ret != -1)
+        {
+            break;
+        }
+
+        // 连接已不可用：关闭后重连，从 offset 续传
+        close(*client_fd);
+        *client_fd = -1;
+        printf("\nConnection lost at %lu bytes, will resume\n", (unsigned long)offset);
+    }
+
+    if (ret == 0)
+    {
+        ret = finish_download(part_fd, &paths);
+    }
+    else if (offset == 0)
+    {
+        // 一个字节都没收到（如文件不存在），不留下空的 .part
+        unlink(paths.part);
+        unlink(paths.info);
+    }
+    close(part_fd);
+    return ret == 0 ? 0 : -1;
+}
+
+// 多连接下载中的一段 [next, end)，由一个线程用自己的连接下载
+typedef struct
+{
+    const struct sockaddr_in *server_addr;
+    const char *remote_name;
+    FileIdentity ident;     // 各段必须来自同一个文件
+    int file_fd;
+    uint64_t next;          // 下一个要接收的字节，下载线程推进，主线程读取
+    uint64_t end;
+    int result;             // 0 完成，-1 重试用尽，-2 服务器报错或文件已变
+    int finished;
+    pthread_t thread;
+} RangeTask;
+
+// 下载线程：断线或校验失败时重连，从本段已收到的位置续传
+void *range_worker(void *arg)
+{
+    RangeTask *task = arg;
+    int ret = -1;
+
+    for (int attempt = 0; attempt <= MAX_RETRY && task->next < task->end; attempt++)
+    {
+        FileIdentity ident = task->ident;
+        uint64_t start;
+        int fd;
+
+        if (attempt > 0)
+        {
+            sleep(RETRY_INTERVAL_SEC);
+        }
+        fd = connect_server(task->server_addr);
+        if (fd == -1)
+        {
+            continue;
+        }
+        ret = request_file(fd, task->remote_name, task->next, task->end, 0, &ident, &start);
+        if (ret == 0 && (start != task->next || ident.size != task->ident.size
+                         || ident.mtime_ns != task->ident.mtime_ns))
+        {
+            printf("\nFile changed on server, abort\n");
+            ret = -2;
+        }
+        if (ret == 0)
+        {
+            ret = receive_chunks(fd, task->file_fd, &task->next, 0);
+        }
+        close(fd);
+        if (ret != -1)
+        {
+            break;
+        }
+    }
+    if (task->next >= task->end)
+    {
+        ret = 0;
+    }
+    task->result = ret;
+    __atomic_store_n(&task->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// 保存各段进度：文件标识(16) + 段数(8) + 每段 next(8) end(8)
+// 只记录已经写入文件的位置，程序退出后可以按段续传
+void save_ranges(const char *path, const RangeTask *tasks, int count)
+{
+    unsigned char buf[FILE_IDENTITY_SIZE + 8 + MAX_STREAMS * 16];
+    size_t len = FILE_IDENTITY_SIZE + 8;
+
+    identity_encode(&tasks[0].ident, buf);
+    put_be64(buf + FILE_IDENTITY_SIZE, (uint64_t)count);
+    for (int i = 0; i < count; i++)
+    {
+        put_be64(buf + len, __atomic_load_n(&tasks[i].next, __ATOMIC_RELAXED));
+        put_be64(buf + len + 8, tasks[i].end);
+        len += 16;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || write_full(fd, buf, len) == -1)
+    {
+        perror("write ranges fail");
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+// 读取上次的各段进度，文件标识与 ident 不一致、或各段没有首尾相接覆盖整个文件时作废
+// 返回值: 段数，没有可用的进度返回0
+int load_ranges(const char *path, const FileIdentity *ident, RangeTask *tasks)
+{
+    unsigned char buf[FILE_IDENTITY_SIZE + 8 + MAX_STREAMS * 16];
+    FileIdentity saved;
+    ssize_t len;
+    int count;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return 0;
+    }
+    len = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (len < FILE_IDENTITY_SIZE + 8)
+    {
+        return 0;
+    }
+    identity_decode(&saved, buf);
+    count = (int)get_be64(buf + FILE_IDENTITY_SIZE);
+    if (saved.size != ident->size || saved.mtime_ns != ident->mtime_ns
+        || count < 1 || count > MAX_STREAMS || len != FILE_IDENTITY_SIZE + 8 + count * 16)
+    {
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        tasks[i].next = get_be64(buf + FILE_IDENTITY_SIZE + 8 + i * 16);
+        tasks[i].end = get_be64(buf + FILE_IDENTITY_SIZE + 16 + i * 16);
+        // 第 i 段从第 i-1 段的 end 开始
+        if (tasks[i].next < (i > 0 ? tasks[i - 1].end : 0) || tasks[i].next > tasks[i].end
+            || tasks[i].end > ident->size)
+        {
+            return 0;
+        }
+    }
+    if (tasks[count - 1].end != ident->size)
+    {
+        return 0;
+    }
+    return count;
+}
+
+// 多连接下载：把文件分成 streams 段，每段一个连接并行下载，
+// 用 pwrite 写入预先分配好大小的 .part；各段进度保存在 <文件名>.part.ranges
+int download_parallel(const struct sockaddr_in *server_addr, const char *remote_name,
+                      const char *local_name, int streams)
+{
+    RangeTask tasks[MAX_STREAMS];
+    DownloadPaths paths;
+    FileIdentity ident = {0, 0};
+    uint64_t start, total_done = 0, resumed = 0;
+    int count, ret, fd;
+
+    download_paths(&paths, local_name);
+    memset(tasks, 0, sizeof(tasks));
+
+    // 先只取文件信息（大小和标识）
+    fd = connect_server(server_addr);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ret = request_file(fd, remote_name, 0, 0, REQUEST_INFO_ONLY, &ident, &start);
+    close(fd);
+    if (ret != 0)
+    {
+        return -1;
+    }
+
+    int part_fd = open(paths.part, O_WRONLY | O_CREAT, 0644);
+    if (part_fd == -1)
+    {
+        perror("open file fail");
+        return -1;
+    }
+
+    // .part 不见了或者大小不对时，保存的进度指向的数据已经不在了
+    struct stat st;
+    count = 0;
+    if (fstat(part_fd, &st) == 0 && (uint64_t)st.st_size == ident.size)
+    {
+        count = load_ranges(paths.ranges, &ident, tasks);
+    }
+    if (count > 0)
+    {
+        printf("Resuming %s with %d streams\n", paths.part, count);
+    }
+    else
+    {
+        // 新下载：预分配整个文件，按块大小对齐切分，小文件用更少的连接
+        uint64_t chunks = (ident.size + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE;
+        uint64_t per = (chunks + (uint64_t)streams - 1) / (uint64_t)streams;
+
+        unlink(paths.info);
+        if (ftruncate(part_fd, 0) == -1 || (ident.size > 0 && fallocate(part_fd, 0, 0, (off_t)ident.size) == -1
+                                            && ftruncate(part_fd, (off_t)ident.size) == -1))
+        {
+            perror("allocate file fail");
+            close(part_fd);
+            return -1;
+        }
+        count = 0;
+        for (uint64_t off = 0; off < ident.size || count == 0; count++)
+        {
+            tasks[count].next = off;
+            off += per * TRANSFER_CHUNK_SIZE;
+            tasks[count].end = off < ident.size ? off : ident.size;
+        }
+    }
+
+    printf("File size: %lu bytes, %d streams\n", (unsigned long)ident.size, count);
+    for (int i = 0; i < count; i++)
+    {
+        resumed += tasks[i].next - (i > 0 ? tasks[i - 1].end : 0);
+        tasks[i].server_addr = server_addr;
+        tasks[i].remote_name = remote_name;
+        tasks[i].ident = ident;
+        tasks[i].file_fd = part_fd;
+        if (pthread_create(&tasks[i].thread, NULL, range_worker, &tasks[i]) != 0)
+        {
+            perror("pthread_create fail");
+            tasks[i].result = -1;
+            tasks[i].finished = 1;
+            tasks[i].thread = 0;
+        }
+    }
+
+    // 主线程定期汇总进度并保存各段位置，所有段结束后退出
+    uint64_t started_ms = now_ms();
+    while (1)
+    {
+        int finished = 0;
+
+        total_done = 0;
+        for (int i = 0; i < count; i++)
+        {
+            finished += __atomic_load_n(&tasks[i].finished, __ATOMIC_ACQUIRE);
+            // 各段首尾相接，第 i 段从第 i-1 段的 end 开始
+            total_done += __atomic_load_n(&tasks[i].next, __ATOMIC_RELAXED) - (i > 0 ? tasks[i - 1].end : 0);
+        }
+        save_ranges(paths.ranges, tasks, count);
+        print_progress(total_done, ident.size, finished == count);
+        if (finished == count)
+        {
+            break;
+        }
+        usleep(PROGRESS_INTERVAL_MS * 1000);
+    }
+
+    ret = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (tasks[i].thread != 0)
+        {
+            pthread_join(tasks[i].thread, NULL);
+        }
+        if (tasks[i].result != 0)
+        {
+            ret = -1;
+        }
+    }
+
+    // 速率只算这次收到的数据
+    double seconds = (double)(now_ms() - started_ms) / 1000;
+    double mbytes = (double)(total_done - resumed) / 1e6;
+    printf("\n%.1f MB in %.2f s (%.1f MB/s)\n", mbytes, seconds, seconds > 0 ? mbytes / seconds : 0.0);
+    if (ret == 0)
+    {
+        ret = finish_download(part_fd, &paths);
+    }
+    else
+    {
+        printf("Download incomplete, progress kept in %s\n", paths.ranges);
+    }
+    close(part_fd);
+    return ret;
+}
+
 // 显示菜单
 void show_menu()
 {
@@ -87,35 +647,62 @@ void show_menu()
     fflush(stdout);
 }
 
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-a server_ip] [-j streams]\n", prog);
+    fprintf(stderr, "  -a  server address (default 127.0.0.1)\n");
+    fprintf(stderr, "  -j  parallel connections per download, 1-%d (default 1)\n", MAX_STREAMS);
+}
+
 int main(int argc, char *argv[])
 {
-    int client_fd;
+    int client_fd = -1;
+    int streams = 1;
+    const char *server_ip = "127.0.0.1";
     struct sockaddr_in server_addr;
-    char rd_buf[MAX_CNT] = {0};
-    int ret;
+    int opt;
 
-    // 创建 socket 文件描述符
-    client_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_fd == -1)
+    while ((opt = getopt(argc, argv, "a:j:h")) != -1)
     {
-        perror("socket fail");
-        exit(1);
+        switch (opt)
+        {
+        case 'a':
+            server_ip = optarg;
+            break;
+        case 'j':
+            streams = atoi(optarg);
+            if (streams < 1 || streams > MAX_STREAMS)
+            {
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
     }
 
     // 初始化服务器地址结构
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(SERVER_PORT);
-    server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid server address: %s\n", server_ip);
+        exit(1);
+    }
 
-    // 连接服务器
-    ret = connect(client_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
-    if(ret == -1)
+    // 单连接下载时先连上服务器；多连接下载每次下载时各自建立连接
+    if (streams == 1)
     {
-        perror("connect fail");
-        exit(2);
+        client_fd = connect_server(&server_addr);
+        if(client_fd == -1)
+        {
+            exit(2);
+        }
+        printf("---- connect server success.\n");
     }
-    printf("---- connect server success.\n");
     
     // 创建下载目录
     mkdir(DOWNLOAD_DIR, 0755);
@@ -154,58 +741,50 @@ int main(int argc, char *argv[])
             continue;
         }
         
-        // 发送命令到服务器
-        ret = write(client_fd, input_cmd, strlen(input_cmd));
-        if (ret == -1)
+        // 命令对应的服务器文件和本地保存的文件名
+        const char *remote_name = NULL;
+        const char *filename = NULL;
+        if (strcmp(input_cmd, "1") == 0)
         {
-            perror("write fail");
-            break;
+            remote_name = "test.txt";
+            filename = "downloaded_file.txt";
         }
-        printf("Command sent: %s\n", input_cmd);
-        
-        // 接收服务器响应
-        memset(rd_buf, 0, MAX_CNT);
-        ret = read(client_fd, rd_buf, MAX_CNT - 1);
-        if (ret > 0)
-        {
-            rd_buf[ret] = '\0';
-            printf("Server response: %s\n", rd_buf);
-            
-            // 如果服务器开始发送文件
-            if (strstr(rd_buf, "SENDING_FILE") != NULL)
+        else if (strcmp(input_cmd, "2") == 0)
+        {
+            remote_name = "test_image.bmp";
+            filename = "downloaded_image.bmp";
+        }
+        else
+        {
+            remote_name = "test_video.mp4";
+            filename = "downloaded_video.mp4";
+        }
+        printf("Requesting: %s\n", remote_name);
+
+        if (streams > 1)
+        {
+            if (download_parallel(&server_addr, remote_name, filename, streams) == 0)
             {
-                const char *filename = NULL;
-                if (strcmp(input_cmd, "1") == 0)
-                    filename = "downloaded_file.txt";
-                else if (strcmp(input_cmd, "2") == 0)
-                    filename = "downloaded_image.bmp";
-                else if (strcmp(input_cmd, "3") == 0)
-                    filename = "downloaded_video.mp4";
-                
-                receive_file(client_fd, filename);
-                
                 printf("\n文件下载完成！保存在：%s%s\n", DOWNLOAD_DIR, filename);
             }
-            else
-            {
-                printf("Error: %s\n", rd_buf);
-            }
         }
-        else if (ret == 0)
+        else if (download_file(&client_fd, &server_addr, remote_name, filename) == 0)
         {
-            printf("Server closed connection.\n");
-            break;
+            printf("\n文件下载完成！保存在：%s%s\n", DOWNLOAD_DIR, filename);
         }
-        else
+        else if (client_fd == -1)
         {
-            perror("read fail");
+            printf("Server unreachable, partial data kept for resume.\n");
             break;
         }
-        
+
         show_menu();
     }
     
-    close(client_fd);
+    if (client_fd != -1)
+    {
+        close(client_fd);
+    }
     printf("---- client closed.\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78u  // 反射后的 Castagnoli 多项式
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const unsigned char *p, size_t len);
+
+static uint32_t crc_table[8][256];
+
+static void crc32c_init_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int t = 1; t < 8; t++)
+        {
+            uint32_t prev = crc_table[t - 1][i];
+            crc_table[t][i] = (prev >> 8) ^ crc_table[0][prev & 0xff];
+        }
+    }
+}
+
+// 查表法：每次处理 8 字节（小端）
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len >= 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+    {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    uint64_t crc64 = crc;
+
+    while (len >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (len--)
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+    {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+static crc32c_fn crc_impl;
+static const char *crc_impl_name;
+
+// 选择实现；多个线程同时首次调用时各自选一遍，结果相同，
+// 函数指针最后发布，其他线程看到它时查表和名字都已就绪
+static crc32c_fn crc32c_select(void)
+{
+    crc32c_fn fn = __atomic_load_n(&crc_impl, __ATOMIC_ACQUIRE);
+
+    if (fn != NULL)
+    {
+        return fn;
+    }
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        crc_impl_name = "sse4.2";
+        fn = crc32c_hw;
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    crc_impl_name = "armv8-crc";
+    fn = crc32c_hw;
+#endif
+    if (fn == NULL)
+    {
+        crc32c_init_table();
+        crc_impl_name = "table";
+        fn = crc32c_sw;
+    }
+    __atomic_store_n(&crc_impl, fn, __ATOMIC_RELEASE);
+    return fn;
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len)
+{
+    return ~crc32c_select()(~crc, (const unsigned char *)data, len);
+}
+
+const char *crc32c_impl(void)
+{
+    crc32c_select();
+    return crc_impl_name;
+}
@@ -0,0 +1,230 @@
+//
+// 并发下载压测：N 个客户端同时下载同一个文件，统计总吞吐、首字节延迟和每个客户端的耗时
+//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "crc32c.h"
+#include "transfer.h"
+
+#define SERVER_PORT 9999
+#define DEFAULT_CLIENTS 100
+#define MAX_CLIENTS 10000
+
+typedef struct
+{
+    pthread_t thread;
+    uint64_t bytes;
+    double first_byte_ms;   // 发出请求到收到 INFO
+    double total_ms;        // 发出请求到收到 DONE
+    int ok;
+} BenchClient;
+
+static struct sockaddr_in server_addr;
+static const char *remote_name = "test_video.mp4";
+static int verify = 1;
+static pthread_barrier_t start_barrier;
+
+double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000 + (double)ts.tv_nsec / 1e6;
+}
+
+// 下载整个文件，数据校验后丢弃
+int bench_download(BenchClient *client, int fd, unsigned char *buf)
+{
+    unsigned char req[REQUEST_FIXED_SIZE + TRANSFER_NAME_MAX];
+    size_t name_len = strlen(remote_name);
+    FrameHeader hdr = {.type = FRAME_REQUEST, .length = (uint32_t)(REQUEST_FIXED_SIZE + name_len)};
+    double start = now_ms();
+
+    memset(req, 0, REQUEST_FIXED_SIZE);
+    memcpy(req + REQUEST_FIXED_SIZE, remote_name, name_len);
+    if (frame_send(fd, &hdr, req, hdr.length) == -1 || frame_recv(fd, &hdr) == -1)
+    {
+        return -1;
+    }
+    if (hdr.type != FRAME_INFO || hdr.length != FILE_IDENTITY_SIZE || read_full(fd, req, FILE_IDENTITY_SIZE) == -1)
+    {
+        fprintf(stderr, "bad reply, is %s on the server?\n", remote_name);
+        return -1;
+    }
+    client->first_byte_ms = now_ms() - start;
+
+    while (1)
+    {
+        if (frame_recv(fd, &hdr) == -1)
+        {
+            return -1;
+        }
+        if (hdr.type == FRAME_DONE)
+        {
+            break;
+        }
+        if (hdr.type != FRAME_DATA || hdr.length > TRANSFER_CHUNK_SIZE || read_full(fd, buf, hdr.length) == -1)
+        {
+            return -1;
+        }
+        if (verify && crc32c(0, buf, hdr.length) != hdr.crc)
+        {
+            fprintf(stderr, "checksum mismatch at offset %lu\n", (unsigned long)hdr.offset);
+            return -1;
+        }
+        client->bytes += hdr.length;
+    }
+    client->total_ms = now_ms() - start;
+    return 0;
+}
+
+void *bench_thread(void *arg)
+{
+    BenchClient *client = arg;
+    unsigned char *buf = malloc(TRANSFER_CHUNK_SIZE);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    // 先全部连上再同时发请求
+    if (fd != -1 && connect(fd, (const struct sockaddr *)&server_addr, sizeof(server_addr)) == -1)
+    {
+        perror("connect fail");
+        close(fd);
+        fd = -1;
+    }
+    pthread_barrier_wait(&start_barrier);
+    if (fd != -1 && buf != NULL)
+    {
+        client->ok = bench_download(client, fd, buf) == 0;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    free(buf);
+    return NULL;
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n clients] [-f file] [-a server_ip] [-N]\n", prog);
+    fprintf(stderr, "  -n  simultaneous downloads (default %d)\n", DEFAULT_CLIENTS);
+    fprintf(stderr, "  -f  file to download (default test_video.mp4)\n");
+    fprintf(stderr, "  -a  server address (default 127.0.0.1)\n");
+    fprintf(stderr, "  -N  do not verify chunk checksums\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = DEFAULT_CLIENTS;
+    const char *server_ip = "127.0.0.1";
+    BenchClient *list;
+    double *first, *total;
+    uint64_t bytes = 0;
+    int ok = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:a:Nh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            clients = atoi(optarg);
+            break;
+        case 'f':
+            remote_name = optarg;
+            break;
+        case 'a':
+            server_ip = optarg;
+            break;
+        case 'N':
+            verify = 0;
+            break;
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (clients < 1 || clients > MAX_CLIENTS || strlen(remote_name) > TRANSFER_NAME_MAX)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid server address: %s\n", server_ip);
+        exit(1);
+    }
+
+    list = calloc((size_t)clients, sizeof(*list));
+    first = calloc((size_t)clients, sizeof(*first));
+    total = calloc((size_t)clients, sizeof(*total));
+    if (list == NULL || first == NULL || total == NULL)
+    {
+        perror("calloc fail");
+        exit(1);
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)clients + 1);
+    for (int i = 0; i < clients; i++)
+    {
+        if (pthread_create(&list[i].thread, NULL, bench_thread, &list[i]) != 0)
+        {
+            perror("pthread_create fail");
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    double start = now_ms();
+    for (int i = 0; i < clients; i++)
+    {
+        pthread_join(list[i].thread, NULL);
+    }
+    double elapsed = now_ms() - start;
+
+    for (int i = 0; i < clients; i++)
+    {
+        bytes += list[i].bytes;
+        if (list[i].ok)
+        {
+            first[ok] = list[i].first_byte_ms;
+            total[ok] = list[i].total_ms;
+            ok++;
+        }
+    }
+    printf("%d/%d downloads of %s completed in %.2f s, %.1f MB total, %.1f MB/s\n",
+           ok, clients, remote_name, elapsed / 1000, (double)bytes / 1e6,
+           elapsed > 0 ? (double)bytes / 1e6 / (elapsed / 1000) : 0.0);
+    if (ok > 0)
+    {
+        qsort(first, (size_t)ok, sizeof(*first), compare_double);
+        qsort(total, (size_t)ok, sizeof(*total), compare_double);
+        printf("first byte ms: p50 %.1f  p99 %.1f  max %.1f\n", first[ok / 2], first[(ok - 1) * 99 / 100], first[ok - 1]);
+        printf("download ms:   min %.1f  p50 %.1f  max %.1f\n", total[0], total[ok / 2], total[ok - 1]);
+    }
+
+    pthread_barrier_destroy(&start_barrier);
+    free(list);
+    free(first);
+    free(total);
+    return ok == clients ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+#include "file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+
+#define CRC_READ_SIZE (32 * 1024)     // 计算 CRC 时每次 pread 的字节数，放在客户端线程的栈上
+
+static CachedFile *cache_slots[FILE_CACHE_SLOTS];
+static uint64_t cache_clock;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void cached_file_free(CachedFile *file)
+{
+    close(file->fd);
+    free(file->chunk_crc);
+    free(file->chunk_ready);
+    free(file);
+}
+
+static int same_file(const CachedFile *file, const struct stat *st)
+{
+    return file->dev == st->st_dev && file->ino == st->st_ino && file->ident.size == (uint64_t)st->st_size
+           && file->ident.mtime_ns == (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+// 打开文件并建立缓存项（不加锁，可能与其他线程并行）
+static CachedFile *cached_file_load(const char *path, const char *name)
+{
+    CachedFile *file = calloc(1, sizeof(*file));
+    struct stat st;
+    uint64_t chunks;
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd == -1)
+    {
+        free(file);
+        return NULL;
+    }
+    if (fstat(file->fd, &st) == -1)
+    {
+        close(file->fd);
+        free(file);
+        return NULL;
+    }
+
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->ident.size = (uint64_t)st.st_size;
+    file->ident.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    file->refs = 1;
+
+    chunks = (file->ident.size + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE;
+    file->chunk_crc = calloc(chunks ? chunks : 1, sizeof(*file->chunk_crc));
+    file->chunk_ready = calloc(chunks ? chunks : 1, 1);
+    if (file->chunk_crc == NULL || file->chunk_ready == NULL)
+    {
+        cached_file_free(file);
+        return NULL;
+    }
+    return file;
+}
+
+CachedFile *file_cache_open(const char *dir, const char *name)
+{
+    CachedFile *file, *loaded;
+    char path[512];
+    struct stat st;
+    int slot = -1;
+
+    snprintf(path, sizeof(path), "%s%s", dir, name);
+    if (stat(path, &st) == -1)
+    {
+        return NULL;
+    }
+
+    // 命中：同名且仍是同一个文件
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < FILE_CACHE_SLOTS; i++)
+    {
+        file = cache_slots[i];
+        if (file != NULL && strcmp(file->name, name) == 0 && same_file(file, &st))
+        {
+            file->refs++;
+            file->last_used = ++cache_clock;
+            pthread_mutex_unlock(&cache_lock);
+            return file;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    // 未命中：在锁外打开并 fstat，再放进缓存表（替换同名的旧项或最久未用的一项）
+    loaded = cached_file_load(path, name);
+    if (loaded == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < FILE_CACHE_SLOTS; i++)
+    {
+        file = cache_slots[i];
+        if (file != NULL && strcmp(file->name, name) == 0)
+        {
+            slot = i;
+            break;
+        }
+        if (slot == -1 || file == NULL
+            || (cache_slots[slot] != NULL && file->last_used < cache_slots[slot]->last_used))
+        {
+            slot = i;
+        }
+    }
+    file = cache_slots[slot];
+    if (file != NULL && file->dev == loaded->dev && file->ino == loaded->ino
+        && file->ident.size == loaded->ident.size && file->ident.mtime_ns == loaded->ident.mtime_ns)
+    {
+        // 另一个线程已经放进来同一个文件，用它的，丢弃自己的
+        file->refs++;
+        file->last_used = ++cache_clock;
+        pthread_mutex_unlock(&cache_lock);
+        cached_file_free(loaded);
+        return file;
+    }
+    if (file != NULL && --file->refs > 0)
+    {
+        file = NULL;
+    }
+    loaded->refs++;
+    loaded->last_used = ++cache_clock;
+    cache_slots[slot] = loaded;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (file != NULL)
+    {
+        cached_file_free(file);
+    }
+    return loaded;
+}
+
+void file_cache_release(CachedFile *file)
+{
+    int last;
+
+    pthread_mutex_lock(&cache_lock);
+    last = --file->refs == 0;
+    pthread_mutex_unlock(&cache_lock);
+    if (last)
+    {
+        cached_file_free(file);
+    }
+}
+
+// 用 pread 分段读入调用线程栈上的缓冲区计算 CRC
+// 文件在发送过程中被原地截断时 pread 读不满，只让这一次请求失败（读 mmap 会收到 SIGBUS，整个服务器退出）
+static int compute_crc(int fd, uint64_t offset, uint32_t len, uint32_t *crc)
+{
+    unsigned char buf[CRC_READ_SIZE];
+    uint32_t value = 0;
+
+    while (len > 0)
+    {
+        size_t want = len > sizeof(buf) ? sizeof(buf) : len;
+        ssize_t n = pread(fd, buf, want, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            if (n == 0)
+            {
+                errno = EIO;
+            }
+            return -1;
+        }
+        value = crc32c(value, buf, (size_t)n);
+        offset += (uint64_t)n;
+        len -= (uint32_t)n;
+    }
+    *crc = value;
+    return 0;
+}
+
+int file_cache_crc(CachedFile *file, uint64_t offset, uint32_t len, uint32_t *crc)
+{
+    uint64_t index = offset / TRANSFER_CHUNK_SIZE;
+    uint64_t chunk_end = offset + TRANSFER_CHUNK_SIZE < file->ident.size ? offset + TRANSFER_CHUNK_SIZE : file->ident.size;
+
+    if (offset % TRANSFER_CHUNK_SIZE != 0 || offset + len != chunk_end)
+    {
+        return compute_crc(file->fd, offset, len, crc);
+    }
+    // 多个线程同时算同一块时结果相同，先写 CRC 再发布 ready
+    if (__atomic_load_n(&file->chunk_ready[index], __ATOMIC_ACQUIRE))
+    {
+        *crc = __atomic_load_n(&file->chunk_crc[index], __ATOMIC_RELAXED);
+        return 0;
+    }
+    if (compute_crc(file->fd, offset, len, crc) == -1)
+    {
+        return -1;
+    }
+    __atomic_store_n(&file->chunk_crc[index], *crc, __ATOMIC_RELAXED);
+    __atomic_store_n(&file->chunk_ready[index], 1, __ATOMIC_RELEASE);
+    return 0;
+}
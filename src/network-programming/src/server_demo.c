@@ -1,105 +1,384 @@
 //
 // Created by idris-24-04 on 2026/3/16.
 //
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
-#include <sys/stat.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 
+#include "file_cache.h"
+#include "transfer.h"
+
 #define SERVER_PORT 9999
-#define MAX_CNT 1024
 #define FILES_DIR "./files/"
+#define DEFAULT_MAX_CLIENTS 128
+#define CLIENT_STACK_SIZE (256 * 1024)
+
+static int verbose = 1;
+static uint64_t rate_limit;     // 每个客户端 IP 的限速（它的所有连接合计），字节/秒，0 表示不限速
+
+// 回复错误信息
+int send_error(int client_fd, const char *msg)
+{
+    FrameHeader hdr = {.type = FRAME_ERROR, .length = (uint32_t)strlen(msg)};
+
+    printf("Send error: %s\n", msg);
+    return frame_send(client_fd, &hdr, msg, hdr.length);
+}
+
+// 只允许下载 FILES_DIR 下的文件，拒绝路径分隔符和隐藏文件
+int valid_filename(const char *filename)
+{
+    return filename[0] != '\0' && filename[0] != '.' && strchr(filename, '/') == NULL;
+}
+
+// 单个客户端（按 IP 区分）的限速：按已发送的字节数和目标速率计算下一次发送的时间
+// 同一个 IP 的所有连接共用一个 RateLimit（client_demo -j 的多个连接合计不超过限速），
+// 每次发送前在锁内预约字节数，锁外睡到预约的时间
+// 空闲（落后超过 RATE_BURST_MS）后重新计时，不把空闲时间攒成突发
+typedef struct RateLimit
+{
+    in_addr_t ip;
+    int refs;               // 使用它的连接数，由 limits_lock 保护
+    uint64_t rate;          // 字节/秒，0 表示不限速
+    uint64_t start_ns;      // 以下由 limits_lock 保护
+    uint64_t sent;
+    struct RateLimit *next;
+} RateLimit;
+
+#define RATE_SLICE (64 * 1024)  // 限速时每次 sendfile 的最大字节数
+#define RATE_BURST_MS 100
+
+static RateLimit *limits;       // 有连接的客户端 IP
+static pthread_mutex_t limits_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 取得 ip 的限速器，同一个 IP 的连接共用
+RateLimit *rate_limit_acquire(in_addr_t ip)
+{
+    RateLimit *rl;
+
+    pthread_mutex_lock(&limits_lock);
+    for (rl = limits; rl != NULL; rl = rl->next)
+    {
+        if (rl->ip == ip)
+        {
+            break;
+        }
+    }
+    if (rl == NULL)
+    {
+        rl = calloc(1, sizeof(*rl));
+        if (rl != NULL)
+        {
+            rl->ip = ip;
+            rl->rate = rate_limit;
+            rl->next = limits;
+            limits = rl;
+        }
+    }
+    if (rl != NULL)
+    {
+        rl->refs++;
+    }
+    pthread_mutex_unlock(&limits_lock);
+    return rl;
+}
+
+// 这个 IP 的最后一个连接断开时释放
+void rate_limit_release(RateLimit *rl)
+{
+    pthread_mutex_lock(&limits_lock);
+    if (--rl->refs == 0)
+    {
+        RateLimit **p = &limits;
+        while (*p != rl)
+        {
+            p = &(*p)->next;
+        }
+        *p = rl->next;
+        free(rl);
+    }
+    pthread_mutex_unlock(&limits_lock);
+}
+
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
 
-// 发送文件到客户端
-int send_file(int client_fd, const char *filename)
+// 发送 bytes 字节之前调用，超过速率时睡眠
+void rate_limit_wait(RateLimit *rl, size_t bytes)
 {
-    int file_fd;
-    char file_buf[MAX_CNT];
-    int read_cnt;
-    struct stat file_stat;
-    
-    // 构建完整文件路径
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s", FILES_DIR, filename);
-    
-    // 打开文件
-    file_fd = open(filepath, O_RDONLY);
-    if (file_fd == -1)
+    uint64_t now, due;
+
+    if (rl->rate == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&limits_lock);
+    now = now_ns();
+    due = rl->start_ns + rl->sent * 1000000000 / rl->rate;
+    if (now > due + RATE_BURST_MS * 1000000ull)
+    {
+        rl->start_ns = now;
+        rl->sent = 0;
+        due = now;
+    }
+    rl->sent += bytes;
+    pthread_mutex_unlock(&limits_lock);
+
+    if (due > now)
+    {
+        struct timespec ts = {(time_t)((due - now) / 1000000000), (long)((due - now) % 1000000000)};
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        {
+        }
+    }
+}
+
+// 发送 [start, end) 这一段文件：每块先发带 CRC32C 的帧头，数据用 sendfile 直接从页缓存发出
+// CRC 用 pread 读页缓存计算并按块缓存，多个客户端下载同一个文件时每块只算一次
+// 文件在发送中途被截断时 CRC 或 sendfile 读不满，这次请求失败、连接关闭，不影响其他客户端
+int send_chunks(int client_fd, CachedFile *file, uint64_t start, uint64_t end, RateLimit *rl)
+{
+    uint64_t offset = start;
+
+    while (offset < end)
+    {
+        uint32_t len = end - offset > TRANSFER_CHUNK_SIZE ? TRANSFER_CHUNK_SIZE : (uint32_t)(end - offset);
+        FrameHeader hdr = {
+            .type = FRAME_DATA,
+            .length = len,
+            .offset = offset,
+        };
+        off_t file_off = (off_t)offset;
+        size_t remain = len;
+
+        if (file_cache_crc(file, offset, len, &hdr.crc) == -1)
+        {
+            return -1;
+        }
+        rate_limit_wait(rl, FRAME_HEADER_SIZE);
+        if (frame_send(client_fd, &hdr, NULL, 0) == -1)
+        {
+            return -1;
+        }
+        while (remain > 0)
+        {
+            // 共享的 fd 上用自己的 file_off，不改变文件位置
+            size_t slice = rl->rate != 0 && remain > RATE_SLICE ? RATE_SLICE : remain;
+            rate_limit_wait(rl, slice);
+            ssize_t n = sendfile(client_fd, file->fd, &file_off, slice);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                if (n == 0)
+                {
+                    errno = EIO;    // 文件在发送途中变短了
+                }
+                return -1;
+            }
+            remain -= (size_t)n;
+        }
+        offset += len;
+    }
+    return 0;
+}
+
+// 发送文件的 [resume, end) 到客户端（end 为 0 表示到文件末尾）
+// expect 与当前文件一致时从 resume 处续传，否则从头发送
+// info_only 时只发送文件信息
+int send_file(int client_fd, const char *filename, uint64_t resume, uint64_t end,
+              const FileIdentity *expect, int info_only, RateLimit *rl)
+{
+    CachedFile *file;
+    FileIdentity ident;
+    unsigned char ident_buf[FILE_IDENTITY_SIZE];
+    uint64_t start;
+    int ret;
+
+    if (!valid_filename(filename))
+    {
+        return send_error(client_fd, "Invalid file name");
+    }
+
+    // 打开文件（同一个文件的并发下载共用 fd 和每块的 CRC）
+    file = file_cache_open(FILES_DIR, filename);
+    if (file == NULL)
     {
         perror("open file fail");
-        return -1;
+        return send_error(client_fd, errno == ENOENT ? "File not found" : "Cannot open file");
     }
-    
-    // 获取文件大小
-    if (fstat(file_fd, &file_stat) == -1)
+
+    ident = file->ident;
+    if (end == 0 || end > ident.size || info_only)
+    {
+        end = ident.size;
+    }
+    start = (expect->size == ident.size && expect->mtime_ns == ident.mtime_ns && resume <= end) ? resume : 0;
+    if (info_only)
     {
-        perror("get file size fail");
-        close(file_fd);
+        start = end;
+    }
+
+    if (verbose)
+    {
+        printf("Sending file: %s%s, size: %lu bytes, range %lu-%lu\n",
+               FILES_DIR, filename, (unsigned long)ident.size, (unsigned long)start, (unsigned long)end);
+    }
+
+    // 先发送文件信息和实际的开始位置，再分块发送内容，最后发送结束帧
+    FrameHeader info = {.type = FRAME_INFO, .length = FILE_IDENTITY_SIZE, .offset = info_only ? 0 : start};
+    FrameHeader done = {.type = FRAME_DONE, .offset = end};
+    identity_encode(&ident, ident_buf);
+    ret = frame_send(client_fd, &info, ident_buf, sizeof(ident_buf));
+    if (ret == 0)
+    {
+        ret = send_chunks(client_fd, file, start, end, rl);
+    }
+    if (ret == 0)
+    {
+        ret = frame_send(client_fd, &done, NULL, 0);
+    }
+
+    file_cache_release(file);
+    if (ret == -1)
+    {
+        perror("send file fail");
         return -1;
     }
-    
-    printf("Sending file: %s, size: %ld bytes\n", filepath, file_stat.st_size);
-    
-    // 先发送文件大小
-    long file_size = file_stat.st_size;
-    write(client_fd, &file_size, sizeof(file_size));
-    
-    // 读取并发送文件内容
-    while ((read_cnt = read(file_fd, file_buf, MAX_CNT)) > 0)
-    {
-        write(client_fd, file_buf, read_cnt);
-    }
-    
-    close(file_fd);
-    printf("File sent successfully: %s\n", filepath);
+    if (verbose)
+    {
+        printf("File sent successfully: %s%s\n", FILES_DIR, filename);
+    }
     return 0;
 }
 
-// 处理客户端命令
-int handle_command(int client_fd, char *cmd)
+// 处理客户端请求：REQUEST 帧的负载为文件标识 + 结束位置 + 文件名
+int handle_request(int client_fd, const FrameHeader *hdr, RateLimit *rl)
+{
+    unsigned char payload[REQUEST_FIXED_SIZE + TRANSFER_NAME_MAX];
+    FileIdentity expect;
+    uint64_t end;
+    char filename[TRANSFER_NAME_MAX + 1];
+    size_t name_len;
+
+    if (hdr->type != FRAME_REQUEST || hdr->length < REQUEST_FIXED_SIZE + 1
+        || hdr->length > REQUEST_FIXED_SIZE + TRANSFER_NAME_MAX)
+    {
+        fprintf(stderr, "bad request frame: type %u, length %u\n", hdr->type, hdr->length);
+        return -1;
+    }
+    if (read_full(client_fd, payload, hdr->length) == -1)
+    {
+        perror("read request fail");
+        return -1;
+    }
+
+    identity_decode(&expect, payload);
+    end = get_be64(payload + FILE_IDENTITY_SIZE);
+    name_len = hdr->length - REQUEST_FIXED_SIZE;
+    memcpy(filename, payload + REQUEST_FIXED_SIZE, name_len);
+    filename[name_len] = '\0';
+
+    if (verbose)
+    {
+        printf("Client requested %s from offset %lu\n", filename, (unsigned long)hdr->offset);
+    }
+    return send_file(client_fd, filename, hdr->offset, end, &expect, hdr->flags & REQUEST_INFO_ONLY, rl);
+}
+
+// 一个客户端连接，由独立的线程处理
+typedef struct
+{
+    int fd;
+    struct sockaddr_in addr;
+} ClientConn;
+
+// 同时服务的客户端数，达到上限时 accept 循环等待，新连接留在监听队列里
+static int active_clients;
+static int max_clients = DEFAULT_MAX_CLIENTS;
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clients_cond = PTHREAD_COND_INITIALIZER;
+
+void client_finished(void)
+{
+    pthread_mutex_lock(&clients_lock);
+    active_clients--;
+    pthread_cond_signal(&clients_cond);
+    pthread_mutex_unlock(&clients_lock);
+}
+
+// 客户端线程：循环处理请求直到客户端断开
+void *client_thread(void *arg)
+{
+    ClientConn *conn = arg;
+    RateLimit *rl = rate_limit_acquire(conn->addr.sin_addr.s_addr);
+    FrameHeader hdr;
+
+    while (rl != NULL)
+    {
+        if (frame_recv(conn->fd, &hdr) == -1)
+        {
+            if (errno == ECONNRESET)
+            {
+                if (verbose)
+                {
+                    printf("client exit\n");
+                }
+            }
+            else
+            {
+                perror("read fail");
+            }
+            break;
+        }
+
+        // 处理客户端请求，发送失败说明连接已断开
+        if (handle_request(conn->fd, &hdr, rl) == -1)
+        {
+            break;
+        }
+    }
+    if (rl != NULL)
+    {
+        rate_limit_release(rl);
+    }
+    close(conn->fd);
+    if (verbose)
+    {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &conn->addr.sin_addr, ip, sizeof(ip));
+        printf("--- client %s:%d connection closed.\n", ip, ntohs(conn->addr.sin_port));
+    }
+    free(conn);
+    client_finished();
+    return NULL;
+}
+
+void usage(const char *prog)
 {
-    int ret = 0;
-    
-    // 去除换行符
-    cmd[strcspn(cmd, "\r\n")] = 0;
-    
-    printf("Received command: %s\n", cmd);
-    
-    if (strcmp(cmd, "1") == 0)
-    {
-        // 发送 txt 文件
-        printf("Client requested TXT file\n");
-        write(client_fd, "SENDING_FILE", 12);
-        ret = send_file(client_fd, "test.txt");
-    }
-    else if (strcmp(cmd, "2") == 0)
-    {
-        // 发送图片文件
-        printf("Client requested IMAGE file\n");
-        write(client_fd, "SENDING_FILE", 12);
-        ret = send_file(client_fd, "test_image.bmp");
-    }
-    else if (strcmp(cmd, "3") == 0)
-    {
-        // 发送视频文件
-        printf("Client requested VIDEO file\n");
-        write(client_fd, "SENDING_FILE", 12);
-        ret = send_file(client_fd, "test_video.mp4");
-    }
-    else
-    {
-        // 未知命令
-        char error_msg[MAX_CNT];
-        snprintf(error_msg, sizeof(error_msg), "Unknown command: %s", cmd);
-        write(client_fd, error_msg, strlen(error_msg));
-        ret = -1;
-    }
-    
-    return ret;
+    fprintf(stderr, "Usage: %s [-c max_clients] [-r KB/s] [-q]\n", prog);
+    fprintf(stderr, "  -c  clients served at the same time, one thread each (default %d, 1 = serial)\n",
+            DEFAULT_MAX_CLIENTS);
+    fprintf(stderr, "  -r  per-client (per IP, all its connections together) bandwidth limit in KB/s\n"
+                    "      (default 0 = unlimited)\n");
+    fprintf(stderr, "  -q  do not log each connection and request\n");
 }
 
 int main(int argc, char *argv[])
@@ -109,9 +388,37 @@ int main(int argc, char *argv[])
     struct sockaddr_in server_addr;
     struct sockaddr_in client_addr;
     socklen_t client_len;
-    char rd_buf[MAX_CNT] = {0};
-    int rd_cnt;
+    pthread_attr_t attr;
+    pthread_t tid;
     int ret;
+    int opt = 1;
+
+    while ((ret = getopt(argc, argv, "c:r:qh")) != -1)
+    {
+        switch (ret)
+        {
+        case 'c':
+            max_clients = atoi(optarg);
+            if (max_clients < 1)
+            {
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case 'r':
+            rate_limit = strtoull(optarg, NULL, 10) * 1024;
+            break;
+        case 'q':
+            verbose = 0;
+            break;
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    // 客户端中途断开时 sendfile 返回错误，而不是让服务器被 SIGPIPE 杀死
+    signal(SIGPIPE, SIG_IGN);
 
     // 创建 socket 文件描述符
     listen_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -121,6 +428,9 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    // 重启后立即复用端口（断点续传测试时服务器会被反复重启）
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
     // 初始化服务器地址结构
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
@@ -137,52 +447,67 @@ int main(int argc, char *argv[])
     }
     printf("---- bind success.\n");
 
-    // 监听 socket
-    ret = listen(listen_fd, 5);
+    // 监听 socket，队列要能放下达到上限时等待的连接
+    ret = listen(listen_fd, SOMAXCONN);
     if (ret == -1)
     {
         perror("listen fail");
         close(listen_fd);
         exit(3);
     }
-    printf("---- listen success. Waiting for client...\n");
+    printf("---- listen success. Waiting for client... (max %d clients, rate limit %lu KB/s)\n",
+           max_clients, (unsigned long)(rate_limit / 1024));
+
+    // 客户端线程分离运行，栈不需要默认的 8MB
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, CLIENT_STACK_SIZE);
 
     while(1)
     {
+        // 达到上限时等待有客户端断开
+        pthread_mutex_lock(&clients_lock);
+        while (active_clients >= max_clients)
+        {
+            pthread_cond_wait(&clients_cond, &clients_lock);
+        }
+        pthread_mutex_unlock(&clients_lock);
+
         // 接受客户端连接
         client_len = sizeof(client_addr);
-        connect_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
+        connect_fd = accept4(listen_fd, (struct sockaddr *)&client_addr, &client_len, SOCK_CLOEXEC);
         if(connect_fd == -1)
         {
             perror("accept fail");
             continue;
         }
-        printf("connect success.\n");
-        printf("client ip: %s\n", inet_ntoa(client_addr.sin_addr));
-        printf("client port: %d \n", ntohs(client_addr.sin_port));
-        
-        while(1)
+        if (verbose)
         {
-            memset(rd_buf, 0, MAX_CNT);
-            rd_cnt = read(connect_fd, rd_buf, MAX_CNT - 1);
-            if(rd_cnt == 0)
-            {
-                printf("client exit\n");
-                break;
-            }
-            else if(rd_cnt < 0)
-            {
-                perror("read fail");
-                break;
-            }
-            printf("+++read data: %s\n", rd_buf);
-            
-            // 处理客户端命令
-            handle_command(connect_fd, rd_buf);
+            printf("connect success.\n");
+            printf("client ip: %s\n", inet_ntoa(client_addr.sin_addr));
+            printf("client port: %d \n", ntohs(client_addr.sin_port));
+        }
+
+        ClientConn *conn = malloc(sizeof(*conn));
+        if (conn == NULL)
+        {
+            close(connect_fd);
+            continue;
+        }
+        conn->fd = connect_fd;
+        conn->addr = client_addr;
+        pthread_mutex_lock(&clients_lock);
+        active_clients++;
+        pthread_mutex_unlock(&clients_lock);
+        if (pthread_create(&tid, &attr, client_thread, conn) != 0)
+        {
+            perror("pthread_create fail");
+            close(connect_fd);
+            free(conn);
+            client_finished();
         }
-        close(connect_fd);
-        printf("--- client connection closed.\n");
     }
+    pthread_attr_destroy(&attr);
     close(listen_fd);
     return 0;
-}
\ No newline at end of file
+}
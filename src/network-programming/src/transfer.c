@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include "transfer.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            errno = ECONNRESET;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void header_encode(const FrameHeader *hdr, unsigned char out[FRAME_HEADER_SIZE])
+{
+    uint32_t magic = htobe32(TRANSFER_MAGIC);
+    uint16_t type = htobe16(hdr->type);
+    uint16_t flags = htobe16(hdr->flags);
+    uint32_t length = htobe32(hdr->length);
+    uint32_t crc = htobe32(hdr->crc);
+    uint64_t offset = htobe64(hdr->offset);
+
+    memcpy(out, &magic, 4);
+    memcpy(out + 4, &type, 2);
+    memcpy(out + 6, &flags, 2);
+    memcpy(out + 8, &length, 4);
+    memcpy(out + 12, &crc, 4);
+    memcpy(out + 16, &offset, 8);
+}
+
+int frame_send(int fd, const FrameHeader *hdr, const void *payload, size_t payload_len)
+{
+    unsigned char head[FRAME_HEADER_SIZE];
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t total = FRAME_HEADER_SIZE + payload_len;
+    int flags = MSG_NOSIGNAL;
+
+    header_encode(hdr, head);
+    iov[0].iov_base = head;
+    iov[0].iov_len = FRAME_HEADER_SIZE;
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = payload_len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = payload_len > 0 ? 2 : 1;
+    if (payload_len < hdr->length)
+    {
+        flags |= MSG_MORE;
+    }
+
+    // 短写时把 iovec 往后推，直到帧头和负载全部发出
+    while (total > 0)
+    {
+        ssize_t n = sendmsg(fd, &msg, flags);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        total -= (size_t)n;
+        while (n > 0 && msg.msg_iovlen > 0)
+        {
+            if ((size_t)n >= msg.msg_iov->iov_len)
+            {
+                n -= (ssize_t)msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            else
+            {
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len -= (size_t)n;
+                n = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+int frame_recv(int fd, FrameHeader *hdr)
+{
+    unsigned char head[FRAME_HEADER_SIZE];
+    uint32_t magic, length, crc;
+    uint16_t type, flags;
+    uint64_t offset;
+
+    if (read_full(fd, head, sizeof(head)) < 0)
+    {
+        return -1;
+    }
+    memcpy(&magic, head, 4);
+    memcpy(&type, head + 4, 2);
+    memcpy(&flags, head + 6, 2);
+    memcpy(&length, head + 8, 4);
+    memcpy(&crc, head + 12, 4);
+    memcpy(&offset, head + 16, 8);
+    if (be32toh(magic) != TRANSFER_MAGIC)
+    {
+        errno = EPROTO;
+        return -1;
+    }
+    hdr->type = be16toh(type);
+    hdr->flags = be16toh(flags);
+    hdr->length = be32toh(length);
+    hdr->crc = be32toh(crc);
+    hdr->offset = be64toh(offset);
+    return 0;
+}
+
+void put_be64(unsigned char *out, uint64_t value)
+{
+    value = htobe64(value);
+    memcpy(out, &value, 8);
+}
+
+uint64_t get_be64(const unsigned char *in)
+{
+    uint64_t value;
+
+    memcpy(&value, in, 8);
+    return be64toh(value);
+}
+
+void identity_encode(const FileIdentity *id, unsigned char out[FILE_IDENTITY_SIZE])
+{
+    put_be64(out, id->size);
+    put_be64(out + 8, (uint64_t)id->mtime_ns);
+}
+
+void identity_decode(FileIdentity *id, const unsigned char in[FILE_IDENTITY_SIZE])
+{
+    id->size = get_be64(in);
+    id->mtime_ns = (int64_t)get_be64(in + 8);
+}
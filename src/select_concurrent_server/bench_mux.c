@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#include "mux.h"
+
+/*
+ * 多路复用后端的唤醒开销随连接数的变化
+ * 登记 N 个 fd（用 eventfd 代替连接，N 个 fd 即 N 个连接），每轮只让其中
+ * 随机一个可读，测量一次 wait 从返回到取回该 fd 的平均耗时
+ */
+
+#define WAKEUPS 2000
+
+static const int kConnCounts[] = { 100, 1000, 10000, 50000 };
+
+/*
+ * now_ns - 单调时钟纳秒数
+ */
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * bench_one - 测量一个后端在 n 个 fd 时每次唤醒的纳秒数
+ * 返回值: 成功返回0；后端不支持这么多 fd 返回1；fd 不够返回-1
+ */
+int bench_one(const MuxOps *ops, int n, int capacity, double *ns_per_wakeup)
+{
+	Mux mux;
+	int *fds;
+	int ready[16];
+	int created = 0, ret = 0;
+	uint64_t value = 1, start;
+
+	fds = malloc((size_t)n * sizeof(int));
+	if (fds == NULL || mux_init(&mux, ops, capacity) < 0) {
+		free(fds);
+		return -1;
+	}
+
+	for (; created < n; created++) {
+		fds[created] = eventfd(0, EFD_NONBLOCK);
+		if (fds[created] < 0) {
+			ret = -1;
+			goto out;
+		}
+		if (mux_add(&mux, fds[created]) < 0) {
+			close(fds[created]);
+			ret = 1;
+			goto out;
+		}
+	}
+
+	srand(1);
+	start = now_ns();
+	for (int i = 0; i < WAKEUPS; i++) {
+		int fd = fds[rand() % n];
+
+		if (write(fd, &value, sizeof(value)) != sizeof(value)
+		    || mux_wait(&mux, ready, 16, -1) != 1 || ready[0] != fd
+		    || read(fd, &value, sizeof(value)) != sizeof(value)) {
+			fprintf(stderr, "%s: unexpected wakeup\n", ops->name);
+			ret = -1;
+			goto out;
+		}
+		value = 1;
+	}
+	*ns_per_wakeup = (double)(now_ns() - start) / WAKEUPS;
+
+out:
+	for (int i = 0; i < created; i++) {
+		mux_del(&mux, fds[i]);
+		close(fds[i]);
+	}
+	mux_destroy(&mux);
+	free(fds);
+	return ret;
+}
+
+int main(void)
+{
+	const MuxOps *backends[] = { &mux_select_ops, &mux_poll_ops, &mux_epoll_ops };
+	struct rlimit rl;
+	int capacity;
+
+	/* 打开文件数上限提到硬上限，超出的规模跳过 */
+	getrlimit(RLIMIT_NOFILE, &rl);
+	if (rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	capacity = rl.rlim_cur > 1 << 20 ? 1 << 20 : (int)rl.rlim_cur;
+
+	printf("ns per wakeup (one ready fd out of N, %d wakeups, fd limit %d)\n",
+	       WAKEUPS, capacity);
+	printf("%8s", "N");
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+		printf("%20s", backends[b]->name);
+	}
+	printf("\n");
+
+	for (size_t i = 0; i < sizeof(kConnCounts) / sizeof(kConnCounts[0]); i++) {
+		int n = kConnCounts[i];
+
+		printf("%8d", n);
+		for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+			double ns = 0;
+			int ret = n + 8 > capacity ? -1 : bench_one(backends[b], n, capacity, &ns);
+
+			if (ret == 0) {
+				printf("%20.0f", ns);
+			} else if (ret > 0) {
+				printf("%20s", "n/a (FD_SETSIZE)");
+			} else {
+				printf("%20s", "skipped (fd limit)");
+			}
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+	return 0;
+}
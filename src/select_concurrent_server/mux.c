@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "mux.h"
+
+static const MuxOps *const kMuxBackends[] = {
+	&mux_select_ops,
+	&mux_poll_ops,
+	&mux_epoll_ops,
+};
+
+const MuxOps *mux_find(const char *name)
+{
+	for (size_t i = 0; i < sizeof(kMuxBackends) / sizeof(kMuxBackends[0]); i++) {
+		if (strcmp(kMuxBackends[i]->name, name) == 0) {
+			return kMuxBackends[i];
+		}
+	}
+	return NULL;
+}
+
+int mux_init(Mux *mux, const MuxOps *ops, int capacity)
+{
+	mux->ops = ops;
+	mux->capacity = capacity;
+	mux->impl = NULL;
+	return ops->init(mux);
+}
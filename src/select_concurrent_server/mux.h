@@ -0,0 +1,78 @@
+#ifndef MUX_H
+#define MUX_H
+
+/*
+ * 可替换的 I/O 多路复用后端：select / poll / epoll 实现同一套接口
+ * - 只关注可读事件，水平触发：没读完的 fd 下次等待仍会就绪
+ * - wait 直接返回就绪的 fd 列表，调用方不需要再遍历所有连接
+ *
+ * 三者的差别在每次等待的开销：
+ * - select：每次把整张位图拷进内核并逐位检查，fd 必须小于 FD_SETSIZE（1024）
+ * - poll：没有 fd 上限，但每次仍要把整个 pollfd 数组交给内核逐个检查
+ * - epoll：登记一次，等待开销只与就绪的 fd 数有关
+ */
+
+typedef struct Mux Mux;
+
+typedef struct {
+	const char *name;
+	int (*init)(Mux *mux);
+	void (*destroy)(Mux *mux);
+	int (*add)(Mux *mux, int fd);
+	int (*del)(Mux *mux, int fd);
+	int (*wait)(Mux *mux, int *ready, int max_ready, int timeout_ms);
+} MuxOps;
+
+struct Mux {
+	const MuxOps *ops;
+	int capacity;   /* 可登记的 fd 上限（fd 必须小于该值） */
+	void *impl;     /* 后端私有状态 */
+};
+
+extern const MuxOps mux_select_ops;
+extern const MuxOps mux_poll_ops;
+extern const MuxOps mux_epoll_ops;
+
+/*
+ * mux_find - 按名字（select/poll/epoll）查找后端
+ * 返回值: 找不到时返回 NULL
+ */
+const MuxOps *mux_find(const char *name);
+
+/*
+ * mux_init - 创建多路复用器，capacity 为 fd 上限
+ * select 后端会把 capacity 限制在 FD_SETSIZE 以内
+ * 返回值: 成功返回0，失败返回-1
+ */
+int mux_init(Mux *mux, const MuxOps *ops, int capacity);
+
+static inline void mux_destroy(Mux *mux)
+{
+	mux->ops->destroy(mux);
+}
+
+/*
+ * mux_add / mux_del - 登记 / 注销关注可读的 fd
+ * 返回值: 成功返回0，fd 超出上限或系统调用失败返回-1
+ */
+static inline int mux_add(Mux *mux, int fd)
+{
+	return mux->ops->add(mux, fd);
+}
+
+static inline int mux_del(Mux *mux, int fd)
+{
+	return mux->ops->del(mux, fd);
+}
+
+/*
+ * mux_wait - 等待最多 timeout_ms 毫秒（-1 表示一直等），
+ * 把就绪的 fd 写入 ready，最多 max_ready 个，其余的下次等待时返回
+ * 返回值: 就绪 fd 数，超时返回0，出错返回-1（errno 保留）
+ */
+static inline int mux_wait(Mux *mux, int *ready, int max_ready, int timeout_ms)
+{
+	return mux->ops->wait(mux, ready, max_ready, timeout_ms);
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "mux.h"
+
+#define EPOLL_MUX_BATCH 1024    /* 一次 epoll_wait 最多取回的事件数 */
+
+/*
+ * epoll 后端：水平触发，与 select/poll 语义一致
+ */
+typedef struct {
+	int epfd;
+	struct epoll_event events[EPOLL_MUX_BATCH];
+} EpollMux;
+
+static int epoll_mux_init(Mux *mux)
+{
+	EpollMux *em = malloc(sizeof(EpollMux));
+
+	if (em == NULL) {
+		return -1;
+	}
+	em->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (em->epfd < 0) {
+		free(em);
+		return -1;
+	}
+	mux->impl = em;
+	return 0;
+}
+
+static void epoll_mux_destroy(Mux *mux)
+{
+	EpollMux *em = mux->impl;
+
+	close(em->epfd);
+	free(em);
+	mux->impl = NULL;
+}
+
+static int epoll_mux_add(Mux *mux, int fd)
+{
+	EpollMux *em = mux->impl;
+	struct epoll_event ev;
+
+	if (fd < 0 || fd >= mux->capacity) {
+		errno = EINVAL;
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	return epoll_ctl(em->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static int epoll_mux_del(Mux *mux, int fd)
+{
+	EpollMux *em = mux->impl;
+
+	return epoll_ctl(em->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int epoll_mux_wait(Mux *mux, int *ready, int max_ready, int timeout_ms)
+{
+	EpollMux *em = mux->impl;
+	int ret;
+
+	if (max_ready > EPOLL_MUX_BATCH) {
+		max_ready = EPOLL_MUX_BATCH;
+	}
+	ret = epoll_wait(em->epfd, em->events, max_ready, timeout_ms);
+	for (int i = 0; i < ret; i++) {
+		ready[i] = em->events[i].data.fd;
+	}
+	return ret;
+}
+
+const MuxOps mux_epoll_ops = {
+	.name = "epoll",
+	.init = epoll_mux_init,
+	.destroy = epoll_mux_destroy,
+	.add = epoll_mux_add,
+	.del = epoll_mux_del,
+	.wait = epoll_mux_wait,
+};
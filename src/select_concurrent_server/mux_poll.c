@@ -0,0 +1,115 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+
+#include "mux.h"
+
+/*
+ * poll 后端：pollfd 数组保持紧凑，另有 fd -> 下标的索引，
+ * 注销时用最后一项填补空位，登记与注销都是 O(1)
+ * 就绪的 fd 超过 max_ready 时从上次停下的位置接着收集，避免靠后的 fd 一直轮不到
+ */
+typedef struct {
+	struct pollfd *pfds;
+	int *slot_of;   /* fd -> pfds 下标，-1 表示未登记 */
+	int nfds;
+	int next;       /* 下次从这个下标开始收集 */
+} PollMux;
+
+static int poll_init(Mux *mux)
+{
+	PollMux *pm = malloc(sizeof(PollMux));
+
+	if (pm == NULL) {
+		return -1;
+	}
+	pm->pfds = malloc((size_t)mux->capacity * sizeof(struct pollfd));
+	pm->slot_of = malloc((size_t)mux->capacity * sizeof(int));
+	if (pm->pfds == NULL || pm->slot_of == NULL) {
+		free(pm->pfds);
+		free(pm->slot_of);
+		free(pm);
+		return -1;
+	}
+	for (int i = 0; i < mux->capacity; i++) {
+		pm->slot_of[i] = -1;
+	}
+	pm->nfds = 0;
+	pm->next = 0;
+	mux->impl = pm;
+	return 0;
+}
+
+static void poll_destroy(Mux *mux)
+{
+	PollMux *pm = mux->impl;
+
+	free(pm->pfds);
+	free(pm->slot_of);
+	free(pm);
+	mux->impl = NULL;
+}
+
+static int poll_add(Mux *mux, int fd)
+{
+	PollMux *pm = mux->impl;
+
+	if (fd < 0 || fd >= mux->capacity || pm->slot_of[fd] >= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	pm->pfds[pm->nfds].fd = fd;
+	pm->pfds[pm->nfds].events = POLLIN;
+	pm->pfds[pm->nfds].revents = 0;
+	pm->slot_of[fd] = pm->nfds++;
+	return 0;
+}
+
+static int poll_del(Mux *mux, int fd)
+{
+	PollMux *pm = mux->impl;
+	int slot;
+
+	if (fd < 0 || fd >= mux->capacity || (slot = pm->slot_of[fd]) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	pm->nfds--;
+	if (slot != pm->nfds) {
+		pm->pfds[slot] = pm->pfds[pm->nfds];
+		pm->slot_of[pm->pfds[slot].fd] = slot;
+	}
+	pm->slot_of[fd] = -1;
+	return 0;
+}
+
+static int poll_wait(Mux *mux, int *ready, int max_ready, int timeout_ms)
+{
+	PollMux *pm = mux->impl;
+	int ret, n = 0;
+
+	ret = poll(pm->pfds, (nfds_t)pm->nfds, timeout_ms);
+	if (ret <= 0) {
+		return ret;
+	}
+	/* 挂断和出错也当作可读，由调用方的 recv 取得具体结果 */
+	int start = pm->next < pm->nfds ? pm->next : 0;
+	int i = start;
+	for (int seen = 0; seen < pm->nfds && n < ret && n < max_ready; seen++) {
+		if (pm->pfds[i].revents != 0) {
+			ready[n++] = pm->pfds[i].fd;
+		}
+		i = i + 1 < pm->nfds ? i + 1 : 0;
+	}
+	pm->next = i;
+	return n;
+}
+
+const MuxOps mux_poll_ops = {
+	.name = "poll",
+	.init = poll_init,
+	.destroy = poll_destroy,
+	.add = poll_add,
+	.del = poll_del,
+	.wait = poll_wait,
+};
@@ -0,0 +1,103 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/select.h>
+
+#include "mux.h"
+
+/*
+ * select 后端：登记的 fd 保存在位图中，每次等待拷贝一份交给内核，
+ * 返回后从上次停下的 fd 开始循环扫描 [0, max_fd] 收集就绪的 fd，
+ * 就绪的 fd 超过 max_ready 时编号大的 fd 也能轮到
+ */
+typedef struct {
+	fd_set readfds;
+	int max_fd;     /* 已登记的最大 fd，没有时为 -1 */
+	int next_fd;    /* 下次从这个 fd 开始收集 */
+} SelectMux;
+
+static int select_init(Mux *mux)
+{
+	SelectMux *sm = malloc(sizeof(SelectMux));
+
+	if (sm == NULL) {
+		return -1;
+	}
+	FD_ZERO(&sm->readfds);
+	sm->max_fd = -1;
+	sm->next_fd = 0;
+	if (mux->capacity > FD_SETSIZE) {
+		mux->capacity = FD_SETSIZE;
+	}
+	mux->impl = sm;
+	return 0;
+}
+
+static void select_destroy(Mux *mux)
+{
+	free(mux->impl);
+	mux->impl = NULL;
+}
+
+static int select_add(Mux *mux, int fd)
+{
+	SelectMux *sm = mux->impl;
+
+	if (fd < 0 || fd >= mux->capacity) {
+		errno = EINVAL;
+		return -1;
+	}
+	FD_SET(fd, &sm->readfds);
+	if (fd > sm->max_fd) {
+		sm->max_fd = fd;
+	}
+	return 0;
+}
+
+static int select_del(Mux *mux, int fd)
+{
+	SelectMux *sm = mux->impl;
+
+	if (fd < 0 || fd >= mux->capacity) {
+		errno = EINVAL;
+		return -1;
+	}
+	FD_CLR(fd, &sm->readfds);
+	while (sm->max_fd >= 0 && !FD_ISSET(sm->max_fd, &sm->readfds)) {
+		sm->max_fd--;
+	}
+	return 0;
+}
+
+static int select_wait(Mux *mux, int *ready, int max_ready, int timeout_ms)
+{
+	SelectMux *sm = mux->impl;
+	fd_set tempfds = sm->readfds;  /* select 会改写位图，每次重新拷贝 */
+	struct timeval tv;
+	int ret, n = 0;
+
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	ret = select(sm->max_fd + 1, &tempfds, NULL, NULL,
+		     timeout_ms < 0 ? NULL : &tv);
+	if (ret <= 0) {
+		return ret;
+	}
+	int fd = sm->next_fd <= sm->max_fd ? sm->next_fd : 0;
+	for (int seen = 0; seen <= sm->max_fd && n < ret && n < max_ready; seen++) {
+		if (FD_ISSET(fd, &tempfds)) {
+			ready[n++] = fd;
+		}
+		fd = fd < sm->max_fd ? fd + 1 : 0;
+	}
+	sm->next_fd = fd;
+	return n;
+}
+
+const MuxOps mux_select_ops = {
+	.name = "select",
+	.init = select_init,
+	.destroy = select_destroy,
+	.add = select_add,
+	.del = select_del,
+	.wait = select_wait,
+};
@@ -1,151 +1,274 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <sys/select.h>
 
-#define MAX_CLIENTS FD_SETSIZE
+#include "async_log.h"
+#include "mux.h"
+#include "timer_wheel.h"
+
 #define SERVER_PORT 8990
+#define LISTEN_BACKLOG 1024
+#define READY_BATCH 1024       /* 一次等待最多处理的就绪 fd 数 */
+#define IDLE_TIMEOUT_SEC 60    /* 超过该时间没有收到数据的客户端被关闭 */
+#define TIMER_TICK_MS 100
+
+/*
+ * 客户端：套接字与空闲超时定时器，按 fd 下标存放
+ */
+typedef struct {
+	int fd;
+	TimerNode timer;
+} Client;
+
+static Mux mux;                /* 监听集合，后端由 -m 选择 */
+static Client *clients;        /* 长度为 mux.capacity */
+static int client_count;
+static TimerWheel timers;      /* 所有客户端的空闲超时 */
+
+/*
+ * now_ms - 单调时钟毫秒数，不受系统时间调整影响
+ */
+uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*
+ * client_close - 关闭客户端并释放槽位
+ */
+void client_close(Client *client)
+{
+	timer_cancel(&timers, &client->timer);
+	mux_del(&mux, client->fd);
+	close(client->fd);
+	client->fd = -1;
+	client_count--;
+}
+
+/*
+ * client_on_timeout - 时间轮到期回调：关闭空闲的客户端
+ */
+void client_on_timeout(TimerWheel *wheel, TimerNode *node, void *arg)
+{
+	Client *client = (Client *)((char *)node - offsetof(Client, timer));
 
-int main()
+	(void)wheel;
+	(void)arg;
+	log_info("Client fd=%d idle timeout", client->fd);
+	client_close(client);
+}
+
+/*
+ * accept_clients - 接受监听队列中的所有新连接
+ * fd 超出多路复用后端的上限（select 为 FD_SETSIZE）时拒绝
+ */
+void accept_clients(int listen_fd)
 {
-	int listen_fd, client_fd;
-	struct sockaddr_in server_addr, client_addr;
-	socklen_t server_len, client_len;
+	struct sockaddr_in client_addr;
+	socklen_t client_len;
+	int client_fd;
 
+	while (1) {
+		client_len = sizeof(client_addr);
+		client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
+		if (client_fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				log_error("accept fail: %m");
+			}
+			return;
+		}
+
+		log_info("New client connected: fd=%d, IP=%s, Port=%d",
+		         client_fd,
+		         inet_ntoa(client_addr.sin_addr),
+		         ntohs(client_addr.sin_port));
+
+		/* 将新客户端加入监听集合 */
+		if (client_fd >= mux.capacity || mux_add(&mux, client_fd) < 0) {
+			log_warn("Too many clients, reject fd=%d!", client_fd);
+			close(client_fd);
+			continue;
+		}
+		clients[client_fd].fd = client_fd;
+		client_count++;
+		timer_schedule(&timers, &clients[client_fd].timer,
+		               now_ms() + IDLE_TIMEOUT_SEC * 1000);
+	}
+}
+
+/*
+ * client_on_readable - 读取一次数据并回复
+ */
+void client_on_readable(Client *client)
+{
 	char recv_buf[1024] = {0};
 	int ret;
 
+	ret = recv(client->fd, recv_buf, sizeof(recv_buf) - 1, 0);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return;
+		}
+		log_warn("recv error: %m");
+		client_close(client);
+	} else if (ret == 0) {
+		/* 客户端断开连接 */
+		log_info("Client fd=%d disconnected", client->fd);
+		client_close(client);
+	} else {
+		/* 收到数据 */
+		log_debug("Received from fd=%d: %s", client->fd, recv_buf);
+
+		/* 回发数据给客户端 */
+		char send_buf[128];
+		snprintf(send_buf, sizeof(send_buf), "Server received: %s", recv_buf);
+		send(client->fd, send_buf, strlen(send_buf), MSG_NOSIGNAL);
+
+		timer_schedule(&timers, &client->timer,
+		               now_ms() + IDLE_TIMEOUT_SEC * 1000);
+	}
+}
+
+void print_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-m select|poll|epoll]  (default: epoll)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int listen_fd;
+	struct sockaddr_in server_addr;
+	socklen_t server_len;
+	const MuxOps *backend = &mux_epoll_ops;
+	struct rlimit rl;
+	int ready[READY_BATCH];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1) {
+		if (opt != 'm' || (backend = mux_find(optarg)) == NULL) {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	/* 日志由后台线程批量写出，收发数据的路径不会被终端或管道阻塞 */
+	if (log_init(STDOUT_FILENO, LOG_LEVEL_DEBUG) == 0) {
+		atexit(log_shutdown);
+	}
+
+	/* 打开文件数上限提到硬上限，客户端表按它分配 */
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+		log_error("getrlimit fail: %m");
+		return -1;
+	}
+	if (rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (mux_init(&mux, backend, rl.rlim_cur > 1 << 20 ? 1 << 20 : (int)rl.rlim_cur) < 0) {
+		log_error("mux_init %s fail: %m", backend->name);
+		return -1;
+	}
+	clients = calloc((size_t)mux.capacity, sizeof(Client));
+	if (clients == NULL) {
+		log_error("calloc clients fail: %m");
+		return -1;
+	}
+	for (int i = 0; i < mux.capacity; i++) {
+		clients[i].fd = -1;
+		timer_node_init(&clients[i].timer);
+	}
+	timer_wheel_init(&timers, now_ms(), TIMER_TICK_MS);
+	log_info("Multiplexer: %s, up to fd %d", backend->name, mux.capacity - 1);
+
 	/* 创建监听套接字 */
 	listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	if (listen_fd < 0) {
-		perror("socket fail");
+		log_error("socket fail: %m");
 		return -1;
 	}
 
-	printf("listen_fd: %d\n", listen_fd);
+	log_info("listen_fd: %d", listen_fd);
+
+	/* 设置端口复用，非阻塞以便一次接受所有排队的连接 */
+	opt = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
 
 	/* 绑定地址 */
+	memset(&server_addr, 0, sizeof(server_addr));
 	server_addr.sin_family = AF_INET;
 	server_addr.sin_port = htons(SERVER_PORT);
-	server_addr.sin_addr.s_addr = htons(INADDR_ANY);
+	server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 	server_len = sizeof(server_addr);
 
 	if (bind(listen_fd, (struct sockaddr *)&server_addr, server_len) < 0) {
-		perror("bind fail");
+		log_error("bind fail: %m");
 		return -1;
 	}
 
-	printf("bind success.\n");
+	log_info("bind success.");
 
 	/* 开始监听 */
-	listen(listen_fd, 5);
-	printf("Server listening on port %d...\n", SERVER_PORT);
-
-	/* select 相关变量 */
-	fd_set readfds, tempfds;
-	int max_fd;
-	int client_fds[MAX_CLIENTS];  /* 存储已连接的客户端套接字 */
-	int client_count = 0;
-
-	/* 初始化 fd_set */
-	FD_ZERO(&readfds);
-	FD_SET(listen_fd, &readfds);
-	max_fd = listen_fd;
-
-	/* 初始化客户端数组 */
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		client_fds[i] = -1;
+	listen(listen_fd, LISTEN_BACKLOG);
+	log_info("Server listening on port %d...", SERVER_PORT);
+
+	if (mux_add(&mux, listen_fd) < 0) {
+		log_error("mux_add listen_fd fail: %m");
+		return -1;
 	}
 
 	while (1) {
-		tempfds = readfds;  /* 每次循环需要重新赋值 */
-
-		/* 等待事件发生 */
-		ret = select(max_fd + 1, &tempfds, NULL, NULL, NULL);
-		if (ret < 0) {
-			perror("select error");
-			break;
-		}
-
-		/* 检查监听套接字 - 是否有新客户端连接 */
-		if (FD_ISSET(listen_fd, &tempfds)) {
-			client_len = sizeof(client_addr);
-			client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-			if (client_fd < 0) {
-				perror("accept fail");
+		/* 等待事件发生，最多等到最近一个客户端超时（没有客户端时一直等待） */
+		int timeout = timer_wheel_timeout_ms(&timers, now_ms());
+		int n = mux_wait(&mux, ready, READY_BATCH, timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
 				continue;
 			}
-
-			printf("New client connected: fd=%d, IP=%s, Port=%d\n",
-			       client_fd,
-			       inet_ntoa(client_addr.sin_addr),
-			       ntohs(client_addr.sin_port));
-
-			/* 将新客户端加入数组 */
-			int i;
-			for (i = 0; i < MAX_CLIENTS; i++) {
-				if (client_fds[i] == -1) {
-					client_fds[i] = client_fd;
-					break;
-				}
-			}
-
-			if (i >= MAX_CLIENTS) {
-				printf("Too many clients, reject!\n");
-				close(client_fd);
-			} else {
-				client_count++;
-				/* 将新客户端加入 select 监听集合 */
-				FD_SET(client_fd, &readfds);
-				if (client_fd > max_fd) {
-					max_fd = client_fd;
-				}
-			}
+			log_error("%s error: %m", backend->name);
+			break;
 		}
 
-		/* 检查所有客户端套接字 - 是否有数据到达 */
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			client_fd = client_fds[i];
-			if (client_fd > 0 && FD_ISSET(client_fd, &tempfds)) {
-				memset(recv_buf, 0, sizeof(recv_buf));
-
-				ret = recv(client_fd, recv_buf, sizeof(recv_buf), 0);
-				if (ret < 0) {
-					perror("recv error");
-				} else if (ret == 0) {
-					/* 客户端断开连接 */
-					printf("Client fd=%d disconnected\n", client_fd);
-					close(client_fd);
-					FD_CLR(client_fd, &readfds);
-					client_fds[i] = -1;
-					client_count--;
-				} else {
-					/* 收到数据 */
-					printf("Received from fd=%d: %s\n", client_fd, recv_buf);
-
-					/* 回发数据给客户端 */
-					char send_buf[128];
-					snprintf(send_buf, sizeof(send_buf), "Server received: %s", recv_buf);
-					send(client_fd, send_buf, strlen(send_buf), 0);
-				}
+		/* 只处理就绪的 fd，不再遍历所有客户端 */
+		for (int i = 0; i < n; i++) {
+			if (ready[i] == listen_fd) {
+				/* 监听套接字 - 有新客户端连接 */
+				accept_clients(listen_fd);
+			} else if (clients[ready[i]].fd >= 0) {
+				/* 客户端套接字 - 有数据到达 */
+				client_on_readable(&clients[ready[i]]);
 			}
 		}
+
+		/* 关闭到期的空闲客户端 */
+		timer_wheel_advance(&timers, now_ms(), client_on_timeout, NULL);
 	}
 
 	/* 关闭所有客户端连接 */
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		if (client_fds[i] > 0) {
-			close(client_fds[i]);
+	for (int i = 0; i < mux.capacity; i++) {
+		if (clients[i].fd >= 0) {
+			close(clients[i].fd);
 		}
 	}
 
+	mux_destroy(&mux);
+	free(clients);
 	close(listen_fd);
 	return 0;
 }
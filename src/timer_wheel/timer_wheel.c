@@ -0,0 +1,178 @@
+#include "timer_wheel.h"
+
+#include <limits.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+/* 能表示的最远到期时间（tick），更远的按这个截断，到期后由调用方重新判断 */
+#define TIMER_WHEEL_SPAN \
+  ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+static void list_init(TimerNode *head) { head->prev = head->next = head; }
+
+static int list_empty(const TimerNode *head) { return head->next == head; }
+
+static void list_add_tail(TimerNode *head, TimerNode *node) {
+  node->prev = head->prev;
+  node->next = head;
+  head->prev->next = node;
+  head->prev = node;
+}
+
+static void list_del(TimerNode *node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->prev = node->next = NULL;
+}
+
+/* 把 src 上的节点整体移到 dst（dst 原来为空），src 清空 */
+static void list_move_all(TimerNode *src, TimerNode *dst) {
+  if (list_empty(src)) {
+    list_init(dst);
+    return;
+  }
+  dst->next = src->next;
+  dst->prev = src->prev;
+  dst->next->prev = dst;
+  dst->prev->next = dst;
+  list_init(src);
+}
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_ms, unsigned tick_ms) {
+  wheel->origin_ms = now_ms;
+  wheel->tick_ms = tick_ms ? tick_ms : 1;
+  wheel->now = 0;
+  wheel->pending = 0;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      list_init(&wheel->slots[level][i]);
+    }
+  }
+}
+
+/* 按与当前 tick 的距离选层：距离 < 64^(n+1) 的放第 n 层 */
+static void wheel_insert(TimerWheel *wheel, TimerNode *node) {
+  uint64_t delta = node->expire - wheel->now;
+  int level = 0;
+  int slot;
+
+  while (level < TIMER_WHEEL_LEVELS - 1 &&
+         delta >= (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  slot = (int)(node->expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+  list_add_tail(&wheel->slots[level][slot], node);
+}
+
+void timer_schedule(TimerWheel *wheel, TimerNode *node, uint64_t expire_ms) {
+  uint64_t expire = 0;
+
+  if (timer_pending(node)) {
+    list_del(node);
+  } else {
+    wheel->pending++;
+  }
+
+  if (expire_ms > wheel->origin_ms) {
+    expire = (expire_ms - wheel->origin_ms + wheel->tick_ms - 1) /
+             wheel->tick_ms;
+  }
+  if (expire <= wheel->now) {
+    expire = wheel->now + 1;
+  }
+  if (expire - wheel->now >= TIMER_WHEEL_SPAN) {
+    expire = wheel->now + TIMER_WHEEL_SPAN - 1;
+  }
+  node->expire = expire;
+  wheel_insert(wheel, node);
+}
+
+void timer_cancel(TimerWheel *wheel, TimerNode *node) {
+  if (!timer_pending(node)) {
+    return;
+  }
+  list_del(node);
+  wheel->pending--;
+}
+
+/* 把第 level 层当前槽的定时器按剩余时间重新放到下面几层 */
+static void wheel_cascade(TimerWheel *wheel, int level) {
+  int slot = (int)(wheel->now >> (TIMER_WHEEL_BITS * level)) &
+             TIMER_WHEEL_MASK;
+  TimerNode list;
+
+  list_move_all(&wheel->slots[level][slot], &list);
+  while (!list_empty(&list)) {
+    TimerNode *node = list.next;
+
+    list_del(node);
+    wheel_insert(wheel, node);
+  }
+}
+
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now_ms, TimerCallback cb,
+                         void *arg) {
+  uint64_t target;
+
+  if (now_ms < wheel->origin_ms) {
+    return;
+  }
+  target = (now_ms - wheel->origin_ms) / wheel->tick_ms;
+
+  while (wheel->now < target) {
+    TimerNode expired;
+
+    if (wheel->pending == 0) {
+      /* 所有槽都是空的，直接跳过去 */
+      wheel->now = target;
+      break;
+    }
+    wheel->now++;
+
+    /* 低层转满一圈时从上一层下放，逐层向上 */
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+      if (wheel->now & (((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) {
+        break;
+      }
+      wheel_cascade(wheel, level);
+    }
+
+    /*
+     * 先把到期槽整体摘到局部链表再逐个回调：回调里新加的定时器
+     * 不会混进本轮，取消局部链表里的其他节点也是安全的
+     */
+    list_move_all(&wheel->slots[0][wheel->now & TIMER_WHEEL_MASK], &expired);
+    while (!list_empty(&expired)) {
+      TimerNode *node = expired.next;
+
+      list_del(node);
+      wheel->pending--;
+      cb(wheel, node, arg);
+    }
+  }
+}
+
+int timer_wheel_timeout_ms(const TimerWheel *wheel, uint64_t now_ms) {
+  uint64_t ticks, deadline;
+
+  if (wheel->pending == 0) {
+    return -1;
+  }
+
+  /* 默认在下一次下放时醒来，第 0 层更早有定时器时以它为准 */
+  ticks = TIMER_WHEEL_SLOTS - (wheel->now & TIMER_WHEEL_MASK);
+  for (uint64_t i = 1; i < ticks; i++) {
+    if (!list_empty(&wheel->slots[0][(wheel->now + i) & TIMER_WHEEL_MASK])) {
+      ticks = i;
+      break;
+    }
+  }
+
+  deadline = wheel->origin_ms + (wheel->now + ticks) * wheel->tick_ms;
+  if (deadline <= now_ms) {
+    return 0;
+  }
+  if (deadline - now_ms > INT_MAX) {
+    return INT_MAX;
+  }
+  return (int)(deadline - now_ms);
+}
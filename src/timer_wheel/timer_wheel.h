@@ -0,0 +1,72 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 分层时间轮：管理大量连接的超时（请求头读取、响应发送、keep-alive 空闲）
+ * - 4 层 × 64 槽，第 0 层每槽一个 tick，第 n 层每槽 64^n 个 tick
+ * - 定时器节点嵌在连接对象里（侵入式双向链表），添加/取消/改期都是 O(1)，
+ *   不分配内存
+ * - 推进时只处理到期的槽；第 0 层转满一圈时把上一层对应槽的定时器
+ *   重新分散到下层（cascade）
+ * - 到期时间精度为一个 tick，只会晚到不会早到
+ *
+ * 时间轮本身不加锁，也不读时钟：调用方传入单调时钟毫秒数
+ */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+typedef struct TimerNode {
+  struct TimerNode *prev;
+  struct TimerNode *next; /* NULL 表示未挂在时间轮上 */
+  uint64_t expire;        /* 到期 tick */
+} TimerNode;
+
+typedef struct TimerWheel TimerWheel;
+
+/* 到期回调，调用前节点已摘下；回调中可以对任意节点 schedule/cancel */
+typedef void (*TimerCallback)(TimerWheel *wheel, TimerNode *node, void *arg);
+
+struct TimerWheel {
+  uint64_t origin_ms; /* tick 0 对应的时刻 */
+  unsigned tick_ms;
+  uint64_t now;   /* 已经处理完的 tick */
+  size_t pending; /* 挂着的定时器数 */
+  TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; /* 各槽的哨兵 */
+};
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_ms, unsigned tick_ms);
+
+static inline void timer_node_init(TimerNode *node) {
+  node->prev = node->next = NULL;
+}
+
+static inline int timer_pending(const TimerNode *node) {
+  return node->next != NULL;
+}
+
+/*
+ * 设置（或改到）在 expire_ms 时刻到期，已挂着的节点先摘下
+ * 已经过期的时刻在下一次推进时到期
+ */
+void timer_schedule(TimerWheel *wheel, TimerNode *node, uint64_t expire_ms);
+
+/* 取消定时器，未挂着时什么也不做 */
+void timer_cancel(TimerWheel *wheel, TimerNode *node);
+
+/* 推进到 now_ms，对所有到期的定时器调用 cb */
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now_ms, TimerCallback cb,
+                         void *arg);
+
+/*
+ * 距离下一次需要推进的毫秒数，可直接作为 epoll_wait/select 的超时
+ * 没有定时器时返回 -1；上层有定时器要下放时返回到下层转满一圈的时间，
+ * 因此结果不会晚于最早的到期时刻
+ */
+int timer_wheel_timeout_ms(const TimerWheel *wheel, uint64_t now_ms);
+
+#endif
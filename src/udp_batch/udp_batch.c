@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include "udp_batch.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/udp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* UDP_GRO 段大小 + SO_RXQ_OVFL 丢包计数 */
+#define RX_CTRL_SIZE (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)))
+#define TX_CTRL_SIZE CMSG_SPACE(sizeof(uint16_t))
+
+int udp_batch_init(UdpBatch *batch, int size, size_t buf_size, int gro) {
+  memset(batch, 0, sizeof(*batch));
+  if (size < 1 || size > UDP_BATCH_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  batch->size = size;
+  batch->buf_size = gro ? UDP_GRO_BUF_SIZE : buf_size;
+  batch->gro = gro;
+  /* 合并的报文可能拆成多个回复报文，每段回复占两个 iovec */
+  batch->tx_cap = gro ? 2 * size : size;
+  batch->tx_iov_cap = gro ? 2 * size * UDP_GSO_MAX_SEGS : 2 * size;
+
+  batch->rx = calloc((size_t)size, sizeof(struct mmsghdr));
+  batch->rx_iov = calloc((size_t)size, sizeof(struct iovec));
+  batch->addr = calloc((size_t)size, sizeof(struct sockaddr_in));
+  batch->rx_buf = malloc((size_t)size * batch->buf_size);
+  batch->rx_ctrl = calloc((size_t)size, RX_CTRL_SIZE);
+  batch->seg_size = calloc((size_t)size, sizeof(int));
+  batch->tx = calloc((size_t)batch->tx_cap, sizeof(struct mmsghdr));
+  batch->tx_iov = calloc((size_t)batch->tx_iov_cap, sizeof(struct iovec));
+  batch->tx_ctrl = calloc((size_t)batch->tx_cap, TX_CTRL_SIZE);
+  if (!batch->rx || !batch->rx_iov || !batch->addr || !batch->rx_buf ||
+      !batch->rx_ctrl || !batch->seg_size || !batch->tx || !batch->tx_iov ||
+      !batch->tx_ctrl) {
+    udp_batch_free(batch);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (int i = 0; i < size; i++) {
+    struct msghdr *hdr = &batch->rx[i].msg_hdr;
+
+    batch->rx_iov[i].iov_base = udp_batch_data(batch, i);
+    batch->rx_iov[i].iov_len = batch->buf_size;
+    hdr->msg_name = &batch->addr[i];
+    hdr->msg_iov = &batch->rx_iov[i];
+    hdr->msg_iovlen = 1;
+    hdr->msg_control = batch->rx_ctrl + (size_t)i * RX_CTRL_SIZE;
+  }
+  batch->rx_count = size;
+  return 0;
+}
+
+void udp_batch_free(UdpBatch *batch) {
+  free(batch->rx);
+  free(batch->rx_iov);
+  free(batch->addr);
+  free(batch->rx_buf);
+  free(batch->rx_ctrl);
+  free(batch->seg_size);
+  free(batch->tx);
+  free(batch->tx_iov);
+  free(batch->tx_ctrl);
+  memset(batch, 0, sizeof(*batch));
+}
+
+int udp_enable_gro(int fd) {
+  int on = 1;
+
+  return setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on));
+}
+
+int udp_enable_drop_count(int fd) {
+  int on = 1;
+
+  return setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+}
+
+/* 解析 cmsg：返回 UDP_GRO 段大小（没有合并时为 0），顺带更新丢包计数 */
+static int rx_parse_cmsg(UdpBatch *batch, struct msghdr *hdr) {
+  int seg = 0;
+
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+    if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+      memcpy(&seg, CMSG_DATA(cm), sizeof(seg));
+    } else if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+      memcpy(&batch->rx_dropped, CMSG_DATA(cm), sizeof(batch->rx_dropped));
+    }
+  }
+  return seg;
+}
+
+int udp_batch_recv(UdpBatch *batch, int fd) {
+  int n;
+
+  /* 内核会改写地址长度和 cmsg 长度，只复位上次用过的槽 */
+  for (int i = 0; i < batch->rx_count; i++) {
+    batch->rx[i].msg_hdr.msg_namelen = sizeof(batch->addr[i]);
+    batch->rx[i].msg_hdr.msg_controllen = RX_CTRL_SIZE;
+  }
+
+  do {
+    n = recvmmsg(fd, batch->rx, (unsigned)batch->size, MSG_WAITFORONE, NULL);
+  } while (n < 0 && errno == EINTR);
+  batch->rx_count = n > 0 ? n : 0;
+
+  for (int i = 0; i < batch->rx_count; i++) {
+    int seg = rx_parse_cmsg(batch, &batch->rx[i].msg_hdr);
+
+    batch->seg_size[i] = seg < (int)batch->rx[i].msg_len ? seg : 0;
+  }
+  return n;
+}
+
+/* 逐段发送一个 UDP_SEGMENT 报文（每段两个 iovec），内核拒绝 GSO 时使用 */
+static int tx_send_split(int fd, const struct msghdr *gso) {
+  struct msghdr hdr = {
+      .msg_name = gso->msg_name,
+      .msg_namelen = gso->msg_namelen,
+      .msg_iovlen = 2,
+  };
+  int ret = 0;
+
+  for (size_t i = 0; i < gso->msg_iovlen; i += 2) {
+    hdr.msg_iov = gso->msg_iov + i;
+    while (sendmsg(fd, &hdr, 0) < 0) {
+      if (errno != EINTR) {
+        ret = -1;
+        break;
+      }
+    }
+  }
+  return ret;
+}
+
+int udp_batch_flush(UdpBatch *batch, int fd) {
+  int sent = 0, ret = 0;
+
+  while (sent < batch->tx_count) {
+    int n = sendmmsg(fd, batch->tx + sent, (unsigned)(batch->tx_count - sent),
+                     0);
+    if (n > 0) {
+      sent += n;
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    /* 失败的总是第一个未发出的报文：GSO 报文退回逐段发送，其余跳过 */
+    struct msghdr *hdr = &batch->tx[sent].msg_hdr;
+    if (hdr->msg_controllen > 0 &&
+        (errno == EINVAL || errno == EMSGSIZE || errno == EIO)) {
+      if (tx_send_split(fd, hdr) < 0)
+        ret = -1;
+    } else {
+      ret = -1;
+    }
+    sent++;
+  }
+  batch->tx_count = 0;
+  batch->tx_iov_used = 0;
+  return ret;
+}
+
+/* 组一个回复报文，segs > 1 时附带 UDP_SEGMENT，由内核按 gso_size 切分 */
+static void tx_add(UdpBatch *batch, struct sockaddr_in *addr, int iov_start,
+                   int segs, size_t gso_size) {
+  struct msghdr *hdr = &batch->tx[batch->tx_count].msg_hdr;
+
+  hdr->msg_name = addr;
+  hdr->msg_namelen = sizeof(*addr);
+  hdr->msg_iov = batch->tx_iov + iov_start;
+  hdr->msg_iovlen = (size_t)segs * 2;
+  hdr->msg_control = NULL;
+  hdr->msg_controllen = 0;
+  if (segs > 1) {
+    char *ctrl = batch->tx_ctrl + (size_t)batch->tx_count * TX_CTRL_SIZE;
+    uint16_t size = (uint16_t)gso_size;
+    struct cmsghdr *cm;
+
+    hdr->msg_control = ctrl;
+    hdr->msg_controllen = TX_CTRL_SIZE;
+    cm = CMSG_FIRSTHDR(hdr);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(size));
+    memcpy(CMSG_DATA(cm), &size, sizeof(size));
+  }
+  batch->tx_count++;
+}
+
+int udp_batch_add_reply(UdpBatch *batch, int fd, struct sockaddr_in *addr,
+                        char *data, size_t len, size_t seg, const char *prefix,
+                        size_t prefix_len) {
+  size_t gso_size, off = 0;
+  int per_msg = 1, ret = 0;
+
+  if (seg == 0 || seg > len)
+    seg = len;
+  gso_size = prefix_len + seg;
+  if (seg < len) {
+    per_msg = (int)(UDP_GSO_MAX_BYTES / gso_size);
+    if (per_msg > UDP_GSO_MAX_SEGS)
+      per_msg = UDP_GSO_MAX_SEGS;
+    if (per_msg < 1)
+      per_msg = 1;
+  }
+
+  do {
+    if (batch->tx_count == batch->tx_cap ||
+        batch->tx_iov_used + 2 * per_msg > batch->tx_iov_cap) {
+      if (udp_batch_flush(batch, fd) < 0)
+        ret = -1;
+    }
+
+    int start = batch->tx_iov_used, segs = 0;
+    for (; segs < per_msg && (off < len || segs == 0); segs++) {
+      size_t chunk = len - off < seg ? len - off : seg;
+      struct iovec *iov = batch->tx_iov + batch->tx_iov_used;
+
+      iov[0].iov_base = (void *)prefix;
+      iov[0].iov_len = prefix_len;
+      iov[1].iov_base = data + off;
+      iov[1].iov_len = chunk;
+      batch->tx_iov_used += 2;
+      off += chunk;
+    }
+    tx_add(batch, addr, start, segs, gso_size);
+  } while (off < len);
+  return ret;
+}
+
+int udp_batch_echo(UdpBatch *batch, int fd, int n, const char *prefix,
+                   size_t prefix_len) {
+  int ret = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (udp_batch_add_reply(batch, fd, &batch->addr[i], udp_batch_data(batch, i),
+                            batch->rx[i].msg_len, (size_t)batch->seg_size[i],
+                            prefix, prefix_len) < 0)
+      ret = -1;
+  }
+  if (udp_batch_flush(batch, fd) < 0)
+    ret = -1;
+  return ret;
+}
+
+/* 逐个报文收发：每个报文一次 recvfrom 和一次 sendto */
+static int serve_single(int fd, size_t buf_size, int quiet, const char *label,
+                        const char *prefix) {
+  size_t prefix_len = strlen(prefix);
+  char *recv_buf = malloc(buf_size);
+  char *send_buf = malloc(prefix_len + buf_size);
+  struct sockaddr_in client_addr;
+  socklen_t client_len;
+  ssize_t ret;
+
+  if (!recv_buf || !send_buf) {
+    free(recv_buf);
+    free(send_buf);
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(send_buf, prefix, prefix_len);
+
+  while (1) {
+    client_len = sizeof(client_addr);
+
+    /* 接收数据 */
+    ret = recvfrom(fd, recv_buf, buf_size - 1, 0,
+                   (struct sockaddr *)&client_addr, &client_len);
+    if (ret < 0) {
+      perror("recvfrom fail");
+      continue;
+    }
+    recv_buf[ret] = '\0';
+
+    if (!quiet) {
+      printf("%s %s:%d : %s\n", label, inet_ntoa(client_addr.sin_addr),
+             ntohs(client_addr.sin_port), recv_buf);
+    }
+
+    /* 回复客户端：前缀 + 收到的字符串 */
+    memcpy(send_buf + prefix_len, recv_buf, strlen(recv_buf));
+    ret = sendto(fd, send_buf, prefix_len + strlen(recv_buf), 0,
+                 (struct sockaddr *)&client_addr, client_len);
+    if (ret < 0) {
+      perror("sendto fail");
+    }
+  }
+
+  free(recv_buf);
+  free(send_buf);
+  return 0;
+}
+
+/* 批量收发：一次 recvmmsg 收下所有排队的报文，回复直接引用接收缓冲区，
+ * 一次 sendmmsg 发出 */
+static int serve_batch(int fd, int batch_size, size_t buf_size, int gro,
+                       int quiet, const char *label, const char *prefix) {
+  size_t prefix_len = strlen(prefix);
+  UdpBatch batch;
+  int n;
+
+  if (gro && udp_enable_gro(fd) < 0) {
+    perror("setsockopt UDP_GRO fail, continue without it");
+    gro = 0;
+  }
+  if (udp_batch_init(&batch, batch_size, buf_size, gro) < 0) {
+    perror("udp_batch_init fail");
+    return -1;
+  }
+
+  while (1) {
+    /* 接收数据 */
+    n = udp_batch_recv(&batch, fd);
+    if (n < 0) {
+      perror("recvmmsg fail");
+      continue;
+    }
+
+    if (!quiet) {
+      for (int i = 0; i < n; i++) {
+        printf("%s %s:%d : %.*s\n", label, inet_ntoa(batch.addr[i].sin_addr),
+               ntohs(batch.addr[i].sin_port), (int)batch.rx[i].msg_len,
+               udp_batch_data(&batch, i));
+      }
+    }
+
+    /* 回复客户端 */
+    if (udp_batch_echo(&batch, fd, n, prefix, prefix_len) < 0) {
+      perror("sendmmsg fail");
+    }
+  }
+
+  udp_batch_free(&batch);
+  return 0;
+}
+
+int udp_batch_serve(int fd, int batch_size, size_t buf_size, int gro,
+                    int quiet, const char *label, const char *prefix) {
+  if (batch_size > 1)
+    return serve_batch(fd, batch_size, buf_size, gro, quiet, label, prefix);
+  return serve_single(fd, buf_size, quiet, label, prefix);
+}
+
+void udp_batch_usage(const char *prog, const char *worker_opts,
+                     const char *worker_help) {
+  fprintf(stderr,
+          "Usage: %s [-b batch] [-g] [-q] [-t workers %s]\n"
+          "  -b batch  recvmmsg/sendmmsg with up to batch datagrams per call "
+          "(1..%d, default 1: recvfrom/sendto)\n"
+          "  -g        enable UDP_GRO on receive and UDP_SEGMENT on reply "
+          "(batched mode only)\n"
+          "  -q        do not print every datagram\n"
+          "%s",
+          prog, worker_opts, UDP_BATCH_MAX, worker_help);
+}
@@ -0,0 +1,123 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*
+ * UDP 批量收发：一次 recvmmsg 收多个报文，一次 sendmmsg 发出全部回复
+ * - mmsghdr / iovec / 地址 / 接收缓冲区在初始化时一次分配，收发路径不再
+ *   memset 或分配内存
+ * - 回复用两段 iovec（固定前缀 + 收到的数据）直接引用接收缓冲区，不拷贝、
+ *   不 snprintf
+ * - 可选 UDP_GRO / UDP_SEGMENT：内核把同一来源的连续小报文合并成一个大缓冲区
+ *   交上来，回复也按段大小交给内核切分，一次系统调用处理几十个报文
+ *
+ * 不加锁，每个线程使用自己的 UdpBatch
+ * recvmmsg / sendmmsg 需要 _GNU_SOURCE，包含本头文件的源文件要在最前面定义
+ */
+
+#define UDP_BATCH_MAX 1024       /* 一次收发的最大报文数 */
+#define UDP_GRO_BUF_SIZE 65536   /* 打开 GRO 时每个槽位的缓冲区大小 */
+#define UDP_GSO_MAX_SEGS 64      /* 一次 UDP_SEGMENT 发送的最大段数 */
+#define UDP_GSO_MAX_BYTES 65000  /* 一次 UDP_SEGMENT 发送的最大负载 */
+
+typedef struct {
+  int size;                 /* 槽位数 */
+  size_t buf_size;          /* 每个槽位的接收缓冲区大小 */
+  int gro;                  /* 已打开 UDP_GRO，接收时解析段大小 */
+  struct mmsghdr *rx;       /* size 个 */
+  struct iovec *rx_iov;     /* size 个 */
+  struct sockaddr_in *addr; /* 来源地址，回复时原样作为目的地址 */
+  char *rx_buf;             /* size * buf_size */
+  char *rx_ctrl;            /* 每槽一个 UDP_GRO cmsg */
+  int *seg_size;            /* 每槽合并报文的段大小，0 表示未合并 */
+  int rx_count;             /* 上次收到的槽位数，下次接收前只复位这些槽 */
+  uint32_t rx_dropped;      /* SO_RXQ_OVFL：套接字因接收队列满累计丢弃的报文数 */
+  struct mmsghdr *tx;       /* tx_cap 个回复报文 */
+  struct iovec *tx_iov;     /* tx_iov_cap 个，每段回复占前缀和数据两个 */
+  char *tx_ctrl;            /* 每个回复报文一个 UDP_SEGMENT cmsg */
+  int tx_cap;
+  int tx_iov_cap;
+  int tx_count;             /* 已组好待发送的回复报文数 */
+  int tx_iov_used;
+} UdpBatch;
+
+/*
+ * udp_batch_init - 分配 size 个槽位（1..UDP_BATCH_MAX）
+ * gro 非 0 时每槽使用 UDP_GRO_BUF_SIZE 的缓冲区，否则使用 buf_size
+ * 返回值: 成功返回0，失败返回-1
+ */
+int udp_batch_init(UdpBatch *batch, int size, size_t buf_size, int gro);
+
+void udp_batch_free(UdpBatch *batch);
+
+/*
+ * udp_enable_gro - 在套接字上打开 UDP_GRO
+ * 返回值: 成功返回0，内核不支持时返回-1
+ */
+int udp_enable_gro(int fd);
+
+/*
+ * udp_enable_drop_count - 打开 SO_RXQ_OVFL，每次接收时更新 batch->rx_dropped
+ * 返回值: 成功返回0，失败返回-1
+ */
+int udp_enable_drop_count(int fd);
+
+/*
+ * udp_batch_recv - 阻塞到至少一个报文到达，再把已排队的报文一并收下
+ * 第 i 个报文的数据在 udp_batch_data(batch, i)，长度 batch->rx[i].msg_len，
+ * 来源 batch->addr[i]；打开 GRO 时可能是 batch->seg_size[i] 大小的多个报文
+ * 返回值: 收到的槽位数，出错返回-1
+ */
+int udp_batch_recv(UdpBatch *batch, int fd);
+
+static inline char *udp_batch_data(const UdpBatch *batch, int i) {
+  return batch->rx_buf + (size_t)i * batch->buf_size;
+}
+
+/*
+ * udp_batch_echo - 对前 n 个槽位的每个报文回复 prefix + 原数据，
+ * 用 sendmmsg 一次发出；合并过的报文用 UDP_SEGMENT 回复，内核不接受时
+ * 退回逐个报文发送
+ * 返回值: 全部发出返回0，有报文发送失败返回-1（errno 为最后一个错误）
+ */
+int udp_batch_echo(UdpBatch *batch, int fd, int n, const char *prefix,
+                   size_t prefix_len);
+
+/*
+ * udp_batch_add_reply - 追加一个回复：data 按 seg 分段（0 表示不分段），
+ * 每段回复 prefix + 该段数据；addr 与 data 在 udp_batch_flush 之前必须保持有效
+ * 待发送的回复放不下时先发出已有的
+ * 返回值: 成功返回0，提前发送时有报文失败返回-1
+ */
+int udp_batch_add_reply(UdpBatch *batch, int fd, struct sockaddr_in *addr,
+                        char *data, size_t len, size_t seg, const char *prefix,
+                        size_t prefix_len);
+
+/*
+ * udp_batch_flush - 用 sendmmsg 发出所有待发送的回复
+ * 返回值: 全部发出返回0，有报文发送失败返回-1（errno 为最后一个错误）
+ */
+int udp_batch_flush(UdpBatch *batch, int fd);
+
+/*
+ * udp_batch_serve - 单线程回显服务的主循环：batch_size 为 1 时逐个报文
+ * recvfrom / sendto，大于 1 时用 UdpBatch 批量收发（gro 非 0 时打开 UDP_GRO）
+ * 每个报文回复 prefix + 原数据；quiet 为 0 时逐个打印 "label ip:port : 数据"
+ * 返回值: 不再返回，分配缓冲区失败时返回-1
+ */
+int udp_batch_serve(int fd, int batch_size, size_t buf_size, int gro,
+                    int quiet, const char *label, const char *prefix);
+
+/*
+ * udp_batch_usage - 打印 -b / -g / -q 的用法；worker_opts 是 -t 之后的
+ * 可选项（如 "[-a]"），worker_help 是这些选项的说明行
+ */
+void udp_batch_usage(const char *prog, const char *worker_opts,
+                     const char *worker_help);
+
+#endif
@@ -0,0 +1,387 @@
+#define _GNU_SOURCE
+#include "udp_shard.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "udp_batch.h"
+
+#define STEER_RING_SIZE 1024 /* 每个工作线程的分发队列长度，必须是 2 的幂 */
+#define STEER_SLOT_DATA 2048 /* steer 模式单个报文的最大长度 */
+#define SHARD_MAX_WORKERS 256
+
+typedef struct {
+  struct sockaddr_in addr;
+  uint32_t len;
+  char data[STEER_SLOT_DATA];
+} SteerSlot;
+
+typedef struct {
+  _Alignas(64) atomic_uint_fast64_t rx_packets;
+  atomic_uint_fast64_t rx_bytes;
+  atomic_uint_fast64_t drops; /* 接收队列满（SO_RXQ_OVFL）或分发队列满 */
+} WorkerStats;
+
+typedef struct Shard Shard;
+
+typedef struct {
+  Shard *shard;
+  int id;
+  int fd; /* reuseport：自己的套接字；steer：共享套接字，只用来回复 */
+  int cpu; /* 绑定的 CPU，-1 表示不绑定 */
+  pthread_t thread;
+  UdpBatch batch;
+  WorkerStats stats;
+  /* steer 模式：接收线程写 tail，工作线程写 head */
+  SteerSlot *ring;
+  _Alignas(64) atomic_uint tail;
+  _Alignas(64) atomic_uint head;
+  atomic_int sleeping; /* 队列空、在 wake_fd 上睡眠 */
+  int wake_fd;
+} Worker;
+
+struct Shard {
+  const UdpShardConfig *cfg;
+  Worker *workers;
+  /* steer 模式的接收线程 */
+  int fd;
+  UdpBatch batch;
+  atomic_uint_fast64_t recv_drops;
+  pthread_t recv_thread;
+};
+
+static void print_datagram(const UdpShardConfig *cfg, int id,
+                           const struct sockaddr_in *addr, const char *data,
+                           size_t len) {
+  char ip[INET_ADDRSTRLEN];
+
+  inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+  printf("[worker %d] %s %s:%d : %.*s\n", id, cfg->label, ip,
+         ntohs(addr->sin_port), (int)len, data);
+}
+
+static int open_socket(const UdpShardConfig *cfg, int reuseport) {
+  struct sockaddr_in addr;
+  int fd, on = 1;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    perror("socket fail");
+    return -1;
+  }
+  if (reuseport &&
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+    perror("setsockopt SO_REUSEPORT fail (try steer mode)");
+    goto fail;
+  }
+  if (cfg->broadcast &&
+      setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0) {
+    perror("setsockopt SO_BROADCAST fail");
+    goto fail;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(cfg->port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind fail");
+    goto fail;
+  }
+
+  if (cfg->gro && udp_enable_gro(fd) < 0)
+    perror("setsockopt UDP_GRO fail, continue without it");
+  udp_enable_drop_count(fd);
+  return fd;
+
+fail:
+  close(fd);
+  return -1;
+}
+
+/* reuseport 模式：每个线程在自己的套接字上收发 */
+static void *worker_socket_main(void *arg) {
+  Worker *w = arg;
+  const UdpShardConfig *cfg = w->shard->cfg;
+
+  while (1) {
+    int n = udp_batch_recv(&w->batch, w->fd);
+    uint64_t packets = 0, bytes = 0;
+
+    if (n < 0) {
+      perror("recvmmsg fail");
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      uint32_t len = w->batch.rx[i].msg_len;
+      uint32_t seg = (uint32_t)w->batch.seg_size[i];
+
+      packets += seg ? (len + seg - 1) / seg : 1;
+      bytes += len;
+      if (!cfg->quiet)
+        print_datagram(cfg, w->id, &w->batch.addr[i],
+                       udp_batch_data(&w->batch, i), len);
+    }
+    if (udp_batch_echo(&w->batch, w->fd, n, cfg->prefix, cfg->prefix_len) < 0)
+      perror("sendmmsg fail");
+
+    atomic_fetch_add_explicit(&w->stats.rx_packets, packets,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->stats.rx_bytes, bytes, memory_order_relaxed);
+    atomic_store_explicit(&w->stats.drops, w->batch.rx_dropped,
+                          memory_order_relaxed);
+  }
+  return NULL;
+}
+
+/* steer 模式：从分发队列取报文，在共享套接字上回复 */
+static void *worker_steer_main(void *arg) {
+  Worker *w = arg;
+  const UdpShardConfig *cfg = w->shard->cfg;
+  unsigned head = atomic_load_explicit(&w->head, memory_order_relaxed);
+
+  while (1) {
+    unsigned tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+    uint64_t bytes = 0;
+    uint64_t value;
+
+    if (tail == head) {
+      /* 先声明要睡，再复查队列；与接收线程的“先入队再查 sleeping”配对 */
+      atomic_store_explicit(&w->sleeping, 1, memory_order_relaxed);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (atomic_load_explicit(&w->tail, memory_order_relaxed) == head) {
+        if (read(w->wake_fd, &value, sizeof(value)) < 0 && errno != EINTR)
+          perror("read eventfd fail");
+      }
+      atomic_store_explicit(&w->sleeping, 0, memory_order_relaxed);
+      continue;
+    }
+
+    unsigned n = tail - head;
+    if (n > (unsigned)cfg->batch)
+      n = (unsigned)cfg->batch;
+    for (unsigned i = 0; i < n; i++) {
+      SteerSlot *slot = &w->ring[(head + i) & (STEER_RING_SIZE - 1)];
+
+      bytes += slot->len;
+      if (!cfg->quiet)
+        print_datagram(cfg, w->id, &slot->addr, slot->data, slot->len);
+      if (udp_batch_add_reply(&w->batch, w->fd, &slot->addr, slot->data,
+                              slot->len, 0, cfg->prefix, cfg->prefix_len) < 0)
+        perror("sendmmsg fail");
+    }
+    if (udp_batch_flush(&w->batch, w->fd) < 0)
+      perror("sendmmsg fail");
+
+    /* 回复发出后才归还槽位：回复的 iovec 直接引用槽里的数据 */
+    head += n;
+    atomic_store_explicit(&w->head, head, memory_order_release);
+    atomic_fetch_add_explicit(&w->stats.rx_packets, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->stats.rx_bytes, bytes, memory_order_relaxed);
+  }
+  return NULL;
+}
+
+/* 按来源地址和端口选工作线程，同一来源总落在同一个线程 */
+static unsigned steer_hash(const struct sockaddr_in *addr, int workers) {
+  uint32_t h = addr->sin_addr.s_addr ^ ((uint32_t)addr->sin_port << 16);
+
+  h *= 0x9e3779b1u;
+  return (h >> 16) % (unsigned)workers;
+}
+
+/* steer 模式的接收线程：批量收下报文，按来源分发到各工作线程 */
+static void *steer_recv_main(void *arg) {
+  Shard *shard = arg;
+  const UdpShardConfig *cfg = shard->cfg;
+  char touched[SHARD_MAX_WORKERS];
+
+  while (1) {
+    int n = udp_batch_recv(&shard->batch, shard->fd);
+
+    if (n < 0) {
+      perror("recvmmsg fail");
+      continue;
+    }
+    memset(touched, 0, (size_t)cfg->workers);
+    for (int i = 0; i < n; i++) {
+      Worker *w = &shard->workers[steer_hash(&shard->batch.addr[i],
+                                             cfg->workers)];
+      unsigned tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+      unsigned head = atomic_load_explicit(&w->head, memory_order_acquire);
+
+      if (tail - head == STEER_RING_SIZE) {
+        atomic_fetch_add_explicit(&w->stats.drops, 1, memory_order_relaxed);
+        continue;
+      }
+      SteerSlot *slot = &w->ring[tail & (STEER_RING_SIZE - 1)];
+      slot->addr = shard->batch.addr[i];
+      slot->len = shard->batch.rx[i].msg_len;
+      memcpy(slot->data, udp_batch_data(&shard->batch, i), slot->len);
+      atomic_store_explicit(&w->tail, tail + 1, memory_order_release);
+      touched[w->id] = 1;
+    }
+    atomic_store_explicit(&shard->recv_drops, shard->batch.rx_dropped,
+                          memory_order_relaxed);
+
+    /* 一批只唤醒一次，且只唤醒正在睡的线程 */
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int i = 0; i < cfg->workers; i++) {
+      Worker *w = &shard->workers[i];
+      uint64_t one = 1;
+
+      if (touched[i] &&
+          atomic_load_explicit(&w->sleeping, memory_order_relaxed) &&
+          write(w->wake_fd, &one, sizeof(one)) < 0)
+        perror("write eventfd fail");
+    }
+  }
+  return NULL;
+}
+
+static int start_thread(pthread_t *thread, int cpu, void *(*fn)(void *),
+                        void *arg) {
+  pthread_attr_t attr;
+  int ret;
+
+  pthread_attr_init(&attr);
+  if (cpu >= 0) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+  }
+  ret = pthread_create(thread, &attr, fn, arg);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+  return 0;
+}
+
+/* 每秒打印一行：总 pps 与各线程的 pps / 累计丢包 */
+static void report_loop(Shard *shard) {
+  const UdpShardConfig *cfg = shard->cfg;
+  uint64_t last[SHARD_MAX_WORKERS] = {0};
+
+  while (1) {
+    char line[64 + SHARD_MAX_WORKERS * 48];
+    uint64_t total = 0;
+    int off = 0;
+
+    sleep(1);
+    for (int i = 0; i < cfg->workers; i++) {
+      WorkerStats *st = &shard->workers[i].stats;
+      uint64_t rx = atomic_load_explicit(&st->rx_packets, memory_order_relaxed);
+      uint64_t drops = atomic_load_explicit(&st->drops, memory_order_relaxed);
+
+      total += rx - last[i];
+      off += snprintf(line + off, sizeof(line) - (size_t)off,
+                      " | w%d %lu pps drop %lu", i,
+                      (unsigned long)(rx - last[i]), (unsigned long)drops);
+      last[i] = rx;
+    }
+    if (total == 0)
+      continue;
+    if (cfg->steer)
+      printf("[stats] %lu pps (recv socket drop %lu)%s\n",
+             (unsigned long)total,
+             (unsigned long)atomic_load_explicit(&shard->recv_drops,
+                                                 memory_order_relaxed),
+             line);
+    else
+      printf("[stats] %lu pps%s\n", (unsigned long)total, line);
+    fflush(stdout);
+  }
+}
+
+int udp_shard_run(const UdpShardConfig *cfg) {
+  Shard shard = {.cfg = cfg, .fd = -1};
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t buf_size = cfg->buf_size;
+
+  if (cfg->workers < 1 || cfg->workers > SHARD_MAX_WORKERS) {
+    fprintf(stderr, "udp_shard: workers must be 1..%d\n", SHARD_MAX_WORKERS);
+    return -1;
+  }
+  if (cfg->steer && (cfg->gro || buf_size > STEER_SLOT_DATA)) {
+    fprintf(stderr, "udp_shard: steer mode needs datagrams <= %d and no GRO\n",
+            STEER_SLOT_DATA);
+    return -1;
+  }
+  if (ncpu < 1)
+    ncpu = 1;
+
+  shard.workers = aligned_alloc(64, sizeof(Worker) * (size_t)cfg->workers);
+  if (shard.workers == NULL) {
+    perror("alloc workers fail");
+    return -1;
+  }
+  memset(shard.workers, 0, sizeof(Worker) * (size_t)cfg->workers);
+
+  if (cfg->steer) {
+    shard.fd = open_socket(cfg, 0);
+    if (shard.fd < 0 || udp_batch_init(&shard.batch, cfg->batch, buf_size, 0) < 0)
+      return -1;
+  }
+
+  /* 先建好所有套接字再启动线程，绑定失败时直接退出 */
+  for (int i = 0; i < cfg->workers; i++) {
+    Worker *w = &shard.workers[i];
+
+    w->shard = &shard;
+    w->id = i;
+    w->cpu = cfg->pin ? (int)(i % ncpu) : -1;
+    if (cfg->steer) {
+      w->fd = shard.fd;
+      w->ring = malloc(sizeof(SteerSlot) * STEER_RING_SIZE);
+      w->wake_fd = eventfd(0, EFD_CLOEXEC);
+      if (w->ring == NULL || w->wake_fd < 0) {
+        perror("alloc steer ring fail");
+        return -1;
+      }
+    } else {
+      w->fd = open_socket(cfg, 1);
+      if (w->fd < 0)
+        return -1;
+    }
+    if (udp_batch_init(&w->batch, cfg->batch, buf_size, cfg->gro) < 0) {
+      perror("udp_batch_init fail");
+      return -1;
+    }
+  }
+
+  for (int i = 0; i < cfg->workers; i++) {
+    Worker *w = &shard.workers[i];
+
+    if (start_thread(&w->thread, w->cpu,
+                     cfg->steer ? worker_steer_main : worker_socket_main,
+                     w) < 0) {
+      perror("pthread_create fail");
+      return -1;
+    }
+  }
+  if (cfg->steer &&
+      start_thread(&shard.recv_thread, -1, steer_recv_main, &shard) < 0) {
+    perror("pthread_create fail");
+    return -1;
+  }
+
+  printf("%d workers (%s%s), batch %d%s\n", cfg->workers,
+         cfg->steer ? "steer by source" : "SO_REUSEPORT",
+         cfg->pin ? ", pinned" : "", cfg->batch, cfg->gro ? ", GRO" : "");
+  fflush(stdout);
+  report_loop(&shard);
+  return 0;
+}
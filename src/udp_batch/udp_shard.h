@@ -0,0 +1,41 @@
+#ifndef UDP_SHARD_H
+#define UDP_SHARD_H
+
+#include <stddef.h>
+
+/*
+ * 多线程 UDP 收发：把一个端口的流量分给 N 个工作线程
+ * - 默认每个线程一个 SO_REUSEPORT 套接字，内核按四元组哈希选套接字，
+ *   同一来源的报文总由同一个线程处理，各线程之间没有共享状态
+ * - steer 模式（不依赖 SO_REUSEPORT，也不需要 eBPF）：一个套接字，
+ *   接收线程按来源地址哈希把报文放进各工作线程的 SPSC 队列，
+ *   工作线程在同一个套接字上回复；用于不支持 SO_REUSEPORT 的环境，
+ *   以及广播（SO_REUSEPORT 下每个套接字都会收到一份广播）
+ * - 可选把工作线程 i 绑定到 CPU i % ncpu
+ * - 每秒打印各线程的收包数与丢包数（套接字接收队列满 / 分发队列满）
+ *
+ * 收发都走 udp_batch：recvmmsg 批量接收，回复 prefix + 原数据，sendmmsg 批量发送
+ */
+
+typedef struct {
+  int port;
+  int workers;         /* 工作线程数 */
+  int batch;           /* 每次 recvmmsg 最多收的报文数 */
+  size_t buf_size;     /* 单个报文的最大长度 */
+  int gro;             /* 打开 UDP_GRO / UDP_SEGMENT（steer 模式不支持） */
+  int pin;             /* 工作线程绑定 CPU */
+  int steer;           /* 用户态按来源哈希分发，不用 SO_REUSEPORT */
+  int broadcast;       /* 套接字打开 SO_BROADCAST */
+  int quiet;           /* 不逐个打印报文 */
+  const char *label;   /* 逐个打印报文时的开头，如 "Received from" */
+  const char *prefix;  /* 回复前缀 */
+  size_t prefix_len;
+} UdpShardConfig;
+
+/*
+ * udp_shard_run - 创建套接字和工作线程，当前线程每秒打印统计，不再返回
+ * 返回值: 创建套接字或线程失败时返回-1
+ */
+int udp_shard_run(const UdpShardConfig *cfg);
+
+#endif
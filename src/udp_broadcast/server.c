@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,17 +8,77 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include "udp_batch.h"
+#include "udp_shard.h"
+
 #define BROADCAST_PORT 9999
 #define MAX_BUF_SIZE 1024
+#define REPLY_PREFIX "Broadcast received: "
 
-int main()
+void print_usage(const char *prog)
+{
+	udp_batch_usage(prog, "[-a]",
+		"  -t N      N worker threads (always steered: SO_REUSEPORT would copy every broadcast to all sockets)\n"
+		"  -a        pin worker i to CPU i % ncpu\n");
+}
+
+int main(int argc, char *argv[])
 {
 	int server_fd;
-	struct sockaddr_in server_addr, client_addr;
-	socklen_t client_len;
-	char recv_buf[MAX_BUF_SIZE];
-	int ret;
-	int opt = 1;
+	struct sockaddr_in server_addr;
+	int batch_size = 1, gro = 0, quiet = 0;
+	int workers = 1, pin = 0;
+	int ret, opt;
+	int on = 1;
+
+	while ((opt = getopt(argc, argv, "b:gqt:a")) != -1) {
+		switch (opt) {
+		case 'b':
+			batch_size = atoi(optarg);
+			break;
+		case 'g':
+			gro = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 't':
+			workers = atoi(optarg);
+			break;
+		case 'a':
+			pin = 1;
+			break;
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (batch_size < 1 || batch_size > UDP_BATCH_MAX || workers < 1
+	    || (gro && batch_size == 1 && workers == 1)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* 多线程：每个工作线程批量收发，套接字由 udp_shard 创建 */
+	if (workers > 1) {
+		UdpShardConfig cfg = {
+			.port = BROADCAST_PORT,
+			.workers = workers,
+			.batch = batch_size,
+			.buf_size = MAX_BUF_SIZE,
+			.gro = gro,
+			.pin = pin,
+			.steer = 1,
+			.broadcast = 1,
+			.quiet = quiet,
+			.label = "Received broadcast from",
+			.prefix = REPLY_PREFIX,
+			.prefix_len = sizeof(REPLY_PREFIX) - 1,
+		};
+
+		printf("UDP Broadcast Server listening on port %d...\n", BROADCAST_PORT);
+		return udp_shard_run(&cfg) < 0 ? -1 : 0;
+	}
 
 	/* 创建 UDP 套接字 */
 	server_fd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -27,7 +88,7 @@ int main()
 	}
 
 	/* 设置套接字选项 - 允许广播 */
-	ret = setsockopt(server_fd, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt));
+	ret = setsockopt(server_fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
 	if (ret < 0) {
 		perror("setsockopt SO_BROADCAST fail");
 		close(server_fd);
@@ -49,38 +110,13 @@ int main()
 		return -1;
 	}
 
-	printf("UDP Broadcast Server listening on port %d...\n", BROADCAST_PORT);
+	printf("UDP Broadcast Server listening on port %d (batch %d%s)...\n",
+	       BROADCAST_PORT, batch_size, gro ? ", GRO" : "");
 
 	/* 主循环：接收广播消息并回复 */
-	while (1) {
-		memset(&client_addr, 0, sizeof(client_addr));
-		client_len = sizeof(client_len);
-		memset(recv_buf, 0, sizeof(recv_buf));
-
-		ret = recvfrom(server_fd, recv_buf, MAX_BUF_SIZE, 0,
-					   (struct sockaddr *)&client_addr, &client_len);
-		if (ret < 0) {
-			perror("recvfrom fail");
-			continue;
-		}
-
-		printf("Received broadcast from %s:%d : %s\n",
-			   inet_ntoa(client_addr.sin_addr),
-			   ntohs(client_addr.sin_port),
-			   recv_buf);
-
-		/* 回复客户端 */
-		char send_buf[MAX_BUF_SIZE];
-		memset(send_buf, 0, sizeof(send_buf));
-		snprintf(send_buf, sizeof(send_buf), "Broadcast received: %s", recv_buf);
-
-		ret = sendto(server_fd, send_buf, strlen(send_buf), 0,
-					 (struct sockaddr *)&client_addr, client_len);
-		if (ret < 0) {
-			perror("sendto fail");
-		}
-	}
+	ret = udp_batch_serve(server_fd, batch_size, MAX_BUF_SIZE, gro, quiet,
+			      "Received broadcast from", REPLY_PREFIX);
 
 	close(server_fd);
-	return 0;
+	return ret < 0 ? -1 : 0;
 }
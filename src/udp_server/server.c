@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,17 +8,80 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include "udp_batch.h"
+#include "udp_shard.h"
+
 #define SERVER_PORT 8090
 #define MAX_BUF_SIZE 1024
+#define REPLY_PREFIX "Server received: "
 
-int main()
+void print_usage(const char *prog)
+{
+	udp_batch_usage(prog, "[-a] [-s]",
+		"  -t N      N worker threads, one SO_REUSEPORT socket each\n"
+		"  -a        pin worker i to CPU i % ncpu\n"
+		"  -s        one socket, steer datagrams to workers by source address in user space\n");
+}
+
+int main(int argc, char *argv[])
 {
 	int server_fd;
-	struct sockaddr_in server_addr, client_addr;
-	socklen_t client_len;
-	char recv_buf[MAX_BUF_SIZE];
-	char send_buf[MAX_BUF_SIZE];
-	int ret;
+	struct sockaddr_in server_addr;
+	int batch_size = 1, gro = 0, quiet = 0;
+	int workers = 1, pin = 0, steer = 0;
+	int ret, opt;
+
+	while ((opt = getopt(argc, argv, "b:gqt:as")) != -1) {
+		switch (opt) {
+		case 'b':
+			batch_size = atoi(optarg);
+			break;
+		case 'g':
+			gro = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 't':
+			workers = atoi(optarg);
+			break;
+		case 'a':
+			pin = 1;
+			break;
+		case 's':
+			steer = 1;
+			break;
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (batch_size < 1 || batch_size > UDP_BATCH_MAX || workers < 1
+	    || (gro && batch_size == 1 && workers == 1)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* 多线程：每个工作线程批量收发，套接字由 udp_shard 创建 */
+	if (workers > 1) {
+		UdpShardConfig cfg = {
+			.port = SERVER_PORT,
+			.workers = workers,
+			.batch = batch_size,
+			.buf_size = MAX_BUF_SIZE,
+			.gro = gro,
+			.pin = pin,
+			.steer = steer,
+			.broadcast = 0,
+			.quiet = quiet,
+			.label = "Received from",
+			.prefix = REPLY_PREFIX,
+			.prefix_len = sizeof(REPLY_PREFIX) - 1,
+		};
+
+		printf("UDP Server listening on port %d...\n", SERVER_PORT);
+		return udp_shard_run(&cfg) < 0 ? -1 : 0;
+	}
 
 	/* 创建 UDP 套接字 */
 	server_fd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -41,37 +105,13 @@ int main()
 		return -1;
 	}
 
-	printf("UDP Server listening on port %d...\n", SERVER_PORT);
+	printf("UDP Server listening on port %d (batch %d%s)...\n",
+	       SERVER_PORT, batch_size, gro ? ", GRO" : "");
 
 	/* 主循环：接收数据并回复 */
-	while (1) {
-		memset(&client_addr, 0, sizeof(client_addr));
-		client_len = sizeof(client_addr);
-		memset(recv_buf, 0, sizeof(recv_buf));
-
-		/* 接收数据 */
-		ret = recvfrom(server_fd, recv_buf, MAX_BUF_SIZE, 0,
-					   (struct sockaddr *)&client_addr, &client_len);
-		if (ret < 0) {
-			perror("recvfrom fail");
-			continue;
-		}
-
-		printf("Received from %s:%d : %s\n",
-			   inet_ntoa(client_addr.sin_addr),
-			   ntohs(client_addr.sin_port),
-			   recv_buf);
-
-		/* 回复客户端 */
-		memset(send_buf, 0, sizeof(send_buf));
-		snprintf(send_buf, sizeof(send_buf), "Server received: %s", recv_buf);
-		ret = sendto(server_fd, send_buf, strlen(send_buf), 0,
-					 (struct sockaddr *)&client_addr, client_len);
-		if (ret < 0) {
-			perror("sendto fail");
-		}
-	}
+	ret = udp_batch_serve(server_fd, batch_size, MAX_BUF_SIZE, gro, quiet,
+			      "Received from", REPLY_PREFIX);
 
 	close(server_fd);
-	return 0;
+	return ret < 0 ? -1 : 0;
 }
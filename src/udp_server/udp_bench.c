@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "udp_batch.h"
+
+/*
+ * UDP 回显服务器的每秒报文数（pps）测试
+ * 保持最多 window 个报文在途：收到多少回复就补发多少，
+ * 一段时间收不到回复则认为在途报文已丢失，重新开始发送
+ *
+ * 用法：先启动 ./build/server -q（逐个收发）或 ./build/server -q -b 64（批量），
+ * 再运行 ./build/udp_bench，比较两种模式的 pps
+ */
+
+#define DEFAULT_PORT 8090
+#define DEFAULT_HOST "127.0.0.1"
+#define MAX_SEND_BATCH 64
+#define LOSS_TIMEOUT_MS 100    /* 这么久没有回复就把在途报文记为丢失 */
+#define SOCK_BUF_SIZE (4 << 20)
+
+/*
+ * now_ms - 单调时钟毫秒数
+ */
+uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*
+ * send_burst - 发送 count 个 size 字节的报文
+ * gso 时用一次 UDP_SEGMENT sendmsg 发出，否则用一次 sendmmsg
+ * 返回值: 发出的报文数，发送缓冲区满返回0，出错返回-1
+ */
+int send_burst(int fd, const char *payload, size_t size, int count, int gso)
+{
+	struct mmsghdr msgs[MAX_SEND_BATCH];
+	struct iovec iov[MAX_SEND_BATCH];
+	int ret;
+
+	if (gso && count > 1) {
+		char ctrl[CMSG_SPACE(sizeof(uint16_t))] = {0};
+		struct iovec whole = { (void *)payload, size * (size_t)count };
+		struct msghdr hdr = {
+			.msg_iov = &whole,
+			.msg_iovlen = 1,
+			.msg_control = ctrl,
+			.msg_controllen = sizeof(ctrl),
+		};
+		struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+		uint16_t seg = (uint16_t)size;
+
+		cm->cmsg_level = SOL_UDP;
+		cm->cmsg_type = UDP_SEGMENT;
+		cm->cmsg_len = CMSG_LEN(sizeof(seg));
+		memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+		ret = sendmsg(fd, &hdr, 0);
+		if (ret < 0) {
+			return errno == EAGAIN || errno == ENOBUFS ? 0 : -1;
+		}
+		return count;
+	}
+
+	memset(msgs, 0, sizeof(msgs[0]) * (size_t)count);
+	for (int i = 0; i < count; i++) {
+		iov[i].iov_base = (void *)payload;
+		iov[i].iov_len = size;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	ret = sendmmsg(fd, msgs, (unsigned)count, 0);
+	if (ret < 0) {
+		return errno == EAGAIN || errno == ENOBUFS ? 0 : -1;
+	}
+	return ret;
+}
+
+void print_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-H host] [-P port] [-s size] [-w window] [-d seconds] [-g]\n"
+		"  -s size    payload bytes per datagram (default 64)\n"
+		"  -w window  datagrams in flight (default 256)\n"
+		"  -g         send with UDP_SEGMENT and receive with UDP_GRO\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *host = DEFAULT_HOST;
+	int port = DEFAULT_PORT, window = 256, seconds = 5, gso = 0;
+	size_t size = 64;
+	struct sockaddr_in server_addr;
+	UdpBatch batch;
+	char *payload;
+	int fd, opt, burst_max, buf_size = SOCK_BUF_SIZE;
+	uint64_t sent = 0, replies = 0, lost = 0;
+	int64_t outstanding = 0;
+
+	while ((opt = getopt(argc, argv, "H:P:s:w:d:g")) != -1) {
+		switch (opt) {
+		case 'H':
+			host = optarg;
+			break;
+		case 'P':
+			port = atoi(optarg);
+			break;
+		case 's':
+			size = (size_t)atoi(optarg);
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'g':
+			gso = 1;
+			break;
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (size < 1 || size > 1400 || window < 1 || seconds < 1) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* 一次 UDP_SEGMENT 最多 64 段且总长不超过 64KB */
+	burst_max = MAX_SEND_BATCH;
+	if (gso && (int)(UDP_GSO_MAX_BYTES / size) < burst_max) {
+		burst_max = (int)(UDP_GSO_MAX_BYTES / size);
+	}
+	payload = malloc(size * MAX_SEND_BATCH);
+	if (payload == NULL) {
+		perror("malloc fail");
+		return -1;
+	}
+	memset(payload, 'x', size * MAX_SEND_BATCH);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket fail");
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+	if (gso && udp_enable_gro(fd) < 0) {
+		perror("setsockopt UDP_GRO fail");
+		return -1;
+	}
+
+	/* 连接后只收这个服务器的回复，发送时也不用再带地址 */
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(port);
+	server_addr.sin_addr.s_addr = inet_addr(host);
+	if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+		perror("connect fail");
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	if (udp_batch_init(&batch, MAX_SEND_BATCH * 4, 2048, gso) < 0) {
+		perror("udp_batch_init fail");
+		return -1;
+	}
+
+	printf("udp_bench: %s:%d, %zu-byte datagrams, window %d, %ds%s\n",
+	       host, port, size, window, seconds, gso ? ", GSO/GRO" : "");
+
+	uint64_t start = now_ms(), end = start + (uint64_t)seconds * 1000;
+	uint64_t last_reply = start, now;
+
+	while ((now = now_ms()) < end) {
+		/* 补满发送窗口 */
+		while (outstanding < window) {
+			int count = window - outstanding < burst_max ? (int)(window - outstanding) : burst_max;
+			int ret = send_burst(fd, payload, size, count, gso);
+			if (ret < 0) {
+				perror("send fail");
+				return -1;
+			}
+			if (ret == 0) {
+				break;
+			}
+			outstanding += ret;
+			sent += ret;
+		}
+
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, 10) <= 0) {
+			if (now_ms() - last_reply > LOSS_TIMEOUT_MS && outstanding > 0) {
+				lost += outstanding;
+				outstanding = 0;
+				last_reply = now_ms();
+			}
+			continue;
+		}
+
+		/* 非阻塞套接字：把排队的回复全部收下 */
+		int n;
+		while ((n = udp_batch_recv(&batch, fd)) > 0) {
+			for (int i = 0; i < n; i++) {
+				uint32_t len = batch.rx[i].msg_len;
+				int seg = batch.seg_size[i];
+				int count = seg ? (int)((len + seg - 1) / seg) : 1;
+
+				replies += count;
+				outstanding -= count;
+			}
+		}
+		if (outstanding < 0) {
+			outstanding = 0;    /* 记为丢失后又到达的回复 */
+		}
+		last_reply = now_ms();
+	}
+
+	double elapsed = (double)(now_ms() - start) / 1000;
+	printf("sent %lu, replies %lu, lost %lu (%.2f%%)\n",
+	       (unsigned long)sent, (unsigned long)replies, (unsigned long)lost,
+	       sent ? 100.0 * (double)lost / (double)sent : 0.0);
+	printf("throughput %.0f replies/s (%.1f MB/s payload)\n",
+	       (double)replies / elapsed, (double)replies * (double)size / elapsed / 1e6);
+
+	udp_batch_free(&batch);
+	free(payload);
+	close(fd);
+	return 0;
+}